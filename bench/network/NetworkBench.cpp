@@ -0,0 +1,244 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/**
+ * Load generator for the running server: every connection keeps the given number of requests in flight and
+ * sends the next one as soon as response comes. Workload is 90% get and 10% set of 8 bytes over 1000 keys.
+ * Prints throughput along with median and 99th percentile of request latency, to compare network backends
+ * on the same storage.
+ *
+ * Server is connected over loopback TCP, or over UNIX socket if path is given instead of port: @name is the one
+ * in the abstract namespace. That compares transports on the same server.
+ *
+ * Usage: runNetworkBench [port|path] [connections] [depth] [seconds] [threads]
+ */
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Client connection, requests in flight are answered in order they have been sent
+struct Connection {
+    int socket = -1;
+    std::deque<Clock::time_point> sent;
+    std::string input;
+    std::size_t parsed = 0;
+    unsigned seed = 0;
+};
+
+// Address of the server
+struct Target {
+    sockaddr_storage addr;
+    socklen_t addr_len = 0;
+};
+
+// Parses port of the loopback TCP or UNIX socket path, returns false if that is neither
+bool ParseTarget(const std::string &arg, Target &target) {
+    std::memset(&target.addr, 0, sizeof(target.addr));
+    if (!arg.empty() && arg.find_first_not_of("0123456789") == std::string::npos) {
+        sockaddr_in &addr = reinterpret_cast<sockaddr_in &>(target.addr);
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(uint16_t(std::atoi(arg.c_str())));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        target.addr_len = sizeof(addr);
+        return true;
+    }
+
+    sockaddr_un &addr = reinterpret_cast<sockaddr_un &>(target.addr);
+    if (arg.size() < 2 || arg.size() >= sizeof(addr.sun_path)) {
+        return false;
+    }
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, arg.data(), arg.size());
+    target.addr_len = socklen_t(offsetof(sockaddr_un, sun_path) + arg.size());
+    if (arg[0] == '@') {
+        addr.sun_path[0] = '\0';
+    } else {
+        target.addr_len++;
+    }
+    return true;
+}
+
+// Appends the next request to out
+void NextRequest(Connection &conn, std::string &out) {
+    unsigned r = rand_r(&conn.seed);
+    std::string key = "key" + std::to_string(r % 1000);
+    if (r % 10 == 0) {
+        out += "set " + key + " 0 0 8\r\nxxxxxxxx\r\n";
+    } else {
+        out += "get " + key + "\r\n";
+    }
+    conn.sent.push_back(Clock::now());
+}
+
+bool SendAll(int socket, const std::string &out) {
+    std::size_t written = 0;
+    while (written < out.size()) {
+        ssize_t n = send(socket, out.data() + written, out.size() - written, MSG_NOSIGNAL);
+        if (n <= 0) {
+            return false;
+        }
+        written += n;
+    }
+    return true;
+}
+
+bool StartsWith(const char *line, std::size_t size, const char *prefix) {
+    std::size_t length = std::strlen(prefix);
+    return size >= length && std::memcmp(line, prefix, length) == 0;
+}
+
+// Checks if response line is the last one of the response
+bool Completes(const char *line, std::size_t size) {
+    return (size == 3 && StartsWith(line, size, "END")) || (size == 6 && StartsWith(line, size, "STORED")) ||
+           StartsWith(line, size, "NOT_STORED") || StartsWith(line, size, "ERROR") ||
+           StartsWith(line, size, "CLIENT_ERROR") || StartsWith(line, size, "SERVER_ERROR");
+}
+
+// Counts responses completed in the input: every one ends with END, STORED or an error line
+std::size_t Responses(Connection &conn) {
+    std::size_t count = 0;
+    std::size_t eol;
+    while ((eol = conn.input.find("\r\n", conn.parsed)) != std::string::npos) {
+        const char *line = conn.input.data() + conn.parsed;
+        std::size_t size = eol - conn.parsed;
+        conn.parsed = eol + 2;
+        if (Completes(line, size)) {
+            count++;
+        }
+    }
+    conn.input.erase(0, conn.parsed);
+    conn.parsed = 0;
+    return count;
+}
+
+// Drives connections until deadline, latencies of completed requests are collected in nanoseconds
+void Run(const Target &target, int connections, int depth, Clock::time_point deadline, std::vector<uint64_t> &latencies,
+         std::atomic<bool> &failed) {
+    int epoll = epoll_create1(EPOLL_CLOEXEC);
+    std::vector<Connection> conns(connections);
+    std::string out;
+    for (int i = 0; i < connections; i++) {
+        Connection &conn = conns[i];
+        conn.seed = unsigned(i * 7919 + reinterpret_cast<uintptr_t>(&conns) % 1000);
+        conn.socket = socket(target.addr.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (target.addr.ss_family == AF_INET) {
+            int one = 1;
+            setsockopt(conn.socket, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        }
+        if (connect(conn.socket, reinterpret_cast<const sockaddr *>(&target.addr), target.addr_len) != 0) {
+            std::cerr << "connect failed: " << strerror(errno) << std::endl;
+            failed = true;
+            return;
+        }
+
+        out.clear();
+        for (int j = 0; j < depth; j++) {
+            NextRequest(conn, out);
+        }
+        SendAll(conn.socket, out);
+
+        epoll_event event;
+        event.events = EPOLLIN;
+        event.data.ptr = &conn;
+        epoll_ctl(epoll, EPOLL_CTL_ADD, conn.socket, &event);
+    }
+
+    char buffer[65536];
+    epoll_event events[64];
+    while (!failed && Clock::now() < deadline) {
+        int n = epoll_wait(epoll, events, 64, 100);
+        for (int i = 0; i < n; i++) {
+            Connection &conn = *static_cast<Connection *>(events[i].data.ptr);
+            ssize_t got = recv(conn.socket, buffer, sizeof(buffer), 0);
+            if (got <= 0) {
+                std::cerr << "connection closed by server" << std::endl;
+                failed = true;
+                break;
+            }
+            conn.input.append(buffer, got);
+
+            Clock::time_point now = Clock::now();
+            out.clear();
+            for (std::size_t done = Responses(conn); done > 0 && !conn.sent.empty(); done--) {
+                auto latency = std::chrono::duration_cast<std::chrono::nanoseconds>(now - conn.sent.front());
+                latencies.push_back(latency.count());
+                conn.sent.pop_front();
+                NextRequest(conn, out);
+            }
+            if (!out.empty() && !SendAll(conn.socket, out)) {
+                failed = true;
+            }
+        }
+    }
+
+    for (auto &conn : conns) {
+        close(conn.socket);
+    }
+    close(epoll);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    Target target;
+    bool parsed = ParseTarget(argc > 1 ? argv[1] : "8080", target);
+    int connections = argc > 2 ? std::atoi(argv[2]) : 64;
+    int depth = argc > 3 ? std::atoi(argv[3]) : 1;
+    double seconds = argc > 4 ? std::atof(argv[4]) : 5.0;
+    int threads = argc > 5 ? std::atoi(argv[5]) : 2;
+    if (!parsed || connections < threads || depth < 1 || threads < 1 || seconds <= 0) {
+        std::cerr << "Usage: " << argv[0] << " [port|path] [connections] [depth] [seconds] [threads]" << std::endl;
+        return 1;
+    }
+
+    std::atomic<bool> failed(false);
+    std::vector<std::vector<uint64_t>> latencies(threads);
+    std::vector<std::thread> pool;
+    Clock::time_point start = Clock::now();
+    Clock::time_point deadline = start + std::chrono::microseconds(int64_t(seconds * 1e6));
+    for (int i = 0; i < threads; i++) {
+        int share = connections / threads + (i < connections % threads ? 1 : 0);
+        pool.emplace_back(Run, std::cref(target), share, depth, deadline, std::ref(latencies[i]), std::ref(failed));
+    }
+    for (auto &t : pool) {
+        t.join();
+    }
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    if (failed) {
+        return 1;
+    }
+
+    std::vector<uint64_t> all;
+    for (auto &l : latencies) {
+        all.insert(all.end(), l.begin(), l.end());
+    }
+    if (all.empty()) {
+        std::cerr << "no responses" << std::endl;
+        return 1;
+    }
+    std::sort(all.begin(), all.end());
+    std::cout << std::fixed << std::setprecision(0) << "connections " << connections << " depth " << depth
+              << ": " << all.size() / elapsed << " ops/s, p50 " << std::setprecision(1)
+              << all[all.size() / 2] / 1000.0 << " us, p99 " << all[all.size() * 99 / 100] / 1000.0 << " us"
+              << std::endl;
+    return 0;
+}
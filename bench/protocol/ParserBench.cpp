@@ -0,0 +1,142 @@
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <string>
+
+#include "protocol/Parser.h"
+#include "protocol/Scan.h"
+
+using namespace Afina;
+
+/**
+ * Throughput of the text protocol parser: stream of commands is fed to the parser the same way connection
+ * does, data blocks are skipped. Besides the whole parser, scanning kernels are measured alone both in
+ * vector and scalar versions.
+ *
+ * Traffic is either read from the file, which is a raw capture of what clients sent, or generated: mix
+ * of single and multi key gets with sets of short values, the way cache is usually used.
+ *
+ * Usage: runParserBench [capture file] [seconds per run]
+ */
+
+namespace {
+
+std::string Generate(std::size_t size) {
+    std::string traffic;
+    unsigned seed = 1;
+    while (traffic.size() < size) {
+        int r = rand_r(&seed) % 10;
+        std::string key = "user:session:" + std::to_string(rand_r(&seed) % 100000);
+        if (r < 6) {
+            traffic += "get " + key + "\r\n";
+        } else if (r < 8) {
+            traffic += "get";
+            for (int i = 0; i < 8; i++) {
+                traffic += " " + key + std::to_string(i);
+            }
+            traffic += "\r\n";
+        } else {
+            std::string value(16 + rand_r(&seed) % 64, 'v');
+            traffic += "set " + key + " 0 3600 " + std::to_string(value.size()) + "\r\n" + value + "\r\n";
+        }
+    }
+    return traffic;
+}
+
+// Runs function over the traffic until time is out, returns GB/s
+template <typename F> double Measure(const std::string &traffic, std::chrono::milliseconds duration, F &&run) {
+    auto start = std::chrono::steady_clock::now();
+    std::size_t bytes = 0;
+    do {
+        run(traffic.data(), traffic.size());
+        bytes += traffic.size();
+    } while (std::chrono::steady_clock::now() - start < duration);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return bytes / elapsed.count() / 1e9;
+}
+
+// Keeps compiler from throwing away computations
+volatile std::size_t sink;
+
+} // namespace
+
+int main(int argc, char **argv) {
+    std::string traffic;
+    if (argc > 1 && std::string(argv[1]) != "-") {
+        std::ifstream file(argv[1], std::ios::binary);
+        if (!file) {
+            std::cerr << "Can't read " << argv[1] << std::endl;
+            return 1;
+        }
+        traffic.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    } else {
+        traffic = Generate(16 << 20);
+    }
+    std::chrono::milliseconds duration(argc > 2 ? std::atoi(argv[2]) * 1000 : 2000);
+
+    std::cout << "traffic: " << traffic.size() << " bytes, run: " << duration.count() << "ms" << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+
+    Protocol::Parser parser;
+    double rate = Measure(traffic, duration, [&parser](const char *p, std::size_t size) {
+        std::size_t commands = 0;
+        while (size > 0) {
+            std::size_t parsed = 0, body_size = 0;
+            bool complete = parser.Parse(p, size, parsed);
+            p += parsed;
+            size -= parsed;
+            if (!complete) {
+                break;
+            }
+
+            parser.Build(body_size);
+            if (body_size > 0) {
+                body_size += 2;
+            }
+            p += body_size;
+            size -= body_size;
+            parser.Reset();
+            commands++;
+        }
+        sink = commands;
+    });
+    std::cout << std::setw(24) << "Parser" << std::setw(10) << rate << " GB/s" << std::endl;
+
+    rate = Measure(traffic, duration, [](const char *p, std::size_t size) {
+        std::size_t lines = 0;
+        for (std::size_t eol; (eol = Protocol::Scan::Find(p, size, '\n')) < size; lines++) {
+            p += eol + 1;
+            size -= eol + 1;
+        }
+        sink = lines;
+    });
+    std::cout << std::setw(24) << "Scan::Find" << std::setw(10) << rate << " GB/s" << std::endl;
+
+    rate = Measure(traffic, duration, [](const char *p, std::size_t size) {
+        std::size_t lines = 0;
+        for (std::size_t eol; (eol = Protocol::Scan::FindScalar(p, size, '\n')) < size; lines++) {
+            p += eol + 1;
+            size -= eol + 1;
+        }
+        sink = lines;
+    });
+    std::cout << std::setw(24) << "Scan::FindScalar" << std::setw(10) << rate << " GB/s" << std::endl;
+
+    rate = Measure(traffic, duration, [](const char *p, std::size_t size) {
+        std::size_t tokens = 0;
+        Protocol::Scan::Split(p, size, [&tokens](const char *, std::size_t) { return ++tokens; });
+        sink = tokens;
+    });
+    std::cout << std::setw(24) << "Scan::Split" << std::setw(10) << rate << " GB/s" << std::endl;
+
+    rate = Measure(traffic, duration, [](const char *p, std::size_t size) {
+        std::size_t tokens = 0;
+        Protocol::Scan::SplitScalar(p, size, [&tokens](const char *, std::size_t) { return ++tokens; });
+        sink = tokens;
+    });
+    std::cout << std::setw(24) << "Scan::SplitScalar" << std::setw(10) << rate << " GB/s" << std::endl;
+    return 0;
+}
@@ -0,0 +1,182 @@
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include <malloc.h>
+
+#include <afina/execute/Command.h>
+
+#include "protocol/Parser.h"
+#include "storage/SimpleLRU.h"
+
+using namespace Afina;
+
+/**
+ * Memory allocations made while processing requests: stream of requests goes through the same steps blocking
+ * servers take - parse, build command, collect data block, execute against storage and form response. Every
+ * heap allocation is counted by replacing malloc family with wrappers around glibc implementation.
+ *
+ * First round warms up buffers and storage, after that request processing is expected to allocate nothing.
+ * Benchmark fails if it does.
+ *
+ * Usage: runRequestBench [requests per workload]
+ */
+
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *p, size_t size);
+void __libc_free(void *p);
+}
+
+namespace {
+
+// Number of allocations made so far, benchmark is single threaded
+std::size_t allocations = 0;
+
+} // namespace
+
+extern "C" {
+void *malloc(size_t size) {
+    allocations++;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+    allocations++;
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *p, size_t size) {
+    allocations++;
+    return __libc_realloc(p, size);
+}
+
+void free(void *p) { __libc_free(p); }
+}
+
+namespace {
+
+// Connection state, mirrors what blocking servers keep
+struct Connection {
+    Protocol::Parser parser;
+    Execute::Command *command = nullptr;
+    std::size_t arg_remains = 0;
+    std::string argument;
+    std::string result;
+    std::size_t responses = 0;
+
+    // Processes block of data as if it has been read from the socket
+    void Process(Storage &storage, const char *input, std::size_t size) {
+        while (size > 0) {
+            if (command == nullptr) {
+                std::size_t parsed = 0;
+                if (parser.Parse(input, size, parsed)) {
+                    command = parser.Build(arg_remains);
+                    if (arg_remains > 0) {
+                        arg_remains += 2;
+                    }
+                }
+                input += parsed;
+                size -= parsed;
+            }
+
+            if (command != nullptr && arg_remains > 0) {
+                std::size_t to_read = std::min(arg_remains, size);
+                argument.append(input, to_read);
+                input += to_read;
+                size -= to_read;
+                arg_remains -= to_read;
+            }
+
+            if (command != nullptr && arg_remains == 0) {
+                if (argument.size() >= 2) {
+                    argument.resize(argument.size() - 2);
+                }
+                command->Execute(storage, argument, result);
+                result += "\r\n";
+                responses += result.size();
+
+                command = nullptr;
+                argument.resize(0);
+                parser.Reset();
+            }
+        }
+    }
+};
+
+const int keys_count = 1000;
+
+std::string Key(int i) { return "user:session:" + std::to_string(100000 + i); }
+
+// Builds stream of requests for the given workload
+std::string Workload(const std::string &name) {
+    std::string stream;
+    for (int i = 0; i < keys_count; i++) {
+        if (name == "get") {
+            stream += "get " + Key(i) + "\r\n";
+        } else if (name == "multiget") {
+            stream += "get";
+            for (int j = 0; j < 8; j++) {
+                stream += " " + Key((i + j * 97) % keys_count);
+            }
+            stream += "\r\n";
+        } else if (name == "set") {
+            stream += "set " + Key(i) + " 0 0 32\r\n" + std::string(32, 'a' + i % 26) + "\r\n";
+        } else if (name == "touch") {
+            stream += "touch " + Key(i) + " 3600\r\n";
+        } else if (name == "gat") {
+            stream += "gat 3600 " + Key(i) + " " + Key(keys_count - i - 1) + "\r\n";
+        }
+    }
+    return stream;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    std::size_t requests = argc > 1 ? std::atoi(argv[1]) : 1000000;
+
+    Backend::SimpleLRU storage(1 << 20);
+    for (int i = 0; i < keys_count; i++) {
+        storage.Put(Key(i), std::string(32, 'v'));
+    }
+
+    std::cout << "requests: " << requests << std::endl;
+    std::cout << std::setw(10) << "workload" << std::setw(16) << "warm-up allocs" << std::setw(18) << "allocs/request"
+              << std::setw(16) << "Mrequests/s" << std::endl;
+
+    bool failed = false;
+    for (auto &name : {"get", "multiget", "set", "touch", "gat"}) {
+        std::string stream = Workload(name);
+
+        // Connection reads data in chunks, make the last request in chunk split
+        Connection connection;
+        auto round = [&connection, &storage, &stream]() {
+            for (std::size_t pos = 0; pos < stream.size(); pos += 4096) {
+                connection.Process(storage, stream.data() + pos, std::min<std::size_t>(4096, stream.size() - pos));
+            }
+        };
+        std::size_t before = allocations;
+        round();
+        std::size_t warmup = allocations - before;
+
+        before = allocations;
+        auto start = std::chrono::steady_clock::now();
+        std::size_t rounds = (requests + keys_count - 1) / keys_count;
+        for (std::size_t i = 0; i < rounds; i++) {
+            round();
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        std::size_t made = allocations - before;
+
+        double per_request = double(made) / (rounds * keys_count);
+        std::cout << std::setw(10) << name << std::setw(16) << warmup << std::fixed << std::setprecision(4)
+                  << std::setw(18) << per_request
+                  << std::setprecision(2) << std::setw(16) << rounds * keys_count / elapsed.count() / 1e6 << std::endl;
+        failed = failed || made > 0;
+    }
+    return failed ? 1 : 0;
+}
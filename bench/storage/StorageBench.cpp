@@ -0,0 +1,97 @@
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "storage/LockFreeLRU.h"
+#include "storage/ThreadSafeSimpleLRU.h"
+
+using namespace Afina;
+
+/**
+ * Throughput of concurrent storages on a read mostly workload: every thread picks random key and
+ * either reads it or overwrites with the new value. Storage is sized to hold about a half of the keys,
+ * so writes keep eviction going all the time.
+ *
+ * Usage: runStorageBench [max threads] [read percent] [seconds per run]
+ */
+
+namespace {
+
+const int keys_count = 100000;
+const int value_size = 32;
+
+// Returns number of operations done by all threads in the given time
+std::size_t Run(Storage &storage, int threads, int read_percent, std::chrono::milliseconds duration) {
+    std::vector<std::string> keys;
+    for (int i = 0; i < keys_count; i++) {
+        keys.push_back("key" + std::to_string(i));
+    }
+    const std::string value(value_size, 'v');
+    for (auto &key : keys) {
+        storage.Put(key, value);
+    }
+
+    std::atomic<bool> stop(false);
+    std::atomic<std::size_t> total(0);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&, t]() {
+            unsigned seed = t + 1;
+            std::string out;
+            std::size_t ops = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                // Check clock once in a while only
+                for (int i = 0; i < 256; i++, ops++) {
+                    const std::string &key = keys[rand_r(&seed) % keys_count];
+                    if (int(rand_r(&seed) % 100) < read_percent) {
+                        storage.Get(key, out);
+                    } else {
+                        storage.Put(key, value);
+                    }
+                }
+            }
+            total += ops;
+        });
+    }
+
+    std::this_thread::sleep_for(duration);
+    stop = true;
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    return total;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    int max_threads = argc > 1 ? std::atoi(argv[1]) : int(std::thread::hardware_concurrency());
+    int read_percent = argc > 2 ? std::atoi(argv[2]) : 90;
+    std::chrono::milliseconds duration(argc > 3 ? std::atoi(argv[3]) * 1000 : 2000);
+    std::size_t max_size = keys_count * (value_size + 10) / 2;
+
+    std::cout << "reads: " << read_percent << "%, keys: " << keys_count << ", run: " << duration.count() << "ms"
+              << std::endl;
+    std::cout << std::setw(8) << "threads" << std::setw(16) << "mt_lru Mops/s" << std::setw(20) << "mt_lockfree Mops/s"
+              << std::endl;
+
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        double seconds = std::chrono::duration<double>(duration).count();
+
+        std::unique_ptr<Storage> locked(new Backend::ThreadSafeSimplLRU(max_size));
+        double locked_rate = Run(*locked, threads, read_percent, duration) / seconds / 1e6;
+
+        std::unique_ptr<Storage> lockfree(new Backend::LockFreeLRU(max_size));
+        double lockfree_rate = Run(*lockfree, threads, read_percent, duration) / seconds / 1e6;
+
+        std::cout << std::setw(8) << threads << std::fixed << std::setprecision(2) << std::setw(16) << locked_rate
+                  << std::setw(20) << lockfree_rate << std::endl;
+    }
+    return 0;
+}
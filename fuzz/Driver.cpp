@@ -0,0 +1,97 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+/**
+ * Standalone driver for fuzz targets, used when compiler has no libFuzzer. Every file given is run as is,
+ * then random mutations of them are run: bytes are flipped, removed, duplicated or replaced by protocol
+ * tokens. There is no coverage feedback, but mutations are cheap and deterministic for the given seed, so
+ * that failure could be reproduced.
+ *
+ * Usage: runXFuzzer [-runs=N] [-seed=N] [corpus files...]
+ */
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, std::size_t size);
+
+namespace {
+
+// Pieces of requests worth inserting, mutations of single bytes hardly ever build them
+const char *const dictionary[] = {
+    "get ", "gets ", "gat ", "set ", "add ", "replace ", "append ", "prepend ", "delete ", "touch ", "stats", "mg ",
+    "ms ", "md ", "ma ", "mn", " noreply", "\r\n", "\r", "\n", " 0", " 1", " -1", " 4294967296", " k", " v", " T10",
+    " q", " O", " C1", " MA", "\x80", "\x81", "\x00", "*2\r\n", "*3\r\n", "$3\r\n", "$-1\r\n", "GET", "SET", "DEL",
+    "INCR", "EXPIRE", " EX 10", " PX 5", " NX", " XX"};
+
+void Mutate(std::string &input, unsigned &seed) {
+    std::size_t pos = input.empty() ? 0 : rand_r(&seed) % input.size();
+    switch (rand_r(&seed) % 4) {
+    case 0:
+        if (!input.empty()) {
+            input[pos] = char(rand_r(&seed));
+        }
+        break;
+    case 1:
+        input.erase(pos, rand_r(&seed) % 16);
+        break;
+    case 2:
+        input.insert(pos, input.substr(pos, rand_r(&seed) % 64));
+        break;
+    default: {
+        const char *token = dictionary[rand_r(&seed) % (sizeof(dictionary) / sizeof(dictionary[0]))];
+        input.insert(pos, token, std::max<std::size_t>(1, std::strlen(token)));
+        break;
+    }
+    }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    long runs = 100000;
+    unsigned seed = 1;
+    std::vector<std::string> corpus;
+    for (int i = 1; i < argc; i++) {
+        if (std::strncmp(argv[i], "-runs=", 6) == 0) {
+            runs = std::atol(argv[i] + 6);
+        } else if (std::strncmp(argv[i], "-seed=", 6) == 0) {
+            seed = unsigned(std::atol(argv[i] + 6));
+        } else {
+            std::ifstream file(argv[i], std::ios::binary);
+            if (!file) {
+                std::cerr << "Can't read " << argv[i] << std::endl;
+                return 1;
+            }
+            corpus.emplace_back(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        }
+    }
+    if (corpus.empty()) {
+        corpus.emplace_back("\x07set foo 0 0 3\r\nbar\r\nget foo\r\n");
+        corpus.emplace_back("\x85*3\r\n$3\r\nSET\r\n$3\r\nfoo\r\n$3\r\nbar\r\n"
+                            "*2\r\n$4\r\nINCR\r\n$1\r\nn\r\nDEL foo n\r\n");
+    }
+
+    for (const auto &input : corpus) {
+        LLVMFuzzerTestOneInput(reinterpret_cast<const uint8_t *>(input.data()), input.size());
+    }
+
+    std::cout << "Running " << runs << " mutations, seed " << seed << std::endl;
+    for (long n = 0; n < runs; n++) {
+        std::string input = corpus[rand_r(&seed) % corpus.size()];
+        for (int m = rand_r(&seed) % 8; m >= 0; m--) {
+            Mutate(input, seed);
+        }
+        LLVMFuzzerTestOneInput(reinterpret_cast<const uint8_t *>(input.data()), input.size());
+
+        // Some mutants join the corpus, so that mutations pile up and longer streams get tested too
+        if (n % 1024 == 0 && input.size() < 65536) {
+            corpus.push_back(input);
+        }
+    }
+    std::cout << "Done" << std::endl;
+    return 0;
+}
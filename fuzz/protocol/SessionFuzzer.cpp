@@ -0,0 +1,49 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include "protocol/Session.h"
+#include "storage/SimpleLRU.h"
+
+using namespace Afina;
+
+/**
+ * Feeds arbitrary bytes into the protocol session, the way connection does. Lower bits of the first byte
+ * tell how the rest is split between reads, so that commands are cut at random places and partial lines,
+ * packets and data blocks get exercised. The highest bit switches session to Redis protocol. Storage is tiny
+ * to make eviction happen all the time.
+ *
+ * Session must neither crash nor throw: malformed input is answered with errors.
+ */
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, std::size_t size) {
+    if (size == 0) {
+        return 0;
+    }
+    std::size_t chunk = std::size_t(data[0] & 0x7f) + 1;
+    bool redis = (data[0] & 0x80) != 0;
+    const char *input = reinterpret_cast<const char *>(data + 1);
+    size--;
+
+    Backend::SimpleLRU storage(1024, Backend::WyHash(0));
+    Protocol::Session session(storage, redis);
+    std::string out;
+    for (std::size_t pos = 0; pos < size; pos += chunk) {
+        // Large data blocks are read directly the way blocking servers do
+        std::size_t length = size - pos < chunk ? size - pos : chunk, direct_size = 0;
+        char *direct = session.BodyBuffer(direct_size);
+        bool alive;
+        if (direct != nullptr) {
+            length = length < direct_size ? length : direct_size;
+            std::memcpy(direct, input + pos, length);
+            alive = session.BodyReceived(length, out);
+        } else {
+            alive = session.Process(input + pos, length, out);
+        }
+        if (!alive) {
+            break;
+        }
+        out.clear();
+    }
+    return 0;
+}
@@ -1,21 +1,132 @@
 #ifndef AFINA_STORAGE_H
 #define AFINA_STORAGE_H
 
+#include <cstdint>
+#include <ctime>
+#include <memory>
 #include <string>
+#include <vector>
+
+#include <afina/StringRef.h>
 
 namespace Afina {
 
+/**
+ * # Item evicted from storage
+ * Owns memory of the item that was stored in storage before eviction
+ */
+struct EvictedItem {
+    std::string key;
+    std::string value;
+    uint32_t flags;
+};
+
+/**
+ * # Receives items evicted from storage
+ * Could be used to feed next storage tier or to notify other parties about
+ * data that is no longer cached
+ */
+class EvictionListener {
+public:
+    virtual ~EvictionListener() {}
+
+    /**
+     * Called with a batch of items storage has evicted to free space for new data. Listener
+     * takes ownership over the batch, item memory is moved from storage without copy.
+     *
+     * Method is called outside of storage critical section, but on the thread that caused
+     * eviction. Listener should offload heavy processing to its own threads.
+     *
+     * @param items evicted in order from oldest to newest
+     */
+    virtual void OnEvict(std::vector<EvictedItem> &&items) = 0;
+};
+
+/**
+ * # Item as seen by ItemUpdater
+ * Besides value and flags every item carries CAS token, unique number that changes on every store, and
+ * a pair of marks used by meta commands to implement stale-while-revalidate
+ */
+struct ItemState {
+    // Value is valid only during ItemUpdater#Apply call
+    const std::string *value;
+    uint32_t flags;
+    // Number of seconds left before item expires, -1 if item never expires
+    int32_t ttl;
+    uint64_t cas;
+    // Item has been invalidated, but still could be served while someone recaches it
+    bool stale;
+    // Some client has been told to recache the item already
+    bool win_sent;
+};
+
+/**
+ * # Change ItemUpdater asks storage to make
+ */
+struct ItemUpdate {
+    // New value, nullptr keeps the current one. Item gets new CAS token only if value is stored
+    const std::string *value = nullptr;
+    // Flags stored along with new value
+    uint32_t flags = 0;
+    // Expiration time, see Storage#Touch. Item that doesn't exist yet always gets it, existing one only
+    // if touch is set
+    int32_t expire = 0;
+    bool touch = false;
+    // Marks of the item after update, see ItemState
+    bool stale = false;
+    bool win_sent = false;
+};
+
+/**
+ * # Read-modify-write access to a single item
+ * Storage calls Apply with the current state of the item and performs action updater has chosen
+ * atomically, nobody could change item in between. That is what conditional updates such as compare and
+ * swap or increment are built from.
+ *
+ * Lock-free storages could call Apply more than once if item has been changed concurrently, so updater
+ * must overwrite its results on every call rather than accumulate them.
+ */
+class ItemUpdater {
+public:
+    enum class Action { kKeep, kStore, kDelete };
+
+    virtual ~ItemUpdater() {}
+
+    /**
+     * @param item current state of the item, nullptr if there is no such item
+     * @param update output parameter describing change to be made if kStore is returned. Storing
+     * item that doesn't exist requires value
+     * @return what storage should do with the item
+     */
+    virtual Action Apply(const ItemState *item, ItemUpdate &update) = 0;
+};
+
 /**
  *
  */
 class Storage {
 public:
-    Storage() {}
+    Storage() : _eviction_batch(0) {}
     virtual ~Storage() {}
 
     virtual void Start() {}
     virtual void Stop() {}
 
+    /**
+     * Installs listener to be notified about items evicted from the storage. Evicted items are
+     * collected and passed to listener once batch gets full, the rest is delivered on Stop.
+     *
+     * Only items dropped to free space are reported, explicitly deleted or overwritten are not.
+     * Method must be called before storage starts serving requests
+     *
+     * @param listener to be notified, nullptr disables notifications
+     * @param batch number of items to collect before listener gets called
+     */
+    void SetEvictionListener(std::shared_ptr<EvictionListener> listener, std::size_t batch = 64) {
+        _eviction_listener = std::move(listener);
+        _eviction_batch = batch > 0 ? batch : 1;
+    }
+
     /**
      * Stores association between given key/value pair.
      * If key is already present in storage then replace existing value by
@@ -27,8 +138,11 @@ public:
      *
      * @param key to be associated with value
      * @param value to be assigned for the key
+     * @param flags opaque client flags stored along with the value
+     * @param expire expiration time, see Storage#Touch
      */
-    virtual bool Put(const std::string &key, const std::string &value) = 0;
+    virtual bool Put(StringRef key, const std::string &value, uint32_t flags = 0,
+                     int32_t expire = 0) = 0;
 
     /**
      * Stores association between given key/value pair if key isn't present in
@@ -40,8 +154,11 @@ public:
      *
      * @param key to be associated with value
      * @param value to be assigned for the key
+     * @param flags opaque client flags stored along with the value
+     * @param expire expiration time, see Storage#Touch
      */
-    virtual bool PutIfAbsent(const std::string &key, const std::string &value) = 0;
+    virtual bool PutIfAbsent(StringRef key, const std::string &value, uint32_t flags = 0,
+                             int32_t expire = 0) = 0;
 
     /**
      * Updates existing association between given key/value pair
@@ -53,8 +170,11 @@ public:
      *
      * @param key to be associated with value
      * @param value to be assigned for the key
+     * @param flags opaque client flags stored along with the value
+     * @param expire expiration time, see Storage#Touch
      */
-    virtual bool Set(const std::string &key, const std::string &value) = 0;
+    virtual bool Set(StringRef key, const std::string &value, uint32_t flags = 0,
+                     int32_t expire = 0) = 0;
 
     /**
      * Removes association for the given key
@@ -70,7 +190,7 @@ public:
      *
      * @param key to be removed
      */
-    virtual bool Delete(const std::string &key) = 0;
+    virtual bool Delete(StringRef key) = 0;
 
     /**
      * Retrive key for the given value
@@ -82,8 +202,74 @@ public:
      *
      * @param key to retrive1 value for
      * @param value output parameter to copy value to
+     * @param flags optional output parameter to copy flags stored with the value to
+     * @param expire optional output parameter to store number of seconds left before item
+     * expires, 0 if item never expires
+     */
+    virtual bool Get(StringRef key, std::string &value, uint32_t *flags = nullptr,
+                     int32_t *expire = nullptr) = 0;
+
+    /**
+     * Updates expiration time of the existing association. If requested key doesn't present
+     * in storage method returns false and doesn't change anything
+     *
+     * Expiration time follows memcached rules:
+     * - 0 means that item never expires
+     * - negative value means that item expired already
+     * - up to 30 days (2592000 seconds) it is offset in seconds from the current time
+     * - otherwise it is absolute unix time
+     *
+     * Expired item is not visible for any storage operation
+     *
+     * @param key to update expiration time for
+     * @param expire new expiration time
+     */
+    virtual bool Touch(StringRef key, int32_t expire) = 0;
+
+    /**
+     * Retrive value for the given key and updates its expiration time in a single
+     * operation, see Storage#Get and Storage#Touch
+     *
+     * @param key to retrive value for
+     * @param expire new expiration time
+     * @param value output parameter to copy value to
+     * @param flags optional output parameter to copy flags stored with the value to
+     */
+    virtual bool GetAndTouch(StringRef key, int32_t expire, std::string &value,
+                             uint32_t *flags = nullptr) = 0;
+
+    /**
+     * Reads and possibly changes the item in a single atomic step, see ItemUpdater. Regular operations
+     * above reset stale marks and assign new CAS token on every store as well
+     *
+     * Method returns true if item is found and kept or if the action updater has chosen was performed.
+     * It returns false if store or delete has failed, for example because item doesn't fit into storage
+     * or doesn't exist
+     *
+     * @param key of the item
+     * @param updater decides what to do with the item
+     * @param cas optional output parameter to store CAS token of the item after update
      */
-    virtual bool Get(const std::string &key, std::string &value) = 0;
+    virtual bool Update(StringRef key, ItemUpdater &updater, uint64_t *cas = nullptr) = 0;
+
+protected:
+    // Converts expiration time in the Storage#Touch format into absolute time, 0 if item never expires
+    static std::time_t ExpireAt(int32_t expire, std::time_t now) {
+        if (expire == 0) {
+            return 0;
+        } else if (expire < 0) {
+            return now;
+        } else if (expire <= 2592000) {
+            return now + expire;
+        }
+        return expire;
+    }
+
+    // Listener for evicted items, could be nullptr
+    std::shared_ptr<EvictionListener> _eviction_listener;
+
+    // Number of evicted items to be passed to listener at once
+    std::size_t _eviction_batch;
 };
 
 } // namespace Afina
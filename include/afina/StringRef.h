@@ -0,0 +1,65 @@
+#ifndef AFINA_STRING_REF_H
+#define AFINA_STRING_REF_H
+
+#include <cstddef>
+#include <cstring>
+#include <ostream>
+#include <string>
+
+namespace Afina {
+
+/**
+ * # Non owning reference to a string
+ * Points to bytes owned by someone else, for example connection read buffer, so that keys could be passed
+ * from the network down to the storage without being copied. Whoever returns reference tells for how long
+ * referenced bytes stay valid.
+ *
+ * That is what std::string_view is in C++17.
+ */
+class StringRef {
+public:
+    constexpr StringRef() : _data(nullptr), _size(0) {}
+    constexpr StringRef(const char *data, std::size_t size) : _data(data), _size(size) {}
+    StringRef(const char *str) : _data(str), _size(std::strlen(str)) {}
+    StringRef(const std::string &str) : _data(str.data()), _size(str.size()) {}
+
+    inline const char *data() const { return _data; }
+    inline std::size_t size() const { return _size; }
+    inline bool empty() const { return _size == 0; }
+
+    inline const char *begin() const { return _data; }
+    inline const char *end() const { return _data + _size; }
+    inline char operator[](std::size_t i) const { return _data[i]; }
+
+    // Copies referenced bytes
+    inline std::string str() const { return std::string(_data, _size); }
+    explicit operator std::string() const { return str(); }
+
+    // Same as std::string::compare
+    int compare(StringRef other) const {
+        std::size_t size = _size < other._size ? _size : other._size;
+        int cmp = size == 0 ? 0 : std::memcmp(_data, other._data, size);
+        if (cmp != 0) {
+            return cmp;
+        }
+        return _size < other._size ? -1 : (_size > other._size ? 1 : 0);
+    }
+
+private:
+    const char *_data;
+    std::size_t _size;
+};
+
+inline bool operator==(StringRef a, StringRef b) {
+    return a.size() == b.size() && (a.size() == 0 || std::memcmp(a.data(), b.data(), a.size()) == 0);
+}
+
+inline bool operator!=(StringRef a, StringRef b) { return !(a == b); }
+
+inline bool operator<(StringRef a, StringRef b) { return a.compare(b) < 0; }
+
+inline std::ostream &operator<<(std::ostream &os, StringRef s) { return os.write(s.data(), s.size()); }
+
+} // namespace Afina
+
+#endif // AFINA_STRING_REF_H
@@ -0,0 +1,98 @@
+#ifndef AFINA_CONCURRENCY_EPOCH_H
+#define AFINA_CONCURRENCY_EPOCH_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace Afina {
+namespace Concurrency {
+
+/**
+ * # Epoch based memory reclamation
+ * Allows lock-free data structures to free memory that could still be seen by concurrent readers.
+ *
+ * Reader enters critical section with a Guard, which publishes global epoch it has observed. Memory
+ * unlinked from the structure is passed to Retire and gets tagged with the current epoch. Global epoch
+ * moves forward only once every active reader has observed it, so memory retired in epoch E is freed
+ * once global epoch reaches E + 2: no reader could hold a reference on it by then.
+ *
+ * Readers never wait for anything, entering and leaving critical section costs a single store each.
+ * Memory is freed by the thread that retired it, in batches.
+ */
+class EpochDomain {
+    // Per thread state: announced epoch and memory retired by the thread
+    struct Record;
+
+public:
+    EpochDomain();
+
+    /**
+     * Frees all memory retired so far, domain must not be used by any thread at this point
+     */
+    ~EpochDomain();
+
+    EpochDomain(const EpochDomain &) = delete;
+    EpochDomain &operator=(const EpochDomain &) = delete;
+
+    /**
+     * # Critical section
+     * Memory reachable from the protected structure stays valid while guard is alive. Guards could be
+     * nested on the same thread
+     */
+    class Guard {
+    public:
+        explicit Guard(EpochDomain &domain);
+        ~Guard();
+
+        Guard(const Guard &) = delete;
+        Guard &operator=(const Guard &) = delete;
+
+    private:
+        Record *_record;
+    };
+
+    /**
+     * Schedules memory to be freed once no reader could see it anymore. Memory must be already
+     * unreachable for the new readers
+     *
+     * @param ptr memory to be freed
+     * @param deleter function that frees memory
+     */
+    void Retire(void *ptr, void (*deleter)(void *));
+
+    template <typename T> void Retire(T *ptr) { Retire(ptr, &Delete<T>); }
+
+    /**
+     * Tries to move global epoch forward and frees memory retired by the calling thread which is
+     * safe to free
+     */
+    void Collect();
+
+private:
+    // Shared between domain and threads that have used it, so that thread could release its record
+    // even after domain is gone
+    struct State;
+
+    // Number of retired objects per thread that triggers collection
+    static constexpr std::size_t collect_threshold = 128;
+
+    template <typename T> static void Delete(void *ptr) { delete static_cast<T *>(ptr); }
+
+    // Returns record of the calling thread, takes one if thread has none yet
+    Record *Local();
+
+    // Moves global epoch forward if all active threads have observed it
+    bool TryAdvance();
+
+    // Frees memory in the record which is safe to be freed
+    void Reclaim(Record &record);
+
+    std::shared_ptr<State> _state;
+};
+
+} // namespace Concurrency
+} // namespace Afina
+
+#endif // AFINA_CONCURRENCY_EPOCH_H
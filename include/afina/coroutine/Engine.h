@@ -2,6 +2,7 @@
 #define AFINA_COROUTINE_ENGINE_H
 
 #include <cstdint>
+#include <functional>
 #include <iostream>
 #include <map>
 #include <setjmp.h>
@@ -13,6 +14,14 @@ namespace Coroutine {
 /**
  * # Entry point of coroutine library
  * Allows to run coroutine and schedule its execution. Not threadsafe
+ *
+ * Coroutines share the stack of the thread called start: when routine is suspended the part of stack it uses
+ * is copied aside, and copied back when it is resumed. So routine costs as much memory as deep its stack is at
+ * the moment of suspension, but every switch copies it twice.
+ *
+ * Routine could block itself until some event happens, see block. If all routines are blocked, engine calls
+ * unblocker given to the constructor, which is expected to wait for events and unblock routines waiting for
+ * them. That's how routines written in blocking style could wait for sockets, see STcoroutine::ServerImpl
  */
 class Engine final {
 private:
@@ -34,6 +43,9 @@ private:
         // Saved coroutine context (registers)
         jmp_buf Environment;
 
+        // Routine is in the blocked list, it can't be scheduled until unblocked
+        bool is_blocked = false;
+
         // To include routine in the different lists, such as "alive", "blocked", e.t.c
         struct context *prev = nullptr;
         struct context *next = nullptr;
@@ -54,11 +66,21 @@ private:
      */
     context *alive;
 
+    /**
+     * List of routines waiting to be unblocked
+     */
+    context *blocked;
+
     /**
      * Context to be returned finally
      */
     context *idle_ctx;
 
+    /**
+     * Called when all routines are blocked, see constructor
+     */
+    std::function<void(Engine &)> _unblocker;
+
 protected:
     /**
      * Save stack of the current coroutine in the given context
@@ -73,10 +95,17 @@ protected:
     /**
      * Suspend current coroutine execution and execute given context
      */
-    // void Enter(context& ctx);
+    void Enter(context &ctx);
 
 public:
-    Engine() : StackBottom(0), cur_routine(nullptr), alive(nullptr) {}
+    /**
+     * @param unblocker called when there are blocked routines but none of them could run. It should unblock
+     * some routines, blocking the thread until there is anything to unblock. If it is not given, routines
+     * still blocked are dropped once no other routine could run
+     */
+    explicit Engine(std::function<void(Engine &)> unblocker = nullptr)
+        : StackBottom(0), cur_routine(nullptr), alive(nullptr), blocked(nullptr), idle_ctx(nullptr),
+          _unblocker(unblocker) {}
     Engine(Engine &&) = delete;
     Engine(const Engine &) = delete;
 
@@ -99,6 +128,17 @@ public:
      */
     void sched(void *routine);
 
+    /**
+     * Blocks the given routine, so that it won't be scheduled until unblocked. If routine is not specified
+     * the current one gets blocked and control passes to any other routine ready to run
+     */
+    void block(void *routine = nullptr);
+
+    /**
+     * Makes blocked routine ready to run again, does nothing if routine isn't blocked
+     */
+    void unblock(void *routine);
+
     /**
      * Entry point into the engine. Prepare all internal mechanics and starts given function which is
      * considered as main.
@@ -117,17 +157,32 @@ public:
         // Start routine execution
         void *pc = run(main, std::forward<Ta>(args)...);
         idle_ctx = new context();
+        cur_routine = idle_ctx;
 
         if (setjmp(idle_ctx->Environment) > 0) {
-            // Here: correct finish of the coroutine section
+            // Here: correct finish of the coroutine section, or all routines are blocked. Pass control to any
+            // routine ready to run, yield doesn't return if there is one
+            cur_routine = idle_ctx;
+            while (alive == nullptr && blocked != nullptr && _unblocker) {
+                _unblocker(*this);
+            }
             yield();
         } else if (pc != nullptr) {
             Store(*idle_ctx);
             sched(pc);
         }
 
-        // Shutdown runtime
+        // Shutdown runtime, routines left blocked are dropped without unwinding their stacks
+        while (blocked != nullptr) {
+            context *ctx = blocked;
+            blocked = blocked->next;
+            delete[] std::get<0>(ctx->Stack);
+            delete ctx;
+        }
+        delete[] std::get<0>(idle_ctx->Stack);
         delete idle_ctx;
+        idle_ctx = nullptr;
+        cur_routine = nullptr;
         this->StackBottom = 0;
     }
 
@@ -173,7 +228,7 @@ public:
             // current coroutine finished, and the pointer is not relevant now
             cur_routine = nullptr;
             pc->prev = pc->next = nullptr;
-            delete std::get<0>(pc->Stack);
+            delete[] std::get<0>(pc->Stack);
             delete pc;
 
             // We cannot return here, as this function "returned" once already, so here we must select some other
@@ -10,8 +10,9 @@ class Storage;
 namespace Execute {
 
 /**
- *
- *
+ * # Command to be executed against storage
+ * Command writes its response to out without the trailing line end. Empty output means that client
+ * expects no response at all, like quiet meta commands on success.
  */
 class Command {
 public:
@@ -1,6 +1,10 @@
 #ifndef AFINA_EXECUTE_DELETE_H
 #define AFINA_EXECUTE_DELETE_H
 
+#include <string>
+
+#include <afina/StringRef.h>
+
 #include "Command.h"
 
 namespace Afina {
@@ -9,7 +13,7 @@ namespace Execute {
 /**
  * # Remove association for the key
  * Delete existing key from the cache. If key not found then command does
- * nothing
+ * nothing. Item is found and removed in a single storage lookup
  *
  * Command must write result to the output, which could be:
  * - "DELETED" to indicate success
@@ -17,10 +21,16 @@ namespace Execute {
  */
 class Delete : public Command {
 public:
-    Delete();
-    ~Delete();
+    explicit Delete(StringRef key) : _key(key) {}
+    ~Delete() {}
+
+    inline StringRef key() const { return _key; }
 
     void Execute(Storage &storage, const std::string &args, std::string &out) override;
+
+private:
+    // Points into the parser input, see Protocol::Parser::Build
+    const StringRef _key;
 };
 
 } // namespace Execute
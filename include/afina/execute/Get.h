@@ -1,9 +1,12 @@
 #ifndef AFINA_EXECUTE_GET_H
 #define AFINA_EXECUTE_GET_H
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
+#include <afina/StringRef.h>
+
 #include "Command.h"
 
 namespace Afina {
@@ -18,13 +21,14 @@ namespace Execute {
  * the items have been transmitted, the server sends the string
  *
  * Each item sent by the server looks like this:
- * VALUE <key> <bytes>\r\n
+ * VALUE <key> <flags> <bytes> [<cas unique>]\r\n
  * <data>\r\n
  * VALUE ....
  * END
  *
- * Where <key> is the key for the value, <bytes> is the number of bytes in the
- * value and <data> is the value text
+ * Where <key> is the key for the value, <flags> is the value of flags set along
+ * with the data, <bytes> is the number of bytes in the value and <data> is the
+ * value text. <cas unique> is CAS token of the item, it is sent only for "gets"
  *
  * If some of the keys appearing in a retrieval request are not sent back
  * by the server in the item list this means that the server does not
@@ -34,15 +38,36 @@ namespace Execute {
  */
 class Get : public Command {
 public:
-    Get(const std::vector<std::string> &keys) : _keys(keys) {}
+    Get(const std::vector<StringRef> &keys, bool cas = false) : _keys(keys), _cas(cas) {}
     ~Get() {}
 
-    inline const std::vector<std::string> &keys() const { return _keys; }
+    inline const std::vector<StringRef> &keys() const { return _keys; }
+    inline bool cas() const { return _cas; }
 
     void Execute(Storage &storage, const std::string &args, std::string &out) override;
 
+    // Buffer for values being read from storage, one per thread so that it is allocated once
+    static std::string &ValueBuffer();
+
+    // Frees the buffer if a large value has grown it, thread doesn't keep the memory once response is formed
+    static void ReleaseValueBuffer();
+
+protected:
+    // Appends item in the format described above to the output, CAS token is appended unless it is nullptr
+    static void AppendValue(StringRef key, uint32_t flags, const std::string &value, const uint64_t *cas,
+                            std::string &out);
+
+    // Reads item along with its CAS token in a single storage update, expiration time of the item is changed
+    // as well unless touch is nullptr. Returns false if there is no such item
+    static bool ReadWithCas(Storage &storage, StringRef key, const int32_t *touch, std::string &value,
+                            uint32_t &flags, uint64_t &cas);
+
 private:
-    std::vector<std::string> _keys;
+    // Keys are not copied, vector is owned by whoever created command, see Protocol::Parser::Build
+    const std::vector<StringRef> &_keys;
+
+    // Items are sent with their CAS tokens
+    const bool _cas;
 };
 
 } // namespace Execute
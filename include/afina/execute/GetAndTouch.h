@@ -0,0 +1,35 @@
+#ifndef AFINA_EXECUTE_GET_AND_TOUCH_H
+#define AFINA_EXECUTE_GET_AND_TOUCH_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Get.h"
+
+namespace Afina {
+namespace Execute {
+
+/**
+ * # Retrive values and update expiration time of the keys
+ * Works the same way as Get does, but each found item also gets new
+ * expiration time. Output format is the same as for Get command, "gats" sends CAS tokens
+ */
+class GetAndTouch : public Get {
+public:
+    GetAndTouch(int32_t expire, const std::vector<StringRef> &keys, bool cas = false)
+        : Get(keys, cas), _expire(expire) {}
+    ~GetAndTouch() {}
+
+    inline const int32_t expire() const { return _expire; }
+
+    void Execute(Storage &storage, const std::string &args, std::string &out) override;
+
+private:
+    const int32_t _expire;
+};
+
+} // namespace Execute
+} // namespace Afina
+
+#endif // AFINA_EXECUTE_GET_AND_TOUCH_H
@@ -4,9 +4,13 @@
 #include <cstdint>
 #include <string>
 
+#include <afina/StringRef.h>
+
 #include "Command.h"
 
 namespace Afina {
+class Storage;
+
 namespace Execute {
 
 /**
@@ -15,15 +19,22 @@ namespace Execute {
  */
 class InsertCommand : public Command {
 public:
-    InsertCommand(const std::string &key, uint32_t flags, int32_t expire) : _key(key), _flags(flags), _expire(expire) {}
+    InsertCommand(StringRef key, uint32_t flags, int32_t expire) : _key(key), _flags(flags), _expire(expire) {}
     ~InsertCommand() {}
 
-    inline const std::string &key() const { return _key; }
+    inline StringRef key() const { return _key; }
     inline const uint32_t flags() const { return _flags; }
     inline const int32_t expire() const { return _expire; }
 
 protected:
-    const std::string _key;
+    /**
+     * Adds data after or before the value of existing item in a single storage update, flags and expiration
+     * time of the item are kept. Returns false if there is no such item or it could not be stored
+     */
+    bool Concat(Storage &storage, const std::string &data, bool prepend) const;
+
+    // Points into the parser input, see Protocol::Parser::Build
+    const StringRef _key;
     const uint32_t _flags;
     const int32_t _expire;
 };
@@ -0,0 +1,45 @@
+#ifndef AFINA_EXECUTE_META_ARITHMETIC_H
+#define AFINA_EXECUTE_META_ARITHMETIC_H
+
+#include <string>
+
+#include "MetaCommand.h"
+
+namespace Afina {
+namespace Execute {
+
+/**
+ * # Increment or decrement item with the meta protocol
+ * ma <key> <flags>*
+ *
+ * Item value must be decimal unsigned 64 bits number. Increment wraps around, decrement stops at zero.
+ *
+ * Response is one of:
+ * - "HD" item is updated, quiet mode suppresses it
+ * - "VA <bytes> <flags>*\r\n<number>" item is updated and v flag is given
+ * - "NF" there is no such item
+ * - "EX" item has CAS token other than the given one
+ * - "CLIENT_ERROR ..." item value isn't a number
+ *
+ * Besides flags returned by every meta command, see MetaCommand, ma understands:
+ * - v: return new value
+ * - q: quiet mode
+ * - C(token): update only if item has the given CAS token
+ * - N(token): create item with the initial value and given expiration time on miss
+ * - J(token): initial value, 0 by default
+ * - D(token): delta, 1 by default
+ * - T(token): update expiration time
+ * - M(token): mode, I or + to increment (default), D or - to decrement
+ */
+class MetaArithmetic : public MetaCommand {
+public:
+    MetaArithmetic(StringRef key, const MetaFlags &flags) : MetaCommand(key, flags) {}
+    ~MetaArithmetic() {}
+
+    void Execute(Storage &storage, const std::string &args, std::string &out) override;
+};
+
+} // namespace Execute
+} // namespace Afina
+
+#endif // AFINA_EXECUTE_META_ARITHMETIC_H
@@ -0,0 +1,62 @@
+#ifndef AFINA_EXECUTE_META_COMMAND_H
+#define AFINA_EXECUTE_META_COMMAND_H
+
+#include <cstdint>
+#include <string>
+
+#include <afina/StringRef.h>
+
+#include "Command.h"
+#include "MetaFlags.h"
+
+namespace Afina {
+namespace Execute {
+
+/**
+ * # Basic class for all meta commands
+ * Meta response is a line with the two letters code followed by the flags client has asked to return,
+ * each of them is a letter with the value right after it:
+ * <code> <flags>*
+ *
+ * Flags returned by all commands:
+ * - O(token): opaque token given with the request
+ * - k: key of the item
+ *
+ * Flags returned by commands which deal with the item value:
+ * - c: CAS token of the item
+ * - f: client flags of the item
+ * - s: size of the item value
+ * - t: number of seconds left before item expires, -1 if it never expires
+ *
+ * Command with the q flag writes nothing to the output on the usual outcome, which one is that depends
+ * on the command. So client could pipeline lots of quiet commands and finish the batch with mn.
+ */
+class MetaCommand : public Command {
+public:
+    MetaCommand(StringRef key, const MetaFlags &flags) : _key(key), _flags(flags) {}
+    ~MetaCommand() {}
+
+    inline StringRef key() const { return _key; }
+    inline const MetaFlags &flags() const { return _flags; }
+
+    // Appends decimal number to the output
+    static void AppendNumber(uint64_t number, std::string &out);
+
+protected:
+    // Appends O and k flags if they are requested
+    void AppendKeyFlags(std::string &out) const;
+
+    // Appends c, f, s, t flags of the item if they are requested and then O and k ones
+    void AppendItemFlags(uint64_t cas, uint32_t flags, std::size_t size, int32_t ttl, std::string &out) const;
+
+    // Points into the parser input, see Protocol::Parser::Build
+    const StringRef _key;
+
+    // Owned by the parser the same way as the key
+    const MetaFlags &_flags;
+};
+
+} // namespace Execute
+} // namespace Afina
+
+#endif // AFINA_EXECUTE_META_COMMAND_H
@@ -0,0 +1,38 @@
+#ifndef AFINA_EXECUTE_META_DELETE_H
+#define AFINA_EXECUTE_META_DELETE_H
+
+#include <string>
+
+#include "MetaCommand.h"
+
+namespace Afina {
+namespace Execute {
+
+/**
+ * # Delete item with the meta protocol
+ * md <key> <flags>*
+ *
+ * Response is one of:
+ * - "HD" item is deleted
+ * - "NF" there is no such item
+ * - "EX" item has CAS token other than the given one
+ * Quiet mode suppresses both HD and NF.
+ *
+ * Besides flags returned by every meta command, see MetaCommand, md understands:
+ * - q: quiet mode
+ * - C(token): delete only if item has the given CAS token
+ * - I: invalidate, item is marked stale instead of being deleted, see MetaGet
+ * - T(token): with I, updates expiration time of the stale item
+ */
+class MetaDelete : public MetaCommand {
+public:
+    MetaDelete(StringRef key, const MetaFlags &flags) : MetaCommand(key, flags) {}
+    ~MetaDelete() {}
+
+    void Execute(Storage &storage, const std::string &args, std::string &out) override;
+};
+
+} // namespace Execute
+} // namespace Afina
+
+#endif // AFINA_EXECUTE_META_DELETE_H
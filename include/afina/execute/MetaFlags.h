@@ -0,0 +1,69 @@
+#ifndef AFINA_EXECUTE_META_FLAGS_H
+#define AFINA_EXECUTE_META_FLAGS_H
+
+#include <cstdint>
+
+#include <afina/StringRef.h>
+
+namespace Afina {
+namespace Execute {
+
+/**
+ * # Flags of the meta command
+ * Meta commands take a list of single letter flags after the key. Some flags carry a token written right
+ * after the letter, like "T30" or "Oabc". Flags are parsed by Protocol::Parser, command decides what
+ * they mean, see MetaCommand
+ */
+struct MetaFlags {
+    MetaFlags()
+        : mask(0), ttl(0), vivify(0), recache(0), client_flags(0), compare_cas(0), delta(1), initial(0),
+          mode(0) {}
+
+    // Bit of the flag letter in the mask, letters are case sensitive
+    static constexpr uint64_t Bit(char letter) {
+        return letter >= 'a' && letter <= 'z'
+                   ? uint64_t(1) << (letter - 'a')
+                   : letter >= 'A' && letter <= 'Z' ? uint64_t(1) << (26 + letter - 'A') : 0;
+    }
+
+    // Mask of all letters in the given string
+    static constexpr uint64_t Mask(const char *letters) {
+        return *letters == '\0' ? 0 : Bit(*letters) | Mask(letters + 1);
+    }
+
+    // Returns true if flag with the given letter has been given
+    inline bool Has(char letter) const { return (mask & Bit(letter)) != 0; }
+
+    // Letters of all flags given
+    uint64_t mask;
+
+    // O: opaque token echoed back in the response, points into the parser input as keys do
+    StringRef opaque;
+
+    // T: expiration time to set, see Storage#Touch
+    int32_t ttl;
+
+    // N: expiration time of the item created on miss
+    int32_t vivify;
+
+    // R: item with less seconds left wins recache
+    int32_t recache;
+
+    // F: client flags to store
+    uint32_t client_flags;
+
+    // C: CAS token item must have for update to happen
+    uint64_t compare_cas;
+
+    // D: delta and J: initial value for arithmetic
+    uint64_t delta;
+    uint64_t initial;
+
+    // M: mode switch, meaning depends on command
+    char mode;
+};
+
+} // namespace Execute
+} // namespace Afina
+
+#endif // AFINA_EXECUTE_META_FLAGS_H
@@ -0,0 +1,43 @@
+#ifndef AFINA_EXECUTE_META_GET_H
+#define AFINA_EXECUTE_META_GET_H
+
+#include <string>
+
+#include "MetaCommand.h"
+
+namespace Afina {
+namespace Execute {
+
+/**
+ * # Retrive item with the meta protocol
+ * mg <key> <flags>*
+ *
+ * Response on hit is either "HD <flags>*" or, if the v flag is given, the value follows:
+ * VA <bytes> <flags>*\r\n
+ * <data>
+ *
+ * On miss response is "EN", quiet mode suppresses it.
+ *
+ * Besides flags returned by every meta command, see MetaCommand, mg understands:
+ * - v: return item value
+ * - q: quiet mode, EN is not sent
+ * - T(token): update expiration time of the item
+ * - N(token): create empty item with the given expiration time on miss, client gets W flag
+ * - R(token): client gets W flag if item expires in less than token seconds
+ *
+ * Stale-while-revalidate: single client gets W (win) flag and is expected to recache the item, all others
+ * get Z flag meaning somebody is at it already and keep serving what they have got. Item invalidated by
+ * md with the I flag is returned with X flag and wins recache the same way.
+ */
+class MetaGet : public MetaCommand {
+public:
+    MetaGet(StringRef key, const MetaFlags &flags) : MetaCommand(key, flags) {}
+    ~MetaGet() {}
+
+    void Execute(Storage &storage, const std::string &args, std::string &out) override;
+};
+
+} // namespace Execute
+} // namespace Afina
+
+#endif // AFINA_EXECUTE_META_GET_H
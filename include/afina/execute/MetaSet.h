@@ -0,0 +1,45 @@
+#ifndef AFINA_EXECUTE_META_SET_H
+#define AFINA_EXECUTE_META_SET_H
+
+#include <string>
+
+#include "MetaCommand.h"
+
+namespace Afina {
+namespace Execute {
+
+/**
+ * # Store item with the meta protocol
+ * ms <key> <datalen> <flags>*\r\n
+ * <data block>\r\n
+ *
+ * Response is one of:
+ * - "HD" item is stored, quiet mode suppresses it
+ * - "NS" item is not stored because of the mode condition
+ * - "EX" item has CAS token other than the given one
+ * - "NF" there is no item to compare CAS token with
+ *
+ * Besides flags returned by every meta command, see MetaCommand, ms understands:
+ * - c: return CAS token of the stored item
+ * - q: quiet mode, HD is not sent
+ * - F(token): client flags to store
+ * - T(token): expiration time
+ * - C(token): store only if item has the given CAS token
+ * - I: with C, item having newer CAS token is overwritten but marked stale rather than rejected
+ * - M(token): mode, S set (default), E add, R replace, A append, P prepend. Append and prepend keep
+ * flags and expiration time of the item unless T is given
+ *
+ * Stored value clears stale and win marks of the item, see MetaGet.
+ */
+class MetaSet : public MetaCommand {
+public:
+    MetaSet(StringRef key, const MetaFlags &flags) : MetaCommand(key, flags) {}
+    ~MetaSet() {}
+
+    void Execute(Storage &storage, const std::string &args, std::string &out) override;
+};
+
+} // namespace Execute
+} // namespace Afina
+
+#endif // AFINA_EXECUTE_META_SET_H
@@ -0,0 +1,85 @@
+#ifndef AFINA_NETWORK_LISTENERS_H
+#define AFINA_NETWORK_LISTENERS_H
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Afina {
+namespace Network {
+
+/**
+ * # Listening sockets of the process
+ * Servers open their listening sockets here, so that process could pass them to the one taking over on restart.
+ * Successor gets sockets that are already bound and have clients queued in the backlog: it starts accepting
+ * while predecessor is still serving connections it has, and no client is refused in between.
+ *
+ * Sockets are passed over UNIX socket as SCM_RIGHTS. Successor takes them via InheritFrom before servers are
+ * started, then every Open looks for inherited socket listening on the same address before opening a new one.
+ * Both processes are expected to run the same network mode: servers of different modes take different number
+ * of sockets per port.
+ */
+class Listeners {
+public:
+    Listeners() {}
+    ~Listeners();
+
+    /**
+     * Returns socket listening on the port on all interfaces, inherited one if there is any
+     *
+     * @param nonblocking socket is to be non-blocking, inherited one is switched to what is asked for
+     * @param reuse_port socket is to share port with other sockets, see SO_REUSEPORT
+     */
+    int Open(uint16_t port, bool nonblocking, bool reuse_port);
+
+    /**
+     * Returns UNIX stream socket listening on the path, inherited one if there is any. Path starting with '@' is
+     * a name in the Linux abstract namespace, otherwise stale socket file left by the previous run is removed.
+     * Socket file somebody still listens on is kept and the address is reported to be in use.
+     *
+     * UNIX sockets can't share the address like SO_REUSEPORT does, so path opened already gives a duplicate of
+     * the same socket: threads accepting on it take connections from the common backlog
+     *
+     * @param nonblocking socket is to be non-blocking, inherited one is switched to what is asked for
+     */
+    int OpenUnix(const std::string &path, bool nonblocking);
+
+    /**
+     * Returns sockets opened so far, they stay valid till servers are stopped
+     */
+    std::vector<int> Opened();
+
+    /**
+     * Sends opened sockets over UNIX socket, returns false if that has failed
+     */
+    bool PassTo(int channel);
+
+    /**
+     * Receives sockets sent by PassTo, so that Open could take them. Throws if that has failed
+     */
+    void InheritFrom(int channel);
+
+    /**
+     * Closes inherited sockets no server has taken, otherwise clients kernel queues there wait forever
+     */
+    void CloseInherited();
+
+private:
+    Listeners(const Listeners &) = delete;
+    Listeners &operator=(const Listeners &) = delete;
+
+    // Servers of the process could be started from different threads
+    std::mutex _lock;
+
+    // Sockets received from predecessor which aren't taken yet
+    std::vector<int> _inherited;
+
+    // Sockets given to servers
+    std::vector<int> _opened;
+};
+
+} // namespace Network
+} // namespace Afina
+
+#endif // AFINA_NETWORK_LISTENERS_H
@@ -1,9 +1,13 @@
 #ifndef AFINA_NETWORK_SERVER_H
 #define AFINA_NETWORK_SERVER_H
 
+#include <ctime>
 #include <memory>
+#include <string>
 #include <vector>
 
+#include <afina/network/Listeners.h>
+
 namespace Afina {
 class Storage;
 namespace Logging {
@@ -11,6 +15,13 @@ class Service;
 }
 namespace Network {
 
+/**
+ * # Protocol clients of the server speak
+ * Memcached text and binary protocols share the port and are told apart by the first byte of the connection,
+ * Redis clients (RESP2) are served by a server of their own
+ */
+enum class Dialect { kMemcached, kRedis };
+
 /**
  * # Network processors coordinator
  * Configure resources for the network processors and coordinates all work
@@ -20,9 +31,33 @@ class Server {
 public:
     Server(std::shared_ptr<Afina::Storage> ps, std::shared_ptr<Afina::Logging::Service> pl,
             std::size_t capacity = 1000, std::time_t read_timeout = 5)
-        : pStorage(ps), pLogging(pl), _server_capacity(capacity), read_timeout(read_timeout) {}
+        : pStorage(ps), pLogging(pl), pListeners(std::make_shared<Listeners>()), _server_capacity(capacity),
+          read_timeout(read_timeout), _dialect(Dialect::kMemcached) {}
     virtual ~Server() {}
 
+    /**
+     * Selects protocol of the clients, must be called before Start
+     */
+    void SetDialect(Dialect dialect) { _dialect = dialect; }
+
+    /**
+     * Sets most connections served at once, must be called before Start. Zero means there is no limit
+     */
+    void SetCapacity(std::size_t capacity) { _server_capacity = capacity; }
+
+    /**
+     * Sets registry listening sockets are taken from, so that servers of the process share it and process
+     * could pass their sockets on restart. Must be called before Start
+     */
+    void SetListeners(std::shared_ptr<Listeners> pl) { pListeners = pl; }
+
+    /**
+     * Makes server listen on UNIX stream socket of the path rather than on TCP port given to Start, clients on
+     * the same host skip TCP stack then. Path starting with '@' is a name in the Linux abstract namespace. Must be
+     * called before Start
+     */
+    void SetUnixPath(const std::string &path) { _unix_path = path; }
+
     /**
      * Starts network service. After method returns process should
      * listen on the given interface/port pair to process  incomming
@@ -47,6 +82,16 @@ public:
     virtual void Join() = 0;
 
 protected:
+    /**
+     * Returns listening socket the server is configured for, see Listeners
+     */
+    int Listen(uint16_t port, bool nonblocking, bool reuse_port) {
+        if (_unix_path.empty()) {
+            return pListeners->Open(port, nonblocking, reuse_port);
+        }
+        return pListeners->OpenUnix(_unix_path, nonblocking);
+    }
+
     /**
      * Instance of backing storeage on which current server should execute
      * each command
@@ -58,8 +103,23 @@ protected:
      */
     std::shared_ptr<Afina::Logging::Service> pLogging;
 
+    /**
+     * Listening sockets of the process, servers supporting restart open theirs there
+     */
+    std::shared_ptr<Listeners> pListeners;
+
     std::size_t _server_capacity;
     std::time_t read_timeout;
+
+    /**
+     * Protocol of the clients
+     */
+    Dialect _dialect;
+
+    /**
+     * UNIX socket to listen on instead of TCP port, if not empty
+     */
+    std::string _unix_path;
 };
 
 } // namespace Network
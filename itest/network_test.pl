@@ -2,7 +2,7 @@
 use 5.016;
 use warnings;
 use threads;
-use Test::More tests => 85;
+use Test::More tests => 138;
 use IO::Socket::INET;
 use Getopt::Long;
 
@@ -89,6 +89,16 @@ afina_test("set foo 0 0 6\r\nfoobar\r\n", "STORED\r\n", "Set command", 1);
 
 afina_test("get foo\r\n", "VALUE foo 0 6\r\nfoobar\r\nEND\r\n", "Get the value we just set", 0);
 
+afina_test("set flagged 42 0 3\r\nabc\r\n", "STORED\r\n", "Set command with flags", 1);
+
+afina_test("get flagged\r\n", "VALUE flagged 42 3\r\nabc\r\nEND\r\n", "Get returns flags stored with the value", 0);
+
+afina_test("touch flagged 3600\r\n", "TOUCHED\r\n", "Touch existing key", 1);
+
+afina_test("touch missing 3600\r\n", "NOT_FOUND\r\n", "Touch missing key", 1);
+
+afina_test("gat 0 flagged missing\r\n", "VALUE flagged 42 3\r\nabc\r\nEND\r\n", "Get and touch", 0);
+
 afina_test(
 	"set foo 0 0 3\r\nwtf\r\n"
 	."set bar 0 0 3\r\nzzz\r\n"
@@ -145,41 +155,61 @@ afina_test(
 	0
 );
 
-TODO: {
-	local $TODO = "Replace command isn't yet implemented in the parser";
+afina_test(
+	"replace test_ 0 0 3\r\nwtf\r\n",
+	"NOT_STORED\r\n",
+	"Don't replace non-existent key",
+	1
+);
 
-	afina_test(
-		"replace test_ 0 0 3\r\nwtf\r\n",
-		"NOT_STORED\r\n",
-		"Don't replace non-existent key",
-		1
-	);
+afina_test(
+	"replace test 0 0 3\r\nzzz\r\n",
+	"STORED\r\n",
+	"Replace an existent key",
+	1
+);
 
-	afina_test(
-		"replace test 0 0 3\r\nzzz\r\n",
-		"STORED\r\n",
-		"Replace an existent key",
-		1
-	);
+afina_test(
+	"get test\r\n",
+	"VALUE test 0 3\r\nzzz\r\nEND\r\n",
+	"Verify replace",
+	0
+);
 
-	afina_test(
-		"get test\r\n",
-		"VALUE test 0 3\r\nzzz\r\nEND\r\n",
-		"Verify replace",
-		0
-	);
-}
+afina_test(
+	"prepend test 0 0 3\r\nfoo\r\n",
+	"STORED\r\n",
+	"Prepend an existent key",
+	1
+);
 
-TODO: {
-	local $TODO = "Delete command isn't yet implemented";
+afina_test(
+	"get test\r\n",
+	"VALUE test 0 6\r\nfoozzz\r\nEND\r\n",
+	"Verify the prepend",
+	0
+);
 
-	afina_test(
-		"delete test\r\n",
-		"DELETED\r\n",
-		"Delete a key",
-		1
-	);
-}
+afina_test(
+	"delete test\r\n",
+	"DELETED\r\n",
+	"Delete a key",
+	1
+);
+
+afina_test(
+	"delete test\r\n",
+	"NOT_FOUND\r\n",
+	"Don't delete non-existent key",
+	1
+);
+
+afina_test(
+	"get test\r\n",
+	"END\r\n",
+	"Verify the delete",
+	0
+);
 
 afina_test(
 	"blablabla 0 0 0\r\n",
@@ -217,3 +247,24 @@ afina_test(
 	"Correct result of partially written command",
 	0
 );
+
+# Client pipelining requests without reading responses gets them all in the end, server doesn't queue them
+# meanwhile but stops reading commands of that client
+SKIP: {
+	skip "slow client needs network", 8 if defined $rfifo;
+
+	my $big = "x" x 900;
+	afina_test("set big 0 0 900\r\n$big\r\n", "STORED\r\n", "Set large value", 1);
+
+	my $count = 20000;
+	my $socket = IO::Socket::INET::->new(PeerAddr => "$server:$port", Proto => "tcp");
+	ok($socket, "Connected slow client");
+	$socket->autoflush(1);
+	ok(print($socket "get big\r\n" x $count), "Sent pipelined requests");
+	sleep 1;
+
+	shutdown($socket, SHUT_WR());
+	my ($received, $buffer) = (0, "");
+	$received += length($buffer) while (sysread($socket, $buffer, 1 << 20));
+	is($received, $count * length("VALUE big 0 900\r\n$big\r\nEND\r\n"), "Slow client gets every response");
+}
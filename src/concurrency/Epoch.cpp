@@ -0,0 +1,192 @@
+#include <afina/concurrency/Epoch.h>
+
+#include <algorithm>
+
+namespace Afina {
+namespace Concurrency {
+
+namespace {
+
+// Object waiting to be freed
+struct Retired {
+    void *ptr;
+    void (*deleter)(void *);
+    uint64_t epoch;
+};
+
+} // namespace
+
+struct EpochDomain::Record {
+    Record() : announce(0), owned(true), nesting(0), next(nullptr) {}
+
+    // Epoch observed by the thread shifted left by one, lowest bit is set while thread is inside
+    // critical section
+    std::atomic<uint64_t> announce;
+
+    // Set while record belongs to some thread, records of finished threads are reused
+    std::atomic<bool> owned;
+
+    // Number of nested guards, accessed by owner only
+    unsigned nesting;
+
+    // Memory retired by the owner, in order of retirement. Accessed by owner only
+    std::vector<Retired> limbo;
+
+    // Records are never unlinked until domain dies
+    Record *next;
+};
+
+struct EpochDomain::State {
+    State() : epoch(1), records(nullptr), closed(false) {}
+
+    ~State() {
+        Record *record = records.load();
+        while (record != nullptr) {
+            Record *next = record->next;
+            delete record;
+            record = next;
+        }
+    }
+
+    std::atomic<uint64_t> epoch;
+    std::atomic<Record *> records;
+
+    // Set once domain is destroyed, records aren't used anymore
+    std::atomic<bool> closed;
+};
+
+namespace {
+
+// Records of the current thread in all domains it has used
+class ThreadRecords {
+public:
+    struct Entry {
+        std::shared_ptr<void> state;
+        std::atomic<bool> *owned;
+        void *record;
+        std::atomic<bool> *closed;
+    };
+
+    ~ThreadRecords() {
+        for (auto &entry : entries) {
+            entry.owned->store(false, std::memory_order_release);
+        }
+    }
+
+    std::vector<Entry> entries;
+};
+
+thread_local ThreadRecords thread_records;
+
+} // namespace
+
+// See Epoch.h
+EpochDomain::EpochDomain() : _state(std::make_shared<State>()) {}
+
+// See Epoch.h
+EpochDomain::~EpochDomain() {
+    _state->closed.store(true, std::memory_order_release);
+    for (Record *record = _state->records.load(); record != nullptr; record = record->next) {
+        for (auto &retired : record->limbo) {
+            retired.deleter(retired.ptr);
+        }
+        record->limbo.clear();
+    }
+}
+
+// See Epoch.h
+EpochDomain::Guard::Guard(EpochDomain &domain) : _record(domain.Local()) {
+    if (_record->nesting++ == 0) {
+        uint64_t epoch = domain._state->epoch.load(std::memory_order_relaxed);
+        // Must be visible before any pointer in the structure is read
+        _record->announce.store((epoch << 1) | 1, std::memory_order_seq_cst);
+    }
+}
+
+// See Epoch.h
+EpochDomain::Guard::~Guard() {
+    if (--_record->nesting == 0) {
+        _record->announce.store(0, std::memory_order_release);
+    }
+}
+
+// See Epoch.h
+void EpochDomain::Retire(void *ptr, void (*deleter)(void *)) {
+    Record *record = Local();
+    record->limbo.push_back(Retired{ptr, deleter, _state->epoch.load(std::memory_order_seq_cst)});
+    if (record->limbo.size() >= collect_threshold) {
+        TryAdvance();
+        Reclaim(*record);
+    }
+}
+
+// See Epoch.h
+void EpochDomain::Collect() {
+    Record *record = Local();
+    TryAdvance();
+    Reclaim(*record);
+}
+
+// See Epoch.h
+EpochDomain::Record *EpochDomain::Local() {
+    auto &entries = thread_records.entries;
+    for (auto it = entries.begin(); it != entries.end();) {
+        if (it->state.get() == _state.get()) {
+            return static_cast<Record *>(it->record);
+        }
+
+        // Drop records of destroyed domains on the way
+        if (it->closed->load(std::memory_order_acquire)) {
+            it = entries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    // Reuse record left by finished thread if there is any
+    Record *record = nullptr;
+    for (Record *r = _state->records.load(std::memory_order_acquire); r != nullptr; r = r->next) {
+        bool owned = false;
+        if (!r->owned.load(std::memory_order_relaxed) && r->owned.compare_exchange_strong(owned, true)) {
+            record = r;
+            break;
+        }
+    }
+
+    if (record == nullptr) {
+        record = new Record();
+        Record *head = _state->records.load(std::memory_order_relaxed);
+        do {
+            record->next = head;
+        } while (!_state->records.compare_exchange_weak(head, record));
+    }
+
+    entries.push_back(ThreadRecords::Entry{_state, &record->owned, record, &_state->closed});
+    return record;
+}
+
+// See Epoch.h
+bool EpochDomain::TryAdvance() {
+    uint64_t epoch = _state->epoch.load(std::memory_order_seq_cst);
+    for (Record *r = _state->records.load(std::memory_order_acquire); r != nullptr; r = r->next) {
+        uint64_t announce = r->announce.load(std::memory_order_seq_cst);
+        if ((announce & 1) && (announce >> 1) != epoch) {
+            return false;
+        }
+    }
+    return _state->epoch.compare_exchange_strong(epoch, epoch + 1);
+}
+
+// See Epoch.h
+void EpochDomain::Reclaim(Record &record) {
+    uint64_t epoch = _state->epoch.load(std::memory_order_acquire);
+    auto end = std::find_if(record.limbo.begin(), record.limbo.end(),
+                            [epoch](const Retired &r) { return r.epoch + 2 > epoch; });
+    for (auto it = record.limbo.begin(); it != end; ++it) {
+        it->deleter(it->ptr);
+    }
+    record.limbo.erase(record.limbo.begin(), end);
+}
+
+} // namespace Concurrency
+} // namespace Afina
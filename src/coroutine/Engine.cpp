@@ -1,5 +1,6 @@
 #include <afina/coroutine/Engine.h>
 
+#include <alloca.h>
 #include <setjmp.h>
 #include <stdio.h>
 #include <string.h>
@@ -7,13 +8,152 @@
 namespace Afina {
 namespace Coroutine {
 
-void Engine::Store(context &ctx) {}
+namespace {
 
-void Engine::Restore(context &ctx) {}
+// Copies saved stack back in place and passes control into it. Whole frame of this function must be below the
+// stack being restored, so it is never inlined into Restore
+__attribute__((noinline)) void Jump(char *low, const char *copy, std::size_t size, jmp_buf &env) {
+    memcpy(low, copy, size);
+    longjmp(env, 1);
+}
 
-void Engine::yield() {}
+} // namespace
 
-void Engine::sched(void *routine_) {}
+// See Engine.h
+void Engine::Store(context &ctx) {
+    // Routine uses stack between the current frame and the bottom engine has been started at
+    char StackEndsHere;
+    if (&StackEndsHere < StackBottom) {
+        ctx.Low = &StackEndsHere;
+        ctx.Hight = StackBottom;
+    } else {
+        ctx.Low = StackBottom;
+        ctx.Hight = &StackEndsHere;
+    }
+
+    // Buffer is reused while it is large enough
+    std::size_t size = ctx.Hight - ctx.Low;
+    char *&copy = std::get<0>(ctx.Stack);
+    uint32_t &capacity = std::get<1>(ctx.Stack);
+    if (capacity < size) {
+        delete[] copy;
+        copy = new char[size];
+        capacity = uint32_t(size);
+    }
+    memcpy(copy, ctx.Low, size);
+}
+
+// See Engine.h
+void Engine::Restore(context &ctx) {
+    // Stack is going to be overwritten up to ctx.Hight, so move below ctx.Low first. Stack grows down on all
+    // platforms server runs on
+    char StackEndsHere;
+    char *pad = nullptr;
+    if (&StackEndsHere >= ctx.Low) {
+        pad = static_cast<char *>(alloca(&StackEndsHere - ctx.Low + 256));
+    }
+    __asm__ volatile("" : : "r"(pad) : "memory");
+
+    Jump(ctx.Low, std::get<0>(ctx.Stack), ctx.Hight - ctx.Low, ctx.Environment);
+}
+
+// See Engine.h
+void Engine::Enter(context &ctx) {
+    // Engine itself isn't resumed where it has been suspended, it always starts over in start
+    if (cur_routine != nullptr && cur_routine != idle_ctx) {
+        if (setjmp(cur_routine->Environment) > 0) {
+            return;
+        }
+        Store(*cur_routine);
+    }
+
+    cur_routine = &ctx;
+    Restore(ctx);
+}
+
+// See Engine.h
+void Engine::yield() {
+    context *routine = alive;
+    if (routine != nullptr && routine == cur_routine) {
+        routine = routine->next;
+    }
+
+    if (routine != nullptr) {
+        Enter(*routine);
+    }
+}
+
+// See Engine.h
+void Engine::sched(void *routine_) {
+    if (routine_ == nullptr) {
+        yield();
+        return;
+    }
+
+    context *routine = static_cast<context *>(routine_);
+    if (routine == cur_routine || routine->is_blocked) {
+        return;
+    }
+    Enter(*routine);
+}
+
+// See Engine.h
+void Engine::block(void *routine_) {
+    context *routine = routine_ == nullptr ? cur_routine : static_cast<context *>(routine_);
+    if (routine == nullptr || routine == idle_ctx || routine->is_blocked) {
+        return;
+    }
+
+    // Move from alive list to blocked one
+    if (routine->prev != nullptr) {
+        routine->prev->next = routine->next;
+    }
+    if (routine->next != nullptr) {
+        routine->next->prev = routine->prev;
+    }
+    if (alive == routine) {
+        alive = routine->next;
+    }
+
+    routine->prev = nullptr;
+    routine->next = blocked;
+    if (blocked != nullptr) {
+        blocked->prev = routine;
+    }
+    blocked = routine;
+    routine->is_blocked = true;
+
+    // Current routine can't go on, control goes to someone else or back to engine to wait for unblock
+    if (routine == cur_routine) {
+        Enter(alive != nullptr ? *alive : *idle_ctx);
+    }
+}
+
+// See Engine.h
+void Engine::unblock(void *routine_) {
+    context *routine = static_cast<context *>(routine_);
+    if (routine == nullptr || !routine->is_blocked) {
+        return;
+    }
+
+    if (routine->prev != nullptr) {
+        routine->prev->next = routine->next;
+    }
+    if (routine->next != nullptr) {
+        routine->next->prev = routine->prev;
+    }
+    if (blocked == routine) {
+        blocked = routine->next;
+    }
+
+    routine->prev = nullptr;
+    routine->next = alive;
+    if (alive != nullptr) {
+        alive->prev = routine;
+    }
+    alive = routine;
+    routine->is_blocked = false;
+}
 
 } // namespace Coroutine
 } // namespace Afina
@@ -1,18 +1,62 @@
 #include <afina/Storage.h>
 #include <afina/execute/Get.h>
 
-#include <iostream>
-#include <iterator>
-#include <sstream>
-
 namespace Afina {
 namespace Execute {
 
+namespace {
+
+// Value buffer grown larger than that is freed rather than kept by the thread, see Get::ReleaseValueBuffer
+constexpr std::size_t max_value_buffer = 65536;
+
+// Writes decimal number right before the end of the buffer, returns where it starts
+char *FormatNumber(uint64_t number, char *end) {
+    do {
+        *--end = '0' + number % 10;
+        number /= 10;
+    } while (number > 0);
+    return end;
+}
+
+// Copies item out of storage along with its CAS token, see Get::ReadWithCas
+class ReadUpdater : public ItemUpdater {
+public:
+    ReadUpdater(const int32_t *touch, std::string &value) : found(false), flags(0), _touch(touch), _value(value) {}
+
+    Action Apply(const ItemState *item, ItemUpdate &update) override {
+        found = item != nullptr;
+        if (!found) {
+            return Action::kKeep;
+        }
+        _value = *item->value;
+        flags = item->flags;
+        if (_touch == nullptr) {
+            return Action::kKeep;
+        }
+
+        // Touch keeps value and CAS token, marks are left as they are
+        update.touch = true;
+        update.expire = *_touch;
+        update.stale = item->stale;
+        update.win_sent = item->win_sent;
+        return Action::kStore;
+    }
+
+    bool found;
+    uint32_t flags;
+
+private:
+    const int32_t *_touch;
+    std::string &_value;
+};
+
+} // namespace
+
 /* memcached protocol:
 
 Each item sent by the server looks like this:
 
-VALUE <key> <flags> <bytes>\r\n
+VALUE <key> <flags> <bytes> [<cas unique>]\r\n
 <data block>\r\n
 
 After all the items have been transmitted, the server sends the string
@@ -22,22 +66,65 @@ to indicate the end of response.
 */
 
 void Get::Execute(Storage &storage, const std::string &args, std::string &out) {
-    std::stringstream keyStream;
-    copy(_keys.begin(), _keys.end(), std::ostream_iterator<std::string>(keyStream, " "));
-    std::cout << "Get(" << keyStream.str() << ")" << std::endl;
+    out.clear();
+    std::string &value = ValueBuffer();
+    uint32_t flags;
+    uint64_t cas;
+    for (auto &key : _keys) {
+        if (!_cas && storage.Get(key, value, &flags)) {
+            AppendValue(key, flags, value, nullptr, out);
+        } else if (_cas && ReadWithCas(storage, key, nullptr, value, flags, cas)) {
+            AppendValue(key, flags, value, &cas, out);
+        }
+    }
+    out += "END"; // networking layer should add the last \r\n
+    ReleaseValueBuffer();
+}
 
-    std::stringstream outStream;
+// See Get.h
+std::string &Get::ValueBuffer() {
+    static thread_local std::string buffer;
+    return buffer;
+}
 
-    std::string value;
-    for (auto &key : _keys) {
-        if (!storage.Get(key, value))
-            continue;
-        outStream << "VALUE " << key << " 0 " << value.size() << "\r\n";
-        outStream << value << "\r\n";
+// See Get.h
+void Get::ReleaseValueBuffer() {
+    std::string &buffer = ValueBuffer();
+    if (buffer.capacity() > max_value_buffer) {
+        std::string().swap(buffer);
+    }
+}
+
+// See Get.h
+bool Get::ReadWithCas(Storage &storage, StringRef key, const int32_t *touch, std::string &value, uint32_t &flags,
+                      uint64_t &cas) {
+    ReadUpdater updater(touch, value);
+    if (!storage.Update(key, updater, &cas) || !updater.found) {
+        return false;
+    }
+    flags = updater.flags;
+    return true;
+}
+
+// See Get.h
+void Get::AppendValue(StringRef key, uint32_t flags, const std::string &value, const uint64_t *cas,
+                      std::string &out) {
+    // Numbers are formatted in place, std::to_string would create temporary string for each
+    char numbers[64];
+    char *end = numbers + sizeof(numbers);
+    char *p = end;
+    if (cas != nullptr) {
+        p = FormatNumber(*cas, p);
+        *--p = ' ';
     }
-    outStream << "END"; // networking layer should add the last \r\n
+    p = FormatNumber(value.size(), p);
+    *--p = ' ';
+    p = FormatNumber(flags, p);
+    *--p = ' ';
 
-    out = outStream.str();
+    out.append("VALUE ", 6).append(key.data(), key.size());
+    out.append(p, end - p).append("\r\n", 2);
+    out.append(value).append("\r\n", 2);
 }
 
 } // namespace Execute
@@ -0,0 +1,26 @@
+#include <afina/Storage.h>
+#include <afina/execute/GetAndTouch.h>
+
+namespace Afina {
+namespace Execute {
+
+// memcached protocol: "gat" and "gats" are used to fetch items and update the expiration time of
+// an existing items. Response is the same as for "get".
+void GetAndTouch::Execute(Storage &storage, const std::string &args, std::string &out) {
+    out.clear();
+    std::string &value = ValueBuffer();
+    uint32_t flags;
+    uint64_t token;
+    for (auto &key : keys()) {
+        if (!cas() && storage.GetAndTouch(key, _expire, value, &flags)) {
+            AppendValue(key, flags, value, nullptr, out);
+        } else if (cas() && ReadWithCas(storage, key, &_expire, value, flags, token)) {
+            AppendValue(key, flags, value, &token, out);
+        }
+    }
+    out += "END"; // networking layer should add the last \r\n
+    ReleaseValueBuffer();
+}
+
+} // namespace Execute
+} // namespace Afina
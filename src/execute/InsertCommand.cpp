@@ -0,0 +1,46 @@
+#include <afina/Storage.h>
+#include <afina/execute/InsertCommand.h>
+
+namespace Afina {
+namespace Execute {
+
+namespace {
+
+// Builds new value out of the current one, see InsertCommand::Concat
+class ConcatUpdater : public ItemUpdater {
+public:
+    ConcatUpdater(const std::string &data, bool prepend) : found(false), _data(data), _prepend(prepend) {}
+
+    Action Apply(const ItemState *item, ItemUpdate &update) override {
+        found = item != nullptr;
+        if (!found) {
+            return Action::kKeep;
+        }
+
+        // Update without touch keeps absolute expiration time of the item as it is
+        _value.clear();
+        _value.reserve(item->value->size() + _data.size());
+        _value.append(_prepend ? _data : *item->value).append(_prepend ? *item->value : _data);
+        update.value = &_value;
+        update.flags = item->flags;
+        return Action::kStore;
+    }
+
+    bool found;
+
+private:
+    const std::string &_data;
+    const bool _prepend;
+    std::string _value;
+};
+
+} // namespace
+
+// See InsertCommand.h
+bool InsertCommand::Concat(Storage &storage, const std::string &data, bool prepend) const {
+    ConcatUpdater updater(data, prepend);
+    return storage.Update(_key, updater) && updater.found;
+}
+
+} // namespace Execute
+} // namespace Afina
@@ -0,0 +1,121 @@
+#include <afina/Storage.h>
+#include <afina/execute/MetaArithmetic.h>
+
+namespace Afina {
+namespace Execute {
+
+namespace {
+
+// Parses decimal unsigned 64 bits number, returns false if value is anything else
+bool ParseNumber(const std::string &value, uint64_t &out) {
+    if (value.empty() || value.size() > 20) {
+        return false;
+    }
+    uint64_t number = 0;
+    for (char c : value) {
+        if (c < '0' || c > '9' || number > (UINT64_MAX - (c - '0')) / 10) {
+            return false;
+        }
+        number = number * 10 + (c - '0');
+    }
+    out = number;
+    return true;
+}
+
+// Calculates new value of the item, see MetaArithmetic.h
+class ArithmeticUpdater : public ItemUpdater {
+public:
+    ArithmeticUpdater(const MetaFlags &flags, bool increment) : _flags(flags), _increment(increment) {}
+
+    Action Apply(const ItemState *item, ItemUpdate &update) override {
+        if (item == nullptr) {
+            if (!_flags.Has('N')) {
+                status = "NF";
+                return Action::kKeep;
+            }
+            number = _flags.initial;
+            flags = 0;
+            ttl = _flags.vivify > 0 ? _flags.vivify : -1;
+            update.expire = _flags.vivify;
+        } else if (_flags.Has('C') && item->cas != _flags.compare_cas) {
+            status = "EX";
+            return Action::kKeep;
+        } else if (!ParseNumber(*item->value, number)) {
+            status = "CLIENT_ERROR cannot increment or decrement non-numeric value";
+            return Action::kKeep;
+        } else {
+            if (_increment) {
+                number += _flags.delta;
+            } else {
+                number = number > _flags.delta ? number - _flags.delta : 0;
+            }
+            flags = item->flags;
+            ttl = item->ttl;
+            if (_flags.Has('T')) {
+                update.touch = true;
+                update.expire = _flags.ttl;
+                ttl = _flags.ttl > 0 ? _flags.ttl : -1;
+            }
+        }
+
+        status = "HD";
+        value.clear();
+        MetaCommand::AppendNumber(number, value);
+        update.value = &value;
+        update.flags = flags;
+        return Action::kStore;
+    }
+
+    const char *status;
+    std::string value;
+    uint64_t number;
+    uint32_t flags;
+    int32_t ttl;
+
+private:
+    const MetaFlags &_flags;
+    const bool _increment;
+};
+
+} // namespace
+
+// memcached meta protocol: "ma" increments or decrements numeric value
+void MetaArithmetic::Execute(Storage &storage, const std::string &args, std::string &out) {
+    char mode = _flags.Has('M') ? _flags.mode : 'I';
+    bool increment = mode == 'I' || mode == 'i' || mode == '+';
+    if (!increment && mode != 'D' && mode != 'd' && mode != '-') {
+        out.assign("CLIENT_ERROR invalid mode for ma");
+        return;
+    }
+
+    ArithmeticUpdater updater(_flags, increment);
+    uint64_t cas;
+    out.clear();
+    bool stored = storage.Update(_key, updater, &cas);
+
+    // Value could not fit into storage
+    const char *status = updater.status[0] != 'H' || stored ? updater.status : "NS";
+    if (status[0] != 'H') {
+        out.append(status);
+        if (status[0] != 'C') {
+            AppendKeyFlags(out);
+        }
+        return;
+    }
+
+    if (_flags.Has('v')) {
+        out.append("VA ", 3);
+        AppendNumber(updater.value.size(), out);
+    } else if (_flags.Has('q')) {
+        return;
+    } else {
+        out.append("HD", 2);
+    }
+    AppendItemFlags(cas, updater.flags, updater.value.size(), updater.ttl, out);
+    if (_flags.Has('v')) {
+        out.append("\r\n", 2).append(updater.value);
+    }
+}
+
+} // namespace Execute
+} // namespace Afina
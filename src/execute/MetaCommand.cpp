@@ -0,0 +1,55 @@
+#include <afina/execute/MetaCommand.h>
+
+namespace Afina {
+namespace Execute {
+
+// See MetaCommand.h
+void MetaCommand::AppendKeyFlags(std::string &out) const {
+    if (_flags.Has('O')) {
+        out.append(" O", 2).append(_flags.opaque.data(), _flags.opaque.size());
+    }
+    if (_flags.Has('k')) {
+        out.append(" k", 2).append(_key.data(), _key.size());
+    }
+}
+
+// See MetaCommand.h
+void MetaCommand::AppendItemFlags(uint64_t cas, uint32_t flags, std::size_t size, int32_t ttl,
+                                  std::string &out) const {
+    if (_flags.Has('c')) {
+        out.append(" c", 2);
+        AppendNumber(cas, out);
+    }
+    if (_flags.Has('f')) {
+        out.append(" f", 2);
+        AppendNumber(flags, out);
+    }
+    if (_flags.Has('s')) {
+        out.append(" s", 2);
+        AppendNumber(size, out);
+    }
+    if (_flags.Has('t')) {
+        out.append(" t", 2);
+        if (ttl < 0) {
+            out.append("-1", 2);
+        } else {
+            AppendNumber(uint64_t(ttl), out);
+        }
+    }
+    AppendKeyFlags(out);
+}
+
+// See MetaCommand.h
+void MetaCommand::AppendNumber(uint64_t number, std::string &out) {
+    // Formatted in place, std::to_string would create temporary string
+    char digits[20];
+    char *end = digits + sizeof(digits), *p = end;
+    do {
+        *--p = '0' + number % 10;
+        number /= 10;
+    } while (number > 0);
+    out.append(p, end - p);
+}
+
+} // namespace Execute
+} // namespace Afina
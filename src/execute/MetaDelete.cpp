@@ -0,0 +1,59 @@
+#include <afina/Storage.h>
+#include <afina/execute/MetaDelete.h>
+
+namespace Afina {
+namespace Execute {
+
+namespace {
+
+// Checks CAS condition and either deletes or invalidates item, see MetaDelete.h
+class DeleteUpdater : public ItemUpdater {
+public:
+    explicit DeleteUpdater(const MetaFlags &flags) : _flags(flags) {}
+
+    Action Apply(const ItemState *item, ItemUpdate &update) override {
+        if (item == nullptr) {
+            status = "NF";
+            return Action::kKeep;
+        } else if (_flags.Has('C') && item->cas != _flags.compare_cas) {
+            status = "EX";
+            return Action::kKeep;
+        }
+
+        status = "HD";
+        if (!_flags.Has('I')) {
+            return Action::kDelete;
+        }
+
+        // Stale item is still served, the next reader wins recache
+        update.stale = true;
+        update.win_sent = false;
+        update.touch = _flags.Has('T');
+        update.expire = _flags.ttl;
+        return Action::kStore;
+    }
+
+    const char *status;
+
+private:
+    const MetaFlags &_flags;
+};
+
+} // namespace
+
+// memcached meta protocol: "md" deletes or invalidates item
+void MetaDelete::Execute(Storage &storage, const std::string &args, std::string &out) {
+    DeleteUpdater updater(_flags);
+    out.clear();
+
+    storage.Update(_key, updater);
+    const char *status = updater.status;
+    if (status[0] != 'E' && _flags.Has('q')) {
+        return;
+    }
+    out.append(status, 2);
+    AppendKeyFlags(out);
+}
+
+} // namespace Execute
+} // namespace Afina
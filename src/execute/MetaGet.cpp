@@ -0,0 +1,113 @@
+#include <afina/Storage.h>
+#include <afina/execute/Get.h>
+#include <afina/execute/MetaGet.h>
+
+namespace Afina {
+namespace Execute {
+
+namespace {
+
+// Reads item and decides who wins recache, see MetaGet.h
+class GetUpdater : public ItemUpdater {
+public:
+    GetUpdater(const MetaFlags &flags, std::string &value) : _flags(flags), value(value) {}
+
+    Action Apply(const ItemState *item, ItemUpdate &update) override {
+        win = lost = stale = false;
+        if (item == nullptr) {
+            if (!_flags.Has('N')) {
+                return Action::kKeep;
+            }
+
+            // Miss creates empty item, this client is the one to fill it
+            value.clear();
+            flags = 0;
+            size = 0;
+            ttl = _flags.vivify > 0 ? _flags.vivify : -1;
+            win = true;
+            update.value = &value;
+            update.expire = _flags.vivify;
+            update.win_sent = true;
+            return Action::kStore;
+        }
+
+        if (_flags.Has('v')) {
+            value = *item->value;
+        }
+        flags = item->flags;
+        size = item->value->size();
+        ttl = item->ttl;
+        stale = item->stale;
+
+        // Only the first client asking gets the win, others are told someone is at it already
+        bool recache = item->stale || (_flags.Has('R') && item->ttl >= 0 && item->ttl < _flags.recache);
+        if (item->win_sent) {
+            lost = true;
+        } else if (recache) {
+            win = true;
+        }
+
+        if (!win && !_flags.Has('T')) {
+            return Action::kKeep;
+        }
+        if (_flags.Has('T')) {
+            update.touch = true;
+            update.expire = _flags.ttl;
+            ttl = _flags.ttl > 0 ? _flags.ttl : -1;
+        }
+        update.stale = item->stale;
+        update.win_sent = item->win_sent || win;
+        return Action::kStore;
+    }
+
+    // Item as it has been seen
+    uint32_t flags;
+    std::size_t size;
+    int32_t ttl;
+    bool win, lost, stale;
+
+private:
+    const MetaFlags &_flags;
+    std::string &value;
+};
+
+} // namespace
+
+// memcached meta protocol: "mg" retrieves item, response carries only what flags ask for
+void MetaGet::Execute(Storage &storage, const std::string &args, std::string &out) {
+    std::string &value = Get::ValueBuffer();
+    GetUpdater updater(_flags, value);
+    uint64_t cas;
+    out.clear();
+    if (!storage.Update(_key, updater, &cas)) {
+        if (!_flags.Has('q')) {
+            out.append("EN", 2);
+            AppendKeyFlags(out);
+        }
+        return;
+    }
+
+    if (_flags.Has('v')) {
+        out.append("VA ", 3);
+        AppendNumber(updater.size, out);
+    } else {
+        out.append("HD", 2);
+    }
+    AppendItemFlags(cas, updater.flags, updater.size, updater.ttl, out);
+    if (updater.win) {
+        out.append(" W", 2);
+    }
+    if (updater.stale) {
+        out.append(" X", 2);
+    }
+    if (updater.lost) {
+        out.append(" Z", 2);
+    }
+    if (_flags.Has('v')) {
+        out.append("\r\n", 2).append(value);
+    }
+    Get::ReleaseValueBuffer();
+}
+
+} // namespace Execute
+} // namespace Afina
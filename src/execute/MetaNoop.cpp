@@ -0,0 +1,10 @@
+#include <afina/execute/MetaNoop.h>
+
+namespace Afina {
+namespace Execute {
+
+// memcached meta protocol: "mn" is answered with "MN" to flush quiet commands
+void MetaNoop::Execute(Storage &storage, const std::string &args, std::string &out) { out.assign("MN"); }
+
+} // namespace Execute
+} // namespace Afina
@@ -0,0 +1,95 @@
+#include <afina/Storage.h>
+#include <afina/execute/MetaSet.h>
+
+namespace Afina {
+namespace Execute {
+
+namespace {
+
+// Checks mode and CAS conditions and builds value to store, see MetaSet.h
+class SetUpdater : public ItemUpdater {
+public:
+    SetUpdater(const MetaFlags &flags, const std::string &data, char mode)
+        : _flags(flags), _data(data), _mode(mode) {}
+
+    Action Apply(const ItemState *item, ItemUpdate &update) override {
+        status = "HD";
+        bool stale = false;
+        if (_flags.Has('C')) {
+            if (item == nullptr) {
+                status = "NF";
+                return Action::kKeep;
+            } else if (item->cas != _flags.compare_cas) {
+                // Late writer with older data could still leave it for readers, marked as stale
+                if (!_flags.Has('I') || _flags.compare_cas > item->cas) {
+                    status = "EX";
+                    return Action::kKeep;
+                }
+                stale = true;
+            }
+        }
+
+        bool exists = item != nullptr;
+        if ((_mode == 'E' && exists) || (_mode != 'S' && _mode != 'E' && !exists)) {
+            status = "NS";
+            return Action::kKeep;
+        }
+
+        update.stale = stale;
+        update.win_sent = false;
+        update.expire = _flags.ttl;
+        if (_mode == 'A' || _mode == 'P') {
+            _value = _mode == 'A' ? *item->value + _data : _data + *item->value;
+            update.value = &_value;
+            update.flags = item->flags;
+            update.touch = _flags.Has('T');
+        } else {
+            update.value = &_data;
+            update.flags = _flags.client_flags;
+            update.touch = true;
+        }
+        return Action::kStore;
+    }
+
+    const char *status;
+
+private:
+    const MetaFlags &_flags;
+    const std::string &_data;
+    const char _mode;
+    std::string _value;
+};
+
+} // namespace
+
+// memcached meta protocol: "ms" stores data block, mode flag turns it into add, replace, append or prepend
+void MetaSet::Execute(Storage &storage, const std::string &args, std::string &out) {
+    char mode = _flags.Has('M') ? _flags.mode : 'S';
+    if (mode >= 'a' && mode <= 'z') {
+        mode -= 'a' - 'A';
+    }
+    if (mode != 'S' && mode != 'E' && mode != 'R' && mode != 'A' && mode != 'P') {
+        out.assign("CLIENT_ERROR invalid mode for ms");
+        return;
+    }
+
+    SetUpdater updater(_flags, args, mode);
+    uint64_t cas;
+    out.clear();
+    bool stored = storage.Update(_key, updater, &cas);
+
+    // Value could not fit into storage
+    const char *status = updater.status[0] != 'H' || stored ? updater.status : "NS";
+    if (status[0] == 'H' && _flags.Has('q')) {
+        return;
+    }
+    out.append(status, 2);
+    if (status[0] == 'H' && _flags.Has('c')) {
+        out.append(" c", 2);
+        AppendNumber(cas, out);
+    }
+    AppendKeyFlags(out);
+}
+
+} // namespace Execute
+} // namespace Afina
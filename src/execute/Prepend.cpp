@@ -0,0 +1,14 @@
+#include <afina/Storage.h>
+#include <afina/execute/Prepend.h>
+
+namespace Afina {
+namespace Execute {
+
+// memcached protocol: "prepend" means "add this data to an existing key before existing data".
+void Prepend::Execute(Storage &storage, const std::string &args, std::string &out) {
+    // Flags and expiration time given with the command are ignored, existing ones are kept untouched
+    out.assign(Concat(storage, args, true) ? "STORED" : "NOT_STORED");
+}
+
+} // namespace Execute
+} // namespace Afina
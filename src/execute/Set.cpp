@@ -1,16 +1,13 @@
 #include <afina/Storage.h>
 #include <afina/execute/Set.h>
 
-#include <iostream>
-
 namespace Afina {
 namespace Execute {
 
 // memcached protocol: "set" means "store this data".
 void Set::Execute(Storage &storage, const std::string &args, std::string &out) {
-    std::cout << "Set(" << _key << "): " << args << std::endl;
-    storage.Put(_key, args);
-    out = "STORED";
+    // Storage refuses only the value which doesn't fit into it at all
+    out = storage.Put(_key, args, _flags, _expire) ? "STORED" : "SERVER_ERROR object too large for cache";
 }
 
 } // namespace Execute
@@ -3,23 +3,34 @@
 #include <memory>
 
 #include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
 #include <semaphore.h>
 #include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
 #include <thread>
+#include <unistd.h>
 
 #include <cxxopts.hpp>
 
 #include <afina/Storage.h>
 #include <afina/Version.h>
 #include <afina/logging/Service.h>
+#include <afina/network/Listeners.h>
 #include <afina/network/Server.h>
 
 #include "logging/ServiceImpl.h"
 #include "network/mt_blocking/ServerImpl.h"
 #include "network/mt_nonblocking/ServerImpl.h"
 #include "network/st_blocking/ServerImpl.h"
+#include "network/st_coroutine/ServerImpl.h"
 #include "network/st_nonblocking/ServerImpl.h"
+#include "network/uring/ServerImpl.h"
 
+#include "storage/LockFreeLRU.h"
 #include "storage/SimpleLRU.h"
 #include "storage/ThreadSafeSimpleLRU.h"
 
@@ -54,6 +65,8 @@ public:
             storage = std::make_shared<Afina::Backend::SimpleLRU>();
         } else if (storage_type == "mt_lru") {
             storage = std::make_shared<Afina::Backend::ThreadSafeSimplLRU>();
+        } else if (storage_type == "mt_lockfree") {
+            storage = std::make_shared<Afina::Backend::LockFreeLRU>();
         } else {
             throw std::runtime_error("Unknown storage type");
         }
@@ -64,16 +77,32 @@ public:
             network_type = options["network"].as<std::string>();
         }
 
-        if (network_type == "st_block") {
-            server = std::make_shared<Afina::Network::STblocking::ServerImpl>(storage, logService);
-        } else if (network_type == "mt_block") {
-            server = std::make_shared<Afina::Network::MTblocking::ServerImpl>(storage, logService);
-        } else if (network_type == "st_nonblock") {
-            server = std::make_shared<Afina::Network::STnonblock::ServerImpl>(storage, logService);
-        } else if (network_type == "mt_nonblock") {
-            server = std::make_shared<Afina::Network::MTnonblock::ServerImpl>(storage, logService);
-        } else {
-            throw std::runtime_error("Unknown network type");
+        // Blocking servers wake their acceptors by shutting listening socket down, that would stop the new
+        // process from accepting as well
+        restartable = network_type != "st_block" && network_type != "mt_block";
+
+        listeners = std::make_shared<Afina::Network::Listeners>();
+        server = CreateServer(network_type);
+        if (options.count("connections") > 0) {
+            server->SetCapacity(options["connections"].as<std::size_t>());
+        }
+        if (options.count("unix") > 0) {
+            unix_path = options["unix"].as<std::string>();
+            server->SetUnixPath(unix_path);
+        }
+
+        // Step 3: Redis clients are served by the network of the same type on their own port
+        if (options.count("redis") > 0) {
+            int port = options["redis"].as<int>();
+            if (port <= 0 || port > UINT16_MAX) {
+                throw std::runtime_error("Invalid Redis port");
+            }
+            redis_port = uint16_t(port);
+            redis_server = CreateServer(network_type);
+            redis_server->SetDialect(Afina::Network::Dialect::kRedis);
+            if (options.count("connections") > 0) {
+                redis_server->SetCapacity(options["connections"].as<std::size_t>());
+            }
         }
     }
 
@@ -86,10 +115,101 @@ public:
         log->warn("Start storage");
         storage->Start();
 
+        // Process started by Restart takes listening sockets of its predecessor
+        const char *channel_env = std::getenv(restart_env);
+        int channel = channel_env != nullptr ? std::atoi(channel_env) : -1;
+        if (channel != -1) {
+            unsetenv(restart_env);
+            fcntl(channel, F_SETFD, FD_CLOEXEC);
+            log->warn("Take listening sockets over from the previous process");
+            listeners->InheritFrom(channel);
+        }
+
         // TODO: configure network service
         const uint16_t port = 8080;
-        log->warn("Start network on {}", port);
+        if (unix_path.empty()) {
+            log->warn("Start network on {}", port);
+        } else {
+            log->warn("Start network on {}", unix_path);
+        }
         server->Start(port, 2, 2);
+
+        if (redis_server) {
+            log->warn("Start Redis network on {}", redis_port);
+            redis_server->Start(redis_port, 2, 2);
+        }
+
+        // Predecessor stops once servers are accepting here
+        if (channel != -1) {
+            listeners->CloseInherited();
+            char ready = 1;
+            if (write(channel, &ready, 1) != 1) {
+                log->error("Failed to notify the previous process: {}", strerror(errno));
+            }
+            close(channel);
+        }
+    }
+
+    /**
+     * Starts new process of the binary with the same arguments and passes it listening sockets, so that clients
+     * are accepted all along. Returns true once the new process is serving clients, this one should be stopped
+     * then: connections it has are closed once commands already read are answered
+     */
+    bool Restart(char **argv) {
+        auto log = logService->select("root");
+
+        if (!restartable) {
+            log->error("Network doesn't support restart");
+            return false;
+        }
+
+        int channel[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, channel) == -1) {
+            log->error("Failed to create restart channel: {}", strerror(errno));
+            return false;
+        }
+
+        // Child of multithreaded process should only exec, so environment is prepared beforehand
+        std::string channel_var = std::string(restart_env) + "=" + std::to_string(channel[1]);
+        std::vector<char *> env;
+        for (char **var = environ; *var != nullptr; var++) {
+            if (std::strncmp(*var, restart_env, std::strlen(restart_env)) != 0) {
+                env.push_back(*var);
+            }
+        }
+        env.push_back(&channel_var[0]);
+        env.push_back(nullptr);
+
+        pid_t pid = fork();
+        if (pid == 0) {
+            fcntl(channel[1], F_SETFD, 0);
+            execvpe(argv[0], argv, env.data());
+            _exit(127);
+        }
+        close(channel[1]);
+        if (pid == -1) {
+            log->error("Failed to start new process: {}", strerror(errno));
+            close(channel[0]);
+            return false;
+        }
+
+        log->warn("Restart: process {} takes listening sockets over", pid);
+        bool ready = listeners->PassTo(channel[0]);
+        if (ready) {
+            struct pollfd pfd;
+            pfd.fd = channel[0];
+            pfd.events = POLLIN;
+            char reply = 0;
+            ready = poll(&pfd, 1, restart_timeout_ms) == 1 && read(channel[0], &reply, 1) == 1 && reply == 1;
+        }
+        close(channel[0]);
+
+        if (!ready) {
+            log->error("New process {} has failed to start, keep serving", pid);
+            kill(pid, SIGKILL);
+            waitpid(pid, nullptr, 0);
+        }
+        return ready;
     }
 
     // Stop services in correct order
@@ -97,6 +217,10 @@ public:
         auto log = logService->select("root");
         log->warn("Stop application");
         server->Stop();
+        if (redis_server) {
+            redis_server->Stop();
+            redis_server->Join();
+        }
         server->Join();
 
         storage->Stop();
@@ -104,11 +228,46 @@ public:
     }
 
 private:
+    std::shared_ptr<Afina::Network::Server> CreateServer(const std::string &network_type) {
+        std::shared_ptr<Afina::Network::Server> result;
+        if (network_type == "st_block") {
+            result = std::make_shared<Afina::Network::STblocking::ServerImpl>(storage, logService);
+        } else if (network_type == "mt_block") {
+            result = std::make_shared<Afina::Network::MTblocking::ServerImpl>(storage, logService);
+        } else if (network_type == "st_nonblock") {
+            result = std::make_shared<Afina::Network::STnonblock::ServerImpl>(storage, logService);
+        } else if (network_type == "mt_nonblock") {
+            result = std::make_shared<Afina::Network::MTnonblock::ServerImpl>(storage, logService);
+        } else if (network_type == "st_coroutine") {
+            result = std::make_shared<Afina::Network::STcoroutine::ServerImpl>(storage, logService);
+        } else if (network_type == "uring") {
+            result = std::make_shared<Afina::Network::Uring::ServerImpl>(storage, logService);
+        } else {
+            throw std::runtime_error("Unknown network type");
+        }
+        result->SetListeners(listeners);
+        return result;
+    }
+
     std::shared_ptr<Afina::Logging::Config> logConfig;
     std::shared_ptr<Afina::Logging::Service> logService;
 
+    // Environment variable telling the restarted process where to take listening sockets from, and how long
+    // the old one waits for the new one to start
+    static constexpr const char *restart_env = "AFINA_RESTART_FD";
+    static constexpr int restart_timeout_ms = 30000;
+
     std::shared_ptr<Afina::Storage> storage;
+    std::shared_ptr<Afina::Network::Listeners> listeners;
     std::shared_ptr<Afina::Network::Server> server;
+    bool restartable = false;
+
+    // UNIX socket the server listens on instead of TCP port, if set
+    std::string unix_path;
+
+    // Optional server for Redis clients
+    uint16_t redis_port = 0;
+    std::shared_ptr<Afina::Network::Server> redis_server;
 };
 
 // Signal set that to notify application about time to stop
@@ -129,6 +288,11 @@ int main(int argc, char **argv) {
         // and simplify validation below
         options.add_options()("s,storage", "Type of storage service to use", cxxopts::value<std::string>());
         options.add_options()("n,network", "Type of network service to use", cxxopts::value<std::string>());
+        options.add_options()("r,redis", "Port to serve Redis (RESP2) clients on", cxxopts::value<int>());
+        options.add_options()("c,connections", "Most client connections served at once",
+                              cxxopts::value<std::size_t>());
+        options.add_options()("u,unix", "UNIX socket to serve clients on instead of TCP port, @name is abstract one",
+                              cxxopts::value<std::string>());
         options.add_options()("h,help", "Print usage info");
         options.parse(argc, argv);
 
@@ -161,6 +325,7 @@ int main(int argc, char **argv) {
 
         sigaction(SIGINT, &act, NULL);
         sigaction(SIGTERM, &act, NULL);
+        sigaction(SIGUSR2, &act, NULL);
     }
 
     // Run app
@@ -168,9 +333,16 @@ int main(int argc, char **argv) {
         // Start services
         app.Start();
 
-        // Freeze main thread until one of signals arrive
-        while (stop_reason == 0 && ((sem_wait(&stop_semaphore) == -1) && (errno == EINTR))) {
-            continue;
+        // Freeze main thread until one of signals arrive. SIGUSR2 asks for restart, this process stops once the
+        // new one has taken over
+        for (;;) {
+            while ((sem_wait(&stop_semaphore) == -1) && (errno == EINTR)) {
+                continue;
+            }
+            if (stop_reason != SIGUSR2 || app.Restart(argv)) {
+                break;
+            }
+            stop_reason = 0;
         }
 
         // Stop services
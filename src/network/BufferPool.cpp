@@ -0,0 +1,49 @@
+#include "BufferPool.h"
+
+namespace Afina {
+namespace Network {
+
+namespace {
+
+// Buffers that have grown larger than that, because of a big value, are freed rather than kept
+constexpr std::size_t max_capacity = 4 * BufferPool::buffer_size;
+
+} // namespace
+
+constexpr std::size_t BufferPool::buffer_size;
+constexpr std::size_t BufferPool::max_free;
+constexpr std::size_t BufferPool::read_size;
+
+// See BufferPool.h
+std::string BufferPool::Take() {
+    if (_free.empty()) {
+        std::string buffer;
+        buffer.reserve(buffer_size);
+        return buffer;
+    }
+
+    std::string buffer = std::move(_free.back());
+    _free.pop_back();
+    if (_unused > _free.size()) {
+        _unused = _free.size();
+    }
+    return buffer;
+}
+
+// See BufferPool.h
+void BufferPool::Give(std::string &&buffer) {
+    if (_free.size() < max_free && buffer.capacity() <= max_capacity) {
+        buffer.clear();
+        _free.push_back(std::move(buffer));
+    }
+}
+
+// See BufferPool.h
+void BufferPool::Trim() {
+    // Buffers taken last are on top, so those at the bottom are the ones that have been idle
+    _free.erase(_free.begin(), _free.begin() + _unused);
+    _unused = _free.size();
+}
+
+} // namespace Network
+} // namespace Afina
@@ -0,0 +1,76 @@
+#ifndef AFINA_NETWORK_BUFFER_POOL_H
+#define AFINA_NETWORK_BUFFER_POOL_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace Afina {
+namespace Network {
+
+/**
+ * # Buffers shared by connections of a single thread
+ * Output queues take segments from the pool and give them back once they are sent, so connections that come
+ * and go don't allocate buffers of their own. Commands are executed as soon as they are read, so the block
+ * data is read from the socket into isn't kept between reads either: one is enough for the whole thread.
+ *
+ * Pool keeps what has been given back, up to max_free buffers. Trim is to be called periodically: it frees
+ * buffers that have stayed in the pool all along since the previous call, so memory taken by a burst is
+ * returned once load goes down.
+ *
+ * Pool isn't thread safe, it belongs to the thread serving connections.
+ */
+class BufferPool {
+public:
+    // Capacity buffers are allocated with
+    static constexpr std::size_t buffer_size = 16384;
+
+    // Most buffers kept for reuse
+    static constexpr std::size_t max_free = 256;
+
+    // Size of the block data is read from the socket in
+    static constexpr std::size_t read_size = 4096;
+
+    BufferPool() : _unused(0) {}
+
+    /**
+     * Returns empty buffer with capacity of at least buffer_size
+     */
+    std::string Take();
+
+    /**
+     * Puts buffer back for reuse. Buffers grown much larger than buffer_size are freed instead
+     */
+    void Give(std::string &&buffer);
+
+    /**
+     * Frees buffers nobody has needed since the previous call
+     */
+    void Trim();
+
+    /**
+     * Number of buffers kept for reuse
+     */
+    inline std::size_t Size() const { return _free.size(); }
+
+    /**
+     * Block to read data from the socket into, it is only valid until the next read
+     */
+    inline char *ReadBlock() { return _read_block; }
+
+private:
+    BufferPool(const BufferPool &) = delete;
+    BufferPool &operator=(const BufferPool &) = delete;
+
+    std::vector<std::string> _free;
+
+    // Fewest buffers pool has had since the previous Trim: that many haven't been needed at all
+    std::size_t _unused;
+
+    char _read_block[read_size];
+};
+
+} // namespace Network
+} // namespace Afina
+
+#endif // AFINA_NETWORK_BUFFER_POOL_H
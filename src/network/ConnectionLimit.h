@@ -0,0 +1,57 @@
+#ifndef AFINA_NETWORK_CONNECTION_LIMIT_H
+#define AFINA_NETWORK_CONNECTION_LIMIT_H
+
+#include <atomic>
+#include <cstddef>
+
+namespace Afina {
+namespace Network {
+
+/**
+ * # Number of connections server serves at once
+ * Acceptor takes a slot before accepting connection and gives it back once connection is closed. Server that is
+ * full stops accepting: new clients wait in the listen backlog rather than get connections served slower than
+ * the rest, and are accepted as soon as some slot is given back.
+ *
+ * Counter could be shared by threads accepting on their own sockets, so that the limit is global for the server.
+ */
+class ConnectionLimit {
+public:
+    /**
+     * @param limit most connections served at once, zero means there is no limit
+     */
+    explicit ConnectionLimit(std::size_t limit) : _limit(limit), _count(0) {}
+
+    /**
+     * Takes a slot for the connection about to be accepted, returns false if there is none left
+     */
+    inline bool Acquire() {
+        if (_count.fetch_add(1, std::memory_order_relaxed) < _limit || _limit == 0) {
+            return true;
+        }
+        _count.fetch_sub(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    /**
+     * Gives back slot of the closed connection, or of the one that hasn't been accepted after all
+     */
+    inline void Release() { _count.fetch_sub(1, std::memory_order_relaxed); }
+
+    /**
+     * Returns true if there is no slot for the next connection
+     */
+    inline bool Full() const { return _limit != 0 && _count.load(std::memory_order_relaxed) >= _limit; }
+
+private:
+    ConnectionLimit(const ConnectionLimit &) = delete;
+    ConnectionLimit &operator=(const ConnectionLimit &) = delete;
+
+    const std::size_t _limit;
+    std::atomic<std::size_t> _count;
+};
+
+} // namespace Network
+} // namespace Afina
+
+#endif // AFINA_NETWORK_CONNECTION_LIMIT_H
@@ -0,0 +1,103 @@
+#include "IdleWheel.h"
+
+namespace Afina {
+namespace Network {
+
+constexpr uint64_t IdleWheel::slot_ms;
+constexpr std::size_t IdleWheel::wheel_size;
+
+// See IdleWheel.h
+IdleWheel::IdleWheel(std::chrono::milliseconds timeout)
+    : _timeout(timeout.count() > 0 ? uint64_t(timeout.count()) : 0), _count(0), _tick(Now() / slot_ms),
+      _next_tick(UINT64_MAX) {
+    _slots.fill(nullptr);
+}
+
+// See IdleWheel.h
+uint64_t IdleWheel::Now() {
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return uint64_t(std::chrono::duration_cast<std::chrono::milliseconds>(now).count());
+}
+
+// See IdleWheel.h
+void IdleWheel::Add(Entry &entry, uint64_t now) {
+    if (_timeout == 0) {
+        return;
+    }
+    entry._last_active = now;
+    Link(entry);
+}
+
+// See IdleWheel.h
+void IdleWheel::Remove(Entry &entry) {
+    if (entry._linked) {
+        Unlink(entry);
+    }
+}
+
+// See IdleWheel.h
+int IdleWheel::Timeout(uint64_t now) const {
+    if (_count == 0) {
+        return -1;
+    }
+
+    uint64_t at = _next_tick * slot_ms;
+    return at > now ? int(at - now) : 0;
+}
+
+// See IdleWheel.h
+void IdleWheel::Link(Entry &entry) {
+    // Slot is never the one processed already, otherwise entry would wait for the whole turn
+    uint64_t tick = (entry._last_active + _timeout + slot_ms - 1) / slot_ms;
+    if (tick <= _tick) {
+        tick = _tick + 1;
+    }
+    entry._check_at = tick;
+
+    Entry *&slot = _slots[tick & (wheel_size - 1)];
+    entry._prev = nullptr;
+    entry._next = slot;
+    if (slot != nullptr) {
+        slot->_prev = &entry;
+    }
+    slot = &entry;
+    entry._linked = true;
+
+    _count++;
+    if (tick < _next_tick) {
+        _next_tick = tick;
+    }
+}
+
+// See IdleWheel.h
+void IdleWheel::Unlink(Entry &entry) {
+    if (entry._prev != nullptr) {
+        entry._prev->_next = entry._next;
+    } else {
+        _slots[entry._check_at & (wheel_size - 1)] = entry._next;
+    }
+    if (entry._next != nullptr) {
+        entry._next->_prev = entry._prev;
+    }
+    entry._prev = entry._next = nullptr;
+    entry._linked = false;
+    _count--;
+}
+
+// See IdleWheel.h
+void IdleWheel::FindNext() {
+    // Slot found could hold entries of the later turns only, then wheel just wakes up for nothing once per turn
+    _next_tick = UINT64_MAX;
+    if (_count == 0) {
+        return;
+    }
+    for (uint64_t tick = _tick + 1; tick <= _tick + wheel_size; tick++) {
+        if (_slots[tick & (wheel_size - 1)] != nullptr) {
+            _next_tick = tick;
+            return;
+        }
+    }
+}
+
+} // namespace Network
+} // namespace Afina
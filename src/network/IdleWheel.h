@@ -0,0 +1,151 @@
+#ifndef AFINA_NETWORK_IDLE_WHEEL_H
+#define AFINA_NETWORK_IDLE_WHEEL_H
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace Afina {
+namespace Network {
+
+/**
+ * # Connections to be closed once they are idle for too long
+ * Hashed timing wheel of slot_ms wide slots. Entry is linked into the slot of the time it has to be checked at,
+ * that is when it becomes idle for timeout unless something happens meanwhile.
+ *
+ * Activity doesn't move entry between slots, Touch only remembers when it has happened. Once slot's time comes
+ * entries there are checked: those idle for timeout are reaped, the rest are moved to the slot their idle time
+ * ends at now. So busy connection costs a store per event and is relinked at most once per timeout.
+ *
+ * Wheel isn't thread safe, it belongs to the thread serving connections.
+ */
+class IdleWheel {
+public:
+    // Width of the slot, entries are reaped up to that late
+    static constexpr uint64_t slot_ms = 250;
+
+    // Number of slots, must be power of 2. Timeouts longer than the whole turn take several turns to come
+    static constexpr std::size_t wheel_size = 256;
+
+    /**
+     * # Part of the connection the wheel tracks
+     * Connection class derives from it, so reaped entry is cast back to the connection
+     */
+    class Entry {
+    public:
+        Entry() : _prev(nullptr), _next(nullptr), _linked(false), _last_active(0), _check_at(0) {}
+
+    private:
+        friend class IdleWheel;
+
+        // Links in the slot
+        Entry *_prev;
+        Entry *_next;
+        bool _linked;
+
+        // Time of the last activity, and slot entry is to be checked at
+        uint64_t _last_active;
+        uint64_t _check_at;
+    };
+
+    /**
+     * @param timeout idle time connection is reaped after, zero disables reaping
+     */
+    explicit IdleWheel(std::chrono::milliseconds timeout);
+
+    /**
+     * Current time in milliseconds, as wheel counts it
+     */
+    static uint64_t Now();
+
+    inline bool Enabled() const { return _timeout != 0; }
+
+    /**
+     * Starts tracking entry, it is active at the given time
+     */
+    void Add(Entry &entry, uint64_t now);
+
+    /**
+     * Remembers that entry is active at the given time
+     */
+    inline void Touch(Entry &entry, uint64_t now) { entry._last_active = now; }
+
+    /**
+     * Stops tracking entry, does nothing if it isn't tracked
+     */
+    void Remove(Entry &entry);
+
+    /**
+     * Returns milliseconds till the next slot to be checked, suitable for epoll_wait: -1 if nothing is tracked
+     */
+    int Timeout(uint64_t now) const;
+
+    /**
+     * Checks all slots whose time has come and calls reap for every entry idle for timeout. Entry is removed
+     * from the wheel before reap is called
+     */
+    template <typename F> void Expire(uint64_t now, F reap) {
+        if (_count == 0) {
+            _tick = now / slot_ms;
+            return;
+        }
+
+        // Once whole turn is skipped every slot is visited, no need to do it again. Wheel is moved forward at
+        // once, so that entries relinked on the way go to the slots after the current one
+        uint64_t to = now / slot_ms;
+        uint64_t from = _tick + 1;
+        if (to - _tick > wheel_size) {
+            from = to - wheel_size + 1;
+        }
+        if (to > _tick) {
+            _tick = to;
+        }
+
+        for (uint64_t tick = from; tick <= to; tick++) {
+            Entry *entry = _slots[tick & (wheel_size - 1)];
+            while (entry != nullptr) {
+                Entry *next = entry->_next;
+                if (entry->_check_at <= to) {
+                    // Entry active meanwhile goes to the slot its new idle time ends at
+                    Unlink(*entry);
+                    if (entry->_last_active + _timeout <= now) {
+                        reap(*entry);
+                    } else {
+                        Link(*entry);
+                    }
+                }
+                entry = next;
+            }
+        }
+        FindNext();
+    }
+
+private:
+    IdleWheel(const IdleWheel &) = delete;
+    IdleWheel &operator=(const IdleWheel &) = delete;
+
+    // Puts entry into the slot its idle time ends at, or removes from one
+    void Link(Entry &entry);
+    void Unlink(Entry &entry);
+
+    // Looks for the earliest slot with entries after the current one
+    void FindNext();
+
+    // Idle time in milliseconds
+    const uint64_t _timeout;
+
+    std::array<Entry *, wheel_size> _slots;
+
+    // Number of entries tracked
+    std::size_t _count;
+
+    // Slot up to which (inclusive) wheel has been processed, and the next slot known to have entries
+    uint64_t _tick;
+    uint64_t _next_tick;
+};
+
+} // namespace Network
+} // namespace Afina
+
+#endif // AFINA_NETWORK_IDLE_WHEEL_H
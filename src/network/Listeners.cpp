@@ -0,0 +1,290 @@
+#include <afina/network/Listeners.h>
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <cstddef>
+
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace Afina {
+namespace Network {
+
+namespace {
+
+// Most sockets passed at once, kernel limit is a bit higher
+constexpr std::size_t max_sockets = 64;
+
+// Sets or clears O_NONBLOCK of the socket
+bool SetNonBlocking(int socket, bool nonblocking) {
+    int flags = fcntl(socket, F_GETFL);
+    if (flags == -1) {
+        return false;
+    }
+    flags = nonblocking ? flags | O_NONBLOCK : flags & ~O_NONBLOCK;
+    return fcntl(socket, F_SETFL, flags) == 0;
+}
+
+// Fills UNIX socket address of the path and returns its length, the way getsockname reports it
+socklen_t UnixAddress(const std::string &path, struct sockaddr_un &addr) {
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::size_t base = offsetof(struct sockaddr_un, sun_path);
+    if (path.empty() || path == "@" || path.size() >= sizeof(addr.sun_path)) {
+        throw std::runtime_error("Invalid UNIX socket path: " + path);
+    }
+
+    // Abstract name starts with zero byte and isn't terminated
+    if (path[0] == '@') {
+        std::memcpy(addr.sun_path + 1, path.data() + 1, path.size() - 1);
+        return socklen_t(base + path.size());
+    }
+    std::memcpy(addr.sun_path, path.data(), path.size());
+    return socklen_t(base + path.size() + 1);
+}
+
+// Checks if the socket is bound to the address
+bool BoundTo(int socket, const struct sockaddr_un &addr, socklen_t addr_len) {
+    struct sockaddr_un bound;
+    socklen_t bound_len = sizeof(bound);
+    return getsockname(socket, (struct sockaddr *)&bound, &bound_len) == 0 && bound.sun_family == AF_UNIX &&
+           bound_len == addr_len && std::memcmp(&bound, &addr, addr_len) == 0;
+}
+
+// Connects to the UNIX socket address, returns zero if somebody listens on it or the error otherwise
+int Probe(const struct sockaddr_un &addr, socklen_t addr_len) {
+    int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (probe == -1) {
+        return errno;
+    }
+    int error = connect(probe, (const struct sockaddr *)&addr, addr_len) == 0 ? 0 : errno;
+    close(probe);
+    return error;
+}
+
+} // namespace
+
+// See Listeners.h
+Listeners::~Listeners() { CloseInherited(); }
+
+// See Listeners.h
+int Listeners::Open(uint16_t port, bool nonblocking, bool reuse_port) {
+    std::lock_guard<std::mutex> lock(_lock);
+
+    // Inherited socket is bound already, port is the only thing to look at
+    for (auto it = _inherited.begin(); it != _inherited.end(); ++it) {
+        struct sockaddr_in addr;
+        socklen_t addr_len = sizeof(addr);
+        if (getsockname(*it, (struct sockaddr *)&addr, &addr_len) == -1 || addr.sin_family != AF_INET ||
+            ntohs(addr.sin_port) != port) {
+            continue;
+        }
+
+        int server_socket = *it;
+        _inherited.erase(it);
+        if (!SetNonBlocking(server_socket, nonblocking)) {
+            close(server_socket);
+            throw std::runtime_error("Failed to set socket flags: " + std::string(strerror(errno)));
+        }
+        _opened.push_back(server_socket);
+        return server_socket;
+    }
+
+    struct sockaddr_in server_addr;
+    std::memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;         // IPv4
+    server_addr.sin_port = htons(port);       // TCP port number
+    server_addr.sin_addr.s_addr = INADDR_ANY; // Bind to any address
+
+    int type = SOCK_STREAM | SOCK_CLOEXEC | (nonblocking ? SOCK_NONBLOCK : 0);
+    int server_socket = socket(PF_INET, type, IPPROTO_TCP);
+    if (server_socket == -1) {
+        throw std::runtime_error("Failed to open socket: " + std::string(strerror(errno)));
+    }
+
+    int opts = 1;
+    if (setsockopt(server_socket, SOL_SOCKET, SO_REUSEADDR, &opts, sizeof(opts)) == -1 ||
+        (reuse_port && setsockopt(server_socket, SOL_SOCKET, SO_REUSEPORT, &opts, sizeof(opts)) == -1)) {
+        close(server_socket);
+        throw std::runtime_error("Socket setsockopt() failed: " + std::string(strerror(errno)));
+    }
+
+    if (bind(server_socket, (struct sockaddr *)&server_addr, sizeof(server_addr)) == -1) {
+        close(server_socket);
+        throw std::runtime_error("Socket bind() failed: " + std::string(strerror(errno)));
+    }
+
+    if (listen(server_socket, SOMAXCONN) == -1) {
+        close(server_socket);
+        throw std::runtime_error("Socket listen() failed: " + std::string(strerror(errno)));
+    }
+    _opened.push_back(server_socket);
+    return server_socket;
+}
+
+// See Listeners.h
+int Listeners::OpenUnix(const std::string &path, bool nonblocking) {
+    struct sockaddr_un server_addr;
+    socklen_t addr_len = UnixAddress(path, server_addr);
+    std::lock_guard<std::mutex> lock(_lock);
+
+    for (int socket : _opened) {
+        if (BoundTo(socket, server_addr, addr_len)) {
+            int server_socket = fcntl(socket, F_DUPFD_CLOEXEC, 0);
+            if (server_socket == -1) {
+                throw std::runtime_error("Failed to duplicate socket: " + std::string(strerror(errno)));
+            }
+            return server_socket;
+        }
+    }
+
+    for (auto it = _inherited.begin(); it != _inherited.end(); ++it) {
+        if (!BoundTo(*it, server_addr, addr_len)) {
+            continue;
+        }
+
+        int server_socket = *it;
+        _inherited.erase(it);
+        if (!SetNonBlocking(server_socket, nonblocking)) {
+            close(server_socket);
+            throw std::runtime_error("Failed to set socket flags: " + std::string(strerror(errno)));
+        }
+        _opened.push_back(server_socket);
+        return server_socket;
+    }
+
+    // Socket file outlives the process, it is removed only if nobody listens on it anymore. Server which is still
+    // running either accepts the probe or has its backlog full
+    struct stat st;
+    if (path[0] != '@' && lstat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+        int error = Probe(server_addr, addr_len);
+        if (error == ECONNREFUSED) {
+            unlink(path.c_str());
+        } else if (error != ENOENT) {
+            error = error == 0 || error == EAGAIN ? EADDRINUSE : error;
+            throw std::runtime_error("Socket bind() failed: " + std::string(strerror(error)));
+        }
+    }
+
+    int type = SOCK_STREAM | SOCK_CLOEXEC | (nonblocking ? SOCK_NONBLOCK : 0);
+    int server_socket = socket(AF_UNIX, type, 0);
+    if (server_socket == -1) {
+        throw std::runtime_error("Failed to open socket: " + std::string(strerror(errno)));
+    }
+
+    if (bind(server_socket, (struct sockaddr *)&server_addr, addr_len) == -1) {
+        close(server_socket);
+        throw std::runtime_error("Socket bind() failed: " + std::string(strerror(errno)));
+    }
+
+    if (listen(server_socket, SOMAXCONN) == -1) {
+        close(server_socket);
+        throw std::runtime_error("Socket listen() failed: " + std::string(strerror(errno)));
+    }
+    _opened.push_back(server_socket);
+    return server_socket;
+}
+
+// See Listeners.h
+std::vector<int> Listeners::Opened() {
+    std::lock_guard<std::mutex> lock(_lock);
+    return _opened;
+}
+
+// See Listeners.h
+bool Listeners::PassTo(int channel) {
+    std::vector<int> sockets = Opened();
+    if (sockets.empty() || sockets.size() > max_sockets) {
+        return false;
+    }
+
+    // Number of sockets goes as data, message without any isn't delivered
+    uint32_t count = uint32_t(sockets.size());
+    struct iovec iov;
+    iov.iov_base = &count;
+    iov.iov_len = sizeof(count);
+
+    char control[CMSG_SPACE(max_sockets * sizeof(int))];
+    std::memset(control, 0, sizeof(control));
+    struct msghdr msg;
+    std::memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = CMSG_SPACE(sockets.size() * sizeof(int));
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sockets.size() * sizeof(int));
+    std::memcpy(CMSG_DATA(cmsg), sockets.data(), sockets.size() * sizeof(int));
+
+    ssize_t sent;
+    do {
+        sent = sendmsg(channel, &msg, MSG_NOSIGNAL);
+    } while (sent == -1 && errno == EINTR);
+    return sent == sizeof(count);
+}
+
+// See Listeners.h
+void Listeners::InheritFrom(int channel) {
+    uint32_t count = 0;
+    struct iovec iov;
+    iov.iov_base = &count;
+    iov.iov_len = sizeof(count);
+
+    char control[CMSG_SPACE(max_sockets * sizeof(int))];
+    struct msghdr msg;
+    std::memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ssize_t received;
+    do {
+        received = recvmsg(channel, &msg, MSG_CMSG_CLOEXEC);
+    } while (received == -1 && errno == EINTR);
+    if (received != sizeof(count)) {
+        throw std::runtime_error("Failed to receive listening sockets: " +
+                                 std::string(received == -1 ? strerror(errno) : "no message"));
+    }
+
+    std::vector<int> sockets;
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+            std::size_t n = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            const unsigned char *data = CMSG_DATA(cmsg);
+            for (std::size_t i = 0; i < n; i++) {
+                int socket;
+                std::memcpy(&socket, data + i * sizeof(int), sizeof(int));
+                sockets.push_back(socket);
+            }
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(_lock);
+    _inherited.insert(_inherited.end(), sockets.begin(), sockets.end());
+    if ((msg.msg_flags & MSG_CTRUNC) != 0 || sockets.size() != count) {
+        throw std::runtime_error("Failed to receive listening sockets: message is truncated");
+    }
+}
+
+// See Listeners.h
+void Listeners::CloseInherited() {
+    std::lock_guard<std::mutex> lock(_lock);
+    for (int socket : _inherited) {
+        close(socket);
+    }
+    _inherited.clear();
+}
+
+} // namespace Network
+} // namespace Afina
@@ -0,0 +1,89 @@
+#include "OutputQueue.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <limits.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+namespace Afina {
+namespace Network {
+
+constexpr std::size_t OutputQueue::segment_size;
+
+// See OutputQueue.h
+std::string &OutputQueue::Back(BufferPool &pool) {
+    if (!_segments.empty() && _segments.back().size() < segment_size) {
+        return _segments.back();
+    }
+
+    // Segment being filled is going to be followed by another one, so its size is fixed from now on
+    if (!_segments.empty()) {
+        _size += _segments.back().size();
+    }
+    _segments.emplace_back(pool.Take());
+    return _segments.back();
+}
+
+// See OutputQueue.h
+OutputQueue::Status OutputQueue::Send(int socket, BufferPool &pool) {
+    while (!Empty()) {
+        struct iovec iov[IOV_MAX];
+        std::size_t count = std::min<std::size_t>(_segments.size(), IOV_MAX);
+        for (std::size_t i = 0; i < count; i++) {
+            std::string &segment = _segments[i];
+            std::size_t offset = i == 0 ? _written : 0;
+            iov[i].iov_base = &segment[0] + offset;
+            iov[i].iov_len = segment.size() - offset;
+        }
+
+        struct msghdr msg;
+        std::memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = count;
+        ssize_t sent = sendmsg(socket, &msg, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno == EAGAIN || errno == EWOULDBLOCK ? Status::kWouldBlock : Status::kError;
+        }
+
+        // Drop segments sent completely, the first one left is sent partially
+        std::size_t left = sent;
+        while (!_segments.empty() && left >= _segments.front().size() - _written) {
+            left -= _segments.front().size() - _written;
+            PopFront(pool);
+        }
+        _written += left;
+    }
+
+    // Segment could have been taken for responses that haven't come, it goes back as well
+    Clear(pool);
+    return Status::kDone;
+}
+
+// See OutputQueue.h
+void OutputQueue::Clear(BufferPool &pool) {
+    while (!_segments.empty()) {
+        PopFront(pool);
+    }
+}
+
+// See OutputQueue.h
+void OutputQueue::PopFront(BufferPool &pool) {
+    std::string segment = std::move(_segments.front());
+    _segments.pop_front();
+    if (!_segments.empty()) {
+        _size -= segment.size();
+    } else {
+        _size = 0;
+    }
+    _written = 0;
+    pool.Give(std::move(segment));
+}
+
+} // namespace Network
+} // namespace Afina
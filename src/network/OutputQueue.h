@@ -0,0 +1,79 @@
+#ifndef AFINA_NETWORK_OUTPUT_QUEUE_H
+#define AFINA_NETWORK_OUTPUT_QUEUE_H
+
+#include <cstddef>
+#include <deque>
+#include <string>
+
+#include "BufferPool.h"
+
+namespace Afina {
+namespace Network {
+
+/**
+ * # Responses waiting to be sent to the client
+ * Responses are appended to the last of the segments, once it grows to segment_size the next segment is
+ * started. Connections make session stop there, see Protocol::Session::SetOutputLimit, so only a single
+ * response larger than that grows segment beyond its buffer, output as a whole is never reallocated and copied.
+ * Nor is it moved once its head is sent: segments sent completely go back to the pool of the thread serving
+ * connection, to be reused for the next responses. Queue that has been sent keeps no memory at all.
+ *
+ * Send hands all the segments to the kernel at once, with a single sendmsg of up to IOV_MAX of them.
+ */
+class OutputQueue {
+public:
+    // Segment is filled up to this size before the next one is started
+    static constexpr std::size_t segment_size = BufferPool::buffer_size;
+
+    // Result of Send
+    enum class Status { kDone, kWouldBlock, kError };
+
+    OutputQueue() : _size(0), _written(0) {}
+
+    /**
+     * Returns buffer to append responses to, it remains valid until the next call of Back or Send
+     *
+     * @param pool to take new segment from
+     */
+    std::string &Back(BufferPool &pool);
+
+    /**
+     * Sends queued data until everything is sent or socket would block
+     *
+     * @param socket non-blocking socket to send to
+     * @param pool to give segments sent back to
+     * @return kDone once queue is empty, kWouldBlock if socket accepts no more, kError if it is broken
+     */
+    Status Send(int socket, BufferPool &pool);
+
+    /**
+     * Number of bytes waiting to be sent
+     */
+    inline std::size_t Size() const {
+        return _segments.empty() ? 0 : _size + _segments.back().size() - _written;
+    }
+
+    inline bool Empty() const { return Size() == 0; }
+
+    /**
+     * Drops everything queued
+     */
+    void Clear(BufferPool &pool);
+
+private:
+    // Segment is sent completely, drops it from the queue
+    void PopFront(BufferPool &pool);
+
+    std::deque<std::string> _segments;
+
+    // Total size of segments but the last one, which is being appended to
+    std::size_t _size;
+
+    // Bytes of the first segment that have been sent already
+    std::size_t _written;
+};
+
+} // namespace Network
+} // namespace Afina
+
+#endif // AFINA_NETWORK_OUTPUT_QUEUE_H
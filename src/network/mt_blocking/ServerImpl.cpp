@@ -1,6 +1,7 @@
 #include "ServerImpl.h"
 
 #include <cassert>
+#include <cerrno>
 #include <cstring>
 #include <iostream>
 #include <memory>
@@ -20,12 +21,35 @@
 #include <afina/execute/Command.h>
 #include <afina/logging/Service.h>
 
-#include "protocol/Parser.h"
+#include "protocol/Session.h"
 
 namespace Afina {
 namespace Network {
 namespace MTblocking {
 
+namespace {
+
+// Responses formed before they are sent, commands beyond that wait in the session
+constexpr std::size_t max_batch = 16384;
+
+// Sends the whole buffer, blocking socket could still accept only a part of it if call gets interrupted
+void SendAll(int socket, const std::string &data) {
+    std::size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = send(socket, data.data() + sent, data.size() - sent, 0);
+        if (n > 0) {
+            sent += n;
+        } else if (n < 0 && errno == EINTR) {
+            // Signal has interrupted the call before anything has been sent, it is just repeated
+            continue;
+        } else {
+            throw std::runtime_error("Failed to send response");
+        }
+    }
+}
+
+} // namespace
+
 // See Server.h
 ServerImpl::ServerImpl(std::shared_ptr<Afina::Storage> ps, std::shared_ptr<Logging::Service> pl,
         std::size_t capacity, std::time_t read_timeout)
@@ -46,32 +70,37 @@ void ServerImpl::Start(uint16_t port, uint32_t n_accept, uint32_t n_workers) {
         throw std::runtime_error("Unable to mask SIGPIPE");
     }
 
-    struct sockaddr_in server_addr;
-    std::memset(&server_addr, 0, sizeof(server_addr));
-    server_addr.sin_family = AF_INET;         // IPv4
-    server_addr.sin_port = htons(port);       // TCP port number
-    server_addr.sin_addr.s_addr = INADDR_ANY; // Bind to any address
-
-    _server_socket = socket(PF_INET, SOCK_STREAM, IPPROTO_TCP);
-    if (_server_socket == -1) {
-        throw std::runtime_error("Failed to open socket");
-    }
+    if (!_unix_path.empty()) {
+        // Clients on the same host talk over UNIX socket, see Server::SetUnixPath
+        _server_socket = pListeners->OpenUnix(_unix_path, false);
+    } else {
+        struct sockaddr_in server_addr;
+        std::memset(&server_addr, 0, sizeof(server_addr));
+        server_addr.sin_family = AF_INET;         // IPv4
+        server_addr.sin_port = htons(port);       // TCP port number
+        server_addr.sin_addr.s_addr = INADDR_ANY; // Bind to any address
+
+        _server_socket = socket(PF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (_server_socket == -1) {
+            throw std::runtime_error("Failed to open socket");
+        }
 
-    int opts = 1;
-    if (setsockopt(_server_socket, SOL_SOCKET, SO_REUSEADDR, &opts, sizeof(opts)) == -1) {
-        close(_server_socket);
-        throw std::runtime_error("Socket setsockopt() failed");
-    }
+        int opts = 1;
+        if (setsockopt(_server_socket, SOL_SOCKET, SO_REUSEADDR, &opts, sizeof(opts)) == -1) {
+            close(_server_socket);
+            throw std::runtime_error("Socket setsockopt() failed");
+        }
 
-    if (bind(_server_socket, (struct sockaddr *) &server_addr, sizeof(server_addr)) == -1) {
-        close(_server_socket);
-        throw std::runtime_error("Socket bind() failed");
-    }
+        if (bind(_server_socket, (struct sockaddr *) &server_addr, sizeof(server_addr)) == -1) {
+            close(_server_socket);
+            throw std::runtime_error("Socket bind() failed");
+        }
 
-    if (listen(_server_socket, 5) == -1) {
+        if (listen(_server_socket, 5) == -1) {
 
-        close(_server_socket);
-        throw std::runtime_error("Socket listen() failed");
+            close(_server_socket);
+            throw std::runtime_error("Socket listen() failed");
+        }
     }
 
     running.store(true);
@@ -150,85 +179,53 @@ void ServerImpl::OnRun() {
 
 void ServerImpl::Work(int client_socket) {
     // Here is connection state
-    // - parser: parse state of the stream
-    // - command_to_execute: last command parsed out of stream
-    // - arg_remains: how many bytes to read from stream to get command argument
-    // - argument_for_command: buffer stores argument
-    std::size_t arg_remains;
-    Protocol::Parser parser;
-    std::string argument_for_command;
-    std::unique_ptr<Execute::Command> command_to_execute;
+    // - session: protocol state of the stream
+    // - result: responses waiting to be sent, reused to avoid allocations
+    Protocol::Session session(*pStorage, _dialect == Dialect::kRedis);
+    session.SetOutputLimit(max_batch);
+    std::string result;
 
     // Process new connection:
     // - read commands until socket alive
     // - execute each command
     // - send response
     try {
-        int readed_bytes = -1;
+        ssize_t readed_bytes = -1;
         char client_buffer[4096];
-        while (running.load() && (readed_bytes = read(client_socket, client_buffer, sizeof(client_buffer))) > 0) {
+        bool alive = true;
+        while (alive && running.load()) {
+            // Large data block is read right into the command argument
+            std::size_t direct_size = 0;
+            char *direct = session.BodyBuffer(direct_size);
+            if (direct != nullptr) {
+                readed_bytes = read(client_socket, direct, direct_size);
+            } else {
+                readed_bytes = read(client_socket, client_buffer, sizeof(client_buffer));
+            }
+            if (readed_bytes <= 0) {
+                break;
+            }
             _logger->debug("Got {} bytes from socket", readed_bytes);
 
-            // Single block of data readed from the socket could trigger inside actions a multiple times,
-            // for example:
-            // - read#0: [<command1 start>]
-            // - read#1: [<command1 end> <argument> <command2> <argument for command 2> <command3> ... ]
-            while (readed_bytes > 0) {
-                _logger->debug("Process {} bytes", readed_bytes);
-                // There is no command yet
-                if (!command_to_execute) {
-                    std::size_t parsed = 0;
-                    if (parser.Parse(client_buffer, readed_bytes, parsed)) {
-                        // There is no command to be launched, continue to parse input stream
-                        // Here we are, current chunk finished some command, process it
-                        _logger->debug("Found new command: {} in {} bytes", parser.Name(), parsed);
-                        command_to_execute = parser.Build(arg_remains);
-                        if (arg_remains > 0) {
-                            arg_remains += 2;
-                        }
-                    }
-
-                    // Parsed might fails to consume any bytes from input stream. In real life that could happens,
-                    // for example, because we are working with UTF-16 chars and only 1 byte left in stream
-                    if (parsed == 0) {
-                        break;
-                    } else {
-                        std::memmove(client_buffer, client_buffer + parsed, readed_bytes - parsed);
-                        readed_bytes -= parsed;
-                    }
-                }
-
-                // There is command, but we still wait for argument to arrive...
-                if (command_to_execute && arg_remains > 0) {
-                    _logger->debug("Fill argument: {} bytes of {}", readed_bytes, arg_remains);
-                    // There is some parsed command, and now we are reading argument
-                    std::size_t to_read = std::min(arg_remains, std::size_t(readed_bytes));
-                    argument_for_command.append(client_buffer, to_read);
-
-                    std::memmove(client_buffer, client_buffer + to_read, readed_bytes - to_read);
-                    arg_remains -= to_read;
-                    readed_bytes -= to_read;
-                }
+            // Responses on all commands completed by this block of data are sent at once
+            if (direct != nullptr) {
+                alive = session.BodyReceived(readed_bytes, result);
+            } else {
+                alive = session.Process(client_buffer, readed_bytes, result);
+            }
+            while (!result.empty()) {
+                SendAll(client_socket, result);
+                result.clear();
 
-                // There is command & argument - RUN!
-                if (command_to_execute && arg_remains == 0) {
-                    _logger->debug("Start command execution");
-
-                    std::string result;
-                    command_to_execute->Execute(*pStorage, argument_for_command, result);
-                    // Send response
-                    result += "\r\n";
-                    if (send(client_socket, result.data(), result.size(), 0) <= 0) {
-                        throw std::runtime_error("Failed to send response");
-                    }
-                    // Prepare for the next command
-                    command_to_execute.reset();
-                    argument_for_command.resize(0);
-                    parser.Reset();
+                // Commands session has held back go on once responses formed so far are sent
+                if (alive && session.Held()) {
+                    alive = session.Resume(result);
                 }
-            } // while (readed_bytes)
+            }
         }
-        if (readed_bytes == 0) {
+        if (!alive) {
+            _logger->debug("Malformed input on {}, closing connection", client_socket);
+        } else if (readed_bytes == 0) {
             _logger->debug("Connection closed");
         } else {
             throw std::runtime_error(std::string(strerror(errno)));
@@ -1,25 +1,140 @@
 #include "Connection.h"
 
-#include <iostream>
+#include <cerrno>
+
+#include <sys/socket.h>
+#include <unistd.h>
 
 namespace Afina {
 namespace Network {
 namespace MTnonblock {
 
+constexpr std::size_t Connection::max_output;
+
+// See Connection.h
+void Connection::Start(int s) {
+    _socket = s;
+    _session.Reset();
+    _alive = true;
+    _reading = true;
+    _throttled = false;
+    _deferred = false;
+    _event.events = EPOLLIN | EPOLLET;
+}
+
 // See Connection.h
-void Connection::Start() { std::cout << "Start" << std::endl; }
+void Connection::OnError() {
+    _alive = false;
+    _reading = false;
+    _output.Clear(*_buffers);
+}
 
 // See Connection.h
-void Connection::OnError() { std::cout << "OnError" << std::endl; }
+void Connection::OnClose() {
+    _alive = false;
+    _reading = false;
+}
 
 // See Connection.h
-void Connection::OnClose() { std::cout << "OnClose" << std::endl; }
+void Connection::DoRead() {
+    // Edge-triggered event comes only once, so socket must be read till it would block
+    while (_reading) {
+        // Client doesn't keep up with responses, try to get rid of them before reading more
+        if (_output.Size() >= max_output) {
+            Flush();
+            if (!_alive) {
+                return;
+            }
+            if (_output.Size() >= max_output) {
+                // Reading goes on once EPOLLOUT reports socket has taken output
+                _throttled = true;
+                return;
+            }
+        }
+
+        if (_session.Held()) {
+            // Commands held back by session have been read before anything left in the socket
+            _reading = _session.Resume(_output.Back(*_buffers));
+        } else {
+            // Large data block is read right into the command argument
+            std::size_t direct_size = 0;
+            char *direct = _session.BodyBuffer(direct_size);
+            ssize_t readed_bytes;
+            if (direct != nullptr) {
+                readed_bytes = read(_socket, direct, direct_size);
+            } else {
+                readed_bytes = read(_socket, _buffers->ReadBlock(), BufferPool::read_size);
+            }
+
+            if (readed_bytes > 0) {
+                bool alive;
+                if (direct != nullptr) {
+                    alive = _session.BodyReceived(readed_bytes, _output.Back(*_buffers));
+                } else {
+                    alive = _session.Process(_buffers->ReadBlock(), readed_bytes, _output.Back(*_buffers));
+                }
+                // Stream is broken, client gets the error and connection is closed then
+                _reading = alive;
+            } else if (readed_bytes == 0) {
+                // Client has sent everything, it is closed once responses are sent
+                _reading = false;
+            } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            } else if (errno != EINTR) {
+                OnError();
+                return;
+            }
+        }
+
+        // Budget of the turn is spent, commands beyond it have been refused. The rest of input waits for the
+        // next turn, worker serves connection again then
+        if (_reading && _session.Budget() == 0) {
+            _deferred = true;
+            break;
+        }
+    }
+
+    // Responses on all commands read are sent at once
+    Flush();
+}
+
+// See Connection.h
+void Connection::DoWrite() {
+    Flush();
+
+    // Input that has been left in the socket doesn't raise another edge, so it is read right away
+    if (_alive && _throttled && _output.Size() < max_output) {
+        _throttled = false;
+        DoRead();
+    }
+}
 
 // See Connection.h
-void Connection::DoRead() { std::cout << "DoRead" << std::endl; }
+void Connection::Flush() {
+    switch (_output.Send(_socket, *_buffers)) {
+    case OutputQueue::Status::kDone:
+        _event.events &= ~EPOLLOUT;
+        if (!_reading) {
+            OnClose();
+        }
+        break;
+    case OutputQueue::Status::kWouldBlock:
+        // The rest is sent once socket gets writable, EPOLLOUT comes then
+        _event.events |= EPOLLOUT;
+        break;
+    case OutputQueue::Status::kError:
+        OnError();
+        break;
+    }
+}
 
 // See Connection.h
-void Connection::DoWrite() { std::cout << "DoWrite" << std::endl; }
+void Connection::Drain() {
+    _reading = false;
+    if (_output.Empty()) {
+        OnClose();
+    }
+}
 
 } // namespace MTnonblock
 } // namespace Network
@@ -1,24 +1,63 @@
 #ifndef AFINA_NETWORK_MT_NONBLOCKING_CONNECTION_H
 #define AFINA_NETWORK_MT_NONBLOCKING_CONNECTION_H
 
+#include <cstddef>
 #include <cstring>
 
 #include <sys/epoll.h>
 
+#include "network/BufferPool.h"
+#include "network/IdleWheel.h"
+#include "network/OutputQueue.h"
+#include "protocol/Session.h"
+
 namespace Afina {
+
+// Forward declaration, see afina/Storage.h
+class Storage;
+
 namespace Network {
 namespace MTnonblock {
 
-class Connection {
+/**
+ * # Client connection served by a worker
+ * Connection is registered in the worker's epoll edge-triggered, so every event means socket state has changed
+ * and connection reads or writes until the call would block.
+ *
+ * Commands are executed as soon as they are complete, responses are collected in the output queue and sent
+ * once the whole input available is processed. Queue is written out as far as socket accepts, EPOLLOUT is
+ * only armed when the rest has to wait, so connections keeping up with their responses get no output events.
+ *
+ * Client that doesn't read responses isn't read either: once output queued exceeds max_output connection stops
+ * reading commands until socket accepts the output, the rest of input stays in the kernel buffer meanwhile.
+ * Input already read is executed a segment of output at a time, commands session holds back wait as well.
+ *
+ * Commands executed are limited by the budget worker sets for the turn, see Protocol::Session::SetBudget.
+ * Connection that has spent it reads no more, the rest of the input waits for the next turn.
+ *
+ * Buffers come from the pool of the worker serving connection, and connection object itself is reused by the
+ * worker once client is gone, see Start. Connection the client has done nothing with for the idle timeout is
+ * closed by the worker's wheel.
+ */
+class Connection : public IdleWheel::Entry {
 public:
-    Connection(int s) : _socket(s) {
+    // Output queued that stops connection from reading new commands
+    static constexpr std::size_t max_output = 1024 * 1024;
+
+    Connection(Afina::Storage &storage, bool redis, BufferPool *buffers)
+        : _socket(-1), _session(storage, redis), _buffers(buffers), _handoff_next(nullptr) {
         std::memset(&_event, 0, sizeof(struct epoll_event));
         _event.data.ptr = this;
+        _session.SetOutputLimit(OutputQueue::segment_size);
     }
 
-    inline bool isAlive() const { return true; }
+    inline bool isAlive() const { return _alive; }
 
-    void Start();
+    // Nothing is in flight: connection reads new commands and has no responses to send
+    inline bool isIdle() const { return _reading && !_deferred && _output.Empty(); }
+
+    // Starts serving client on the given socket, connection could have served another one before
+    void Start(int s);
 
 protected:
     void OnError();
@@ -26,12 +65,42 @@ protected:
     void DoRead();
     void DoWrite();
 
+    // Stops reading new commands, connection is closed once responses already formed are sent
+    void Drain();
+
+    // Sends output queued, EPOLLOUT is armed while some of it waits for the socket
+    void Flush();
+
 private:
     friend class Worker;
     friend class ServerImpl;
 
     int _socket;
     struct epoll_event _event;
+
+    // Connection is open, otherwise worker has closed it and keeps the object for the next client, see Start
+    bool _alive;
+
+    // New commands are read from the client
+    bool _reading;
+
+    // Protocol state of the stream
+    Protocol::Session _session;
+
+    // Reading is suspended till output queued is sent
+    bool _throttled;
+
+    // Reading has stopped as the budget of the turn is spent, worker resumes it on the next turn
+    bool _deferred;
+
+    // Responses waiting to be sent
+    OutputQueue _output;
+
+    // Pool of the worker serving connection
+    BufferPool *_buffers;
+
+    // Next connection in the handoff stack of the worker connection is handed over to
+    Connection *_handoff_next;
 };
 
 } // namespace MTnonblock
@@ -1,11 +1,14 @@
 #ifndef AFINA_NETWORK_MT_NONBLOCKING_SERVER_H
 #define AFINA_NETWORK_MT_NONBLOCKING_SERVER_H
 
+#include <memory>
 #include <thread>
 #include <vector>
 
 #include <afina/network/Server.h>
 
+#include "network/ConnectionLimit.h"
+
 namespace spdlog {
 class logger;
 }
@@ -19,7 +22,9 @@ class Worker;
 
 /**
  * # Network resource manager implementation
- * Epoll based server
+ * Epoll based server, every worker is a reactor of its own: it accepts connections on a private
+ * SO_REUSEPORT socket and serves them on a private epoll instance, see Worker. So there are no acceptor
+ * threads, number of acceptors given to Start is ignored
  */
 class ServerImpl : public Server {
 public:
@@ -35,34 +40,22 @@ public:
     // See Server.h
     void Join() override;
 
-protected:
-    void OnRun();
-    void OnNewConnection();
-
 private:
     // logger to use
     std::shared_ptr<spdlog::logger> _logger;
 
-    // Port to listen for new connections, permits access only from
-    // inside of accept_thread
+    // Port to listen for new connections
     // Read-only
     uint16_t listen_port;
 
-    // Socket to accept new connection on, shared between acceptors
-    int _server_socket;
-
-    // Threads that accepts new connections, each has private epoll instance
-    // but share global server socket
-    std::vector<std::thread> _acceptors;
-
-    // EPOLL instance shared between workers
-    int _data_epoll_fd;
-
     // Curstom event "device" used to wakeup workers
     int _event_fd;
 
+    // Connections of all workers
+    std::unique_ptr<ConnectionLimit> _limit;
+
     // threads serving read/write requests
-    std::vector<Worker> _workers;
+    std::vector<std::unique_ptr<Worker>> _workers;
 };
 
 } // namespace MTnonblock
@@ -1,16 +1,25 @@
 #include "Worker.h"
 
+#include <algorithm>
+#include <array>
 #include <cassert>
+#include <cerrno>
+#include <cstring>
 #include <functional>
-#include <iostream>
+#include <initializer_list>
+#include <stdexcept>
+#include <string>
 
 #include <netdb.h>
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <unistd.h>
 
 #include <spdlog/logger.h>
 
+#include <afina/Storage.h>
 #include <afina/logging/Service.h>
 
 #include "Connection.h"
@@ -20,40 +29,114 @@ namespace Afina {
 namespace Network {
 namespace MTnonblock {
 
+namespace {
+
+// How often worker compares its load with peers
+constexpr std::chrono::milliseconds rebalance_interval(100);
+
+// Worker hands connections over if it has processed more than twice as many events as the least loaded
+// peer plus this margin, so that nearly idle workers don't shuffle connections back and forth
+constexpr uint64_t rebalance_margin = 64;
+
+// Most connections handed over at once
+constexpr std::size_t max_handoffs = 64;
+
+// How often pools are trimmed, and most closed connections kept for reuse
+constexpr std::chrono::milliseconds pool_trim_interval(1000);
+constexpr std::size_t max_spare_connections = 1024;
+
+// Commands executed between two waits for events, connections getting their turn after that many are answered
+// with busy error
+constexpr std::size_t max_inflight = 4096;
+
+// How often paused worker checks if connections closed by peers have made room for new ones
+constexpr std::chrono::milliseconds accept_retry(100);
+
+} // namespace
+
 // See Worker.h
-Worker::Worker(std::shared_ptr<Afina::Storage> ps, std::shared_ptr<Afina::Logging::Service> pl)
-    : _pStorage(ps), _pLogging(pl), isRunning(false), _epoll_fd(-1) {
-    // TODO: implementation here
+Worker::Worker(std::shared_ptr<Afina::Storage> ps, std::shared_ptr<Afina::Logging::Service> pl, bool redis,
+               std::chrono::milliseconds idle_timeout, ConnectionLimit *limit)
+    : _pStorage(ps), _pLogging(pl), isRunning(false), _epoll_fd(-1), _server_socket(-1), _event_fd(-1),
+      _redis(redis), _limit(limit), _accept_paused(false), _spare_unused(0), _idle(idle_timeout), _events(0),
+      _connection_count(0), _last_events(0), _handoff(nullptr) {
+    // Peers could hand connections over as soon as they start, so descriptor exists from the very beginning
+    _handoff_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (_handoff_fd == -1) {
+        throw std::runtime_error("Failed to create eventfd descriptor: " + std::string(strerror(errno)));
+    }
 }
 
 // See Worker.h
 Worker::~Worker() {
-    // TODO: implementation here
+    // Connection could be handed over by peer that hasn't noticed stop yet
+    for (Connection *pconn = _handoff.exchange(nullptr); pconn != nullptr; pconn = pconn->_handoff_next) {
+        _connections.insert(pconn);
+    }
+    for (Connection *pconn : _connections) {
+        close(pconn->_socket);
+        delete pconn;
+    }
+    for (Connection *pconn : _spare_connections) {
+        delete pconn;
+    }
+    if (_server_socket != -1) {
+        close(_server_socket);
+    }
+    if (_epoll_fd != -1) {
+        close(_epoll_fd);
+    }
+    close(_handoff_fd);
 }
 
 // See Worker.h
-Worker::Worker(Worker &&other) { *this = std::move(other); }
+void Worker::Start(int server_socket, int event_fd) {
+    if (isRunning.exchange(true) == false) {
+        assert(_epoll_fd == -1);
+        _server_socket = server_socket;
+        _event_fd = event_fd;
+        _logger = _pLogging->select("network.worker");
 
-// See Worker.h
-Worker &Worker::operator=(Worker &&other) {
-    _pStorage = std::move(other._pStorage);
-    _pLogging = std::move(other._pLogging);
-    _logger = std::move(other._logger);
-    _thread = std::move(other._thread);
-    _epoll_fd = other._epoll_fd;
+        _epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        if (_epoll_fd == -1) {
+            throw std::runtime_error("Failed to create epoll file descriptor: " + std::string(strerror(errno)));
+        }
+
+        // Server socket is told apart by the worker pointer, eventfd by nullptr
+        struct epoll_event event;
+        event.events = EPOLLIN | EPOLLET;
+        event.data.ptr = this;
+        if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, _server_socket, &event)) {
+            throw std::runtime_error("Failed to add server socket to epoll");
+        }
+
+        event.events = EPOLLIN;
+        event.data.ptr = nullptr;
+        if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, _event_fd, &event)) {
+            throw std::runtime_error("Failed to add eventfd descriptor to epoll");
+        }
 
-    other._epoll_fd = -1;
-    return *this;
+        // Handoff eventfd is told apart by the stack address
+        event.events = EPOLLIN;
+        event.data.ptr = &_handoff;
+        if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, _handoff_fd, &event)) {
+            throw std::runtime_error("Failed to add eventfd descriptor to epoll");
+        }
+        _last_rebalance = std::chrono::steady_clock::now();
+
+        _thread = std::thread(&Worker::OnRun, this);
+    }
 }
 
 // See Worker.h
-void Worker::Start(int epoll_fd) {
-    if (isRunning.exchange(true) == false) {
-        assert(_epoll_fd == -1);
-        _epoll_fd = epoll_fd;
-        _logger = _pLogging->select("network.worker");
-        _thread = std::thread(&Worker::OnRun, this);
+void Worker::SetPeers(const std::vector<Worker *> &peers) {
+    _peers.clear();
+    for (Worker *peer : peers) {
+        if (peer != this) {
+            _peers.push_back(peer);
+        }
     }
+    _peer_events.assign(_peers.size(), 0);
 }
 
 // See Worker.h
@@ -70,15 +153,35 @@ void Worker::OnRun() {
     assert(_epoll_fd >= 0);
     _logger->trace("OnRun");
 
-    // Process connection events
-    //
-    // Do not forget to use EPOLLEXCLUSIVE flag when register socket
-    // for events to avoid thundering herd type behavior.
-    int timeout = -1;
+    // Process connection events. Connections are registered edge-triggered, registration only changes when
+    // connection starts or stops waiting for socket to accept output
+    bool accepting = true;
     std::array<struct epoll_event, 64> mod_list;
-    while (isRunning) {
+    while (accepting || !_connections.empty()) {
+        // Worker wakes up once the next idle connection could be found and, if idle itself, to give pooled
+        // memory back
+        int timeout = _idle.Timeout(IdleWheel::Now());
+        if (!_spare_connections.empty() || _buffers.Size() > 0) {
+            int trim_timeout = int(pool_trim_interval.count());
+            timeout = timeout == -1 || timeout > trim_timeout ? trim_timeout : timeout;
+        }
+        if (_accept_paused) {
+            int retry_timeout = int(accept_retry.count());
+            timeout = timeout == -1 || timeout > retry_timeout ? retry_timeout : timeout;
+        }
+        if (!_deferred.empty()) {
+            timeout = 0;
+        }
         int nmod = epoll_wait(_epoll_fd, &mod_list[0], mod_list.size(), timeout);
+        if (nmod == -1 && errno != EINTR) {
+            _logger->error("epoll_wait failed: {}", strerror(errno));
+            break;
+        }
         _logger->debug("Worker wokeup: {} events", nmod);
+        uint64_t now = IdleWheel::Now();
+        std::size_t budget = max_inflight;
+        _deferred_now.swap(_deferred);
+        std::size_t waiting = std::max(nmod, 0) + _deferred_now.size();
 
         for (int i = 0; i < nmod; i++) {
             struct epoll_event &current_event = mod_list[i];
@@ -90,47 +193,358 @@ void Worker::OnRun() {
                 continue;
             }
 
-            // Some connection gets new data
+            if (current_event.data.ptr == this) {
+                OnNewConnection();
+                continue;
+            }
+
+            if (current_event.data.ptr == &_handoff) {
+                OnHandoff();
+                continue;
+            }
+
+            // Some connection gets new data or could send more
             Connection *pconn = static_cast<Connection *>(current_event.data.ptr);
-            if ((current_event.events & EPOLLERR) || (current_event.events & EPOLLHUP)) {
-                _logger->debug("Got EPOLLERR or EPOLLHUP, value of returned events: {}", current_event.events);
-                pconn->OnError();
-            } else if (current_event.events & EPOLLRDHUP) {
-                _logger->debug("Got EPOLLRDHUP, value of returned events: {}", current_event.events);
-                pconn->OnClose();
-            } else {
-                // Depends on what connection wants...
-                if (current_event.events & EPOLLIN) {
-                    _logger->trace("Got EPOLLIN");
-                    pconn->DoRead();
-                }
-                if (current_event.events & EPOLLOUT) {
-                    _logger->trace("Got EPOLLOUT");
-                    pconn->DoWrite();
-                }
+            budget = Serve(pconn, current_event.events, now, budget, waiting--);
+        }
+
+        // Connections left over from the previous turn go on with the input they haven't read yet, unless they
+        // have had events and so have been served already
+        while (!_deferred_now.empty()) {
+            Connection *pconn = _deferred_now.back();
+            budget = Serve(pconn, EPOLLIN, now, budget, _deferred_now.size());
+        }
+        if (nmod > 0) {
+            _events.store(Events() + nmod, std::memory_order_relaxed);
+        }
+
+        if (accepting && !isRunning) {
+            OnStop();
+            accepting = false;
+        } else if (accepting && !_peers.empty()) {
+            Rebalance();
+        }
+        if (accepting && _accept_paused && !_limit->Full()) {
+            PauseAccept(false);
+        }
+        Reap(now);
+        TrimPools();
+    }
+    _logger->warn("Worker stopped");
+}
+
+// See Worker.h
+void Worker::OnNewConnection() {
+    // Edge-triggered socket must be accepted till it would block
+    for (;;) {
+        // Server is full, clients are left in the backlog till some connection is closed
+        if (!_limit->Acquire()) {
+            _logger->debug("Server is full, stop accepting");
+            PauseAccept(true);
+            return;
+        }
+
+        struct sockaddr in_addr;
+        socklen_t in_len = sizeof(in_addr);
+        int infd = accept4(_server_socket, &in_addr, &in_len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (infd == -1) {
+            _limit->Release();
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                _logger->error("Failed to accept socket: {}", strerror(errno));
             }
+            return;
+        }
 
-            // Rearm connection
-            if (pconn->isAlive()) {
-                pconn->_event.events |= EPOLLONESHOT;
-                int epoll_ctl_retval;
-                if ((epoll_ctl_retval = epoll_ctl(_epoll_fd, EPOLL_CTL_MOD, pconn->_socket, &pconn->_event))) {
-                    _logger->debug("epoll_ctl failed during connection rearm: error {}", epoll_ctl_retval);
-                    pconn->OnError();
-                    delete pconn;
-                }
+        // Print host and service info.
+        if (_logger->should_log(spdlog::level::debug)) {
+            char hbuf[NI_MAXHOST], sbuf[NI_MAXSERV];
+            if (getnameinfo(&in_addr, in_len, hbuf, sizeof hbuf, sbuf, sizeof sbuf,
+                            NI_NUMERICHOST | NI_NUMERICSERV) == 0) {
+                _logger->debug("Accepted connection on descriptor {} (host={}, port={})", infd, hbuf, sbuf);
             }
-            // Or delete closed one
-            else {
-                if (epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, pconn->_socket, &pconn->_event)) {
-                    std::cerr << "Failed to delete connection!" << std::endl;
+        }
+
+        // Register connection in worker's epoll
+        Connection *pc = NewConnection();
+        pc->Start(infd);
+        if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, pc->_socket, &pc->_event)) {
+            _logger->error("Failed to register connection {} in epoll: {}", infd, strerror(errno));
+            close(infd);
+            _spare_connections.push_back(pc);
+            _limit->Release();
+            continue;
+        }
+        _connections.insert(pc);
+        _idle.Add(*pc, IdleWheel::Now());
+        _connection_count.store(_connections.size(), std::memory_order_relaxed);
+    }
+}
+
+// See Worker.h
+std::size_t Worker::Serve(Connection *pconn, uint32_t events, uint64_t now, std::size_t budget,
+                          std::size_t waiting) {
+    // Every connection gets a fair share of what is left, so that single client pipelining lots of commands
+    // doesn't take the whole turn. Commands beyond the share wait for the next turn, those of the connections
+    // that have come once budget is over are rejected
+    std::size_t share = (budget + waiting - 1) / std::max<std::size_t>(waiting, 1);
+    pconn->_session.SetBudget(share, share > 0);
+    Undefer(pconn);
+
+    // Input is read before errors are checked: client could have sent commands and closed connection right after
+    uint32_t old_mask = pconn->_event.events;
+    _idle.Touch(*pconn, now);
+    if (events & (EPOLLIN | EPOLLHUP)) {
+        _logger->trace("Got EPOLLIN");
+        pconn->DoRead();
+    }
+    if (pconn->isAlive() && (events & EPOLLOUT)) {
+        _logger->trace("Got EPOLLOUT");
+        pconn->DoWrite();
+    }
+    if (pconn->isAlive() && (events & EPOLLERR)) {
+        _logger->debug("Got EPOLLERR, value of returned events: {}", events);
+        pconn->OnError();
+    }
+    budget -= share - pconn->_session.Budget();
+
+    if (!pconn->isAlive()) {
+        Close(pconn);
+    } else if (pconn->_event.events != old_mask &&
+               epoll_ctl(_epoll_fd, EPOLL_CTL_MOD, pconn->_socket, &pconn->_event)) {
+        _logger->error("Failed to modify connection {} in epoll: {}", pconn->_socket, strerror(errno));
+        pconn->OnError();
+        Close(pconn);
+    } else if (pconn->_deferred) {
+        _deferred.push_back(pconn);
+    }
+    return budget;
+}
+
+// See Worker.h
+void Worker::OnStop() {
+    _logger->debug("Stop accepting, {} connections to drain", _connections.size());
+
+    // Eventfd stays signalled, so it has to be removed not to wake worker up over and over
+    epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, _event_fd, nullptr);
+    epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, _server_socket, nullptr);
+    close(_server_socket);
+    _server_socket = -1;
+
+    // Connections handed over till now are drained along with the rest, later ones are closed by destructor
+    OnHandoff();
+
+    // Connections without pending responses are closed right away, the rest once responses are sent
+    for (auto it = _connections.begin(); it != _connections.end();) {
+        Connection *pconn = *it++;
+        pconn->Drain();
+        if (!pconn->isAlive()) {
+            Close(pconn);
+        }
+    }
+}
+
+// See Worker.h
+void Worker::PauseAccept(bool pause) {
+    // Socket stays registered, resumed one is reported right away if clients have piled up meanwhile
+    struct epoll_event event;
+    event.events = pause ? 0 : EPOLLIN | EPOLLET;
+    event.data.ptr = this;
+    if (epoll_ctl(_epoll_fd, EPOLL_CTL_MOD, _server_socket, &event)) {
+        _logger->error("Failed to modify server socket in epoll: {}", strerror(errno));
+        return;
+    }
+    _accept_paused = pause;
+}
+
+// See Worker.h
+void Worker::Close(Connection *pconn) {
+    _logger->debug("Close connection on descriptor {}", pconn->_socket);
+
+    // Closing descriptor removes it from epoll as well
+    close(pconn->_socket);
+    _limit->Release();
+    _connections.erase(pconn);
+    _connection_count.store(_connections.size(), std::memory_order_relaxed);
+    _idle.Remove(*pconn);
+    Undefer(pconn);
+
+    // Connection keeps no buffers once closed, except for those session has grown
+    pconn->_output.Clear(_buffers);
+    pconn->_session.Reset();
+    if (_spare_connections.size() < max_spare_connections) {
+        _spare_connections.push_back(pconn);
+    } else {
+        delete pconn;
+    }
+}
+
+// See Worker.h
+void Worker::Undefer(Connection *pconn) {
+    if (!pconn->_deferred) {
+        return;
+    }
+    pconn->_deferred = false;
+
+    // Connection marks itself once it runs out of budget, it could be closed before worker lists it
+    for (std::vector<Connection *> *list : {&_deferred, &_deferred_now}) {
+        auto it = std::find(list->begin(), list->end(), pconn);
+        if (it != list->end()) {
+            list->erase(it);
+            return;
+        }
+    }
+}
+
+// See Worker.h
+Connection *Worker::NewConnection() {
+    if (_spare_connections.empty()) {
+        return new Connection(*_pStorage, _redis, &_buffers);
+    }
+
+    Connection *pconn = _spare_connections.back();
+    _spare_connections.pop_back();
+    if (_spare_unused > _spare_connections.size()) {
+        _spare_unused = _spare_connections.size();
+    }
+
+    // Connection could have been handed over from peer, so it still refers to the peer's pool
+    pconn->_buffers = &_buffers;
+    return pconn;
+}
+
+// See Worker.h
+void Worker::Reap(uint64_t now) {
+    _idle.Expire(now, [this](IdleWheel::Entry &entry) {
+        Connection *pconn = static_cast<Connection *>(&entry);
+        _logger->debug("Connection {} is idle for too long, closing", pconn->_socket);
+        pconn->OnError();
+        Close(pconn);
+    });
+}
+
+// See Worker.h
+void Worker::TrimPools() {
+    auto now = std::chrono::steady_clock::now();
+    if (now - _last_trim < pool_trim_interval) {
+        return;
+    }
+    _last_trim = now;
+
+    // Connections closed last are on top, those at the bottom haven't been needed since the previous trim
+    for (std::size_t i = 0; i < _spare_unused; i++) {
+        delete _spare_connections[i];
+    }
+    _spare_connections.erase(_spare_connections.begin(), _spare_connections.begin() + _spare_unused);
+    _spare_unused = _spare_connections.size();
+    _buffers.Trim();
+}
+
+// See Worker.h
+void Worker::Rebalance() {
+    auto now = std::chrono::steady_clock::now();
+    if (now - _last_rebalance < rebalance_interval) {
+        return;
+    }
+    _last_rebalance = now;
+
+    // Load is number of events processed since the last check, of this worker and the least loaded peer
+    uint64_t events = Events();
+    uint64_t load = events - _last_events;
+    _last_events = events;
+
+    std::size_t target = 0;
+    uint64_t target_load = UINT64_MAX;
+    for (std::size_t i = 0; i < _peers.size(); i++) {
+        uint64_t peer_events = _peers[i]->Events();
+        uint64_t peer_load = peer_events - _peer_events[i];
+        _peer_events[i] = peer_events;
+        if (peer_load < target_load && _peers[i]->isRunning) {
+            target = i;
+            target_load = peer_load;
+        }
+    }
+
+    if (load <= 2 * target_load + rebalance_margin || _connections.size() < 2) {
+        return;
+    }
+
+    // Share of connections to hand over, so that both workers end up with about the same load
+    std::size_t count = _connections.size() * (load - target_load) / (2 * load);
+    count = std::min(count, max_handoffs);
+    if (count == 0) {
+        return;
+    }
+
+    Worker *peer = _peers[target];
+    std::size_t moved = 0;
+    for (auto it = _connections.begin(); it != _connections.end() && moved < count;) {
+        Connection *pconn = *it;
+        if (!pconn->isIdle()) {
+            ++it;
+            continue;
+        }
+
+        // Once removed from epoll connection gets no events here, peer registers it in its own epoll
+        if (epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, pconn->_socket, nullptr)) {
+            _logger->error("Failed to remove connection {} from epoll: {}", pconn->_socket, strerror(errno));
+            ++it;
+            continue;
+        }
+        it = _connections.erase(it);
+        _idle.Remove(*pconn);
+        peer->Adopt(pconn);
+        moved++;
+    }
+    _connection_count.store(_connections.size(), std::memory_order_relaxed);
+    _logger->debug("Handed {} connections over, load {} against {}", moved, load, target_load);
+}
+
+// See Worker.h
+void Worker::Adopt(Connection *pconn) {
+    Connection *head = _handoff.load(std::memory_order_relaxed);
+    do {
+        pconn->_handoff_next = head;
+    } while (!_handoff.compare_exchange_weak(head, pconn, std::memory_order_release, std::memory_order_relaxed));
+
+    if (eventfd_write(_handoff_fd, 1)) {
+        _logger->error("Failed to wake up worker: {}", strerror(errno));
+    }
+}
+
+// See Worker.h
+void Worker::OnHandoff() {
+    eventfd_t value;
+    eventfd_read(_handoff_fd, &value);
+
+    // Whole stack is taken at once, so there is no ABA to care about
+    Connection *pconn = _handoff.exchange(nullptr, std::memory_order_acquire);
+    while (pconn != nullptr) {
+        Connection *next = pconn->_handoff_next;
+        pconn->_handoff_next = nullptr;
+
+        // Connection is idle, so it holds no buffers from the peer's pool and takes them from this one now on.
+        // Registering socket that is ready already reports it right away, so no edge is lost in between
+        pconn->_buffers = &_buffers;
+        if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, pconn->_socket, &pconn->_event)) {
+            _logger->error("Failed to register connection {} in epoll: {}", pconn->_socket, strerror(errno));
+            close(pconn->_socket);
+            _limit->Release();
+            delete pconn;
+        } else {
+            _connections.insert(pconn);
+            _idle.Add(*pconn, IdleWheel::Now());
+            if (!isRunning) {
+                pconn->Drain();
+                if (!pconn->isAlive()) {
+                    Close(pconn);
                 }
-                delete pconn;
             }
         }
-        // TODO: Select timeout...
+        pconn = next;
     }
-    _logger->warn("Worker stopped");
+    _connection_count.store(_connections.size(), std::memory_order_relaxed);
 }
 
 } // namespace MTnonblock
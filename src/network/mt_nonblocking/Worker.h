@@ -2,8 +2,16 @@
 #define AFINA_NETWORK_MT_NONBLOCKING_WORKER_H
 
 #include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <memory>
 #include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "network/BufferPool.h"
+#include "network/ConnectionLimit.h"
+#include "network/IdleWheel.h"
 
 namespace spdlog {
 class logger;
@@ -20,25 +28,65 @@ class Service;
 namespace Network {
 namespace MTnonblock {
 
+// Forward declaration, see Connection.h
+class Connection;
+
 /**
  * # Thread running epoll
  * On Start spaws background thread that is doing epoll on the given server
  * socket and process incoming connections and its data
+ *
+ * Every worker has epoll instance and listening socket of its own: sockets are bound to the same port with
+ * SO_REUSEPORT, so kernel spreads new connections between workers. Kernel knows nothing about how busy
+ * connections are though, so long-lived clients could pile up on one worker while others idle.
+ *
+ * To even that out workers publish their load: number of connections and of events processed. Periodically
+ * worker compares how many events it has processed since the last check with its peers. If it is much busier
+ * than the least loaded one, it hands some of its connections over: connections with nothing in flight are
+ * removed from its epoll and pushed into the peer's lock-free handoff stack, peer is woken up by its eventfd
+ * and registers them in its own epoll. Connection is served by one thread at a time all along.
+ *
+ * Clients that connect for a couple of commands come and go at a high rate, so worker doesn't allocate
+ * anything per connection: closed connection objects are kept for the next clients, and buffers are taken
+ * from the pool connections of this worker share. Whatever has stayed unused in the pools for a second is freed,
+ * so memory taken by a burst is given back once it is over.
+ *
+ * Clients that have done nothing for the idle timeout are disconnected. Every event only stamps connection
+ * with the time, idle ones are found by the timing wheel, see IdleWheel. Worker sleeps in epoll_wait till the
+ * next wheel slot is due and closes all connections found idle there at once.
+ *
+ * Overloaded worker sheds load instead of queueing it. Connections of all workers are counted against the
+ * server capacity: worker that finds server full stops polling its listening socket, new clients wait in the
+ * backlog till some connection is closed. Number of commands executed between two waits for events is limited
+ * too: connections getting their turn once it is over have commands answered with busy error, so that clients
+ * get fast refusal rather than a response delayed by everyone else's. Connection gets a fair share of what is
+ * left of the budget, the one that spends its share stops reading: edge-triggered socket won't report the rest
+ * of its input again, so worker serves it once more on the next turn.
  */
 class Worker {
 public:
-    Worker(std::shared_ptr<Afina::Storage> ps, std::shared_ptr<Afina::Logging::Service> pl);
+    /**
+     * @param idle_timeout connections idle for that long are closed, zero keeps them open forever
+     * @param limit connections of the whole server, shared by all workers
+     */
+    Worker(std::shared_ptr<Afina::Storage> ps, std::shared_ptr<Afina::Logging::Service> pl, bool redis,
+           std::chrono::milliseconds idle_timeout, ConnectionLimit *limit);
     ~Worker();
 
-    Worker(Worker &&);
-    Worker &operator=(Worker &&);
-
     /**
      * Spaws new background thread that is doing epoll on the given server
      * socket. Once connection accepted it must be registered and being processed
      * on this thread
+     *
+     * @param server_socket listening socket, worker takes ownership of it
+     * @param event_fd descriptor server signals to wake workers up on Stop
      */
-    void Start(int epoll_fd);
+    void Start(int server_socket, int event_fd);
+
+    /**
+     * Sets workers connections could be handed over to, must be called before any of them is started
+     */
+    void SetPeers(const std::vector<Worker *> &peers);
 
     /**
      * Signal background thread to stop. After that signal thread must stop to
@@ -54,15 +102,59 @@ public:
      */
     void Join();
 
+    /**
+     * Load metrics, could be read from any thread: events processed since start and number of connections
+     * being served
+     */
+    inline uint64_t Events() const { return _events.load(std::memory_order_relaxed); }
+    inline uint32_t Connections() const { return _connection_count.load(std::memory_order_relaxed); }
+
 protected:
     /**
      * Method executing by background thread
      */
     void OnRun();
 
+    // Accepts all pending connections and registers them in the worker's epoll
+    void OnNewConnection();
+
+    // Handles events of the connection executing its share of the budget among connections waiting for the turn,
+    // what is left of the budget is returned
+    std::size_t Serve(Connection *pconn, uint32_t events, uint64_t now, std::size_t budget, std::size_t waiting);
+
+    // Stops accepting connections and drains the existing ones
+    void OnStop();
+
+    // Stops or resumes polling listening socket, connections wait in the backlog meanwhile
+    void PauseAccept(bool pause);
+
+    // Closes connection and keeps object for reuse
+    void Close(Connection *pconn);
+
+    // Returns connection object ready to be started, reused one if there is any
+    Connection *NewConnection();
+
+    // Removes connection from the deferred ones, it is served or closed now
+    void Undefer(Connection *pconn);
+
+    // Frees spare connections and buffers nobody has needed since the previous call
+    void TrimPools();
+
+    // Closes connections idle for too long
+    void Reap(uint64_t now);
+
+    // Compares load with peers and hands connections over to the least loaded one if this worker is too busy
+    void Rebalance();
+
+    // Called from peer thread: pushes connection into the handoff stack and wakes worker up
+    void Adopt(Connection *pconn);
+
+    // Registers connections handed over by peers
+    void OnHandoff();
+
 private:
-    Worker(Worker &) = delete;
-    Worker &operator=(Worker &) = delete;
+    Worker(const Worker &) = delete;
+    Worker &operator=(const Worker &) = delete;
 
     // afina services
     std::shared_ptr<Afina::Storage> _pStorage;
@@ -81,6 +173,51 @@ private:
 
     // EPOLL descriptor using for events processing
     int _epoll_fd;
+
+    // Socket to accept new connections on and descriptor signalling stop
+    int _server_socket;
+    int _event_fd;
+
+    // Clients speak Redis protocol
+    bool _redis;
+
+    // Connections of the whole server, and whether listening socket is paused as there are too many of them
+    ConnectionLimit *_limit;
+    bool _accept_paused;
+
+    // Connections served by this worker
+    std::unordered_set<Connection *> _connections;
+
+    // Connections that have run out of the budget with input left, to be served on the next turn, and those
+    // deferred by the previous turn that current one is yet to serve
+    std::vector<Connection *> _deferred;
+    std::vector<Connection *> _deferred_now;
+
+    // Closed connections kept for reuse, and the fewest of them there have been since the last TrimPools
+    std::vector<Connection *> _spare_connections;
+    std::size_t _spare_unused;
+
+    // Connections by the time of their last activity
+    IdleWheel _idle;
+
+    // Buffers shared by connections of this worker
+    BufferPool _buffers;
+    std::chrono::steady_clock::time_point _last_trim;
+
+    // Load metrics, written by the worker thread only
+    std::atomic<uint64_t> _events;
+    std::atomic<uint32_t> _connection_count;
+
+    // Workers connections could be handed over to, and their event counters as of the last Rebalance
+    std::vector<Worker *> _peers;
+    std::vector<uint64_t> _peer_events;
+    uint64_t _last_events;
+    std::chrono::steady_clock::time_point _last_rebalance;
+
+    // Connections handed over by peers: lock-free stack linked through Connection::_handoff_next and
+    // eventfd signalling it is not empty
+    std::atomic<Connection *> _handoff;
+    int _handoff_fd;
 };
 
 } // namespace MTnonblock
@@ -1,6 +1,7 @@
 #include "ServerImpl.h"
 
 #include <cassert>
+#include <cerrno>
 #include <cstring>
 #include <iostream>
 #include <memory>
@@ -21,12 +22,35 @@
 #include <afina/execute/Command.h>
 #include <afina/logging/Service.h>
 
-#include "protocol/Parser.h"
+#include "protocol/Session.h"
 
 namespace Afina {
 namespace Network {
 namespace STblocking {
 
+namespace {
+
+// Responses formed before they are sent, commands beyond that wait in the session
+constexpr std::size_t max_batch = 16384;
+
+// Sends the whole buffer, blocking socket could still accept only a part of it if call gets interrupted
+void SendAll(int socket, const std::string &data) {
+    std::size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = send(socket, data.data() + sent, data.size() - sent, 0);
+        if (n > 0) {
+            sent += n;
+        } else if (n < 0 && errno == EINTR) {
+            // Signal has interrupted the call before anything has been sent, it is just repeated
+            continue;
+        } else {
+            throw std::runtime_error("Failed to send response");
+        }
+    }
+}
+
+} // namespace
+
 // See Server.h
 ServerImpl::ServerImpl(std::shared_ptr<Afina::Storage> ps, std::shared_ptr<Logging::Service> pl) : Server(ps, pl) {}
 
@@ -48,57 +72,62 @@ void ServerImpl::Start(uint16_t port, uint32_t n_accept, uint32_t n_workers) {
         throw std::runtime_error("Unable to mask SIGPIPE");
     }
 
-    // For IPv4 we use struct sockaddr_in:
-    // struct sockaddr_in {
-    //     short int          sin_family;  // Address family, AF_INET
-    //     unsigned short int sin_port;    // Port number
-    //     struct in_addr     sin_addr;    // Internet address
-    //     unsigned char      sin_zero[8]; // Same size as struct sockaddr
-    // };
-    //
-    // Note we need to convert the port to network order
-    struct sockaddr_in server_addr;
-    std::memset(&server_addr, 0, sizeof(server_addr));
-    server_addr.sin_family = AF_INET;         // IPv4
-    server_addr.sin_port = htons(port);       // TCP port number
-    server_addr.sin_addr.s_addr = INADDR_ANY; // Bind to any address
-
-    // Arguments are:
-    // - Family: IPv4
-    // - Type: Full-duplex stream (reliable)
-    // - Protocol: TCP
-    _server_socket = socket(PF_INET, SOCK_STREAM, IPPROTO_TCP);
-    if (_server_socket == -1) {
-        throw std::runtime_error("Failed to open socket");
-    }
+    if (!_unix_path.empty()) {
+        // Clients on the same host talk over UNIX socket, see Server::SetUnixPath
+        _server_socket = pListeners->OpenUnix(_unix_path, false);
+    } else {
+        // For IPv4 we use struct sockaddr_in:
+        // struct sockaddr_in {
+        //     short int          sin_family;  // Address family, AF_INET
+        //     unsigned short int sin_port;    // Port number
+        //     struct in_addr     sin_addr;    // Internet address
+        //     unsigned char      sin_zero[8]; // Same size as struct sockaddr
+        // };
+        //
+        // Note we need to convert the port to network order
+        struct sockaddr_in server_addr;
+        std::memset(&server_addr, 0, sizeof(server_addr));
+        server_addr.sin_family = AF_INET;         // IPv4
+        server_addr.sin_port = htons(port);       // TCP port number
+        server_addr.sin_addr.s_addr = INADDR_ANY; // Bind to any address
+
+        // Arguments are:
+        // - Family: IPv4
+        // - Type: Full-duplex stream (reliable)
+        // - Protocol: TCP
+        _server_socket = socket(PF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (_server_socket == -1) {
+            throw std::runtime_error("Failed to open socket");
+        }
 
-    // when the server closes the socket,the connection must stay in the TIME_WAIT state to
-    // make sure the client received the acknowledgement that the connection has been terminated.
-    // During this time, this port is unavailable to other processes, unless we specify this option
-    //
-    // This option let kernel knows that we are OK that multiple threads/processes are listen on the
-    // same port. In a such case kernel will balance input traffic between all listeners (except those who
-    // are closed already)
-    int opts = 1;
-    if (setsockopt(_server_socket, SOL_SOCKET, SO_REUSEADDR, &opts, sizeof(opts)) == -1) {
-        close(_server_socket);
-        throw std::runtime_error("Socket setsockopt() failed");
-    }
+        // when the server closes the socket,the connection must stay in the TIME_WAIT state to
+        // make sure the client received the acknowledgement that the connection has been terminated.
+        // During this time, this port is unavailable to other processes, unless we specify this option
+        //
+        // This option let kernel knows that we are OK that multiple threads/processes are listen on the
+        // same port. In a such case kernel will balance input traffic between all listeners (except those who
+        // are closed already)
+        int opts = 1;
+        if (setsockopt(_server_socket, SOL_SOCKET, SO_REUSEADDR, &opts, sizeof(opts)) == -1) {
+            close(_server_socket);
+            throw std::runtime_error("Socket setsockopt() failed");
+        }
 
-    // Bind the socket to the address. In other words let kernel know data for what address we'd
-    // like to see in the socket
-    if (bind(_server_socket, (struct sockaddr *)&server_addr, sizeof(server_addr)) == -1) {
-        close(_server_socket);
-        throw std::runtime_error("Socket bind() failed");
-    }
+        // Bind the socket to the address. In other words let kernel know data for what address we'd
+        // like to see in the socket
+        if (bind(_server_socket, (struct sockaddr *)&server_addr, sizeof(server_addr)) == -1) {
+            close(_server_socket);
+            throw std::runtime_error("Socket bind() failed");
+        }
 
-    // Start listening. The second parameter is the "backlog", or the maximum number of
-    // connections that we'll allow to queue up. Note that listen() doesn't block until
-    // incoming connections arrive. It just makesthe OS aware that this process is willing
-    // to accept connections on this socket (which is bound to a specific IP and port)
-    if (listen(_server_socket, 5) == -1) {
-        close(_server_socket);
-        throw std::runtime_error("Socket listen() failed");
+        // Start listening. The second parameter is the "backlog", or the maximum number of
+        // connections that we'll allow to queue up. Note that listen() doesn't block until
+        // incoming connections arrive. It just makesthe OS aware that this process is willing
+        // to accept connections on this socket (which is bound to a specific IP and port)
+        if (listen(_server_socket, 5) == -1) {
+            close(_server_socket);
+            throw std::runtime_error("Socket listen() failed");
+        }
     }
 
     running.store(true);
@@ -121,14 +150,11 @@ void ServerImpl::Join() {
 // See Server.h
 void ServerImpl::OnRun() {
     // Here is connection state
-    // - parser: parse state of the stream
-    // - command_to_execute: last command parsed out of stream
-    // - arg_remains: how many bytes to read from stream to get command argument
-    // - argument_for_command: buffer stores argument
-    std::size_t arg_remains;
-    Protocol::Parser parser;
-    std::string argument_for_command;
-    std::unique_ptr<Execute::Command> command_to_execute;
+    // - session: protocol state of the stream
+    // - result: responses waiting to be sent, reused to avoid allocations
+    Protocol::Session session(*pStorage, _dialect == Dialect::kRedis);
+    session.SetOutputLimit(max_batch);
+    std::string result;
     while (running.load()) {
         _logger->debug("waiting for connection...");
 
@@ -166,74 +192,43 @@ void ServerImpl::OnRun() {
         // - execute each command
         // - send response
         try {
-            int readed_bytes = -1;
+            ssize_t readed_bytes = -1;
             char client_buffer[4096];
-            while ((readed_bytes = read(client_socket, client_buffer, sizeof(client_buffer))) > 0) {
+            bool alive = true;
+            while (alive) {
+                // Large data block is read right into the command argument
+                std::size_t direct_size = 0;
+                char *direct = session.BodyBuffer(direct_size);
+                if (direct != nullptr) {
+                    readed_bytes = read(client_socket, direct, direct_size);
+                } else {
+                    readed_bytes = read(client_socket, client_buffer, sizeof(client_buffer));
+                }
+                if (readed_bytes <= 0) {
+                    break;
+                }
                 _logger->debug("Got {} bytes from socket", readed_bytes);
 
-                // Single block of data readed from the socket could trigger inside actions a multiple times,
-                // for example:
-                // - read#0: [<command1 start>]
-                // - read#1: [<command1 end> <argument> <command2> <argument for command 2> <command3> ... ]
-                while (readed_bytes > 0) {
-                    _logger->debug("Process {} bytes", readed_bytes);
-                    // There is no command yet
-                    if (!command_to_execute) {
-                        std::size_t parsed = 0;
-                        if (parser.Parse(client_buffer, readed_bytes, parsed)) {
-                            // There is no command to be launched, continue to parse input stream
-                            // Here we are, current chunk finished some command, process it
-                            _logger->debug("Found new command: {} in {} bytes", parser.Name(), parsed);
-                            command_to_execute = parser.Build(arg_remains);
-                            if (arg_remains > 0) {
-                                arg_remains += 2;
-                            }
-                        }
-
-                        // Parsed might fails to consume any bytes from input stream. In real life that could happens,
-                        // for example, because we are working with UTF-16 chars and only 1 byte left in stream
-                        if (parsed == 0) {
-                            break;
-                        } else {
-                            std::memmove(client_buffer, client_buffer + parsed, readed_bytes - parsed);
-                            readed_bytes -= parsed;
-                        }
-                    }
-
-                    // There is command, but we still wait for argument to arrive...
-                    if (command_to_execute && arg_remains > 0) {
-                        _logger->debug("Fill argument: {} bytes of {}", readed_bytes, arg_remains);
-                        // There is some parsed command, and now we are reading argument
-                        std::size_t to_read = std::min(arg_remains, std::size_t(readed_bytes));
-                        argument_for_command.append(client_buffer, to_read);
-
-                        std::memmove(client_buffer, client_buffer + to_read, readed_bytes - to_read);
-                        arg_remains -= to_read;
-                        readed_bytes -= to_read;
-                    }
-
-                    // Thre is command & argument - RUN!
-                    if (command_to_execute && arg_remains == 0) {
-                        _logger->debug("Start command execution");
-
-                        std::string result;
-                        command_to_execute->Execute(*pStorage, argument_for_command, result);
-
-                        // Send response
-                        result += "\r\n";
-                        if (send(client_socket, result.data(), result.size(), 0) <= 0) {
-                            throw std::runtime_error("Failed to send response");
-                        }
-
-                        // Prepare for the next command
-                        command_to_execute.reset();
-                        argument_for_command.resize(0);
-                        parser.Reset();
+                // Responses on all commands completed by this block of data are sent at once
+                if (direct != nullptr) {
+                    alive = session.BodyReceived(readed_bytes, result);
+                } else {
+                    alive = session.Process(client_buffer, readed_bytes, result);
+                }
+                while (!result.empty()) {
+                    SendAll(client_socket, result);
+                    result.clear();
+
+                    // Commands session has held back go on once responses formed so far are sent
+                    if (alive && session.Held()) {
+                        alive = session.Resume(result);
                     }
-                } // while (readed_bytes)
+                }
             }
 
-            if (readed_bytes == 0) {
+            if (!alive) {
+                _logger->debug("Malformed input on {}, closing connection", client_socket);
+            } else if (readed_bytes == 0) {
                 _logger->debug("Connection closed");
             } else {
                 throw std::runtime_error(std::string(strerror(errno)));
@@ -245,10 +240,9 @@ void ServerImpl::OnRun() {
         // We are done with this connection
         close(client_socket);
 
-        // Prepare for the next command: just in case if connection was closed in the middle of executing something
-        command_to_execute.reset();
-        argument_for_command.resize(0);
-        parser.Reset();
+        // Prepare for the next connection: just in case if it was closed in the middle of executing something
+        session.Reset();
+        result.clear();
     }
 
     // Cleanup on exit...
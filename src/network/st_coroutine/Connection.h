@@ -0,0 +1,48 @@
+#ifndef AFINA_NETWORK_ST_COROUTINE_CONNECTION_H
+#define AFINA_NETWORK_ST_COROUTINE_CONNECTION_H
+
+#include <string>
+
+#include "network/IdleWheel.h"
+#include "protocol/Session.h"
+
+namespace Afina {
+
+// Forward declaration, see afina/Storage.h
+class Storage;
+
+namespace Network {
+namespace STcoroutine {
+
+/**
+ * # Client connection served by a coroutine
+ * State of the connection lives on the heap rather than on the coroutine stack: stack is copied on every
+ * switch, so it is kept as shallow as possible.
+ */
+class Connection : public IdleWheel::Entry {
+public:
+    Connection(int s, Afina::Storage &storage, bool redis) : _socket(s), _routine(nullptr), _session(storage, redis) {}
+
+private:
+    friend class ServerImpl;
+
+    int _socket;
+
+    // Coroutine serving the connection
+    void *_routine;
+
+    // Protocol state of the stream
+    Protocol::Session _session;
+
+    // Responses on the block of data just read
+    std::string _output;
+
+    // Block of data being read from the socket
+    char _buffer[4096];
+};
+
+} // namespace STcoroutine
+} // namespace Network
+} // namespace Afina
+
+#endif // AFINA_NETWORK_ST_COROUTINE_CONNECTION_H
@@ -0,0 +1,314 @@
+#include "ServerImpl.h"
+
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <netinet/in.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <spdlog/logger.h>
+
+#include <afina/Storage.h>
+#include <afina/logging/Service.h>
+
+#include "Connection.h"
+
+namespace Afina {
+namespace Network {
+namespace STcoroutine {
+
+namespace {
+
+// Most commands executed between two Polls, the rest of them are answered with busy error
+constexpr std::size_t max_inflight = 4096;
+
+// Responses formed before they are sent, commands beyond that wait in the session
+constexpr std::size_t max_batch = 16384;
+
+} // namespace
+
+// See Server.h
+ServerImpl::ServerImpl(std::shared_ptr<Afina::Storage> ps, std::shared_ptr<Logging::Service> pl)
+    : Server(ps, pl), _server_socket(-1), _event_fd(-1), _epoll(-1), _engine([this](Coroutine::Engine &) { Poll(); }),
+      _running(false), _acceptor(nullptr), _accept_paused(false), _budget(max_inflight),
+      _idle(std::chrono::seconds(read_timeout)) {}
+
+// See Server.h
+ServerImpl::~ServerImpl() {
+    if (_event_fd != -1) {
+        close(_event_fd);
+    }
+}
+
+// See Server.h
+void ServerImpl::Start(uint16_t port, uint32_t n_acceptors, uint32_t n_workers) {
+    _logger = pLogging->select("network");
+    _logger->info("Start st_coroutine network service");
+
+    sigset_t sig_mask;
+    sigemptyset(&sig_mask);
+    sigaddset(&sig_mask, SIGPIPE);
+    if (pthread_sigmask(SIG_BLOCK, &sig_mask, NULL) != 0) {
+        throw std::runtime_error("Unable to mask SIGPIPE");
+    }
+
+    _server_socket = Listen(port, true, false);
+    _limit.reset(new ConnectionLimit(_server_capacity));
+    _event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (_event_fd == -1) {
+        throw std::runtime_error("Failed to create eventfd descriptor: " + std::string(strerror(errno)));
+    }
+
+    _epoll = epoll_create1(EPOLL_CLOEXEC);
+    if (_epoll == -1) {
+        throw std::runtime_error("Failed to create epoll file descriptor: " + std::string(strerror(errno)));
+    }
+
+    // Listening socket wakes acceptor up, eventfd stays readable once stop is signalled
+    struct epoll_event event;
+    event.events = EPOLLIN | EPOLLET;
+    event.data.ptr = this;
+    if (epoll_ctl(_epoll, EPOLL_CTL_ADD, _server_socket, &event)) {
+        throw std::runtime_error("Failed to add file descriptor to epoll");
+    }
+
+    event.events = EPOLLIN;
+    event.data.ptr = nullptr;
+    if (epoll_ctl(_epoll, EPOLL_CTL_ADD, _event_fd, &event)) {
+        throw std::runtime_error("Failed to add file descriptor to epoll");
+    }
+
+    _running = true;
+    _work_thread = std::thread(&ServerImpl::OnRun, this);
+}
+
+// See Server.h
+void ServerImpl::Stop() {
+    _logger->warn("Stop network service");
+
+    // Wakeup thread that is sleep on epoll_wait
+    if (eventfd_write(_event_fd, 1)) {
+        throw std::runtime_error("Failed to wakeup workers");
+    }
+}
+
+// See Server.h
+void ServerImpl::Join() {
+    // Wait for work to be complete
+    _work_thread.join();
+}
+
+// See ServerImpl.h
+void ServerImpl::OnRun() {
+    // Returns once every coroutine is done
+    _engine.start(&ServerImpl::Main, *this);
+
+    close(_epoll);
+    close(_server_socket);
+    _logger->warn("Network stopped");
+}
+
+// See ServerImpl.h
+void ServerImpl::Main(ServerImpl &server) { server._acceptor = server._engine.run(&ServerImpl::Acceptor, server); }
+
+// See ServerImpl.h
+void ServerImpl::Acceptor(ServerImpl &server) {
+    while (server._running) {
+        // Server is full, clients are left in the backlog till some connection is closed
+        if (!server._limit->Acquire()) {
+            server._logger->debug("Server is full, stop accepting");
+            server._accept_paused = true;
+            server._engine.block();
+            continue;
+        }
+
+        int client_socket = accept4(server._server_socket, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client_socket == -1) {
+            server._limit->Release();
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                // All pending connections are accepted, wait for the next one
+                server._engine.block();
+            } else if (errno != EINTR && errno != ECONNABORTED) {
+                // Out of descriptors or memory, try again later
+                server._logger->error("Failed to accept socket: {}", strerror(errno));
+                server.Reschedule(server._acceptor);
+            }
+            continue;
+        }
+        server._logger->debug("Accepted connection on descriptor {}", client_socket);
+
+        Connection *pconn = new Connection(client_socket, *server.pStorage, server._dialect == Dialect::kRedis);
+        pconn->_session.SetOutputLimit(max_batch);
+        struct epoll_event event;
+        event.events = EPOLLIN | EPOLLOUT | EPOLLET;
+        event.data.ptr = pconn;
+        if (epoll_ctl(server._epoll, EPOLL_CTL_ADD, client_socket, &event)) {
+            server._logger->error("Failed to add connection to epoll");
+            close(client_socket);
+            delete pconn;
+            server._limit->Release();
+            continue;
+        }
+
+        // Coroutine gets control once acceptor blocks
+        server._connections.insert(pconn);
+        server._idle.Add(*pconn, IdleWheel::Now());
+        pconn->_routine = server._engine.run(&ServerImpl::Serve, server, *pconn);
+    }
+    server._accept_paused = false;
+}
+
+// See ServerImpl.h
+void ServerImpl::Serve(ServerImpl &server, Connection &conn) {
+    Protocol::Session &session = conn._session;
+    bool reading = true;
+    while (reading && server._running) {
+        // Large data block is read right into the command argument
+        std::size_t direct_size = 0;
+        char *direct = session.BodyBuffer(direct_size);
+        ssize_t readed_bytes;
+        if (direct != nullptr) {
+            readed_bytes = read(conn._socket, direct, direct_size);
+        } else {
+            readed_bytes = read(conn._socket, conn._buffer, sizeof(conn._buffer));
+        }
+
+        if (readed_bytes > 0) {
+            session.SetBudget(server._budget);
+            if (direct != nullptr) {
+                reading = session.BodyReceived(readed_bytes, conn._output);
+            } else {
+                reading = session.Process(conn._buffer, readed_bytes, conn._output);
+            }
+            server._budget = session.Budget();
+
+            // Responses on the whole block are sent at once, connection reads nothing until they are. Commands
+            // session has held back go on then
+            bool sent = server.Send(conn);
+            while (sent && reading && session.Held()) {
+                session.SetBudget(server._budget);
+                reading = session.Resume(conn._output);
+                server._budget = session.Budget();
+                sent = server.Send(conn);
+            }
+            if (!sent) {
+                break;
+            }
+
+            // Client keeping the socket busy goes on after everyone else has been served
+            server.Reschedule(conn._routine);
+        } else if (readed_bytes == 0) {
+            server._logger->debug("Connection {} closed by client", conn._socket);
+            reading = false;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            server._engine.block();
+        } else if (errno != EINTR) {
+            server._logger->debug("Failed to read from {}: {}", conn._socket, strerror(errno));
+            break;
+        }
+    }
+    server.Close(&conn);
+}
+
+// See ServerImpl.h
+bool ServerImpl::Send(Connection &conn) {
+    std::size_t written = 0;
+    while (written < conn._output.size()) {
+        ssize_t sent = send(conn._socket, conn._output.data() + written, conn._output.size() - written, MSG_NOSIGNAL);
+        if (sent > 0) {
+            written += sent;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            _engine.block();
+            if (!_running) {
+                return false;
+            }
+        } else if (errno != EINTR) {
+            _logger->debug("Failed to write to {}: {}", conn._socket, strerror(errno));
+            return false;
+        }
+    }
+    conn._output.clear();
+    return true;
+}
+
+// See ServerImpl.h
+void ServerImpl::Reschedule(void *routine) {
+    _ready.push_back(routine);
+    _engine.block(routine);
+}
+
+// See ServerImpl.h
+void ServerImpl::Close(Connection *pconn) {
+    _logger->debug("Close connection on descriptor {}", pconn->_socket);
+    if (epoll_ctl(_epoll, EPOLL_CTL_DEL, pconn->_socket, nullptr)) {
+        _logger->error("Failed to delete connection from epoll");
+    }
+    close(pconn->_socket);
+    _connections.erase(pconn);
+    _idle.Remove(*pconn);
+    delete pconn;
+
+    // Acceptor waiting for a slot gets control on the next Poll
+    _limit->Release();
+    if (_accept_paused) {
+        _accept_paused = false;
+        _engine.unblock(_acceptor);
+    }
+}
+
+// See ServerImpl.h
+void ServerImpl::Poll() {
+    // Rescheduled coroutines are ready to go on, so only check for events then. Otherwise wait till the next
+    // idle connection could be found
+    std::array<struct epoll_event, 64> events;
+    int timeout = _ready.empty() ? _idle.Timeout(IdleWheel::Now()) : 0;
+    int nevents = epoll_wait(_epoll, events.data(), events.size(), timeout);
+    if (nevents == -1 && errno != EINTR) {
+        throw std::runtime_error("Failed to wait for events: " + std::string(strerror(errno)));
+    }
+    uint64_t now = IdleWheel::Now();
+    _budget = max_inflight;
+
+    for (void *routine : _ready) {
+        _engine.unblock(routine);
+    }
+    _ready.clear();
+
+    for (int i = 0; i < nevents; i++) {
+        void *ptr = events[i].data.ptr;
+        if (ptr == this) {
+            _engine.unblock(_acceptor);
+        } else if (ptr != nullptr) {
+            Connection *pconn = static_cast<Connection *>(ptr);
+            _idle.Touch(*pconn, now);
+            _engine.unblock(pconn->_routine);
+        } else if (_running) {
+            // Stop signal: every coroutine gets control back, sees server stopping and finishes
+            _logger->debug("Stop {} connections", _connections.size());
+            _running = false;
+            _engine.unblock(_acceptor);
+            for (Connection *pconn : _connections) {
+                _engine.unblock(pconn->_routine);
+            }
+        }
+    }
+
+    // Coroutine of the idle connection reads end of stream or fails to send, and closes connection then
+    _idle.Expire(now, [this](IdleWheel::Entry &entry) {
+        Connection *pconn = static_cast<Connection *>(&entry);
+        _logger->debug("Connection {} is idle for too long, closing", pconn->_socket);
+        shutdown(pconn->_socket, SHUT_RDWR);
+        _engine.unblock(pconn->_routine);
+    });
+}
+
+} // namespace STcoroutine
+} // namespace Network
+} // namespace Afina
@@ -0,0 +1,126 @@
+#ifndef AFINA_NETWORK_ST_COROUTINE_SERVER_H
+#define AFINA_NETWORK_ST_COROUTINE_SERVER_H
+
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include <afina/coroutine/Engine.h>
+#include <afina/network/Server.h>
+
+#include "network/ConnectionLimit.h"
+#include "network/IdleWheel.h"
+
+namespace spdlog {
+class logger;
+}
+
+namespace Afina {
+namespace Network {
+namespace STcoroutine {
+
+// Forward declaration, see Connection.h
+class Connection;
+
+/**
+ * # Network resource manager implementation
+ * Single threaded server where every connection is served by a coroutine written in blocking style, the
+ * way mt_blocking serves it by a thread. Sockets are non-blocking though: once read or write would block,
+ * coroutine blocks itself in the engine and other coroutines run.
+ *
+ * When every coroutine is blocked engine calls Poll, which waits on epoll and unblocks coroutines whose
+ * sockets got ready. Sockets are registered once, edge-triggered, so coroutine always reads or writes until
+ * the call would block before waiting for the next event. After every block of data read coroutine lets
+ * the others run, so a client keeping its socket busy doesn't starve the rest.
+ *
+ * Poll also finds connections idle for the read timeout: their sockets are shut down, so that coroutines
+ * serving them see the client gone and finish the usual way.
+ *
+ * Acceptor is a coroutine as well. Once server has capacity connections acceptor blocks till one of them is
+ * closed, new clients wait in the backlog meanwhile. Commands executed between two Polls are limited too, the
+ * rest are answered with busy error. Number of acceptors and workers given to Start is ignored
+ */
+class ServerImpl : public Server {
+public:
+    ServerImpl(std::shared_ptr<Afina::Storage> ps, std::shared_ptr<Logging::Service> pl);
+    ~ServerImpl();
+
+    // See Server.h
+    void Start(uint16_t port, uint32_t acceptors, uint32_t workers) override;
+
+    // See Server.h
+    void Stop() override;
+
+    // See Server.h
+    void Join() override;
+
+protected:
+    /**
+     * Method executing by background thread, runs coroutine engine
+     */
+    void OnRun();
+
+private:
+    // Coroutines: main one starts acceptor, which starts one per connection
+    static void Main(ServerImpl &server);
+    static void Acceptor(ServerImpl &server);
+    static void Serve(ServerImpl &server, Connection &conn);
+
+    // Sends responses collected in connection output, false if connection is broken or server stops
+    bool Send(Connection &conn);
+
+    // Gives up control until the next Poll, routine is ready to go on but shouldn't starve others
+    void Reschedule(void *routine);
+
+    // Closes connection served by the current coroutine
+    void Close(Connection *pconn);
+
+    // Engine unblocker: waits for events on sockets and unblocks coroutines waiting for them
+    void Poll();
+
+    // logger to use
+    std::shared_ptr<spdlog::logger> _logger;
+
+    // Socket to accept new connections on
+    int _server_socket;
+
+    // Curstom event "device" used to wakeup IO thread
+    int _event_fd;
+
+    // epoll instance all sockets are registered in
+    int _epoll;
+
+    // IO thread
+    std::thread _work_thread;
+
+    // Fields below are used by IO thread only
+    Coroutine::Engine _engine;
+
+    // Server serves connections, false once stop is signalled
+    bool _running;
+
+    // Coroutine accepting connections
+    void *_acceptor;
+
+    // Coroutines rescheduled till the next Poll
+    std::vector<void *> _ready;
+
+    // Connections being served
+    std::unordered_set<Connection *> _connections;
+
+    // Slots for connections, acceptor waits for one to be given back if there are none
+    std::unique_ptr<ConnectionLimit> _limit;
+    bool _accept_paused;
+
+    // Commands to be executed till the next Poll
+    std::size_t _budget;
+
+    // Connections by the time of their last activity
+    IdleWheel _idle;
+};
+
+} // namespace STcoroutine
+} // namespace Network
+} // namespace Afina
+
+#endif // AFINA_NETWORK_ST_COROUTINE_SERVER_H
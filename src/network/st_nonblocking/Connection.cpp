@@ -1,26 +1,103 @@
 #include "Connection.h"
 
-#include <iostream>
+#include <cerrno>
+
+#include <unistd.h>
 
 namespace Afina {
 namespace Network {
 namespace STnonblock {
 
+constexpr std::size_t Connection::max_output;
+
 // See Connection.h
-void Connection::Start() { std::cout << "Start" << std::endl; }
+void Connection::Start() {
+    _alive = true;
+    _reading = true;
+    _event.events = EPOLLIN;
+}
 
 // See Connection.h
-void Connection::OnError() { std::cout << "OnError" << std::endl; }
+void Connection::OnError() {
+    _alive = false;
+    _reading = false;
+    _output.Clear(_buffers);
+}
 
 // See Connection.h
-void Connection::OnClose() { std::cout << "OnClose" << std::endl; }
+void Connection::OnClose() {
+    _alive = false;
+    _reading = false;
+}
 
 // See Connection.h
-void Connection::DoRead() { std::cout << "DoRead" << std::endl; }
+void Connection::DoRead() {
+    // Level-triggered event comes again while there is something left, so a single read is enough
+    std::size_t direct_size = 0;
+    char *direct = _session.BodyBuffer(direct_size);
+    ssize_t readed_bytes;
+    if (direct != nullptr) {
+        readed_bytes = read(_socket, direct, direct_size);
+    } else {
+        readed_bytes = read(_socket, _buffers.ReadBlock(), BufferPool::read_size);
+    }
+
+    if (readed_bytes > 0) {
+        // Stream is broken, client gets the error and connection is closed then
+        if (direct != nullptr) {
+            _reading = _session.BodyReceived(readed_bytes, _output.Back(_buffers));
+        } else {
+            _reading = _session.Process(_buffers.ReadBlock(), readed_bytes, _output.Back(_buffers));
+        }
+    } else if (readed_bytes == 0) {
+        // Client has sent everything, it is closed once responses are sent
+        _reading = false;
+    } else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+        OnError();
+        return;
+    }
+
+    Flush();
+}
+
+// See Connection.h
+void Connection::DoWrite() { Flush(); }
+
+// See Connection.h
+void Connection::Flush() {
+    // Commands held back by session are executed as their responses get sent, till socket would block
+    OutputQueue::Status status;
+    do {
+        Resume();
+        status = _output.Send(_socket, _buffers);
+    } while (status == OutputQueue::Status::kDone && _reading && _session.Held());
+
+    switch (status) {
+    case OutputQueue::Status::kDone:
+        if (!_reading) {
+            OnClose();
+        }
+        _event.events = EPOLLIN;
+        break;
+    case OutputQueue::Status::kWouldBlock:
+        _event.events = EPOLLOUT;
+        if (_reading && !_session.Held() && _output.Size() < max_output) {
+            _event.events |= EPOLLIN;
+        }
+        break;
+    case OutputQueue::Status::kError:
+        OnError();
+        break;
+    }
+}
 
 // See Connection.h
-void Connection::DoWrite() { std::cout << "DoWrite" << std::endl; }
+void Connection::Resume() {
+    while (_reading && _session.Held() && _output.Size() < max_output) {
+        _reading = _session.Resume(_output.Back(_buffers));
+    }
+}
 
 } // namespace STnonblock
 } // namespace Network
-} // namespace Afina
\ No newline at end of file
+} // namespace Afina
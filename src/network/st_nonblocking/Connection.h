@@ -1,22 +1,48 @@
 #ifndef AFINA_NETWORK_ST_NONBLOCKING_CONNECTION_H
 #define AFINA_NETWORK_ST_NONBLOCKING_CONNECTION_H
 
+#include <cstddef>
 #include <cstring>
 
 #include <sys/epoll.h>
 
+#include "network/BufferPool.h"
+#include "network/IdleWheel.h"
+#include "network/OutputQueue.h"
+#include "protocol/Session.h"
+
 namespace Afina {
+
+// Forward declaration, see afina/Storage.h
+class Storage;
+
 namespace Network {
 namespace STnonblock {
 
-class Connection {
+/**
+ * # Client connection served by the IO thread
+ * Connection is registered level-triggered and asks for the events it is able to handle now: EPOLLIN while it
+ * reads commands, EPOLLOUT only while responses wait for socket to accept them. Server applies the mask after
+ * every event.
+ *
+ * Client that doesn't read responses isn't read either: once output queued exceeds max_output connection drops
+ * EPOLLIN until socket accepts the output. Commands session holds back are executed meanwhile as output is
+ * sent, a segment at a time. Connection the client has done nothing with for the idle timeout is
+ * closed by the server.
+ */
+class Connection : public IdleWheel::Entry {
 public:
-    Connection(int s) : _socket(s) {
+    // Output queued that stops connection from reading new commands
+    static constexpr std::size_t max_output = 1024 * 1024;
+
+    Connection(int s, Afina::Storage &storage, bool redis, BufferPool &buffers)
+        : _socket(s), _session(storage, redis), _buffers(buffers) {
         std::memset(&_event, 0, sizeof(struct epoll_event));
         _event.data.ptr = this;
+        _session.SetOutputLimit(OutputQueue::segment_size);
     }
 
-    inline bool isAlive() const { return true; }
+    inline bool isAlive() const { return _alive; }
 
     void Start();
 
@@ -26,15 +52,36 @@ protected:
     void DoRead();
     void DoWrite();
 
+    // Sends output queued and chooses events connection waits for next
+    void Flush();
+
+    // Executes commands session has held back while output queued allows
+    void Resume();
+
 private:
     friend class ServerImpl;
 
     int _socket;
     struct epoll_event _event;
+
+    // Connection is open, it is closed and deleted by the server otherwise
+    bool _alive;
+
+    // New commands are read from the client
+    bool _reading;
+
+    // Protocol state of the stream
+    Protocol::Session _session;
+
+    // Responses waiting to be sent
+    OutputQueue _output;
+
+    // Pool shared by all connections of the server
+    BufferPool &_buffers;
 };
 
 } // namespace STnonblock
 } // namespace Network
 } // namespace Afina
 
-#endif // AFINA_NETWORK_ST_NONBLOCKING_CONNECTION_H
\ No newline at end of file
+#endif // AFINA_NETWORK_ST_NONBLOCKING_CONNECTION_H
@@ -28,8 +28,19 @@ namespace Afina {
 namespace Network {
 namespace STnonblock {
 
+namespace {
+
+// Most commands executed between two waits for events, the rest of them are answered with busy error
+constexpr std::size_t max_inflight = 4096;
+
+// How often buffers nobody has needed are given back
+constexpr std::chrono::milliseconds pool_trim_interval(1000);
+
+} // namespace
+
 // See Server.h
-ServerImpl::ServerImpl(std::shared_ptr<Afina::Storage> ps, std::shared_ptr<Logging::Service> pl) : Server(ps, pl) {}
+ServerImpl::ServerImpl(std::shared_ptr<Afina::Storage> ps, std::shared_ptr<Logging::Service> pl)
+    : Server(ps, pl), _idle(std::chrono::seconds(read_timeout)), _accept_paused(false) {}
 
 // See Server.h
 ServerImpl::~ServerImpl() {}
@@ -46,35 +57,14 @@ void ServerImpl::Start(uint16_t port, uint32_t n_acceptors, uint32_t n_workers)
         throw std::runtime_error("Unable to mask SIGPIPE");
     }
 
-    // Create server socket
-    struct sockaddr_in server_addr;
-    std::memset(&server_addr, 0, sizeof(server_addr));
-    server_addr.sin_family = AF_INET;         // IPv4
-    server_addr.sin_port = htons(port);       // TCP port number
-    server_addr.sin_addr.s_addr = INADDR_ANY; // Bind to any address
-
-    _server_socket = socket(PF_INET, SOCK_STREAM, IPPROTO_TCP);
-    if (_server_socket == -1) {
-        throw std::runtime_error("Failed to open socket: " + std::string(strerror(errno)));
-    }
-
+    // Accepted sockets inherit keepalive from the listening one
+    _server_socket = Listen(port, true, false);
     int opts = 1;
-    if (setsockopt(_server_socket, SOL_SOCKET, (SO_KEEPALIVE), &opts, sizeof(opts)) == -1) {
-        close(_server_socket);
+    if (setsockopt(_server_socket, SOL_SOCKET, SO_KEEPALIVE, &opts, sizeof(opts)) == -1) {
         throw std::runtime_error("Socket setsockopt() failed: " + std::string(strerror(errno)));
     }
 
-    if (bind(_server_socket, (struct sockaddr *)&server_addr, sizeof(server_addr)) == -1) {
-        close(_server_socket);
-        throw std::runtime_error("Socket bind() failed: " + std::string(strerror(errno)));
-    }
-
-    make_socket_non_blocking(_server_socket);
-    if (listen(_server_socket, 5) == -1) {
-        close(_server_socket);
-        throw std::runtime_error("Socket listen() failed: " + std::string(strerror(errno)));
-    }
-
+    _limit.reset(new ConnectionLimit(_server_capacity));
     _event_fd = eventfd(0, EFD_NONBLOCK);
     if (_event_fd == -1) {
         throw std::runtime_error("Failed to create epoll file descriptor: " + std::string(strerror(errno)));
@@ -124,8 +114,17 @@ void ServerImpl::OnRun() {
     bool run = true;
     std::array<struct epoll_event, 64> mod_list;
     while (run) {
-        int nmod = epoll_wait(epoll_descr, &mod_list[0], mod_list.size(), -1);
+        // Server wakes up once the next idle connection could be found and, if idle itself, to give pooled
+        // buffers back
+        int timeout = _idle.Timeout(IdleWheel::Now());
+        if (_buffers.Size() > 0) {
+            int trim_timeout = int(pool_trim_interval.count());
+            timeout = timeout == -1 || timeout > trim_timeout ? trim_timeout : timeout;
+        }
+        int nmod = epoll_wait(epoll_descr, &mod_list[0], mod_list.size(), timeout);
         _logger->debug("Acceptor wokeup: {} events", nmod);
+        uint64_t now = IdleWheel::Now();
+        std::size_t budget = max_inflight;
 
         for (int i = 0; i < nmod; i++) {
             struct epoll_event &current_event = mod_list[i];
@@ -142,6 +141,8 @@ void ServerImpl::OnRun() {
             Connection *pc = static_cast<Connection *>(current_event.data.ptr);
 
             auto old_mask = pc->_event.events;
+            _idle.Touch(*pc, now);
+            pc->_session.SetBudget(budget);
             if ((current_event.events & EPOLLERR) || (current_event.events & EPOLLHUP)) {
                 pc->OnError();
             } else if (current_event.events & EPOLLRDHUP) {
@@ -155,34 +156,53 @@ void ServerImpl::OnRun() {
                     pc->DoWrite();
                 }
             }
+            budget = pc->_session.Budget();
 
             // Does it alive?
             if (!pc->isAlive()) {
                 if (epoll_ctl(epoll_descr, EPOLL_CTL_DEL, pc->_socket, &pc->_event)) {
                     _logger->error("Failed to delete connection from epoll");
                 }
-
-                close(pc->_socket);
-                pc->OnClose();
-
-                delete pc;
+                Close(pc);
             } else if (pc->_event.events != old_mask) {
                 if (epoll_ctl(epoll_descr, EPOLL_CTL_MOD, pc->_socket, &pc->_event)) {
                     _logger->error("Failed to change connection event mask");
-
-                    close(pc->_socket);
-                    pc->OnClose();
-
-                    delete pc;
+                    Close(pc);
                 }
             }
         }
+
+        // Connections idle for too long are closed all at once
+        _idle.Expire(now, [this](IdleWheel::Entry &entry) {
+            Connection *pc = static_cast<Connection *>(&entry);
+            _logger->debug("Connection {} is idle for too long, closing", pc->_socket);
+            Close(pc);
+        });
+
+        // Closed connections have made room for new ones
+        if (_accept_paused && !_limit->Full()) {
+            PauseAccept(epoll_descr, false);
+        }
+
+        // Trimming goes on a deadline, server that is never idle still gives unneeded buffers back
+        auto trim_now = std::chrono::steady_clock::now();
+        if (trim_now - _last_trim >= pool_trim_interval) {
+            _last_trim = trim_now;
+            _buffers.Trim();
+        }
     }
     _logger->warn("Acceptor stopped");
 }
 
 void ServerImpl::OnNewConnection(int epoll_descr) {
     for (;;) {
+        // Server is full, clients are left in the backlog till some connection is closed
+        if (!_limit->Acquire()) {
+            _logger->debug("Server is full, stop accepting");
+            PauseAccept(epoll_descr, true);
+            break;
+        }
+
         struct sockaddr in_addr;
         socklen_t in_len;
 
@@ -190,6 +210,7 @@ void ServerImpl::OnNewConnection(int epoll_descr) {
         in_len = sizeof in_addr;
         int infd = accept4(_server_socket, &in_addr, &in_len, SOCK_NONBLOCK | SOCK_CLOEXEC);
         if (infd == -1) {
+            _limit->Release();
             if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
                 break; // We have processed all incoming connections.
             } else {
@@ -207,22 +228,43 @@ void ServerImpl::OnNewConnection(int epoll_descr) {
         }
 
         // Register the new FD to be monitored by epoll.
-        Connection *pc = new(std::nothrow) Connection(infd);
+        Connection *pc = new(std::nothrow) Connection(infd, *pStorage, _dialect == Dialect::kRedis, _buffers);
         if (pc == nullptr) {
             throw std::runtime_error("Failed to allocate connection");
         }
 
         // Register connection in worker's epoll
         pc->Start();
-        if (pc->isAlive()) {
-            if (epoll_ctl(epoll_descr, EPOLL_CTL_ADD, pc->_socket, &pc->_event)) {
-                pc->OnError();
-                delete pc;
-            }
+        if (epoll_ctl(epoll_descr, EPOLL_CTL_ADD, pc->_socket, &pc->_event)) {
+            _logger->error("Failed to register connection {} in epoll", infd);
+            Close(pc);
+        } else {
+            _idle.Add(*pc, IdleWheel::Now());
         }
     }
 }
 
+// See ServerImpl.h
+void ServerImpl::PauseAccept(int epoll_descr, bool pause) {
+    struct epoll_event event;
+    event.events = pause ? 0 : EPOLLIN;
+    event.data.fd = _server_socket;
+    if (epoll_ctl(epoll_descr, EPOLL_CTL_MOD, _server_socket, &event)) {
+        _logger->error("Failed to modify server socket in epoll: {}", strerror(errno));
+        return;
+    }
+    _accept_paused = pause;
+}
+
+// See ServerImpl.h
+void ServerImpl::Close(Connection *pc) {
+    _idle.Remove(*pc);
+    close(pc->_socket);
+    pc->OnError();
+    delete pc;
+    _limit->Release();
+}
+
 } // namespace STnonblock
 } // namespace Network
 } // namespace Afina
\ No newline at end of file
@@ -1,11 +1,16 @@
 #ifndef AFINA_NETWORK_ST_NONBLOCKING_SERVER_H
 #define AFINA_NETWORK_ST_NONBLOCKING_SERVER_H
 
+#include <chrono>
 #include <thread>
 #include <vector>
 
 #include <afina/network/Server.h>
 
+#include "network/BufferPool.h"
+#include "network/ConnectionLimit.h"
+#include "network/IdleWheel.h"
+
 namespace spdlog {
 class logger;
 }
@@ -14,12 +19,15 @@ namespace Afina {
 namespace Network {
 namespace STnonblock {
 
-// Forward declaration, see Worker.h
-class Worker;
+// Forward declaration, see Connection.h
+class Connection;
 
 /**
 * # Network resource manager implementation
 * Epoll based server
+*
+* Server serves at most capacity connections at once, listening socket isn't polled while it is full. Commands
+* executed between two waits for events are limited as well, the rest are answered with busy error.
 */
 class ServerImpl : public Server {
 public:
@@ -39,6 +47,12 @@ protected:
     void OnRun();
     void OnNewConnection(int);
 
+    // Stops or resumes polling listening socket, connections wait in the backlog meanwhile
+    void PauseAccept(int epoll_descr, bool pause);
+
+    // Closes connection and gives its slot back
+    void Close(Connection *pc);
+
 private:
     // logger to use
     std::shared_ptr<spdlog::logger> _logger;
@@ -56,6 +70,17 @@ private:
 
     // IO thread
     std::thread _work_thread;
+
+    // Buffers shared by connections and when unneeded ones were last given back, used by IO thread only
+    BufferPool _buffers;
+    std::chrono::steady_clock::time_point _last_trim;
+
+    // Connections by the time of their last activity, used by IO thread only
+    IdleWheel _idle;
+
+    // Connections being served, and whether listening socket is paused as there are too many of them
+    std::unique_ptr<ConnectionLimit> _limit;
+    bool _accept_paused;
 };
 
 } // namespace STnonblock
@@ -0,0 +1,80 @@
+#ifndef AFINA_NETWORK_URING_CONNECTION_H
+#define AFINA_NETWORK_URING_CONNECTION_H
+
+#include <cstddef>
+#include <string>
+
+#include "protocol/Session.h"
+
+namespace Afina {
+
+// Forward declaration, see afina/Storage.h
+class Storage;
+
+namespace Network {
+namespace Uring {
+
+/**
+ * # Client connection served by io_uring worker
+ * Connection has at most one multishot receive and one send in flight, worker drives both. Responses formed
+ * while send is in flight are collected in _pending and go out with the next send, so commands pipelined by
+ * the client are answered in batches.
+ *
+ * Client that doesn't read responses isn't read either: once output queued exceeds max_output receive is
+ * cancelled, and it is armed again once send gets output below the limit. Data kernel has delivered before
+ * cancellation waits in _input meanwhile. Input is executed batch_output of responses at a time, so a few
+ * bytes asking for large values don't get the output far over the limit either: commands session holds back
+ * wait along with _input.
+ *
+ * Connection is deleted only once kernel has nothing in flight for it, as completions refer to it.
+ */
+class Connection {
+public:
+    // Output queued that stops connection from reading new commands
+    static constexpr std::size_t max_output = 1024 * 1024;
+
+    // Output executing input gets at once, see Protocol::Session::SetOutputLimit
+    static constexpr std::size_t batch_output = 16384;
+
+    Connection(int s, Afina::Storage &storage, bool redis)
+        : _socket(s), _session(storage, redis), _reading(true), _receiving(false), _sending(false),
+          _cancelling(false), _throttled(false), _written(0) {}
+
+    // Bytes of responses not sent yet
+    inline std::size_t Queued() const { return _output.size() - _written + _pending.size(); }
+
+private:
+    friend class Worker;
+
+    int _socket;
+
+    // Protocol state of the stream
+    Protocol::Session _session;
+
+    // New commands are read from the client
+    bool _reading;
+
+    // Multishot receive and send are in flight, receive is being cancelled
+    bool _receiving;
+    bool _sending;
+    bool _cancelling;
+
+    // Reading is suspended till output queued is sent
+    bool _throttled;
+
+    // Input received while reading is suspended
+    std::string _input;
+
+    // Responses being sent, _written bytes of them have been sent already
+    std::string _output;
+    std::size_t _written;
+
+    // Responses waiting for the current send to complete
+    std::string _pending;
+};
+
+} // namespace Uring
+} // namespace Network
+} // namespace Afina
+
+#endif // AFINA_NETWORK_URING_CONNECTION_H
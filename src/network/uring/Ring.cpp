@@ -0,0 +1,195 @@
+#include "Ring.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace Afina {
+namespace Network {
+namespace Uring {
+
+namespace {
+
+int Setup(unsigned entries, io_uring_params &params) {
+    return int(syscall(__NR_io_uring_setup, entries, &params));
+}
+
+// Maps shared memory region of the ring, nullptr on failure
+void *Map(int fd, std::size_t size, off_t offset) {
+    void *p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+    return p == MAP_FAILED ? nullptr : p;
+}
+
+std::runtime_error Error(const char *what) { return std::runtime_error(std::string(what) + ": " + strerror(errno)); }
+
+} // namespace
+
+constexpr std::size_t Ring::buffer_size;
+
+// See Ring.h
+Ring::Ring(unsigned entries, unsigned buffers)
+    : _fd(-1), _sqe_tail(0), _sqes(nullptr), _rings(nullptr), _rings_size(0), _sqes_size(0), _buf_ring(nullptr),
+      _buf_ring_size(0), _buffers(nullptr), _buffers_size(0) {
+    // Multishot receive appeared along with single issuer rings, so kernel that refuses the flag is too old.
+    // Deferred task running is a bit newer and is optional. Completion queue is larger than submission one
+    // as every multishot request posts many completions
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN | IORING_SETUP_CQSIZE;
+    params.cq_entries = entries * 4;
+    _fd = Setup(entries, params);
+    if (_fd < 0 && errno == EINVAL) {
+        std::memset(&params, 0, sizeof(params));
+        params.flags = IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_CQSIZE;
+        params.cq_entries = entries * 4;
+        _fd = Setup(entries, params);
+    }
+    if (_fd < 0) {
+        throw Error("io_uring_setup failed");
+    }
+    if ((params.features & IORING_FEAT_SINGLE_MMAP) == 0 || (params.features & IORING_FEAT_NODROP) == 0) {
+        Destroy();
+        throw std::runtime_error("io_uring is too old");
+    }
+
+    // Both queues share a single mapping
+    _rings_size = std::max<std::size_t>(params.sq_off.array + params.sq_entries * sizeof(unsigned),
+                                        params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+    _rings = Map(_fd, _rings_size, IORING_OFF_SQ_RING);
+    _sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    _sqes = static_cast<io_uring_sqe *>(Map(_fd, _sqes_size, IORING_OFF_SQES));
+    if (_rings == nullptr || _sqes == nullptr) {
+        Destroy();
+        throw Error("Failed to map io_uring");
+    }
+
+    char *rings = static_cast<char *>(_rings);
+    _sq_head = reinterpret_cast<unsigned *>(rings + params.sq_off.head);
+    _sq_tail = reinterpret_cast<unsigned *>(rings + params.sq_off.tail);
+    _sq_mask = *reinterpret_cast<unsigned *>(rings + params.sq_off.ring_mask);
+    _sq_entries = params.sq_entries;
+    _cq_head = reinterpret_cast<unsigned *>(rings + params.cq_off.head);
+    _cq_tail = reinterpret_cast<unsigned *>(rings + params.cq_off.tail);
+    _cq_mask = *reinterpret_cast<unsigned *>(rings + params.cq_off.ring_mask);
+    _cqes = reinterpret_cast<io_uring_cqe *>(rings + params.cq_off.cqes);
+    _sqe_tail = *_sq_tail;
+
+    // Entries are always submitted in order, so index array is identity
+    unsigned *array = reinterpret_cast<unsigned *>(rings + params.sq_off.array);
+    for (unsigned i = 0; i < _sq_entries; i++) {
+        array[i] = i;
+    }
+
+    // Buffer ring is a page aligned array of buffer descriptors, kernel takes them from the head
+    _buf_ring_size = buffers * sizeof(io_uring_buf);
+    void *buf_ring = mmap(nullptr, _buf_ring_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    _buffers_size = buffers * buffer_size;
+    void *data = mmap(nullptr, _buffers_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    _buf_ring = buf_ring == MAP_FAILED ? nullptr : static_cast<io_uring_buf_ring *>(buf_ring);
+    _buffers = data == MAP_FAILED ? nullptr : static_cast<char *>(data);
+    if (_buf_ring == nullptr || _buffers == nullptr) {
+        Destroy();
+        throw Error("Failed to allocate receive buffers");
+    }
+
+    // Kernel pins pages of the ring on registration, untouched anonymous memory would pin the shared zero page
+    std::memset(_buf_ring, 0, _buf_ring_size);
+
+    io_uring_buf_reg reg;
+    std::memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = reinterpret_cast<uint64_t>(_buf_ring);
+    reg.ring_entries = buffers;
+    reg.bgid = 0;
+    if (syscall(__NR_io_uring_register, _fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        Destroy();
+        throw Error("Failed to register buffer ring");
+    }
+
+    _buf_mask = buffers - 1;
+    for (unsigned i = 0; i < buffers; i++) {
+        io_uring_buf &buf = BufferEntry(i);
+        buf.addr = reinterpret_cast<uint64_t>(Buffer(uint16_t(i)));
+        buf.len = buffer_size;
+        buf.bid = uint16_t(i);
+    }
+    __atomic_store_n(&_buf_ring->tail, uint16_t(buffers), __ATOMIC_RELEASE);
+}
+
+// See Ring.h
+Ring::~Ring() { Destroy(); }
+
+// See Ring.h
+bool Ring::Supported(std::string &error) {
+    try {
+        Ring ring(8, 8);
+        return true;
+    } catch (std::runtime_error &ex) {
+        error = ex.what();
+        return false;
+    }
+}
+
+// See Ring.h
+io_uring_sqe *Ring::NextSqe() {
+    if (_sqe_tail - __atomic_load_n(_sq_head, __ATOMIC_ACQUIRE) >= _sq_entries) {
+        Enter(0);
+    }
+    io_uring_sqe *sqe = &_sqes[_sqe_tail & _sq_mask];
+    _sqe_tail++;
+    std::memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+// See Ring.h
+int Ring::Enter(unsigned wait) {
+    unsigned to_submit = _sqe_tail - __atomic_load_n(_sq_head, __ATOMIC_ACQUIRE);
+    __atomic_store_n(_sq_tail, _sqe_tail, __ATOMIC_RELEASE);
+
+    // Completions of the deferred task running ring are posted only when they are asked for
+    int result = int(syscall(__NR_io_uring_enter, _fd, to_submit, wait, IORING_ENTER_GETEVENTS, nullptr, 0));
+    return result < 0 ? -errno : result;
+}
+
+// See Ring.h
+void Ring::RecycleBuffer(uint16_t id) {
+    uint16_t tail = _buf_ring->tail;
+    io_uring_buf &buf = BufferEntry(tail & _buf_mask);
+    buf.addr = reinterpret_cast<uint64_t>(Buffer(id));
+    buf.len = buffer_size;
+    buf.bid = id;
+    __atomic_store_n(&_buf_ring->tail, uint16_t(tail + 1), __ATOMIC_RELEASE);
+}
+
+// See Ring.h
+void Ring::Destroy() {
+    if (_fd >= 0) {
+        close(_fd);
+        _fd = -1;
+    }
+    if (_sqes != nullptr) {
+        munmap(_sqes, _sqes_size);
+        _sqes = nullptr;
+    }
+    if (_rings != nullptr) {
+        munmap(_rings, _rings_size);
+        _rings = nullptr;
+    }
+    if (_buf_ring != nullptr) {
+        munmap(_buf_ring, _buf_ring_size);
+        _buf_ring = nullptr;
+    }
+    if (_buffers != nullptr) {
+        munmap(_buffers, _buffers_size);
+        _buffers = nullptr;
+    }
+}
+
+} // namespace Uring
+} // namespace Network
+} // namespace Afina
@@ -0,0 +1,130 @@
+#ifndef AFINA_NETWORK_URING_RING_H
+#define AFINA_NETWORK_URING_RING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include <linux/io_uring.h>
+
+namespace Afina {
+namespace Network {
+namespace Uring {
+
+/**
+ * # io_uring instance
+ * Thin wrapper over the raw system calls: submission and completion queues are shared with the kernel, so
+ * requests are queued and completions are reaped by plain memory accesses. Only Enter makes a system call,
+ * it submits everything queued so far and waits for completions at once.
+ *
+ * Ring is created with IORING_SETUP_SINGLE_ISSUER and, if kernel supports it, IORING_SETUP_DEFER_TASKRUN:
+ * completions are posted only when the owner asks for them, so it must be created and used by one thread.
+ *
+ * Receive buffers are provided to the kernel by the buffer ring, see RecycleBuffer. Kernel picks a free buffer
+ * when data arrives, so idle connections don't hold any memory for reads.
+ */
+class Ring {
+public:
+    // Size of every provided buffer
+    static constexpr std::size_t buffer_size = 4096;
+
+    /**
+     * Creates ring and registers buffer ring of the given number of buffers as group 0. Throws
+     * std::runtime_error if kernel lacks any of the features server relies on
+     *
+     * @param entries size of the submission queue, power of 2
+     * @param buffers number of receive buffers, power of 2
+     */
+    Ring(unsigned entries, unsigned buffers);
+    ~Ring();
+
+    /**
+     * Checks that kernel supports everything ring needs, so that server could choose another backend
+     * in advance. Ring is created and destroyed on the calling thread
+     *
+     * @param error output parameter, reason if ring isn't supported
+     */
+    static bool Supported(std::string &error);
+
+    /**
+     * Returns zeroed submission queue entry to fill, it is submitted by the next Enter. If queue is full,
+     * what has been queued is submitted right away
+     */
+    io_uring_sqe *NextSqe();
+
+    /**
+     * Submits queued entries and waits until at least wait completions are available
+     *
+     * @return number of entries submitted or -errno
+     */
+    int Enter(unsigned wait);
+
+    /**
+     * Calls f for every completion available and marks them consumed. Completion is released before f is
+     * called, so that f could queue new requests
+     */
+    template <typename F> void ForEachCompletion(F f) {
+        unsigned head = *_cq_head;
+        unsigned tail = __atomic_load_n(_cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++) {
+            io_uring_cqe cqe = _cqes[head & _cq_mask];
+            __atomic_store_n(_cq_head, head + 1, __ATOMIC_RELEASE);
+            f(cqe);
+        }
+    }
+
+    /**
+     * Returns provided buffer with the given id, as reported in the flags of the receive completion
+     */
+    inline char *Buffer(uint16_t id) const { return _buffers + std::size_t(id) * buffer_size; }
+
+    /**
+     * Gives buffer back to the kernel, so that it could be used for the next receive
+     */
+    void RecycleBuffer(uint16_t id);
+
+private:
+    Ring(const Ring &) = delete;
+    Ring &operator=(const Ring &) = delete;
+
+    // Releases all resources, safe to call on partially constructed ring
+    void Destroy();
+
+    // Entry of the buffer ring. Kernel header declares bufs as flexible array, which C++ compilers place after
+    // an empty member, so entries are addressed directly: they start at the ring and the first one holds tail
+    inline io_uring_buf &BufferEntry(unsigned i) { return reinterpret_cast<io_uring_buf *>(_buf_ring)[i]; }
+
+    int _fd;
+
+    // Submission queue: entries are filled at _sqe_tail, kernel consumes them from the head
+    unsigned *_sq_head;
+    unsigned *_sq_tail;
+    unsigned _sq_mask;
+    unsigned _sq_entries;
+    unsigned _sqe_tail;
+    io_uring_sqe *_sqes;
+
+    // Completion queue
+    unsigned *_cq_head;
+    unsigned *_cq_tail;
+    unsigned _cq_mask;
+    io_uring_cqe *_cqes;
+
+    // Queues mapping shared with the kernel
+    void *_rings;
+    std::size_t _rings_size;
+    std::size_t _sqes_size;
+
+    // Buffer ring and buffers it refers to
+    io_uring_buf_ring *_buf_ring;
+    std::size_t _buf_ring_size;
+    unsigned _buf_mask;
+    char *_buffers;
+    std::size_t _buffers_size;
+};
+
+} // namespace Uring
+} // namespace Network
+} // namespace Afina
+
+#endif // AFINA_NETWORK_URING_RING_H
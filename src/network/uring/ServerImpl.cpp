@@ -0,0 +1,113 @@
+#include "ServerImpl.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <netinet/in.h>
+#include <signal.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <spdlog/logger.h>
+
+#include <afina/Storage.h>
+#include <afina/logging/Service.h>
+
+#include "Ring.h"
+#include "Worker.h"
+#include "network/mt_nonblocking/ServerImpl.h"
+
+namespace Afina {
+namespace Network {
+namespace Uring {
+
+// See Server.h
+ServerImpl::ServerImpl(std::shared_ptr<Afina::Storage> ps, std::shared_ptr<Logging::Service> pl)
+    : Server(ps, pl), _event_fd(-1) {}
+
+// See Server.h
+ServerImpl::~ServerImpl() {
+    if (_event_fd != -1) {
+        close(_event_fd);
+    }
+}
+
+// See Server.h
+void ServerImpl::Start(uint16_t port, uint32_t n_acceptors, uint32_t n_workers) {
+    _logger = pLogging->select("network");
+
+    std::string error;
+    if (!Ring::Supported(error)) {
+        _logger->warn("io_uring isn't available ({}), fall back to mt_nonblocking", error);
+        _fallback = std::make_shared<MTnonblock::ServerImpl>(pStorage, pLogging);
+        _fallback->SetDialect(_dialect);
+        _fallback->SetCapacity(_server_capacity);
+        _fallback->SetListeners(pListeners);
+        _fallback->SetUnixPath(_unix_path);
+        _fallback->Start(port, n_acceptors, n_workers);
+        return;
+    }
+
+    _logger->info("Start io_uring network service");
+    listen_port = port;
+
+    sigset_t sig_mask;
+    sigemptyset(&sig_mask);
+    sigaddset(&sig_mask, SIGPIPE);
+    if (pthread_sigmask(SIG_BLOCK, &sig_mask, NULL) != 0) {
+        throw std::runtime_error("Unable to mask SIGPIPE");
+    }
+
+    _event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (_event_fd == -1) {
+        throw std::runtime_error("Failed to create eventfd descriptor: " + std::string(strerror(errno)));
+    }
+
+    // Every worker accepts connections on its own socket, kernel balances them. UNIX socket is shared instead
+    n_workers = std::max<uint32_t>(n_workers, 1);
+    _workers.reserve(n_workers);
+    for (uint32_t i = 0; i < n_workers; i++) {
+        // Socket is blocking: io_uring waits for readiness itself, non-blocking socket would fail with EAGAIN
+        int server_socket = Listen(port, false, true);
+        _workers.emplace_back(new Worker(pStorage, pLogging, _dialect == Dialect::kRedis));
+        _workers.back()->Start(server_socket, _event_fd);
+    }
+}
+
+// See Server.h
+void ServerImpl::Stop() {
+    if (_fallback) {
+        _fallback->Stop();
+        return;
+    }
+
+    _logger->warn("Stop network service");
+    for (auto &w : _workers) {
+        w->Stop();
+    }
+
+    // Every worker polls eventfd, poll doesn't consume the counter so one write wakes them all
+    if (eventfd_write(_event_fd, 1)) {
+        throw std::runtime_error("Failed to wakeup workers");
+    }
+}
+
+// See Server.h
+void ServerImpl::Join() {
+    if (_fallback) {
+        _fallback->Join();
+        return;
+    }
+
+    for (auto &w : _workers) {
+        w->Join();
+    }
+    _workers.clear();
+}
+
+} // namespace Uring
+} // namespace Network
+} // namespace Afina
@@ -0,0 +1,65 @@
+#ifndef AFINA_NETWORK_URING_SERVER_H
+#define AFINA_NETWORK_URING_SERVER_H
+
+#include <memory>
+#include <vector>
+
+#include <afina/network/Server.h>
+
+namespace spdlog {
+class logger;
+}
+
+namespace Afina {
+namespace Network {
+namespace Uring {
+
+// Forward declaration, see Worker.h
+class Worker;
+
+/**
+ * # Network resource manager implementation
+ * io_uring based server, organized as MTnonblock::ServerImpl: every worker accepts connections on a private
+ * SO_REUSEPORT socket and serves them on a private ring, see Worker. Number of acceptors given to Start is
+ * ignored.
+ *
+ * If kernel has no io_uring or lacks some of its features, server logs the reason and runs
+ * MTnonblock::ServerImpl instead
+ */
+class ServerImpl : public Server {
+public:
+    ServerImpl(std::shared_ptr<Afina::Storage> ps, std::shared_ptr<Logging::Service> pl);
+    ~ServerImpl();
+
+    // See Server.h
+    void Start(uint16_t port, uint32_t acceptors, uint32_t workers) override;
+
+    // See Server.h
+    void Stop() override;
+
+    // See Server.h
+    void Join() override;
+
+private:
+    // logger to use
+    std::shared_ptr<spdlog::logger> _logger;
+
+    // Port to listen for new connections
+    // Read-only
+    uint16_t listen_port;
+
+    // Custom event "device" used to wakeup workers
+    int _event_fd;
+
+    // threads serving read/write requests
+    std::vector<std::unique_ptr<Worker>> _workers;
+
+    // epoll based server running instead if io_uring isn't supported
+    std::shared_ptr<Server> _fallback;
+};
+
+} // namespace Uring
+} // namespace Network
+} // namespace Afina
+
+#endif // AFINA_NETWORK_URING_SERVER_H
@@ -0,0 +1,351 @@
+#include "Worker.h"
+
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <spdlog/logger.h>
+
+#include <afina/Storage.h>
+#include <afina/logging/Service.h>
+
+#include "Connection.h"
+#include "Ring.h"
+
+namespace Afina {
+namespace Network {
+namespace Uring {
+
+namespace {
+
+// Sizes of the ring: submission queue and number of receive buffers, both must be power of 2
+constexpr unsigned ring_entries = 1024;
+constexpr unsigned ring_buffers = 1024;
+
+// Lower bits of user data keep operation kind, connections are aligned enough to leave them free
+constexpr uint64_t operation_mask = 7;
+
+} // namespace
+
+// See Worker.h
+Worker::Worker(std::shared_ptr<Afina::Storage> ps, std::shared_ptr<Afina::Logging::Service> pl, bool redis)
+    : _pStorage(ps), _pLogging(pl), isRunning(false), _server_socket(-1), _event_fd(-1), _accepting(false),
+      _redis(redis) {}
+
+// See Worker.h
+Worker::~Worker() {}
+
+// See Worker.h
+void Worker::Start(int server_socket, int event_fd) {
+    if (isRunning.exchange(true) == false) {
+        _server_socket = server_socket;
+        _event_fd = event_fd;
+        _logger = _pLogging->select("network.worker");
+        _thread = std::thread(&Worker::OnRun, this);
+    }
+}
+
+// See Worker.h
+void Worker::Stop() { isRunning = false; }
+
+// See Worker.h
+void Worker::Join() {
+    assert(_thread.joinable());
+    _thread.join();
+}
+
+// See Worker.h
+void Worker::OnRun() {
+    _logger->trace("OnRun");
+    try {
+        _ring.reset(new Ring(ring_entries, ring_buffers));
+    } catch (std::runtime_error &ex) {
+        _logger->error("Failed to create io_uring: {}", ex.what());
+        close(_server_socket);
+        return;
+    }
+
+    // Stop is signalled by eventfd, it stays readable so that every worker notices it
+    ArmAccept();
+    io_uring_sqe *sqe = _ring->NextSqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = _event_fd;
+    sqe->poll32_events = POLLIN;
+    sqe->user_data = kStop;
+
+    while (_accepting || !_connections.empty()) {
+        int result = _ring->Enter(1);
+        if (result < 0 && result != -EINTR && result != -EAGAIN && result != -EBUSY) {
+            _logger->error("io_uring_enter failed: {}", strerror(-result));
+            break;
+        }
+        _ring->ForEachCompletion([this](const io_uring_cqe &cqe) { OnCompletion(cqe); });
+    }
+
+    // Normally there is nothing left, unless ring has failed
+    for (Connection *pconn : _connections) {
+        close(pconn->_socket);
+        delete pconn;
+    }
+    _connections.clear();
+    close(_server_socket);
+    _ring.reset();
+    _logger->warn("Worker stopped");
+}
+
+// See Worker.h
+void Worker::OnCompletion(const io_uring_cqe &cqe) {
+    Connection *pconn = reinterpret_cast<Connection *>(cqe.user_data & ~operation_mask);
+    switch (cqe.user_data & operation_mask) {
+    case kAccept:
+        OnAccept(cqe);
+        break;
+    case kStop:
+        OnStop();
+        break;
+    case kRecv:
+        OnRecv(pconn, cqe);
+        break;
+    case kSend:
+        OnSend(pconn, cqe);
+        break;
+    default:
+        // Cancellations and closes, nothing to do about them
+        break;
+    }
+}
+
+// See Worker.h
+void Worker::OnAccept(const io_uring_cqe &cqe) {
+    if (cqe.res >= 0) {
+        _logger->debug("Accepted connection on descriptor {}", cqe.res);
+        Connection *pconn = new Connection(cqe.res, *_pStorage, _redis);
+        _connections.insert(pconn);
+        if (isRunning) {
+            ArmRecv(pconn);
+        } else {
+            pconn->_reading = false;
+            Finish(pconn);
+        }
+    } else if (cqe.res != -ECANCELED) {
+        _logger->error("Failed to accept socket: {}", strerror(-cqe.res));
+    }
+
+    // Multishot accept could stop on error, it is restarted then
+    if ((cqe.flags & IORING_CQE_F_MORE) == 0) {
+        _accepting = false;
+        if (isRunning) {
+            ArmAccept();
+        }
+    }
+}
+
+// See Worker.h
+void Worker::OnRecv(Connection *pconn, const io_uring_cqe &cqe) {
+    if ((cqe.flags & IORING_CQE_F_MORE) == 0) {
+        pconn->_receiving = false;
+        pconn->_cancelling = false;
+    }
+
+    if (cqe.res > 0) {
+        // Commands are executed right in the kernel provided buffer, so it could be given back at once. Unless
+        // reading is suspended: then data is copied out and waits for the output to be sent
+        uint16_t id = uint16_t(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+        if (pconn->_reading && pconn->_throttled) {
+            pconn->_input.append(_ring->Buffer(id), cqe.res);
+        } else if (pconn->_reading) {
+            Execute(pconn, _ring->Buffer(id), cqe.res);
+        }
+        _ring->RecycleBuffer(id);
+    } else if (cqe.res == 0) {
+        // Input kept while reading is suspended is the last the client has sent, it is answered anyway: receive
+        // is armed once it is, to report the end of stream again
+        if (pconn->_input.empty() && !pconn->_session.Held()) {
+            _logger->debug("Connection {} closed by client", pconn->_socket);
+            pconn->_reading = false;
+        }
+    } else if (cqe.res != -ENOBUFS && cqe.res != -ECANCELED) {
+        // Out of buffers only stops multishot receive, anything else is an error
+        _logger->debug("Failed to receive on {}: {}", pconn->_socket, strerror(-cqe.res));
+        pconn->_reading = false;
+    }
+
+    if (!pconn->_sending && !pconn->_output.empty()) {
+        Send(pconn);
+    }
+    Throttle(pconn);
+    Finish(pconn);
+}
+
+// See Worker.h
+void Worker::OnSend(Connection *pconn, const io_uring_cqe &cqe) {
+    pconn->_sending = false;
+    if (cqe.res < 0) {
+        _logger->debug("Failed to send on {}: {}", pconn->_socket, strerror(-cqe.res));
+        pconn->_reading = false;
+        pconn->_output.clear();
+        pconn->_pending.clear();
+        pconn->_written = 0;
+    } else {
+        pconn->_written += cqe.res;
+        if (pconn->_written < pconn->_output.size()) {
+            Send(pconn);
+            return;
+        }
+
+        // Responses formed meanwhile go out with the next send
+        pconn->_output.clear();
+        pconn->_written = 0;
+        pconn->_output.swap(pconn->_pending);
+        if (!pconn->_output.empty()) {
+            Send(pconn);
+        }
+        Throttle(pconn);
+    }
+    Finish(pconn);
+}
+
+// See Worker.h
+void Worker::OnStop() {
+    _logger->debug("Stop accepting, {} connections to drain", _connections.size());
+    if (_accepting) {
+        Cancel(kAccept);
+    }
+
+    // Connections without pending responses are closed right away, the rest once responses are sent
+    for (auto it = _connections.begin(); it != _connections.end();) {
+        Connection *pconn = *it++;
+        pconn->_reading = false;
+        Finish(pconn);
+    }
+}
+
+// See Worker.h
+void Worker::Execute(Connection *pconn, const char *data, std::size_t size) {
+    // Responses pile up in _pending while send is in flight, so every call is limited by the batch it adds
+    std::string &out = pconn->_sending ? pconn->_pending : pconn->_output;
+    pconn->_session.SetOutputLimit(out.size() + Connection::batch_output);
+    bool alive = pconn->_session.Process(data, size, out);
+
+    // Commands session has held back go on while client keeps up with responses, the rest wait for send
+    while (alive && pconn->_session.Held() && pconn->Queued() < Connection::max_output) {
+        pconn->_session.SetOutputLimit(out.size() + Connection::batch_output);
+        alive = pconn->_session.Resume(out);
+    }
+    if (!alive) {
+        _logger->debug("Malformed input on {}, closing connection", pconn->_socket);
+        pconn->_reading = false;
+    }
+}
+
+// See Worker.h
+void Worker::Throttle(Connection *pconn) {
+    if (!pconn->_reading) {
+        return;
+    }
+
+    // Input kept while reading has been suspended goes first, it could suspend reading again
+    if (pconn->_throttled && pconn->Queued() < Connection::max_output) {
+        pconn->_throttled = false;
+        if (!pconn->_input.empty() || pconn->_session.Held()) {
+            Execute(pconn, pconn->_input.data(), pconn->_input.size());
+            pconn->_input.clear();
+            if (!pconn->_sending && !pconn->_output.empty()) {
+                Send(pconn);
+            }
+        }
+    }
+    if (pconn->_reading && pconn->Queued() >= Connection::max_output) {
+        pconn->_throttled = true;
+    }
+
+    // Multishot receive goes on until it is cancelled, so suspended connection cancels it
+    if (!pconn->_reading) {
+        return;
+    } else if (pconn->_throttled && pconn->_receiving && !pconn->_cancelling) {
+        _logger->debug("Connection {} has {} bytes queued, stop reading", pconn->_socket, pconn->Queued());
+        Cancel(reinterpret_cast<uint64_t>(pconn) | kRecv);
+        pconn->_cancelling = true;
+    } else if (!pconn->_throttled && !pconn->_receiving) {
+        ArmRecv(pconn);
+    }
+}
+
+// See Worker.h
+void Worker::ArmAccept() {
+    io_uring_sqe *sqe = _ring->NextSqe();
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = _server_socket;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_CLOEXEC;
+    sqe->user_data = kAccept;
+    _accepting = true;
+}
+
+// See Worker.h
+void Worker::ArmRecv(Connection *pconn) {
+    io_uring_sqe *sqe = _ring->NextSqe();
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = pconn->_socket;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = 0;
+    sqe->user_data = reinterpret_cast<uint64_t>(pconn) | kRecv;
+    pconn->_receiving = true;
+}
+
+// See Worker.h
+void Worker::Send(Connection *pconn) {
+    // MSG_WAITALL makes kernel retry short sends itself, so there is usually a single completion per batch
+    io_uring_sqe *sqe = _ring->NextSqe();
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = pconn->_socket;
+    sqe->addr = reinterpret_cast<uint64_t>(pconn->_output.data() + pconn->_written);
+    sqe->len = uint32_t(pconn->_output.size() - pconn->_written);
+    sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+    sqe->user_data = reinterpret_cast<uint64_t>(pconn) | kSend;
+    pconn->_sending = true;
+}
+
+// See Worker.h
+void Worker::Cancel(uint64_t user_data) {
+    io_uring_sqe *sqe = _ring->NextSqe();
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = user_data;
+    sqe->user_data = kIgnore;
+}
+
+// See Worker.h
+void Worker::Finish(Connection *pconn) {
+    if (pconn->_reading || pconn->_sending) {
+        return;
+    }
+
+    // Completion of the cancelled receive is still to come
+    if (pconn->_receiving) {
+        if (!pconn->_cancelling) {
+            Cancel(reinterpret_cast<uint64_t>(pconn) | kRecv);
+            pconn->_cancelling = true;
+        }
+        return;
+    }
+
+    _logger->debug("Close connection on descriptor {}", pconn->_socket);
+    io_uring_sqe *sqe = _ring->NextSqe();
+    sqe->opcode = IORING_OP_CLOSE;
+    sqe->fd = pconn->_socket;
+    sqe->user_data = kIgnore;
+
+    _connections.erase(pconn);
+    delete pconn;
+}
+
+} // namespace Uring
+} // namespace Network
+} // namespace Afina
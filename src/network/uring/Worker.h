@@ -0,0 +1,139 @@
+#ifndef AFINA_NETWORK_URING_WORKER_H
+#define AFINA_NETWORK_URING_WORKER_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <unordered_set>
+
+#include <linux/io_uring.h>
+
+namespace spdlog {
+class logger;
+}
+
+namespace Afina {
+
+// Forward declaration, see afina/Storage.h
+class Storage;
+namespace Logging {
+class Service;
+}
+
+namespace Network {
+namespace Uring {
+
+// Forward declaration, see Connection.h
+class Connection;
+class Ring;
+
+/**
+ * # Thread running io_uring
+ * Worker accepts connections on its own SO_REUSEPORT socket and serves them on its own ring, the same way
+ * MTnonblock::Worker does with epoll. Instead of readiness notifications worker gets completed operations:
+ * - multishot accept posts a completion for every new connection
+ * - multishot receive posts a completion for every block of data, data is in a buffer kernel has taken from
+ *   the buffer ring, so there are no reads to issue and no buffers to keep per connection
+ * - send completes once the whole batch of responses has been sent
+ *
+ * All requests made while completions are processed are submitted with a single io_uring_enter, which also
+ * waits for the next completions. So under load round trip of many connections costs one system call.
+ */
+class Worker {
+public:
+    Worker(std::shared_ptr<Afina::Storage> ps, std::shared_ptr<Afina::Logging::Service> pl, bool redis);
+    ~Worker();
+
+    /**
+     * Spaws new background thread that serves connections accepted on the given socket
+     *
+     * @param server_socket listening socket, worker takes ownership of it
+     * @param event_fd descriptor server signals to wake workers up on Stop
+     */
+    void Start(int server_socket, int event_fd);
+
+    /**
+     * Signal background thread to stop. Thread stops accepting new connections and reading new commands,
+     * connections are closed once responses on commands already read are sent
+     */
+    void Stop();
+
+    /**
+     * Blocks calling thread until background one for this worker is actually
+     * been destoryed
+     */
+    void Join();
+
+protected:
+    /**
+     * Method executing by background thread
+     */
+    void OnRun();
+
+private:
+    Worker(const Worker &) = delete;
+    Worker &operator=(const Worker &) = delete;
+
+    // Kinds of requests, kept in the lower bits of user data along with the connection pointer
+    enum Operation : uint64_t { kAccept = 0, kStop = 1, kRecv = 2, kSend = 3, kIgnore = 4 };
+
+    void OnCompletion(const io_uring_cqe &cqe);
+    void OnAccept(const io_uring_cqe &cqe);
+    void OnRecv(Connection *pconn, const io_uring_cqe &cqe);
+    void OnSend(Connection *pconn, const io_uring_cqe &cqe);
+    void OnStop();
+
+    // Executes commands of the input block, responses go out with the current send or the next one. Commands
+    // beyond the output limit are held back by session
+    void Execute(Connection *pconn, const char *data, std::size_t size);
+
+    // Suspends or resumes reading depending on output queued, see Connection
+    void Throttle(Connection *pconn);
+
+    // Queue requests, they are submitted by the next Ring::Enter
+    void ArmAccept();
+    void ArmRecv(Connection *pconn);
+    void Send(Connection *pconn);
+    void Cancel(uint64_t user_data);
+
+    // Closes connection if it is done and kernel has nothing in flight for it, otherwise moves it towards that
+    void Finish(Connection *pconn);
+
+    // afina services
+    std::shared_ptr<Afina::Storage> _pStorage;
+
+    // afina services
+    std::shared_ptr<Afina::Logging::Service> _pLogging;
+
+    // Logger to be used
+    std::shared_ptr<spdlog::logger> _logger;
+
+    // Flag signals that thread should continue to operate
+    std::atomic<bool> isRunning;
+
+    // Thread serving requests in this worker
+    std::thread _thread;
+
+    // Ring is created by the background thread, it must be the only one to use it
+    std::unique_ptr<Ring> _ring;
+
+    // Socket to accept new connections on and descriptor signalling stop
+    int _server_socket;
+    int _event_fd;
+
+    // Multishot accept is in flight
+    bool _accepting;
+
+    // Clients speak Redis protocol
+    bool _redis;
+
+    // Connections served by this worker
+    std::unordered_set<Connection *> _connections;
+};
+
+} // namespace Uring
+} // namespace Network
+} // namespace Afina
+
+#endif // AFINA_NETWORK_URING_WORKER_H
@@ -0,0 +1,410 @@
+#include "BinaryParser.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "Scan.h"
+
+namespace Afina {
+namespace Protocol {
+
+namespace {
+
+// Packet fields are in the network byte order
+inline uint16_t Read16(const char *p) {
+    const uint8_t *b = reinterpret_cast<const uint8_t *>(p);
+    return uint16_t(b[0] << 8 | b[1]);
+}
+
+inline uint32_t Read32(const char *p) {
+    const uint8_t *b = reinterpret_cast<const uint8_t *>(p);
+    return uint32_t(b[0]) << 24 | uint32_t(b[1]) << 16 | uint32_t(b[2]) << 8 | uint32_t(b[3]);
+}
+
+inline uint64_t Read64(const char *p) { return uint64_t(Read32(p)) << 32 | Read32(p + 4); }
+
+inline void Append16(uint16_t v, std::string &out) {
+    char b[2] = {char(v >> 8), char(v)};
+    out.append(b, sizeof(b));
+}
+
+inline void Append32(uint32_t v, std::string &out) {
+    char b[4] = {char(v >> 24), char(v >> 16), char(v >> 8), char(v)};
+    out.append(b, sizeof(b));
+}
+
+inline void Append64(uint64_t v, std::string &out) {
+    Append32(uint32_t(v >> 32), out);
+    Append32(uint32_t(v), out);
+}
+
+} // namespace
+
+// See BinaryParser.h
+bool BinaryParser::Parse(const char *input, const size_t size, size_t &parsed) {
+    parsed = 0;
+    if (parse_complete) {
+        return true;
+    } else if (broken) {
+        parsed = size;
+        return false;
+    }
+
+    // Header tells how long the rest of the packet is
+    std::size_t taken = 0;
+    if (packet.size() < header_size && (!packet.empty() || size < header_size)) {
+        taken = std::min(header_size - packet.size(), size);
+        packet.append(input, taken);
+        if (packet.size() < header_size) {
+            parsed = taken;
+            return false;
+        }
+    }
+
+    const char *header = packet.empty() ? input : packet.data();
+    if (uint8_t(header[0]) != request_magic) {
+        // There is no way to find where the next packet starts
+        broken = true;
+        parsed = size;
+        return false;
+    }
+    std::size_t need = header_size + uint8_t(header[4]) + Read16(header + 2);
+    if (need - header_size > Read32(header + 8)) {
+        // Header is consumed alone and the whole body is skipped as if it were a value
+        opcode = Opcode(header[1]);
+        body_length = Read32(header + 8);
+        std::memcpy(&opaque, header + 12, sizeof(opaque));
+        error = Status::kInvalidArguments;
+        parsed = packet.empty() ? header_size : taken;
+        parse_complete = true;
+        return true;
+    }
+
+    // Most of the time packet comes in a single read, so there is no need to copy it
+    const char *p = input;
+    if (packet.empty() && size >= need) {
+        parsed = need;
+    } else {
+        std::size_t rest = std::min(need - packet.size(), size - taken);
+        packet.append(input + taken, rest);
+        parsed = taken + rest;
+        if (packet.size() < need) {
+            return false;
+        }
+        p = packet.data();
+    }
+
+    // Value may arrive in the next reads overwriting input, so the key must be kept
+    if (p == input && Read32(p + 8) > need - header_size) {
+        packet.assign(p, need);
+        p = packet.data();
+    }
+
+    ParsePacket(p);
+    parse_complete = true;
+    return true;
+}
+
+// See BinaryParser.h
+void BinaryParser::ParsePacket(const char *p) {
+    opcode = Opcode(p[1]);
+    key_length = Read16(p + 2);
+    extras_length = uint8_t(p[4]);
+    body_length = Read32(p + 8);
+    std::memcpy(&opaque, p + 12, sizeof(opaque));
+    cas = Read64(p + 16);
+
+    const char *extras = p + header_size;
+    std::size_t expect_extras = 0;
+    bool expect_key = true;
+    switch (opcode) {
+    case Opcode::kSet:
+    case Opcode::kSetQ:
+    case Opcode::kAdd:
+    case Opcode::kAddQ:
+    case Opcode::kReplace:
+    case Opcode::kReplaceQ:
+        // Flags and expiration time
+        expect_extras = 8;
+        if (extras_length == expect_extras) {
+            flags = Read32(extras);
+            expire = int32_t(Read32(extras + 4));
+        }
+        break;
+
+    case Opcode::kTouch:
+    case Opcode::kGat:
+    case Opcode::kGatQ:
+    case Opcode::kGatK:
+    case Opcode::kGatKQ:
+        // Expiration time
+        expect_extras = 4;
+        if (extras_length == expect_extras) {
+            expire = int32_t(Read32(extras));
+        }
+        break;
+
+    case Opcode::kGet:
+    case Opcode::kGetQ:
+    case Opcode::kGetK:
+    case Opcode::kGetKQ:
+    case Opcode::kAppend:
+    case Opcode::kAppendQ:
+    case Opcode::kPrepend:
+    case Opcode::kPrependQ:
+    case Opcode::kDelete:
+    case Opcode::kDeleteQ:
+        break;
+
+    case Opcode::kNoop:
+        expect_key = false;
+        break;
+
+    default:
+        error = Status::kUnknownCommand;
+        return;
+    }
+
+    // Delete request carries nothing but the key
+    bool unexpected_value = (opcode == Opcode::kDelete || opcode == Opcode::kDeleteQ) && body_length != key_length;
+    if (extras_length != expect_extras || (key_length > 0) != expect_key || key_length > max_key ||
+        unexpected_value) {
+        error = Status::kInvalidArguments;
+    } else if (expect_key) {
+        keys.emplace_back(extras + extras_length, key_length);
+    }
+}
+
+// See BinaryParser.h
+Execute::Command *BinaryParser::Build(size_t &body_size) {
+    if (!parse_complete) {
+        return nullptr;
+    }
+
+    body_size = body_length - extras_length - key_length;
+    if (error != Status::kNoError) {
+        return nullptr;
+    }
+
+    // Request CAS token is the condition of the meta command
+    meta = Execute::MetaFlags();
+    if (cas != 0) {
+        meta.mask |= Execute::MetaFlags::Bit('C');
+        meta.compare_cas = cas;
+    }
+
+    switch (opcode) {
+    case Opcode::kSet:
+    case Opcode::kSetQ:
+        return BuildStore('S');
+    case Opcode::kAdd:
+    case Opcode::kAddQ:
+        return BuildStore('E');
+    case Opcode::kReplace:
+    case Opcode::kReplaceQ:
+        return BuildStore('R');
+    case Opcode::kAppend:
+    case Opcode::kAppendQ:
+        return BuildStore('A');
+    case Opcode::kPrepend:
+    case Opcode::kPrependQ:
+        return BuildStore('P');
+    case Opcode::kDelete:
+    case Opcode::kDeleteQ:
+        return command.Emplace<Execute::MetaDelete>(keys[0], meta);
+    case Opcode::kGet:
+    case Opcode::kGetQ:
+    case Opcode::kGetK:
+    case Opcode::kGetKQ:
+        return command.Emplace<Execute::Get>(keys, true);
+    case Opcode::kTouch:
+        return command.Emplace<Execute::Touch>(keys[0], expire);
+    case Opcode::kGat:
+    case Opcode::kGatQ:
+    case Opcode::kGatK:
+    case Opcode::kGatKQ:
+        return command.Emplace<Execute::GetAndTouch>(expire, keys, true);
+    default:
+        return nullptr;
+    }
+}
+
+// See BinaryParser.h
+Execute::Command *BinaryParser::BuildStore(char mode) {
+    // As memcached does, store with CAS token replaces the item it has been compared with whatever the command is
+    meta.mask |= Execute::MetaFlags::Mask("cM");
+    meta.mode = cas != 0 && mode != 'A' && mode != 'P' ? 'S' : mode;
+    if (mode != 'A' && mode != 'P') {
+        meta.mask |= Execute::MetaFlags::Mask("FT");
+        meta.client_flags = flags;
+        meta.ttl = expire;
+    }
+    return command.Emplace<Execute::MetaSet>(keys[0], meta);
+}
+
+// See BinaryParser.h
+void BinaryParser::Respond(const std::string &result, std::string &out) const {
+    if (error != Status::kNoError) {
+        AppendResponse(error, 0, 0, StringRef(), StringRef(), out);
+        return;
+    }
+
+    bool quiet = opcode == Opcode::kSetQ || opcode == Opcode::kAddQ || opcode == Opcode::kReplaceQ ||
+                 opcode == Opcode::kAppendQ || opcode == Opcode::kPrependQ || opcode == Opcode::kDeleteQ ||
+                 opcode == Opcode::kGetQ || opcode == Opcode::kGetKQ || opcode == Opcode::kGatQ ||
+                 opcode == Opcode::kGatKQ;
+    switch (opcode) {
+    case Opcode::kSet:
+    case Opcode::kSetQ:
+    case Opcode::kAdd:
+    case Opcode::kAddQ:
+    case Opcode::kReplace:
+    case Opcode::kReplaceQ:
+    case Opcode::kAppend:
+    case Opcode::kAppendQ:
+    case Opcode::kPrepend:
+    case Opcode::kPrependQ:
+        RespondStore(result, quiet, out);
+        break;
+
+    case Opcode::kDelete:
+    case Opcode::kDeleteQ:
+        // Execute::MetaDelete answers HD, NF or EX
+        if (result[0] == 'E') {
+            AppendResponse(Status::kKeyExists, 0, 0, StringRef(), StringRef(), out);
+        } else if (result[0] != 'H') {
+            AppendResponse(Status::kKeyNotFound, 0, 0, StringRef(), StringRef(), out);
+        } else if (!quiet) {
+            AppendResponse(Status::kNoError, 0, 0, StringRef(), StringRef(), out);
+        }
+        break;
+
+    case Opcode::kTouch:
+        AppendResponse(result == "TOUCHED" ? Status::kNoError : Status::kKeyNotFound, 0, 0, StringRef(),
+                       StringRef(), out);
+        break;
+
+    case Opcode::kGet:
+    case Opcode::kGetQ:
+    case Opcode::kGetK:
+    case Opcode::kGetKQ:
+    case Opcode::kGat:
+    case Opcode::kGatQ:
+    case Opcode::kGatK:
+    case Opcode::kGatKQ:
+        RespondValue(result, quiet, out);
+        break;
+
+    default:
+        AppendResponse(Status::kNoError, 0, 0, StringRef(), StringRef(), out);
+        break;
+    }
+}
+
+// See BinaryParser.h
+void BinaryParser::RespondBusy(std::string &out) const {
+    AppendResponse(Status::kBusy, 0, 0, StringRef(), StringRef(), out);
+}
+
+// See BinaryParser.h
+void BinaryParser::RespondStore(const std::string &result, bool quiet, std::string &out) const {
+    // Stored item is reported as "HD c<cas>", the rest are NS, EX and NF
+    if (result[0] == 'H') {
+        uint64_t item_cas = 0;
+        Scan::ParseUint64(result.data() + 4, result.size() - 4, item_cas);
+        if (!quiet) {
+            AppendResponse(Status::kNoError, 0, item_cas, StringRef(), StringRef(), out);
+        }
+        return;
+    }
+
+    // Unmet condition of add and replace is told apart from value that doesn't fit
+    Status status = Status::kNotStored;
+    if (result[0] == 'E') {
+        status = Status::kKeyExists;
+    } else if (result[0] == 'N' && result[1] == 'F') {
+        status = Status::kKeyNotFound;
+    } else if (opcode == Opcode::kAdd || opcode == Opcode::kAddQ) {
+        status = Status::kKeyExists;
+    } else if (opcode == Opcode::kReplace || opcode == Opcode::kReplaceQ) {
+        status = Status::kKeyNotFound;
+    }
+    AppendResponse(status, 0, 0, StringRef(), StringRef(), out);
+}
+
+// See BinaryParser.h
+void BinaryParser::RespondValue(const std::string &result, bool quiet, std::string &out) const {
+    bool with_key = opcode == Opcode::kGetK || opcode == Opcode::kGetKQ || opcode == Opcode::kGatK ||
+                    opcode == Opcode::kGatKQ;
+    StringRef key = with_key ? keys[0] : StringRef();
+
+    // Item is formatted by Execute::Get as "VALUE <key> <flags> <bytes> <cas>\r\n<data>\r\nEND"
+    if (result.compare(0, 6, "VALUE ") != 0) {
+        if (!quiet) {
+            AppendResponse(Status::kKeyNotFound, 0, 0, key, StringRef(), out);
+        }
+        return;
+    }
+
+    std::size_t eol = Scan::Find(result.data(), result.size(), '\n');
+    StringRef fields[4];
+    std::size_t count = 0;
+    Scan::Split(result.data() + 6, eol - 7, [&fields, &count](const char *data, std::size_t size) {
+        fields[count++] = StringRef(data, size);
+        return count < 4;
+    });
+
+    uint32_t item_flags = 0, bytes = 0;
+    uint64_t item_cas = 0;
+    Scan::ParseUint32(fields[1].data(), fields[1].size(), item_flags);
+    Scan::ParseUint32(fields[2].data(), fields[2].size(), bytes);
+    Scan::ParseUint64(fields[3].data(), fields[3].size(), item_cas);
+    AppendResponse(Status::kNoError, item_flags, item_cas, key, StringRef(result.data() + eol + 1, bytes), out);
+}
+
+// See BinaryParser.h
+void BinaryParser::AppendResponse(Status status, uint32_t flags, uint64_t cas, StringRef key, StringRef value,
+                                  std::string &out) const {
+    // Only found items carry flags
+    bool with_flags = status == Status::kNoError && (opcode == Opcode::kGet || opcode == Opcode::kGetQ ||
+                                                     opcode == Opcode::kGetK || opcode == Opcode::kGetKQ ||
+                                                     opcode == Opcode::kGat || opcode == Opcode::kGatQ ||
+                                                     opcode == Opcode::kGatK || opcode == Opcode::kGatKQ);
+    uint8_t extras = with_flags ? 4 : 0;
+
+    out.push_back(char(response_magic));
+    out.push_back(char(opcode));
+    Append16(uint16_t(key.size()), out);
+    out.push_back(char(extras));
+    out.push_back(0); // data type
+    Append16(uint16_t(status), out);
+    Append32(uint32_t(extras + key.size() + value.size()), out);
+    out.append(reinterpret_cast<const char *>(&opaque), sizeof(opaque));
+    Append64(cas, out);
+    if (with_flags) {
+        Append32(flags, out);
+    }
+    out.append(key.data(), key.size());
+    out.append(value.data(), value.size());
+}
+
+// See BinaryParser.h
+void BinaryParser::Reset() {
+    command.Clear();
+    keys.clear();
+    packet.clear();
+    parse_complete = false;
+    broken = false;
+    opcode = Opcode::kNoop;
+    extras_length = 0;
+    key_length = 0;
+    body_length = 0;
+    opaque = 0;
+    cas = 0;
+    flags = 0;
+    expire = 0;
+    error = Status::kNoError;
+}
+
+} // namespace Protocol
+} // namespace Afina
@@ -0,0 +1,197 @@
+#ifndef AFINA_PROTOCOL_BINARY_PARSER_H
+#define AFINA_PROTOCOL_BINARY_PARSER_H
+
+#include <string>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <afina/StringRef.h>
+#include <afina/execute/Get.h>
+#include <afina/execute/GetAndTouch.h>
+#include <afina/execute/MetaDelete.h>
+#include <afina/execute/MetaFlags.h>
+#include <afina/execute/MetaSet.h>
+#include <afina/execute/Touch.h>
+
+#include "CommandSlot.h"
+
+namespace Afina {
+namespace Protocol {
+
+/**
+ * # Memcached binary protocol parser
+ * Every request is a packet: fixed 24 bytes header followed by extras, key and value, header tells their
+ * lengths. Parser handles header, extras and key while value is a data block read by the caller, the same
+ * way it is done for the text protocol. Requests are mapped onto the same Execute commands text protocol
+ * uses, text output of the command is translated back into binary response by Respond.
+ *
+ * Stores and deletes are executed as meta commands: request with non-zero CAS token is applied only if item
+ * still has that token, and response carries the token item has got. Retrievals report it as well.
+ *
+ * Quiet commands (getq, getkq, setq, ...) keep silence on the usual outcome, that is miss for retrievals and
+ * success for updates. So client could pipeline lots of them and finish the batch with a single noop.
+ *
+ * As well as Parser does, key is referenced right in the input unless packet is split between reads or
+ * carries value.
+ *
+ * Invalid packets are answered with error status. Only packet without magic byte is fatal, stream can't be
+ * resynchronized after it, see Broken.
+ */
+class BinaryParser {
+public:
+    // Magic byte every request packet starts with
+    static constexpr uint8_t request_magic = 0x80;
+
+    // Magic byte every response packet starts with
+    static constexpr uint8_t response_magic = 0x81;
+
+    // Size of the packet header
+    static constexpr std::size_t header_size = 24;
+
+    // Longest key memcached allows
+    static constexpr std::size_t max_key = 250;
+
+    BinaryParser() {
+        packet.reserve(header_size + max_key + 8);
+        keys.reserve(1);
+        Reset();
+    }
+
+    /**
+     * Push given string into parser input. Method returns true once packet header, extras and key have
+     * been parsed out from comulative input. In a such case method Build will return new command
+     *
+     * @param input string to be added to the parsed input
+     * @param size number of bytes in the input buffer that could be read
+     * @param parsed output parameter tells how many bytes was consumed from the string
+     * @return true if command has been parsed out
+     */
+    bool Parse(const char *input, const size_t size, size_t &parsed);
+
+    /**
+     * Builds new command from parsed packet. Returns nullptr if packet isn't parsed yet or if request needs
+     * no command, like noop or request with invalid arguments. Value size is set either way: value must be
+     * passed to the command or skipped if there is no command.
+     *
+     * Command is owned by the parser and lives until Reset, keys are referenced the same way Parser does.
+     */
+    Execute::Command *Build(size_t &body_size);
+
+    /**
+     * Appends response on the current request to the output, quiet requests could have none
+     *
+     * @param result text output of the command, ignored if Build returned no command
+     * @param out buffer response is appended to
+     */
+    void Respond(const std::string &result, std::string &out) const;
+
+    /**
+     * Appends response telling the current request hasn't been executed as server is busy
+     */
+    void RespondBusy(std::string &out) const;
+
+    /**
+     * Reset parse so that it could be used to parse out new command
+     */
+    void Reset();
+
+    // Stream doesn't look like binary protocol anymore, the rest of it is dropped
+    inline bool Broken() const { return broken; }
+
+private:
+    // Requests parser knows about
+    enum class Opcode : uint8_t {
+        kGet = 0x00,
+        kSet = 0x01,
+        kAdd = 0x02,
+        kReplace = 0x03,
+        kDelete = 0x04,
+        kGetQ = 0x09,
+        kNoop = 0x0a,
+        kGetK = 0x0c,
+        kGetKQ = 0x0d,
+        kAppend = 0x0e,
+        kPrepend = 0x0f,
+        kSetQ = 0x11,
+        kAddQ = 0x12,
+        kReplaceQ = 0x13,
+        kDeleteQ = 0x14,
+        kAppendQ = 0x19,
+        kPrependQ = 0x1a,
+        kTouch = 0x1c,
+        kGat = 0x1d,
+        kGatQ = 0x1e,
+        kGatK = 0x23,
+        kGatKQ = 0x24,
+    };
+
+    // Response status codes
+    enum class Status : uint16_t {
+        kNoError = 0x00,
+        kKeyNotFound = 0x01,
+        kKeyExists = 0x02,
+        kInvalidArguments = 0x04,
+        kNotStored = 0x05,
+        kUnknownCommand = 0x81,
+        kBusy = 0x85,
+    };
+
+    // Checks header fields and extras of the complete packet, fills command arguments
+    void ParsePacket(const char *p);
+
+    // Builds Execute::MetaSet storing value in the given mode, see MetaSet.h
+    Execute::Command *BuildStore(char mode);
+
+    // Translates output of Execute::MetaSet into response on storage request
+    void RespondStore(const std::string &result, bool quiet, std::string &out) const;
+
+    // Translates output of Execute::Get into response on retrieval request
+    void RespondValue(const std::string &result, bool quiet, std::string &out) const;
+
+    // Appends response packet with the given status and body to the output
+    void AppendResponse(Status status, uint32_t flags, uint64_t cas, StringRef key, StringRef value,
+                        std::string &out) const;
+
+    // Header fields of the current packet
+    Opcode opcode;
+    uint8_t extras_length;
+    uint16_t key_length;
+    uint32_t body_length;
+
+    // Opaque value is sent back as is, so it is kept in the network byte order
+    uint32_t opaque;
+
+    // CAS token item must have for the request to be applied, 0 means any
+    uint64_t cas;
+
+    // Extras of the storage and touch commands
+    uint32_t flags;
+    int32_t expire;
+
+    // Problem found in the packet, request is answered with it instead of executing command
+    Status error;
+
+    // Key of the request, vector is what Execute::Get takes
+    std::vector<StringRef> keys;
+
+    // Arguments of the meta command request is executed as
+    Execute::MetaFlags meta;
+
+    // Beginning of the packet received by previous Parse calls
+    std::string packet;
+
+    bool parse_complete;
+
+    // See Broken
+    bool broken;
+
+    // Current command
+    CommandSlot<Execute::MetaSet, Execute::MetaDelete, Execute::Get, Execute::GetAndTouch, Execute::Touch> command;
+};
+
+} // namespace Protocol
+} // namespace Afina
+
+#endif // AFINA_PROTOCOL_BINARY_PARSER_H
@@ -0,0 +1,52 @@
+#ifndef AFINA_PROTOCOL_COMMAND_SLOT_H
+#define AFINA_PROTOCOL_COMMAND_SLOT_H
+
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include <afina/execute/Command.h>
+
+namespace Afina {
+namespace Protocol {
+
+/**
+ * # Place for a single command of one of the given types
+ * Command is constructed in place, so building it takes no memory allocation. Slot holds one command at
+ * a time, the next one replaces previous.
+ */
+template <typename... Commands> class CommandSlot {
+public:
+    CommandSlot() : _command(nullptr) {}
+    ~CommandSlot() { Clear(); }
+
+    CommandSlot(const CommandSlot &) = delete;
+    CommandSlot &operator=(const CommandSlot &) = delete;
+
+    // Constructs command of the given type, destroying previous one
+    template <typename T, typename... Args> Execute::Command *Emplace(Args &&... args) {
+        static_assert(sizeof(T) <= sizeof(Storage) && alignof(T) <= alignof(Storage), "Command doesn't fit slot");
+        Clear();
+        _command = new (&_storage) T(std::forward<Args>(args)...);
+        return _command;
+    }
+
+    // Destroys current command if there is any
+    void Clear() {
+        if (_command != nullptr) {
+            _command->~Command();
+            _command = nullptr;
+        }
+    }
+
+private:
+    using Storage = typename std::aligned_union<0, Commands...>::type;
+
+    Storage _storage;
+    Execute::Command *_command;
+};
+
+} // namespace Protocol
+} // namespace Afina
+
+#endif // AFINA_PROTOCOL_COMMAND_SLOT_H
@@ -1,198 +1,425 @@
 #include "Parser.h"
 
-#include <iostream>
-#include <sstream>
-#include <stdexcept>
-
-#include <afina/execute/Add.h>
-#include <afina/execute/Append.h>
-#include <afina/execute/Command.h>
-#include <afina/execute/Delete.h>
-#include <afina/execute/Get.h>
-#include <afina/execute/Set.h>
-#include <afina/execute/Stats.h>
+#include "Scan.h"
 
 namespace Afina {
 namespace Protocol {
 
 // See Parse.h
 bool Parser::Parse(const char *input, const size_t size, size_t &parsed) {
-    size_t pos;
     parsed = 0;
+    if (parse_complete) {
+        return true;
+    }
 
-    for (pos = 0; pos < size && !parse_complete; pos++) {
-        char c = input[pos];
-        // std::cout << "[" << pos << "] '" << c << "': state=" << int(state) << std::endl;
-
-        switch (state) {
-        case State::sName: {
-            if (c == ' ' || c == '\r') {
-                // std::cout << "parser debug: name='" << name << "'" << std::endl;
-                if (name == "set" || name == "add" || name == "append" || name == "prepend") {
-                    state = State::spKey;
-                } else if (name == "get" || name == "gets") {
-                    state = State::sgKey;
-                } else if (name == "stats") {
-                    state = State::sLF;
-                    continue;
-                } else {
-                    throw std::runtime_error("Unknown command name: " + name);
-                }
-            } else {
-                name.push_back(c);
-            }
-            break;
+    // Rest of the broken line is dropped, next command starts after its end
+    std::size_t eol = Scan::Find(input, size, '\n');
+    if (skip_line) {
+        skip_line = eol == size;
+        parsed = skip_line ? size : eol + 1;
+        return false;
+    }
+
+    if (line.size() + eol > max_line) {
+        return Resync(size, eol, parsed, "CLIENT_ERROR line too long");
+    }
+
+    // Line isn't complete yet, keep its beginning till the rest arrives
+    if (eol == size) {
+        // Carriage return could be followed by line feed only, otherwise client is out of sync
+        std::size_t cr = Scan::Find(input, size, '\r');
+        if (cr + 1 < size || (!line.empty() && line.back() == '\r')) {
+            return Resync(size, eol, parsed, bad_format);
         }
+        line.append(input, size);
+        parsed = size;
+        return false;
+    }
 
-        case State::spKey: {
-            if (c == ' ') {
-                state = State::spFlags;
-                keys.push_back(curKey);
-                // std::cout << "parser debug: key[" << keys.size() - 1 << "]='" << curKey << "'" << std::endl;
-            } else {
-                curKey.push_back(c);
-            }
-            break;
+    // Most of the time line comes in a single read, so there is no need to copy it
+    const char *p = input;
+    std::size_t length = eol;
+    if (!line.empty()) {
+        line.append(input, eol);
+        p = line.data();
+        length = line.size();
+    }
+
+    // Lines are terminated by "\r\n", but memcached accepts bare "\n" as well
+    if (length > 0 && p[length - 1] == '\r') {
+        length--;
+    }
+
+    // Stray carriage return means client is out of sync
+    if (Scan::Find(p, length, '\r') != length) {
+        return Resync(size, eol, parsed, bad_format);
+    }
+
+    parsed = eol + 1;
+    parse_complete = true;
+    if (!ParseLine(p, length)) {
+        return true;
+    }
+
+    // Data block may arrive in the next reads overwriting input, so the key must be kept
+    if (has_body && line.empty()) {
+        line.assign(p, length);
+        for (auto &key : keys) {
+            key = StringRef(line.data() + (key.data() - p), key.size());
+        }
+        if (meta.Has('O')) {
+            meta.opaque = StringRef(line.data() + (meta.opaque.data() - p), meta.opaque.size());
         }
+    }
+    return true;
+}
 
-        case State::sgKey: {
-            if (c == '\r') {
-                keys.push_back(curKey);
-                // std::cout << "parser debug: total '" << keys.size() << " keys" << std::endl;
-
-                if (keys.size() == 0) {
-                    throw std::runtime_error("Client provides no key to retrive");
-                }
-
-                curKey.clear();
-                state = State::sLF;
-            } else if (c == ' ') {
-                // std::cout << "parser debug: key[" << keys.size() << "]='" << curKey << "'" << std::endl;
-                state = State::sgKey;
-                keys.push_back(curKey);
-                curKey.clear();
-            } else {
-                curKey.push_back(c);
-            }
-            break;
+// See Parse.h
+bool Parser::Resync(std::size_t size, std::size_t eol, std::size_t &parsed, const char *message) {
+    line.clear();
+    skip_line = eol == size;
+    parsed = skip_line ? size : eol + 1;
+    parse_complete = true;
+    error = message;
+    return true;
+}
+
+// See Parse.h
+bool Parser::ParseLine(const char *p, std::size_t size) {
+    tokens.clear();
+    Scan::Split(p, size, [this](const char *data, std::size_t size) {
+        tokens.push_back(Token{data, size});
+        return true;
+    });
+    if (tokens.empty()) {
+        return Fail(unknown_command);
+    }
+
+    // Verbs are short, so it is enough to compare them as integers
+    const Token &first = tokens[0];
+    name.assign(first.data, first.size);
+    switch (first.size <= 8 ? Scan::Pack(first.data, first.size) : 0) {
+    case Scan::Literal("get", 3):
+        verb = Verb::kGet;
+        break;
+    case Scan::Literal("gets", 4):
+        verb = Verb::kGets;
+        break;
+    case Scan::Literal("gat", 3):
+        verb = Verb::kGat;
+        break;
+    case Scan::Literal("gats", 4):
+        verb = Verb::kGats;
+        break;
+    case Scan::Literal("set", 3):
+        verb = Verb::kSet;
+        break;
+    case Scan::Literal("add", 3):
+        verb = Verb::kAdd;
+        break;
+    case Scan::Literal("replace", 7):
+        verb = Verb::kReplace;
+        break;
+    case Scan::Literal("append", 6):
+        verb = Verb::kAppend;
+        break;
+    case Scan::Literal("prepend", 7):
+        verb = Verb::kPrepend;
+        break;
+    case Scan::Literal("delete", 6):
+        verb = Verb::kDelete;
+        break;
+    case Scan::Literal("touch", 5):
+        verb = Verb::kTouch;
+        break;
+    case Scan::Literal("stats", 5):
+        verb = Verb::kStats;
+        break;
+    case Scan::Literal("mg", 2):
+        verb = Verb::kMetaGet;
+        break;
+    case Scan::Literal("ms", 2):
+        verb = Verb::kMetaSet;
+        break;
+    case Scan::Literal("md", 2):
+        verb = Verb::kMetaDelete;
+        break;
+    case Scan::Literal("ma", 2):
+        verb = Verb::kMetaArithmetic;
+        break;
+    case Scan::Literal("mn", 2):
+        verb = Verb::kMetaNoop;
+        break;
+    default:
+        return Fail(unknown_command);
+    }
+
+    switch (verb) {
+    case Verb::kGet:
+    case Verb::kGets:
+        if (!ParseKeys(1, tokens.size())) {
+            return false;
         }
+        break;
 
-        case State::spFlags: {
-            if (c == ' ') {
-                negative = false;
-                state = State::spExprTimeStart;
-                // std::cout << "parser debug: flags='" << flags << "'" << std::endl;
-            } else if (c >= '0' && c <= '9') {
-                uint32_t f = (flags * 10) + (c - '0');
-                if (f < flags) {
-                    // Overflow
-                    throw std::runtime_error("Flags field overflow");
-                }
-                flags = f;
-            }
-            break;
+    case Verb::kGat:
+    case Verb::kGats:
+        if (tokens.size() < 2 || !Scan::ParseInt32(tokens[1].data, tokens[1].size, exprtime)) {
+            return Fail(bad_format);
+        }
+        if (!ParseKeys(2, tokens.size())) {
+            return false;
         }
+        break;
 
-        case State::spExprTimeStart: {
-            if (c == '-') {
-                negative = true;
-                state = State::spExprTime;
-            } else if (c >= '0' && c <= '9') {
-                exprtime = (c - '0');
-                state = State::spExprTime;
-            }
-            break;
+    case Verb::kSet:
+    case Verb::kAdd:
+    case Verb::kReplace:
+    case Verb::kAppend:
+    case Verb::kPrepend:
+        // <command name> <key> <flags> <exptime> <bytes> [noreply]
+        if (tokens.size() < 5 || tokens.size() > 6) {
+            return Fail(bad_format);
+        }
+        // Data block size goes first: once it is known, the block is skipped even if other fields are broken
+        if (!Scan::ParseUint32(tokens[4].data, tokens[4].size, bytes)) {
+            return Fail(bad_format);
+        }
+        has_body = true;
+        if (!ParseKeys(1, 2)) {
+            return false;
         }
+        if (!Scan::ParseUint32(tokens[2].data, tokens[2].size, flags)) {
+            return Fail(bad_format);
+        }
+        if (!Scan::ParseInt32(tokens[3].data, tokens[3].size, exprtime)) {
+            return Fail(bad_format);
+        }
+        if (!ParseNoReply(5)) {
+            return false;
+        }
+        break;
 
-        case State::spExprTime: {
-            if (c == ' ') {
-                state = State::spBytes;
-                // std::cout << "parser debug: ExprTime='" << exprtime << "'" << std::endl;
-            } else if (c >= '0' && c <= '9') {
-                int32_t et = exprtime;
-                if (negative) {
-                    et -= (c - '0');
-                    if (et > exprtime) {
-                        throw std::runtime_error("Expire time field overflow");
-                    }
-                } else {
-                    et += (c - '0');
-                    if (et < exprtime) {
-                        throw std::runtime_error("Expire time field overflow");
-                    }
-                }
-                exprtime = et;
-            }
-            break;
+    case Verb::kDelete: {
+        // delete <key> [0] [noreply], zero time is accepted for compatibility with old clients
+        if (tokens.size() < 2 || tokens.size() > 4) {
+            return Fail(bad_format);
+        }
+        if (!ParseKeys(1, 2)) {
+            return false;
         }
+        std::size_t position = 2;
+        if (position < tokens.size() && tokens[position].size == 1 && tokens[position].data[0] == '0') {
+            position++;
+        }
+        if (position + 1 < tokens.size() || !ParseNoReply(position)) {
+            return Fail(bad_format);
+        }
+        break;
+    }
 
-        case State::spBytes: {
-            if (c == '\r') {
-                state = State::sLF;
-                // std::cout << "parser debug: bytes='" << bytes << "'" << std::endl;
-            } else if (c >= '0' && c <= '9') {
-                uint32_t b = (bytes * 10) + (c - '0');
-                if (b < bytes) {
-                    // Overflow
-                    throw std::runtime_error("Bytes field overflow");
-                }
-                bytes = b;
-            }
-            break;
+    case Verb::kTouch:
+        // touch <key> <exptime> [noreply]
+        if (tokens.size() < 3 || tokens.size() > 4) {
+            return Fail(bad_format);
+        }
+        if (!ParseKeys(1, 2)) {
+            return false;
         }
+        if (!Scan::ParseInt32(tokens[2].data, tokens[2].size, exprtime)) {
+            return Fail(bad_format);
+        }
+        if (!ParseNoReply(3)) {
+            return false;
+        }
+        break;
 
-        case State::sLF: {
-            if (c == '\n') {
-                parse_complete = true;
-            } else {
-                std::stringstream err;
-                err << "Invalid char " << (int)c << " at position " << (parsed + pos) << ", \\n expected";
-                throw std::runtime_error(err.str());
-            }
-            break;
+    case Verb::kStats:
+    case Verb::kMetaNoop:
+        break;
+
+    case Verb::kMetaGet:
+        // mg <key> <flags>*
+        if (!ParseKeys(1, 2) || !ParseMetaFlags(2, Execute::MetaFlags::Mask("cfkOqstvTNR"))) {
+            return false;
         }
+        break;
 
-        default:
-            throw std::runtime_error("Unknown state");
+    case Verb::kMetaSet:
+        // ms <key> <datalen> <flags>*
+        if (tokens.size() < 3 || !Scan::ParseUint32(tokens[2].data, tokens[2].size, bytes)) {
+            return Fail(bad_format);
+        }
+        has_body = true;
+        if (!ParseKeys(1, 2) || !ParseMetaFlags(3, Execute::MetaFlags::Mask("ckOqFTCIM"))) {
+            return false;
+        }
+        break;
+
+    case Verb::kMetaDelete:
+        // md <key> <flags>*
+        if (!ParseKeys(1, 2) || !ParseMetaFlags(2, Execute::MetaFlags::Mask("kOqCIT"))) {
+            return false;
+        }
+        break;
+
+    case Verb::kMetaArithmetic:
+        // ma <key> <flags>*
+        if (!ParseKeys(1, 2) || !ParseMetaFlags(2, Execute::MetaFlags::Mask("ckOqstvCNJDTM"))) {
+            return false;
+        }
+        break;
+    }
+    return true;
+}
+
+// See Parse.h
+bool Parser::ParseKeys(std::size_t first, std::size_t last) {
+    if (last <= first || last > tokens.size()) {
+        return Fail(bad_format);
+    }
+    for (std::size_t i = first; i < last; i++) {
+        if (tokens[i].size > max_key) {
+            return Fail(bad_format);
         }
+        keys.emplace_back(tokens[i].data, tokens[i].size);
     }
+    return true;
+}
 
-    parsed += pos;
-    return parse_complete;
+// See Parse.h
+bool Parser::ParseNoReply(std::size_t position) {
+    if (position >= tokens.size()) {
+        return true;
+    }
+    const Token &token = tokens[position];
+    if (token.size != 7 || Scan::Pack(token.data, token.size) != Scan::Literal("noreply", 7)) {
+        return Fail(bad_format);
+    }
+    noreply = true;
+    return true;
 }
 
 // See Parse.h
-std::unique_ptr<Execute::Command> Parser::Build(size_t &body_size) const {
-    if (state != State::sLF) {
-        return std::unique_ptr<Execute::Command>(nullptr);
-    }
-
-    body_size = bytes;
-    if (name == "set") {
-        return std::unique_ptr<Execute::Command>(new Execute::Set(keys[0], flags, exprtime));
-    } else if (name == "add") {
-        return std::unique_ptr<Execute::Command>(new Execute::Add(keys[0], flags, exprtime));
-    } else if (name == "append") {
-        return std::unique_ptr<Execute::Command>(new Execute::Append(keys[0], flags, exprtime));
-    } else if (name == "get") {
-        return std::unique_ptr<Execute::Command>(new Execute::Get(keys));
-    } else if (name == "stats") {
-        return std::unique_ptr<Execute::Command>(new Execute::Stats());
-    } else {
-        throw std::runtime_error("Unsupported command");
+bool Parser::ParseMetaFlags(std::size_t first, uint64_t allowed) {
+    for (std::size_t i = first; i < tokens.size(); i++) {
+        const char *p = tokens[i].data + 1;
+        std::size_t size = tokens[i].size - 1;
+        char letter = tokens[i].data[0];
+        uint64_t bit = Execute::MetaFlags::Bit(letter);
+        if ((bit & allowed) == 0) {
+            return Fail(bad_format);
+        }
+        meta.mask |= bit;
+
+        bool valid = true;
+        switch (letter) {
+        case 'O':
+            meta.opaque = StringRef(p, size);
+            valid = size <= max_opaque;
+            break;
+        case 'T':
+            valid = Scan::ParseInt32(p, size, meta.ttl);
+            break;
+        case 'N':
+            valid = Scan::ParseInt32(p, size, meta.vivify);
+            break;
+        case 'R':
+            valid = Scan::ParseInt32(p, size, meta.recache);
+            break;
+        case 'F':
+            valid = Scan::ParseUint32(p, size, meta.client_flags);
+            break;
+        case 'C':
+            valid = Scan::ParseUint64(p, size, meta.compare_cas);
+            break;
+        case 'D':
+            valid = Scan::ParseUint64(p, size, meta.delta);
+            break;
+        case 'J':
+            valid = Scan::ParseUint64(p, size, meta.initial);
+            break;
+        case 'M':
+            meta.mode = p[0];
+            valid = size == 1;
+            break;
+        default:
+            // Flags without token
+            valid = size == 0;
+            break;
+        }
+        if (!valid) {
+            return Fail(bad_format);
+        }
+    }
+    return true;
+}
+
+// See Parse.h
+Execute::Command *Parser::Build(size_t &body_size) {
+    if (!parse_complete) {
+        return nullptr;
+    }
+
+    body_size = has_body ? bytes : 0;
+    if (error != nullptr) {
+        return nullptr;
+    }
+
+    switch (verb) {
+    case Verb::kSet:
+        return command.Emplace<Execute::Set>(keys[0], flags, exprtime);
+    case Verb::kAdd:
+        return command.Emplace<Execute::Add>(keys[0], flags, exprtime);
+    case Verb::kAppend:
+        return command.Emplace<Execute::Append>(keys[0], flags, exprtime);
+    case Verb::kReplace:
+        return command.Emplace<Execute::Replace>(keys[0], flags, exprtime);
+    case Verb::kPrepend:
+        return command.Emplace<Execute::Prepend>(keys[0], flags, exprtime);
+    case Verb::kDelete:
+        return command.Emplace<Execute::Delete>(keys[0]);
+    case Verb::kGet:
+    case Verb::kGets:
+        return command.Emplace<Execute::Get>(keys, verb == Verb::kGets);
+    case Verb::kGat:
+    case Verb::kGats:
+        return command.Emplace<Execute::GetAndTouch>(exprtime, keys, verb == Verb::kGats);
+    case Verb::kTouch:
+        return command.Emplace<Execute::Touch>(keys[0], exprtime);
+    case Verb::kStats:
+        return command.Emplace<Execute::Stats>();
+    case Verb::kMetaGet:
+        return command.Emplace<Execute::MetaGet>(keys[0], meta);
+    case Verb::kMetaSet:
+        return command.Emplace<Execute::MetaSet>(keys[0], meta);
+    case Verb::kMetaDelete:
+        return command.Emplace<Execute::MetaDelete>(keys[0], meta);
+    case Verb::kMetaArithmetic:
+        return command.Emplace<Execute::MetaArithmetic>(keys[0], meta);
+    case Verb::kMetaNoop:
+        return command.Emplace<Execute::MetaNoop>();
+    default:
+        // Command isn't supported yet, data block is skipped
+        Fail(unknown_command);
+        return nullptr;
     }
 }
 
 // See Parse.h
 void Parser::Reset() {
-    state = State::sName;
+    command.Clear();
     name.clear();
     keys.clear();
-    curKey.clear();
+    line.clear();
     parse_complete = false;
     flags = 0;
     bytes = 0;
     exprtime = 0;
+    noreply = false;
+    has_body = false;
+    error = nullptr;
+    meta = Execute::MetaFlags();
 }
 
 } // namespace Protocol
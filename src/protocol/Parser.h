@@ -1,26 +1,70 @@
 #ifndef AFINA_PROTOCOL_PARSER_H
 #define AFINA_PROTOCOL_PARSER_H
 
-#include <memory>
 #include <string>
 #include <vector>
 
 #include <cstddef>
 #include <cstdint>
 
+#include <afina/StringRef.h>
+#include <afina/execute/Add.h>
+#include <afina/execute/Append.h>
+#include <afina/execute/Delete.h>
+#include <afina/execute/Get.h>
+#include <afina/execute/GetAndTouch.h>
+#include <afina/execute/MetaArithmetic.h>
+#include <afina/execute/MetaDelete.h>
+#include <afina/execute/MetaFlags.h>
+#include <afina/execute/MetaGet.h>
+#include <afina/execute/MetaNoop.h>
+#include <afina/execute/MetaSet.h>
+#include <afina/execute/Prepend.h>
+#include <afina/execute/Replace.h>
+#include <afina/execute/Set.h>
+#include <afina/execute/Stats.h>
+#include <afina/execute/Touch.h>
+
+#include "CommandSlot.h"
+
 namespace Afina {
-namespace Execute {
-class Command;
-} // namespace Execute
 namespace Protocol {
 
 /**
  * # Memcached protocol parser
  * Parser supports subset of memcached protocol
+ *
+ * Command line is processed as a whole: parser looks for the line end and splits line into tokens using
+ * vector instructions, see Scan.h. Line split between several reads is accumulated in the internal
+ * buffer, otherwise tokens are taken right from the input without any copy or allocation.
+ *
+ * Commands are built in place, inside of the parser, see CommandSlot. So once buffers have grown to fit
+ * usual requests, parsing and executing commands takes no memory allocations at all.
+ *
+ * Meta commands (mg, ms, md, ma, mn) are parsed into Execute::MetaFlags, every command accepts its own
+ * set of flags and the rest are rejected.
+ *
+ * Malformed input never throws: parser completes the request with an error instead, see Error, and skips
+ * input up to the next line end, so that client could go on with the next command.
  */
 class Parser {
 public:
-    Parser() { Reset(); }
+    // Longest command line parser accepts
+    static constexpr std::size_t max_line = 8192;
+
+    // Longest key memcached allows
+    static constexpr std::size_t max_key = 250;
+
+    // Longest opaque token of meta commands
+    static constexpr std::size_t max_opaque = 32;
+
+    Parser() : skip_line(false) {
+        line.reserve(256);
+        tokens.reserve(16);
+        keys.reserve(16);
+        Reset();
+    }
+
     /**
      * Push given string into parser input. Method returns true if it was a command parsed out
      * from comulative input. In a such case method Build will return new command
@@ -31,9 +75,13 @@ public:
      */
     bool Parse(const std::string &input, size_t &parsed) { return Parse(&input[0], input.size(), parsed); }
 
+    // Parsed command references input, so it must outlive the command
+    bool Parse(std::string &&input, size_t &parsed) = delete;
+
     /**
      * Push given string into parser input. Method returns true if it was a command parsed out
-     * from comulative input. In a such case method Build will return new command
+     * from comulative input. In a such case method Build will return new command, unless command
+     * is malformed and Error tells what is wrong
      *
      * @param input string to be added to the parsed input
      * @param size number of bytes in the input buffer that could be read
@@ -45,31 +93,104 @@ public:
     /**
      * Builds new command from parsed input. In case if it wasn't enough input to prse command out
      * method return nullptr
+     *
+     * Command is owned by the parser and lives until Reset, so it must not be deleted by the caller.
+     *
+     * Keys are not copied: command references them right in the input given to Parse or in the parser own
+     * buffer, if line has been split between reads or command expects data block. So command must be
+     * executed before parser is reset and before input given to the last Parse call is overwritten.
+     *
+     * Returns nullptr for malformed or unsupported command. Data block size is still set if it has been
+     * parsed out before the error was found, so that the block could be skipped.
      */
-    std::unique_ptr<Execute::Command> Build(size_t &body_size) const;
+    Execute::Command *Build(size_t &body_size);
 
     /**
-     * Reset parse so that it could be used to parse out new command
+     * Reset parse so that it could be used to parse out new command. Rest of the broken line is still
+     * going to be skipped
      */
     void Reset();
 
-    inline const std::string &Name() const { return name; }
-
-private:
     /**
-     * State of the command parser. Prefixes are:
-     * - s: state for PUT and GET commands
-     * - sp: for PUT commands only
-     * - sg: for GET commands only
+     * Reset parser and forget about the broken line, so that parser could serve the next connection
      */
-    enum State : uint16_t { sCR, sLF, sName, spKey, spFlags, spExprTimeStart, spExprTime, spBytes, sgKey };
+    void Restart() {
+        Reset();
+        skip_line = false;
+    }
 
-    // Current parser state
-    State state;
+    inline const std::string &Name() const { return name; }
+
+    // Client asked for no response on the parsed command
+    inline bool NoReply() const { return noreply; }
+
+    // Command is followed by a data block, even empty one is terminated by "\r\n"
+    inline bool HasBody() const { return has_body; }
+
+    // Response on the malformed command, nullptr if command is fine. Points to a string literal, so that
+    // reporting errors takes no allocations
+    inline const char *Error() const { return error; }
+
+private:
+    // Commands parser knows about
+    enum class Verb : uint8_t {
+        kGet,
+        kGets,
+        kGat,
+        kGats,
+        kSet,
+        kAdd,
+        kReplace,
+        kAppend,
+        kPrepend,
+        kDelete,
+        kTouch,
+        kStats,
+        kMetaGet,
+        kMetaSet,
+        kMetaDelete,
+        kMetaArithmetic,
+        kMetaNoop
+    };
+
+    // Part of the command line between spaces
+    struct Token {
+        const char *data;
+        std::size_t size;
+    };
+
+    // Responses on malformed commands
+    static constexpr const char *unknown_command = "ERROR";
+    static constexpr const char *bad_format = "CLIENT_ERROR bad command line format";
+
+    // Parses complete command line, that is everything before "\r\n". Methods below return false once
+    // command turns out to be malformed, error is set then
+    bool ParseLine(const char *p, std::size_t size);
+
+    // Copies keys from tokens [first, last)
+    bool ParseKeys(std::size_t first, std::size_t last);
+
+    // Checks optional "noreply" token at the given position, which must be the last one
+    bool ParseNoReply(std::size_t position);
+
+    // Parses meta flags from tokens starting with first, allowed is MetaFlags::Mask of accepted letters
+    bool ParseMetaFlags(std::size_t first, uint64_t allowed);
+
+    // Sets error and returns false
+    inline bool Fail(const char *message) {
+        error = message;
+        return false;
+    }
+
+    // Completes request with the error on broken line, the rest of the line is going to be skipped
+    bool Resync(std::size_t size, std::size_t eol, std::size_t &parsed, const char *message);
+
+    // Current command
+    Verb verb;
 
     // vrious fields of the command
     std::string name;
-    std::vector<std::string> keys;
+    std::vector<StringRef> keys;
 
     // <flags> is an arbitrary 16-bit unsigned integer (written out in decimal) that the server stores along with
     // the data and sends back when the item is retrieved. Clients may use this as a bit field to store data-specific
@@ -88,9 +209,34 @@ private:
     // it's followed by an empty data block).
     uint32_t bytes;
 
-    bool negative;
-    std::string curKey;
+    // "noreply" optional parameter instructs the server to not send the reply
+    bool noreply;
+
+    // See HasBody
+    bool has_body;
+
+    // Flags of the meta command
+    Execute::MetaFlags meta;
+
+    // Beginning of the command line received by previous Parse calls
+    std::string line;
+
+    // Tokens of the current command line, kept to reuse memory
+    std::vector<Token> tokens;
+
     bool parse_complete;
+
+    // See Error
+    const char *error;
+
+    // Input is dropped till the end of the broken line
+    bool skip_line;
+
+    // Current command
+    CommandSlot<Execute::Set, Execute::Add, Execute::Replace, Execute::Append, Execute::Prepend, Execute::Delete,
+                Execute::Get, Execute::GetAndTouch, Execute::Touch, Execute::Stats, Execute::MetaGet, Execute::MetaSet,
+                Execute::MetaDelete, Execute::MetaArithmetic, Execute::MetaNoop>
+        command;
 };
 
 } // namespace Protocol
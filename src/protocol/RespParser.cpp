@@ -0,0 +1,446 @@
+#include "RespParser.h"
+
+#include <algorithm>
+#include <ctime>
+
+#include "Scan.h"
+
+namespace Afina {
+namespace Protocol {
+
+namespace {
+
+// Errors on the valid protocol, connection goes on after them
+const char *const arity_error = "-ERR wrong number of arguments";
+const char *const syntax_error = "-ERR syntax error";
+const char *const integer_error = "-ERR value is not an integer or out of range";
+const char *const expire_error = "-ERR invalid expire time";
+const char *const key_error = "-ERR key is too long";
+
+// Packs verb the same way Scan::Pack does, folding letters to upper case
+inline uint64_t PackUpper(StringRef name) {
+    uint64_t w = Scan::Pack(name.data(), name.size());
+    return name.size() <= 8 ? w & ~0x2020202020202020ull : 0;
+}
+
+// Relative expiration time as Storage understands it, long ones must be absolute
+int32_t ExpireIn(int64_t seconds) {
+    if (seconds <= 0) {
+        return -1;
+    } else if (seconds <= 2592000) {
+        return int32_t(seconds);
+    }
+    int64_t at = int64_t(std::time(nullptr)) + seconds;
+    return int32_t(std::min<int64_t>(at, INT32_MAX));
+}
+
+// Parses signed 64 bits decimal number
+bool ParseInt64(StringRef token, int64_t &out) {
+    bool negative = token.size() > 0 && token.data()[0] == '-';
+    uint64_t value;
+    if (!Scan::ParseUint64(token.data() + negative, token.size() - negative, value) ||
+        value > uint64_t(INT64_MAX) + negative) {
+        return false;
+    }
+    out = negative ? int64_t(0 - value) : int64_t(value);
+    return true;
+}
+
+} // namespace
+
+// See RespParser.h
+bool RespParser::Parse(const char *input, const size_t size, size_t &parsed) {
+    parsed = 0;
+    if (parse_complete) {
+        return true;
+    } else if (broken) {
+        parsed = size;
+        return false;
+    }
+
+    // Most of the time request comes in a single read, so there is no need to copy it
+    std::size_t before = buffer.size();
+    if (before > 0) {
+        buffer.append(input, size);
+        base = buffer.data();
+    } else {
+        base = input;
+    }
+
+    Status status = ParseRequest(base, before + size);
+    if (status == Status::kIncomplete) {
+        if (before == 0) {
+            buffer.assign(input, size);
+        }
+        parsed = size;
+        return false;
+    }
+
+    parse_complete = true;
+    if (status == Status::kError) {
+        broken = true;
+        parsed = size;
+        return true;
+    }
+
+    // Data after the request belongs to the next one
+    parsed = position - before;
+    if (before > 0) {
+        buffer.resize(position);
+    }
+    ParseCommand();
+    return true;
+}
+
+// See RespParser.h
+RespParser::Status RespParser::ParseRequest(const char *p, std::size_t size) {
+    if (position == 0 && expected < 0) {
+        if (size == 0) {
+            return Status::kIncomplete;
+        } else if (p[0] != '*') {
+            return ParseInline(p, size);
+        }
+
+        Status status = ParseHeader(p, size, '*', expected);
+        if (status != Status::kComplete) {
+            return status;
+        } else if (expected > int64_t(max_args)) {
+            error = "-ERR Protocol error: invalid multibulk length";
+            return Status::kError;
+        }
+    }
+
+    while (int64_t(args.size()) < expected) {
+        std::size_t start = position;
+        int64_t length;
+        Status status = ParseHeader(p, size, '$', length);
+        if (status != Status::kComplete) {
+            return status;
+        } else if (length < 0 || length > int64_t(max_bulk)) {
+            error = "-ERR Protocol error: invalid bulk length";
+            return Status::kError;
+        }
+
+        // Wait till the whole argument arrives, buffer is sized once for a large one
+        if (size - position < std::size_t(length) + 2) {
+            buffer.reserve(position + length + 2);
+            position = start;
+            return Status::kIncomplete;
+        } else if (p[position + length] != '\r' || p[position + length + 1] != '\n') {
+            error = "-ERR Protocol error: bulk string is not terminated";
+            return Status::kError;
+        }
+        args.push_back(Arg{position, std::size_t(length)});
+        position += length + 2;
+    }
+    return Status::kComplete;
+}
+
+// See RespParser.h
+RespParser::Status RespParser::ParseInline(const char *p, std::size_t size) {
+    std::size_t eol = Scan::Find(p, size, '\n');
+    if (eol == size) {
+        if (size > max_inline) {
+            error = "-ERR Protocol error: too big inline request";
+            return Status::kError;
+        }
+        return Status::kIncomplete;
+    }
+
+    std::size_t length = eol > 0 && p[eol - 1] == '\r' ? eol - 1 : eol;
+    Scan::Split(p, length, [this, p](const char *data, std::size_t size) {
+        args.push_back(Arg{std::size_t(data - p), size});
+        return args.size() < max_args;
+    });
+    expected = int64_t(args.size());
+    position = eol + 1;
+    return Status::kComplete;
+}
+
+// See RespParser.h
+RespParser::Status RespParser::ParseHeader(const char *p, std::size_t size, char prefix, int64_t &number) {
+    // Header is short, there is no need to look for its end far away
+    std::size_t limit = std::min<std::size_t>(size - position, 32);
+    std::size_t eol = Scan::Find(p + position, limit, '\n');
+    if (eol == limit) {
+        if (limit == 32) {
+            error = "-ERR Protocol error: header is too long";
+            return Status::kError;
+        }
+        return Status::kIncomplete;
+    }
+
+    const char *line = p + position;
+    if (line[0] != prefix || eol < 2 || line[eol - 1] != '\r' ||
+        !ParseInt64(StringRef(line + 1, eol - 2), number)) {
+        error = prefix == '$' ? "-ERR Protocol error: expected '$'" : "-ERR Protocol error: invalid multibulk length";
+        return Status::kError;
+    }
+    position += eol + 1;
+    return Status::kComplete;
+}
+
+// See RespParser.h
+void RespParser::ParseCommand() {
+    if (args.empty()) {
+        // Empty request is ignored, as Redis does
+        verb = Verb::kNone;
+        return;
+    }
+
+    std::size_t count = args.size();
+    switch (PackUpper(Argument(0))) {
+    case Scan::Literal("GET", 3):
+        verb = Verb::kGet;
+        error = count != 2 ? arity_error : nullptr;
+        break;
+    case Scan::Literal("SET", 3):
+        verb = Verb::kSet;
+        if (count < 3) {
+            error = arity_error;
+        } else {
+            ParseSetOptions(3);
+        }
+        break;
+    case Scan::Literal("DEL", 3):
+        verb = Verb::kDel;
+        error = count < 2 ? arity_error : nullptr;
+        break;
+    case Scan::Literal("INCR", 4):
+        verb = Verb::kIncr;
+        error = count != 2 ? arity_error : nullptr;
+        break;
+    case Scan::Literal("EXPIRE", 6): {
+        verb = Verb::kExpire;
+        int64_t seconds;
+        if (count != 3) {
+            error = arity_error;
+        } else if (!ParseInt64(Argument(2), seconds)) {
+            error = integer_error;
+        } else {
+            expire = ExpireIn(seconds);
+        }
+        break;
+    }
+    case Scan::Literal("PING", 4):
+        verb = Verb::kPing;
+        error = count > 2 ? arity_error : nullptr;
+        break;
+    case Scan::Literal("CONFIG", 6):
+        verb = Verb::kConfig;
+        error = count != 3 || PackUpper(Argument(1)) != Scan::Literal("GET", 3) ? syntax_error : nullptr;
+        break;
+    default:
+        verb = Verb::kUnknown;
+        return;
+    }
+
+    // Commands having keys
+    if (error == nullptr && verb != Verb::kPing && verb != Verb::kConfig) {
+        for (std::size_t i = 1; i < (verb == Verb::kDel ? count : 2); i++) {
+            if (args[i].size > max_key) {
+                error = key_error;
+                return;
+            }
+        }
+        keys.push_back(Argument(1));
+    }
+}
+
+// See RespParser.h
+void RespParser::ParseSetOptions(std::size_t first) {
+    for (std::size_t i = first; i < args.size(); i++) {
+        StringRef option = Argument(i);
+        switch (PackUpper(option)) {
+        case Scan::Literal("EX", 2):
+        case Scan::Literal("PX", 2): {
+            int64_t time;
+            if (i + 1 == args.size()) {
+                error = syntax_error;
+                return;
+            } else if (!ParseInt64(Argument(++i), time)) {
+                error = integer_error;
+                return;
+            } else if (time <= 0) {
+                error = expire_error;
+                return;
+            }
+            // Storage counts seconds, milliseconds are rounded up
+            expire = ExpireIn(option.data()[0] == 'E' || option.data()[0] == 'e' ? time : (time + 999) / 1000);
+            break;
+        }
+        case Scan::Literal("NX", 2):
+            only_absent = true;
+            break;
+        case Scan::Literal("XX", 2):
+            only_present = true;
+            break;
+        default:
+            error = syntax_error;
+            return;
+        }
+    }
+    if (only_absent && only_present) {
+        error = syntax_error;
+    }
+}
+
+// See RespParser.h
+Execute::Command *RespParser::Build(StringRef &value) {
+    value = StringRef();
+    if (!parse_complete || error != nullptr) {
+        return nullptr;
+    }
+
+    switch (verb) {
+    case Verb::kGet:
+        return command.Emplace<Execute::Get>(keys);
+    case Verb::kSet:
+        value = Argument(2);
+        if (only_absent) {
+            return command.Emplace<Execute::Add>(keys[0], 0, expire);
+        } else if (only_present) {
+            return command.Emplace<Execute::Replace>(keys[0], 0, expire);
+        }
+        return command.Emplace<Execute::Set>(keys[0], 0, expire);
+    case Verb::kDel:
+        next_key = 2;
+        return command.Emplace<Execute::Delete>(keys[0]);
+    case Verb::kIncr:
+        return command.Emplace<Execute::MetaArithmetic>(keys[0], incr_flags);
+    case Verb::kExpire:
+        return command.Emplace<Execute::Touch>(keys[0], expire);
+    default:
+        return nullptr;
+    }
+}
+
+// See RespParser.h
+Execute::Command *RespParser::Respond(const std::string &result, std::string &out) {
+    if (error == arity_error) {
+        out.append(error).append(" for '", 6).append(Argument(0).data(), args[0].size).append("' command\r\n");
+        return nullptr;
+    } else if (error != nullptr) {
+        out.append(error).append("\r\n", 2);
+        return nullptr;
+    }
+
+    switch (verb) {
+    case Verb::kNone:
+        break;
+
+    case Verb::kUnknown:
+        out.append("-ERR unknown command '").append(Argument(0).data(), std::min<std::size_t>(args[0].size, 128));
+        out.append("'\r\n", 3);
+        break;
+
+    case Verb::kPing:
+        if (args.size() == 2) {
+            AppendBulk(Argument(1), out);
+        } else {
+            out.append("+PONG\r\n", 7);
+        }
+        break;
+
+    case Verb::kConfig:
+        // Parameters are not configurable, but clients like redis-benchmark want to see some value
+        out.append("*2\r\n", 4);
+        AppendBulk(Argument(2), out);
+        out.append("$0\r\n\r\n", 6);
+        break;
+
+    case Verb::kGet: {
+        // Item is formatted by Execute::Get as "VALUE <key> <flags> <bytes>\r\n<data>\r\nEND"
+        if (result.compare(0, 6, "VALUE ") != 0) {
+            out.append("$-1\r\n", 5);
+            break;
+        }
+        std::size_t eol = result.find('\n');
+        std::size_t space = result.rfind(' ', eol);
+        uint32_t bytes = 0;
+        Scan::ParseUint32(result.data() + space + 1, eol - space - 2, bytes);
+        AppendBulk(StringRef(result.data() + eol + 1, bytes), out);
+        break;
+    }
+
+    case Verb::kSet:
+        if (result == "STORED") {
+            out.append("+OK\r\n", 5);
+        } else {
+            out.append("$-1\r\n", 5);
+        }
+        break;
+
+    case Verb::kDel:
+        deleted += result == "DELETED";
+        if (next_key < args.size()) {
+            keys[0] = Argument(next_key++);
+            return command.Emplace<Execute::Delete>(keys[0]);
+        }
+        AppendInteger(deleted, out);
+        break;
+
+    case Verb::kIncr: {
+        // New value is returned as "VA <bytes> <flags>*\r\n<number>"
+        int64_t number;
+        std::size_t eol = result.find('\n');
+        if (result.compare(0, 3, "VA ") != 0 || eol == std::string::npos ||
+            !ParseInt64(StringRef(result.data() + eol + 1, result.size() - eol - 1), number)) {
+            out.append(result.compare(0, 2, "NS") == 0 ? "-ERR value could not be stored" : integer_error);
+            out.append("\r\n", 2);
+            break;
+        }
+        AppendInteger(number, out);
+        break;
+    }
+
+    case Verb::kExpire:
+        AppendInteger(result == "TOUCHED" ? 1 : 0, out);
+        break;
+    }
+    return nullptr;
+}
+
+// See RespParser.h
+void RespParser::AppendBulk(StringRef data, std::string &out) {
+    out.push_back('$');
+    Execute::MetaCommand::AppendNumber(data.size(), out);
+    out.append("\r\n", 2).append(data.data(), data.size()).append("\r\n", 2);
+}
+
+// See RespParser.h
+void RespParser::AppendInteger(int64_t number, std::string &out) {
+    out.push_back(':');
+    if (number < 0) {
+        out.push_back('-');
+    }
+    Execute::MetaCommand::AppendNumber(number < 0 ? 0 - uint64_t(number) : uint64_t(number), out);
+    out.append("\r\n", 2);
+}
+
+// See RespParser.h
+void RespParser::Reset() {
+    command.Clear();
+    buffer.clear();
+    base = nullptr;
+    position = 0;
+    expected = -1;
+    args.clear();
+    keys.clear();
+    verb = Verb::kNone;
+    expire = 0;
+    only_absent = false;
+    only_present = false;
+    error = nullptr;
+    next_key = 0;
+    deleted = 0;
+    parse_complete = false;
+
+    // INCR creates missing item with the value 1, as if it were 0 before
+    incr_flags = Execute::MetaFlags();
+    incr_flags.mask = Execute::MetaFlags::Mask("vNJ");
+    incr_flags.initial = 1;
+}
+
+} // namespace Protocol
+} // namespace Afina
@@ -0,0 +1,191 @@
+#ifndef AFINA_PROTOCOL_RESP_PARSER_H
+#define AFINA_PROTOCOL_RESP_PARSER_H
+
+#include <string>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <afina/StringRef.h>
+#include <afina/execute/Add.h>
+#include <afina/execute/Delete.h>
+#include <afina/execute/Get.h>
+#include <afina/execute/MetaArithmetic.h>
+#include <afina/execute/MetaFlags.h>
+#include <afina/execute/Replace.h>
+#include <afina/execute/Set.h>
+#include <afina/execute/Touch.h>
+
+#include "CommandSlot.h"
+
+namespace Afina {
+namespace Protocol {
+
+/**
+ * # Redis protocol (RESP2) parser
+ * Request is an array of bulk strings: "*<count>\r\n" followed by "$<length>\r\n<bytes>\r\n" for every
+ * argument. Inline commands, that is arguments separated by spaces on a single line, are accepted as well.
+ *
+ * Subset of commands is mapped onto Execute commands memcached protocols use, text output of the command
+ * is translated back into RESP reply by Respond, the same way BinaryParser does:
+ * - GET key
+ * - SET key value [EX seconds | PX milliseconds] [NX | XX]
+ * - DEL key [key ...]
+ * - INCR key
+ * - EXPIRE key seconds
+ * - PING [message], CONFIG GET parameter (answers with empty value, for redis-benchmark)
+ *
+ * Arguments are referenced right in the input unless command is split between reads. In a such case it is
+ * accumulated in the internal buffer and parsing goes on where it stopped, so large values are not scanned
+ * over and over again.
+ *
+ * Unknown commands and wrong arguments are answered with errors. Malformed protocol is fatal as it is for
+ * Redis: client gets an error and connection should be closed, see Broken.
+ */
+class RespParser {
+public:
+    // Most arguments command could have
+    static constexpr std::size_t max_args = 1024;
+
+    // Longest bulk string parser accepts
+    static constexpr std::size_t max_bulk = 64 << 20;
+
+    // Longest inline command
+    static constexpr std::size_t max_inline = 64 << 10;
+
+    // Longest key memcached allows, storage shares it
+    static constexpr std::size_t max_key = 250;
+
+    RespParser() : broken(false) {
+        args.reserve(16);
+        keys.reserve(1);
+        Reset();
+    }
+
+    /**
+     * Push given string into parser input. Method returns true once complete command has been parsed out
+     * from comulative input. In a such case method Build will return new command
+     *
+     * @param input string to be added to the parsed input
+     * @param size number of bytes in the input buffer that could be read
+     * @param parsed output parameter tells how many bytes was consumed from the string
+     * @return true if command has been parsed out
+     */
+    bool Parse(const char *input, const size_t size, size_t &parsed);
+
+    /**
+     * Builds new command from parsed request. Returns nullptr if request isn't parsed yet or if it needs no
+     * command, like PING or request with invalid arguments.
+     *
+     * Command is owned by the parser and lives until Reset, keys are referenced the same way Parser does.
+     *
+     * @param value output parameter, data command stores, it references input as keys do
+     */
+    Execute::Command *Build(StringRef &value);
+
+    /**
+     * Translates output of the command into reply and appends it to the output. Commands working on several
+     * keys are executed once per key: method returns command for the next key then, reply is appended once
+     * the last key is done
+     *
+     * @param result text output of the command, ignored if Build returned no command
+     * @param out buffer reply is appended to
+     * @return command to be executed next or nullptr if request is done
+     */
+    Execute::Command *Respond(const std::string &result, std::string &out);
+
+    /**
+     * Reset parse so that it could be used to parse out new command
+     */
+    void Reset();
+
+    /**
+     * Reset parser and forget about broken stream, so that parser could serve the next connection
+     */
+    void Restart() {
+        Reset();
+        broken = false;
+    }
+
+    // Stream isn't valid RESP, the rest of it is dropped
+    inline bool Broken() const { return broken; }
+
+private:
+    // Commands parser knows about
+    enum class Verb : uint8_t { kNone, kUnknown, kGet, kSet, kDel, kIncr, kExpire, kPing, kConfig };
+
+    // Argument of the request, offsets are relative to the request start as buffer could be reallocated
+    struct Arg {
+        std::size_t offset;
+        std::size_t size;
+    };
+
+    // Outcome of the parsing attempt
+    enum class Status : uint8_t { kIncomplete, kComplete, kError };
+
+    // Parses request from the given data, going on where the previous call stopped
+    Status ParseRequest(const char *p, std::size_t size);
+
+    // Parses inline command, that is a line of arguments separated by spaces
+    Status ParseInline(const char *p, std::size_t size);
+
+    // Parses "<prefix><number>\r\n" line starting at position, moves position past it
+    Status ParseHeader(const char *p, std::size_t size, char prefix, int64_t &number);
+
+    // Checks arguments of the command, sets error if they are wrong
+    void ParseCommand();
+
+    // Parses SET options starting from the argument index, sets error if they are wrong
+    void ParseSetOptions(std::size_t first);
+
+    // Returns argument with the given index
+    inline StringRef Argument(std::size_t i) const { return StringRef(base + args[i].offset, args[i].size); }
+
+    // Appends bulk string or error reply
+    static void AppendBulk(StringRef data, std::string &out);
+    static void AppendInteger(int64_t number, std::string &out);
+
+    // Beginning of the request received by previous Parse calls
+    std::string buffer;
+
+    // Where the request starts, either in the input or in the buffer
+    const char *base;
+
+    // Parsing progress: where the next element starts and how many arguments there should be
+    std::size_t position;
+    int64_t expected;
+    std::vector<Arg> args;
+
+    // Parsed request
+    Verb verb;
+    std::vector<StringRef> keys;
+    int32_t expire;
+    bool only_absent;
+    bool only_present;
+
+    // Reply on the malformed request, nullptr if request is fine
+    const char *error;
+
+    // DEL progress: key being deleted and how many keys have been deleted
+    std::size_t next_key;
+    int64_t deleted;
+
+    // Flags of the meta command INCR is built from
+    Execute::MetaFlags incr_flags;
+
+    bool parse_complete;
+
+    // See Broken
+    bool broken;
+
+    // Current command
+    CommandSlot<Execute::Get, Execute::Set, Execute::Add, Execute::Replace, Execute::Delete,
+                Execute::MetaArithmetic, Execute::Touch>
+        command;
+};
+
+} // namespace Protocol
+} // namespace Afina
+
+#endif // AFINA_PROTOCOL_RESP_PARSER_H
@@ -0,0 +1,207 @@
+#ifndef AFINA_PROTOCOL_SCAN_H
+#define AFINA_PROTOCOL_SCAN_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace Afina {
+namespace Protocol {
+
+/**
+ * # Text protocol scanning primitives
+ * Vector versions compare 32 (AVX2) or 16 (SSE2) bytes per instruction and fall back to scalar code
+ * for the tail. Instruction set is chosen at compile time, project is built with -march=native.
+ * Scalar versions are always available, both for the tail and as a reference.
+ */
+namespace Scan {
+
+// Returns position of the first byte equal to c or size if there is none
+inline std::size_t FindScalar(const char *p, std::size_t size, char c) {
+    for (std::size_t i = 0; i < size; i++) {
+        if (p[i] == c) {
+            return i;
+        }
+    }
+    return size;
+}
+
+// See FindScalar
+inline std::size_t Find(const char *p, std::size_t size, char c) {
+    std::size_t i = 0;
+#if defined(__AVX2__)
+    const __m256i needle32 = _mm256_set1_epi8(c);
+    for (; i + 32 <= size; i += 32) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + i));
+        uint32_t mask = uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle32)));
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+#endif
+#if defined(__SSE2__)
+    const __m128i needle16 = _mm_set1_epi8(c);
+    for (; i + 16 <= size; i += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+        uint32_t mask = uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle16)));
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+#endif
+    return i + FindScalar(p + i, size - i, c);
+}
+
+// Calls on_token(begin, size) for every non empty token separated by spaces, returns false as soon
+// as on_token does
+template <typename F> inline bool SplitScalar(const char *p, std::size_t size, F &&on_token) {
+    std::size_t start = 0;
+    for (std::size_t i = 0; i < size; i++) {
+        if (p[i] == ' ') {
+            if (i > start && !on_token(p + start, i - start)) {
+                return false;
+            }
+            start = i + 1;
+        }
+    }
+    return size <= start || on_token(p + start, size - start);
+}
+
+// See SplitScalar
+template <typename F> inline bool Split(const char *p, std::size_t size, F &&on_token) {
+    std::size_t start = 0, i = 0;
+#if defined(__AVX2__)
+    const __m256i space32 = _mm256_set1_epi8(' ');
+    for (; i + 32 <= size; i += 32) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + i));
+        uint32_t mask = uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, space32)));
+        for (; mask != 0; mask &= mask - 1) {
+            std::size_t pos = i + __builtin_ctz(mask);
+            if (pos > start && !on_token(p + start, pos - start)) {
+                return false;
+            }
+            start = pos + 1;
+        }
+    }
+#endif
+#if defined(__SSE2__)
+    const __m128i space16 = _mm_set1_epi8(' ');
+    for (; i + 16 <= size; i += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+        uint32_t mask = uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, space16)));
+        for (; mask != 0; mask &= mask - 1) {
+            std::size_t pos = i + __builtin_ctz(mask);
+            if (pos > start && !on_token(p + start, pos - start)) {
+                return false;
+            }
+            start = pos + 1;
+        }
+    }
+#endif
+    // Tail is split by scalar code, token could start before it
+    if (i > start) {
+        std::size_t first = FindScalar(p + i, size - i, ' ');
+        if (first == size - i) {
+            return on_token(p + start, size - start);
+        }
+        if (!on_token(p + start, i + first - start)) {
+            return false;
+        }
+        start = i + first + 1;
+    }
+    return SplitScalar(p + start, size - start, on_token);
+}
+
+// Packs up to 8 bytes into a word, so that short strings could be compared as integers
+inline uint64_t Pack(const char *p, std::size_t size) {
+    uint64_t w = 0;
+    std::memcpy(&w, p, size < 8 ? size : 8);
+    return w;
+}
+
+// Compile time version of Pack for string literals, assumes little endian byte order
+constexpr uint64_t Literal(const char *s, std::size_t size, std::size_t i = 0) {
+    return i == size ? 0 : (uint64_t(uint8_t(s[i])) << (8 * i)) | Literal(s, size, i + 1);
+}
+
+// Parses up to 8 decimal digits at once (SWAR), returns false if there is anything except digits
+inline bool ParseDigits(const char *p, std::size_t size, uint64_t &out) {
+    // Digits are right aligned in the word padded by '0' on the left, so padding doesn't change value
+    uint64_t w = 0x3030303030303030ull;
+    std::memcpy(reinterpret_cast<char *>(&w) + (8 - size), p, size);
+
+    // Every byte must be in 0x30..0x39: high nibble is 3 and adding 6 doesn't carry into it
+    if ((((w & 0xf0f0f0f0f0f0f0f0ull) | (((w + 0x0606060606060606ull) & 0xf0f0f0f0f0f0f0f0ull) >> 4))) !=
+        0x3333333333333333ull) {
+        return false;
+    }
+
+    // Combine pairs of digits, then pairs of pairs and so on: 3 multiplications instead of 8
+    w = ((w & 0x0f0f0f0f0f0f0f0full) * 2561) >> 8;
+    w = ((w & 0x00ff00ff00ff00ffull) * 6553601) >> 16;
+    out = ((w & 0x0000ffff0000ffffull) * 42949672960001ull) >> 32;
+    return true;
+}
+
+// Parses unsigned 32 bits decimal number, returns false if token isn't a number or it overflows
+inline bool ParseUint32(const char *p, std::size_t size, uint32_t &out) {
+    uint64_t high = 0, low;
+    if (size == 0 || size > 10) {
+        return false;
+    } else if (size <= 8) {
+        if (!ParseDigits(p, size, low)) {
+            return false;
+        }
+    } else if (!ParseDigits(p, size - 8, high) || !ParseDigits(p + size - 8, 8, low)) {
+        return false;
+    }
+
+    uint64_t value = high * 100000000ull + low;
+    if (value > UINT32_MAX) {
+        return false;
+    }
+    out = uint32_t(value);
+    return true;
+}
+
+// Parses unsigned 64 bits decimal number, returns false if token isn't a number or it overflows
+inline bool ParseUint64(const char *p, std::size_t size, uint64_t &out) {
+    if (size == 0 || size > 20) {
+        return false;
+    }
+
+    // Leading chunk takes whatever doesn't fit into full 8 digits chunks
+    uint64_t value = 0;
+    for (std::size_t chunk = (size - 1) % 8 + 1; size > 0; chunk = 8) {
+        uint64_t digits;
+        if (!ParseDigits(p, chunk, digits) || value > (UINT64_MAX - digits) / 100000000ull) {
+            return false;
+        }
+        value = value * 100000000ull + digits;
+        p += chunk;
+        size -= chunk;
+    }
+    out = value;
+    return true;
+}
+
+// Parses signed 32 bits decimal number, returns false if token isn't a number or it overflows
+inline bool ParseInt32(const char *p, std::size_t size, int32_t &out) {
+    bool negative = size > 0 && p[0] == '-';
+    uint32_t value;
+    if (!ParseUint32(p + negative, size - negative, value) || value > uint32_t(INT32_MAX) + negative) {
+        return false;
+    }
+    out = negative ? int32_t(-int64_t(value)) : int32_t(value);
+    return true;
+}
+
+} // namespace Scan
+} // namespace Protocol
+} // namespace Afina
+
+#endif // AFINA_PROTOCOL_SCAN_H
@@ -0,0 +1,251 @@
+#include "Session.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <afina/Storage.h>
+#include <afina/execute/Command.h>
+
+namespace Afina {
+namespace Protocol {
+
+// Limits are passed to std::min by reference, so they need definitions
+constexpr std::size_t Session::direct_body;
+constexpr std::size_t Session::max_prealloc;
+
+// See Session.h
+bool Session::Process(const char *input, std::size_t size, std::string &out) {
+    if (_held.empty()) {
+        return Consume(input, size, out);
+    }
+
+    // Input comes after the one held back, so it waits as well
+    _held.append(input, size);
+    return Resume(out);
+}
+
+// See Session.h
+bool Session::Resume(std::string &out) {
+    // Commands reference input in place, so it is moved out of the way of what is going to be held back next
+    std::string held;
+    held.swap(_held);
+    return Consume(held.data(), held.size(), out);
+}
+
+// See Session.h
+bool Session::Consume(const char *input, std::size_t size, std::string &out) {
+    // Single block of data readed from the socket could trigger inside actions a multiple times,
+    // for example:
+    // - read#0: [<command1 start>]
+    // - read#1: [<command1 end> <argument> <command2> <argument for command 2> <command3> ... ]
+    while (size > 0) {
+        // Responses formed are enough for now, the rest is executed once they are sent or there is budget for it
+        if (!_parsed && (out.size() >= _output_limit || (_budget == 0 && _hold_over_budget))) {
+            _held.assign(input, size);
+            return true;
+        }
+
+        if (!_parsed) {
+            std::size_t parsed = Parse(input, size);
+            input += parsed;
+            size -= parsed;
+            if (_mode == Mode::kBinary && _binary.Broken()) {
+                return false;
+            }
+        }
+
+        // There is command, but we still wait for argument to arrive...
+        if (_parsed && _arg_remains > 0) {
+            std::size_t to_read = std::min(_arg_remains, size);
+            if (_command != nullptr) {
+                if (_argument.size() == _arg_filled) {
+                    _argument.append(input, to_read);
+                } else {
+                    // Rest of the buffer preallocated by BodyBuffer
+                    _argument.resize(std::max(_argument.size(), _arg_filled + to_read));
+                    std::memcpy(&_argument[_arg_filled], input, to_read);
+                }
+                _arg_filled += to_read;
+            }
+            input += to_read;
+            size -= to_read;
+            _arg_remains -= to_read;
+        }
+
+        // There is command & argument - RUN!
+        if (_parsed && _arg_remains == 0) {
+            Execute(out);
+            if (_mode == Mode::kRedis && _redis.Broken()) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// See Session.h
+char *Session::BodyBuffer(std::size_t &size) {
+    if (!_parsed || _command == nullptr || _arg_remains < direct_body) {
+        return nullptr;
+    }
+
+    // Buffer is sized after the data block, but client could lie about its size, so that memory is committed
+    // by steps growing along with the data actually received
+    if (_argument.size() == _arg_filled) {
+        std::size_t step = std::max(_arg_filled, max_prealloc);
+        _argument.resize(_arg_filled + std::min(_arg_remains, step));
+    }
+    size = std::min(_argument.size() - _arg_filled, _arg_remains);
+    return &_argument[_arg_filled];
+}
+
+// See Session.h
+bool Session::BodyReceived(std::size_t size, std::string &out) {
+    _arg_filled += size;
+    _arg_remains -= size;
+    if (_arg_remains == 0) {
+        Execute(out);
+    }
+    return true;
+}
+
+// See Session.h
+std::size_t Session::Parse(const char *input, std::size_t size) {
+    if (_mode == Mode::kUnknown) {
+        _mode = uint8_t(input[0]) == BinaryParser::request_magic ? Mode::kBinary : Mode::kText;
+    }
+
+    std::size_t parsed = 0;
+    if (_mode == Mode::kText) {
+        if (_text.Parse(input, size, parsed)) {
+            _command = _text.Build(_arg_remains);
+            _parsed = true;
+            // Data block is followed by "\r\n", even empty one
+            if (_text.HasBody()) {
+                _arg_remains += 2;
+            }
+        }
+    } else if (_mode == Mode::kRedis) {
+        // Value is a part of the request, there is no data block to wait for
+        if (_redis.Parse(input, size, parsed)) {
+            StringRef value;
+            _command = _redis.Build(value);
+            _argument.assign(value.data(), value.size());
+            _arg_filled = _argument.size();
+            _parsed = true;
+        }
+    } else if (_binary.Parse(input, size, parsed)) {
+        _command = _binary.Build(_arg_remains);
+        _parsed = true;
+    }
+
+    // Large value gets its buffer at once rather than growing as the data arrives
+    if (_command != nullptr && _arg_remains >= direct_body) {
+        _argument.reserve(std::min(_arg_remains, max_prealloc));
+    }
+    return parsed;
+}
+
+// See Session.h
+void Session::Execute(std::string &out) {
+    _result.clear();
+    _argument.resize(_arg_filled);
+    if (_command != nullptr && _budget == 0) {
+        Reject(out);
+    } else if (_mode == Mode::kText) {
+        if (_command == nullptr) {
+            // Errors are reported even if client asked for no reply, as memcached does
+            out += _text.Error();
+            out += "\r\n";
+        } else if (_text.HasBody() &&
+                   (_argument.size() < 2 || _argument.compare(_argument.size() - 2, 2, "\r\n") != 0)) {
+            out += "CLIENT_ERROR bad data chunk\r\n";
+        } else {
+            // Data block is followed by "\r\n" which isn't part of the value itself
+            if (_text.HasBody()) {
+                _argument.resize(_argument.size() - 2);
+            }
+            _command->Execute(_storage, _argument, _result);
+            _budget--;
+        }
+        if (!_result.empty() && !_text.NoReply()) {
+            // First response of the batch takes over the buffer rather than being copied, it could carry
+            // a large value
+            if (out.empty()) {
+                out.swap(_result);
+            } else {
+                out += _result;
+            }
+            out += "\r\n";
+        }
+        _text.Reset();
+    } else if (_mode == Mode::kRedis) {
+        // Command working on several keys is executed once per key, it still counts as one
+        if (_command != nullptr) {
+            _command->Execute(_storage, _argument, _result);
+            _budget--;
+        }
+        while ((_command = _redis.Respond(_result, out)) != nullptr) {
+            _result.clear();
+            _command->Execute(_storage, _argument, _result);
+        }
+        _redis.Reset();
+    } else {
+        if (_command != nullptr) {
+            _command->Execute(_storage, _argument, _result);
+            _budget--;
+        }
+        _binary.Respond(_result, out);
+        _binary.Reset();
+    }
+
+    // Prepare for the next command, buffer of the huge value isn't kept for the connection lifetime
+    _parsed = false;
+    _command = nullptr;
+    _arg_filled = 0;
+    if (_argument.capacity() > max_prealloc) {
+        std::string().swap(_argument);
+    } else {
+        _argument.resize(0);
+    }
+}
+
+// See Session.h
+void Session::Reject(std::string &out) {
+    // Data block of the command has been read anyway, so stream goes on with the next command
+    if (_mode == Mode::kText) {
+        out += "SERVER_ERROR busy\r\n";
+        _text.Reset();
+    } else if (_mode == Mode::kRedis) {
+        out += "-BUSY server is busy, try again later\r\n";
+        _redis.Reset();
+    } else {
+        _binary.RespondBusy(out);
+        _binary.Reset();
+    }
+}
+
+// See Session.h
+void Session::Reset() {
+    _mode = _initial_mode;
+    _text.Restart();
+    _binary.Reset();
+    _redis.Restart();
+    _parsed = false;
+    _command = nullptr;
+    _arg_remains = 0;
+    _arg_filled = 0;
+    _budget = SIZE_MAX;
+    _hold_over_budget = false;
+    std::string().swap(_held);
+
+    // Buffer grown for a large data block isn't kept for the next connection
+    if (_argument.capacity() > direct_body) {
+        std::string().swap(_argument);
+    } else {
+        _argument.resize(0);
+    }
+}
+
+} // namespace Protocol
+} // namespace Afina
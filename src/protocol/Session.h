@@ -0,0 +1,177 @@
+#ifndef AFINA_PROTOCOL_SESSION_H
+#define AFINA_PROTOCOL_SESSION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "BinaryParser.h"
+#include "Parser.h"
+#include "RespParser.h"
+
+namespace Afina {
+
+class Storage;
+
+namespace Protocol {
+
+/**
+ * # Protocol side of the client connection
+ * Turns bytes received from the client into commands, executes them against the storage and forms
+ * responses. Memcached protocol is detected by the first byte of the connection: binary requests start with
+ * the magic byte, which is never a start of the text command. Redis clients are served on their own port,
+ * so session is told to speak RESP when it is created.
+ *
+ * Commands reference input in place, so session executes every command as soon as it is complete, before
+ * Process returns. Only incomplete command is kept between the calls, in parsers own buffers.
+ *
+ * Large data blocks could be read from the socket right into the argument buffer, see BodyBuffer, so that
+ * multi-megabyte values are neither copied through the read buffer nor reallocated chunk by chunk.
+ *
+ * Overloaded server could limit number of commands session executes, see SetBudget. Commands beyond the budget
+ * are answered with busy error of the protocol right away, client could retry them later. Or they are held back
+ * till server gives session more budget, if it serves clients by turns.
+ *
+ * Few bytes of commands could ask for megabytes of responses, so server could limit output of a single call as
+ * well, see SetOutputLimit. Once the limit is reached session stops between commands and holds the rest of
+ * the input back, server gets responses out and calls Resume to go on.
+ */
+class Session {
+public:
+    // Data blocks at least this large are worth reading directly, see BodyBuffer
+    static constexpr std::size_t direct_body = 16384;
+
+    // Largest part of the data block allocated ahead of the data itself
+    static constexpr std::size_t max_prealloc = 1 << 20;
+
+    /**
+     * @param storage to execute commands against
+     * @param redis true if clients speak Redis protocol, memcached otherwise
+     */
+    explicit Session(Storage &storage, bool redis = false)
+        : _storage(storage), _initial_mode(redis ? Mode::kRedis : Mode::kUnknown), _output_limit(SIZE_MAX) {
+        Reset();
+    }
+
+    /**
+     * Processes block of data received from the client. Responses on all commands completed by this block
+     * are appended to out, so that they could be sent at once. Malformed commands are answered with errors
+     * and stream goes on with the next command, as memcached does. Input held back is processed first, see
+     * SetOutputLimit
+     *
+     * @param input data received from the client
+     * @param size number of bytes in the input
+     * @param out buffer responses are appended to
+     * @return false if stream can't be resynchronized, like binary packet without magic or malformed RESP,
+     * connection should be closed then once out is sent
+     */
+    bool Process(const char *input, std::size_t size, std::string &out);
+
+    /**
+     * Returns buffer the next read from the client could go to bypassing Process, or nullptr if session
+     * doesn't wait for a large data block now. Buffer is a part of the command argument, allocated according
+     * to the size client declared for the data block
+     *
+     * @param size output parameter tells how many bytes could be written into the buffer
+     */
+    char *BodyBuffer(std::size_t &size);
+
+    /**
+     * Accounts bytes written into the buffer returned by BodyBuffer, command gets executed and its response
+     * is appended to out once data block is complete
+     *
+     * @return see Process
+     */
+    bool BodyReceived(std::size_t size, std::string &out);
+
+    /**
+     * Limits number of commands the following calls execute, the rest are rejected with busy error. Session
+     * has no limit till the first call
+     *
+     * @param hold if true commands beyond the budget are held back rather than rejected, see Held
+     */
+    inline void SetBudget(std::size_t commands, bool hold = false) {
+        _budget = commands;
+        _hold_over_budget = hold;
+    }
+
+    /**
+     * Returns how many commands could be executed yet within the budget
+     */
+    inline std::size_t Budget() const { return _budget; }
+
+    /**
+     * Makes Process and Resume stop once out grows to the given size, the rest of the input is held back by
+     * the session then. Session has no limit till the first call, limit is kept for the next connections
+     */
+    inline void SetOutputLimit(std::size_t bytes) { _output_limit = bytes; }
+
+    /**
+     * Returns true if there is input held back because of the output limit or the budget
+     */
+    inline bool Held() const { return !_held.empty(); }
+
+    /**
+     * Goes on with the input held back, as Process does
+     *
+     * @return see Process
+     */
+    bool Resume(std::string &out);
+
+    /**
+     * Forgets about the current connection, so that session could serve the next one
+     */
+    void Reset();
+
+private:
+    // Protocol client speaks, it is known after the first byte
+    enum class Mode : uint8_t { kUnknown, kText, kBinary, kRedis };
+
+    // Executes commands in the input till it is over or output limit is reached
+    bool Consume(const char *input, std::size_t size, std::string &out);
+
+    // Parses command out of the input, returns number of bytes consumed
+    std::size_t Parse(const char *input, std::size_t size);
+
+    // Executes complete command and appends response to the output
+    void Execute(std::string &out);
+
+    // Answers complete command with busy error instead of executing it
+    void Reject(std::string &out);
+
+    Storage &_storage;
+
+    const Mode _initial_mode;
+    Mode _mode;
+    Parser _text;
+    BinaryParser _binary;
+    RespParser _redis;
+
+    // Command has been parsed out, data block is being read for it
+    bool _parsed;
+
+    // Last command parsed out of stream, owned by the parser. Could be nullptr for binary requests
+    Execute::Command *_command;
+
+    // How many bytes to read from stream to get command argument and buffer for it. Buffer could be
+    // allocated ahead of the data, _arg_filled tells how much of it has been received
+    std::size_t _arg_remains;
+    std::size_t _arg_filled;
+    std::string _argument;
+
+    // Text output of the command, reused to avoid allocations
+    std::string _result;
+
+    // Commands to be executed yet, and whether those beyond are held back rather than rejected, see SetBudget
+    std::size_t _budget;
+    bool _hold_over_budget;
+
+    // Output a call forms before the rest of the input is held back in _held, see SetOutputLimit
+    std::size_t _output_limit;
+    std::string _held;
+};
+
+} // namespace Protocol
+} // namespace Afina
+
+#endif // AFINA_PROTOCOL_SESSION_H
@@ -0,0 +1,133 @@
+#ifndef AFINA_STORAGE_HASH_H
+#define AFINA_STORAGE_HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <string>
+
+#include <afina/StringRef.h>
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Keyed hash function for storage keys
+ * Implementation of wyhash (final version 4, public domain) algorithm. Hash is seeded per instance, so
+ * collisions could not be predicted by a client without knowing seed value. That makes hash flooding
+ * attacks on the storage index impractical.
+ *
+ * Algorithm is built around 64x64->128 multiplication and processes 48 bytes per round, which is faster
+ * than vectorized alternatives on keys of typical memcached size (up to 250 bytes).
+ */
+class WyHash {
+public:
+    explicit WyHash(uint64_t seed) : _seed(seed) {}
+
+    /**
+     * Creates hash with random seed, taken from system entropy source
+     */
+    static WyHash Random() {
+        std::random_device rd;
+        return WyHash((uint64_t(rd()) << 32) ^ rd());
+    }
+
+    inline uint64_t seed() const { return _seed; }
+
+    std::size_t operator()(StringRef key) const { return (*this)(key.data(), key.size()); }
+
+    std::size_t operator()(const char *data, std::size_t len) const {
+        const uint8_t *p = reinterpret_cast<const uint8_t *>(data);
+        uint64_t seed = _seed ^ mix(_seed ^ secret0, secret1);
+        uint64_t a, b;
+        if (len <= 16) {
+            if (len >= 4) {
+                a = (read4(p) << 32) | read4(p + ((len >> 3) << 2));
+                b = (read4(p + len - 4) << 32) | read4(p + len - 4 - ((len >> 3) << 2));
+            } else if (len > 0) {
+                a = read3(p, len);
+                b = 0;
+            } else {
+                a = b = 0;
+            }
+        } else {
+            std::size_t i = len;
+            if (i > 48) {
+                uint64_t see1 = seed, see2 = seed;
+                do {
+                    seed = mix(read8(p) ^ secret1, read8(p + 8) ^ seed);
+                    see1 = mix(read8(p + 16) ^ secret2, read8(p + 24) ^ see1);
+                    see2 = mix(read8(p + 32) ^ secret3, read8(p + 40) ^ see2);
+                    p += 48;
+                    i -= 48;
+                } while (i > 48);
+                seed ^= see1 ^ see2;
+            }
+            while (i > 16) {
+                seed = mix(read8(p) ^ secret1, read8(p + 8) ^ seed);
+                i -= 16;
+                p += 16;
+            }
+            a = read8(p + i - 16);
+            b = read8(p + i - 8);
+        }
+        a ^= secret1;
+        b ^= seed;
+        mum(a, b);
+        return mix(a ^ secret0 ^ len, b ^ secret1);
+    }
+
+private:
+    // Default wyhash secret
+    static constexpr uint64_t secret0 = 0x2d358dccaa6c78a5ull;
+    static constexpr uint64_t secret1 = 0x8bb84b93962eacc9ull;
+    static constexpr uint64_t secret2 = 0x4b33a62ed433d4a3ull;
+    static constexpr uint64_t secret3 = 0x4d5a2da51de1aa47ull;
+
+    // 128 bits product of A and B, low half goes to A, high half to B
+    static inline void mum(uint64_t &A, uint64_t &B) {
+#ifdef __SIZEOF_INT128__
+        __uint128_t r = A;
+        r *= B;
+        A = uint64_t(r);
+        B = uint64_t(r >> 64);
+#else
+        uint64_t ha = A >> 32, hb = B >> 32, la = uint32_t(A), lb = uint32_t(B);
+        uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb, t = rl + (rm0 << 32);
+        uint64_t c = t < rl;
+        uint64_t lo = t + (rm1 << 32);
+        c += lo < t;
+        A = lo;
+        B = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+    }
+
+    static inline uint64_t mix(uint64_t A, uint64_t B) {
+        mum(A, B);
+        return A ^ B;
+    }
+
+    static inline uint64_t read8(const uint8_t *p) {
+        uint64_t v;
+        std::memcpy(&v, p, 8);
+        return v;
+    }
+
+    static inline uint64_t read4(const uint8_t *p) {
+        uint32_t v;
+        std::memcpy(&v, p, 4);
+        return v;
+    }
+
+    static inline uint64_t read3(const uint8_t *p, std::size_t k) {
+        return (uint64_t(p[0]) << 16) | (uint64_t(p[k >> 1]) << 8) | p[k - 1];
+    }
+
+    uint64_t _seed;
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_HASH_H
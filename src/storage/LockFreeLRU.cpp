@@ -0,0 +1,614 @@
+#include "LockFreeLRU.h"
+
+namespace Afina {
+namespace Backend {
+
+namespace {
+
+// Reverses order of bits in the word
+inline uint64_t Reverse(uint64_t v) {
+    v = ((v >> 1) & 0x5555555555555555ull) | ((v & 0x5555555555555555ull) << 1);
+    v = ((v >> 2) & 0x3333333333333333ull) | ((v & 0x3333333333333333ull) << 2);
+    v = ((v >> 4) & 0x0f0f0f0f0f0f0f0full) | ((v & 0x0f0f0f0f0f0f0f0full) << 4);
+    return __builtin_bswap64(v);
+}
+
+// Number of buckets storage starts with
+constexpr std::size_t initial_buckets = 16;
+
+} // namespace
+
+// See LockFreeLRU.h
+LockFreeLRU::LockFreeLRU(size_t max_size, WyHash hash)
+    : _max_size(max_size), _hash(hash), _buckets_count(initial_buckets), _items_count(0), _storage_size(0),
+      _clock_hand(0), _cas(0) {
+    for (auto &segment : _segments) {
+        segment.store(nullptr, std::memory_order_relaxed);
+    }
+    BucketSlot(0).store(new Node(DummyKey(0)), std::memory_order_release);
+}
+
+// See LockFreeLRU.h
+LockFreeLRU::~LockFreeLRU() {
+    // Nodes that are still linked, including marked ones, are owned by the list. Unlinked ones are
+    // freed by the epoch domain
+    Node *node = BucketSlot(0).load(std::memory_order_relaxed);
+    while (node != nullptr) {
+        Node *next = Ptr(node->next.load(std::memory_order_relaxed));
+        delete node;
+        node = next;
+    }
+
+    for (auto &segment : _segments) {
+        delete[] segment.load(std::memory_order_relaxed);
+    }
+}
+
+// See MapBasedGlobalLockImpl.h
+void LockFreeLRU::Stop() { DeliverEvicted(true); }
+
+// See MapBasedGlobalLockImpl.h
+bool LockFreeLRU::Put(StringRef key, const std::string &value, uint32_t flags, int32_t expire) {
+    Item *item = MakeItem(key, value, flags);
+    if (item == nullptr) {
+        return false;
+    }
+
+    uint64_t hash = _hash(key);
+    std::time_t now = Now();
+    std::time_t expire_at = ExpireAt(expire, now);
+    {
+        Concurrency::EpochDomain::Guard guard(_epoch);
+        while (true) {
+            Node *start = Bucket(hash);
+            Node *found = Lookup(start, RegularKey(hash), key, now);
+            if (found != nullptr) {
+                if (Replace(found, item, expire_at)) {
+                    break;
+                }
+                // Node has been deleted concurrently and item is gone with it
+                item = MakeItem(key, value, flags);
+                continue;
+            }
+
+            Node *node = new Node(RegularKey(hash), key, item, expire_at);
+            if (Publish(start, node)) {
+                break;
+            }
+
+            // Someone has inserted the same key first, node wasn't published so item could be reused
+            node->item.store(nullptr, std::memory_order_relaxed);
+            delete node;
+        }
+        Evict(now);
+    }
+    DeliverEvicted(false);
+    return true;
+}
+
+// See MapBasedGlobalLockImpl.h
+bool LockFreeLRU::PutIfAbsent(StringRef key, const std::string &value, uint32_t flags, int32_t expire) {
+    Item *item = MakeItem(key, value, flags);
+    if (item == nullptr) {
+        return false;
+    }
+
+    uint64_t hash = _hash(key);
+    std::time_t now = Now();
+    {
+        Concurrency::EpochDomain::Guard guard(_epoch);
+        Node *start = Bucket(hash);
+        while (true) {
+            if (Lookup(start, RegularKey(hash), key, now) != nullptr) {
+                delete item;
+                return false;
+            }
+
+            Node *node = new Node(RegularKey(hash), key, item, ExpireAt(expire, now));
+            if (Publish(start, node)) {
+                break;
+            }
+
+            // Existing node could be expired already, lookup will tell
+            node->item.store(nullptr, std::memory_order_relaxed);
+            delete node;
+        }
+        Evict(now);
+    }
+    DeliverEvicted(false);
+    return true;
+}
+
+// See MapBasedGlobalLockImpl.h
+bool LockFreeLRU::Set(StringRef key, const std::string &value, uint32_t flags, int32_t expire) {
+    Item *item = MakeItem(key, value, flags);
+    if (item == nullptr) {
+        return false;
+    }
+
+    uint64_t hash = _hash(key);
+    std::time_t now = Now();
+    bool result;
+    {
+        Concurrency::EpochDomain::Guard guard(_epoch);
+        Node *found = Lookup(Bucket(hash), RegularKey(hash), key, now);
+        if (found == nullptr) {
+            delete item;
+            return false;
+        }
+
+        // Deleted concurrently means there is no such key anymore
+        result = Replace(found, item, ExpireAt(expire, now));
+        Evict(now);
+    }
+    DeliverEvicted(false);
+    return result;
+}
+
+// See MapBasedGlobalLockImpl.h
+bool LockFreeLRU::Delete(StringRef key) {
+    uint64_t hash = _hash(key);
+    Concurrency::EpochDomain::Guard guard(_epoch);
+    Node *start = Bucket(hash);
+    Node *found = Lookup(start, RegularKey(hash), key, Now());
+    return found != nullptr && Remove(start, found, false);
+}
+
+// See MapBasedGlobalLockImpl.h
+bool LockFreeLRU::Get(StringRef key, std::string &value, uint32_t *flags, int32_t *expire) {
+    uint64_t hash = _hash(key);
+    std::time_t now = Now();
+    Concurrency::EpochDomain::Guard guard(_epoch);
+    Node *found = Lookup(Bucket(hash), RegularKey(hash), key, now);
+    if (found == nullptr) {
+        return false;
+    }
+
+    Item *item = found->item.load(std::memory_order_acquire);
+    if (item == nullptr) {
+        return false;
+    }
+
+    value = item->value;
+    if (flags != nullptr) {
+        *flags = item->flags;
+    }
+    if (expire != nullptr) {
+        std::time_t expire_at = found->expire_at.load(std::memory_order_relaxed);
+        *expire = expire_at == 0 ? 0 : int32_t(expire_at - now);
+    }
+
+    // Avoid writing shared cache line if bit is set already
+    if (!found->referenced.load(std::memory_order_relaxed)) {
+        found->referenced.store(true, std::memory_order_relaxed);
+    }
+    return true;
+}
+
+// See SimpleLRU.h
+bool LockFreeLRU::Touch(StringRef key, int32_t expire) {
+    uint64_t hash = _hash(key);
+    std::time_t now = Now();
+    Concurrency::EpochDomain::Guard guard(_epoch);
+    Node *found = Lookup(Bucket(hash), RegularKey(hash), key, now);
+    if (found == nullptr) {
+        return false;
+    }
+
+    found->expire_at.store(ExpireAt(expire, now), std::memory_order_relaxed);
+    found->referenced.store(true, std::memory_order_relaxed);
+    return true;
+}
+
+// See SimpleLRU.h
+bool LockFreeLRU::GetAndTouch(StringRef key, int32_t expire, std::string &value, uint32_t *flags) {
+    uint64_t hash = _hash(key);
+    std::time_t now = Now();
+    Concurrency::EpochDomain::Guard guard(_epoch);
+    Node *found = Lookup(Bucket(hash), RegularKey(hash), key, now);
+    if (found == nullptr) {
+        return false;
+    }
+
+    Item *item = found->item.load(std::memory_order_acquire);
+    if (item == nullptr) {
+        return false;
+    }
+
+    value = item->value;
+    if (flags != nullptr) {
+        *flags = item->flags;
+    }
+    found->expire_at.store(ExpireAt(expire, now), std::memory_order_relaxed);
+    found->referenced.store(true, std::memory_order_relaxed);
+    return true;
+}
+
+// See SimpleLRU.h
+bool LockFreeLRU::Update(StringRef key, ItemUpdater &updater, uint64_t *cas) {
+    uint64_t hash = _hash(key);
+    std::time_t now = Now();
+    bool result = false;
+    uint64_t result_cas = 0;
+    {
+        Concurrency::EpochDomain::Guard guard(_epoch);
+        while (true) {
+            Node *start = Bucket(hash);
+            Node *found = Lookup(start, RegularKey(hash), key, now);
+            Item *item = found != nullptr ? found->item.load(std::memory_order_acquire) : nullptr;
+
+            ItemState state;
+            if (item != nullptr) {
+                std::time_t expire_at = found->expire_at.load(std::memory_order_relaxed);
+                state.value = &item->value;
+                state.flags = item->flags;
+                state.ttl = expire_at == 0 ? -1 : int32_t(expire_at - now);
+                state.cas = item->cas;
+                state.stale = item->stale;
+                state.win_sent = item->win_sent;
+            }
+
+            // Every change is conditional on the item updater has seen, otherwise updater is asked again
+            ItemUpdate update;
+            ItemUpdater::Action action = updater.Apply(item != nullptr ? &state : nullptr, update);
+            if (action == ItemUpdater::Action::kKeep) {
+                result = item != nullptr;
+                result_cas = result ? item->cas : 0;
+                break;
+            } else if (action == ItemUpdater::Action::kDelete) {
+                if (item == nullptr || RemoveIf(start, found, item)) {
+                    result = item != nullptr;
+                    break;
+                }
+                continue;
+            } else if (update.value == nullptr && item == nullptr) {
+                break;
+            }
+
+            // Marks change keeps value and CAS token, but item is immutable so it is copied anyway
+            Item *fresh = update.value == nullptr
+                              ? new Item(item->value, item->flags, item->cas, update.stale, update.win_sent)
+                              : MakeItem(key, *update.value, update.flags, update.stale, update.win_sent);
+            if (fresh == nullptr) {
+                break;
+            }
+            result_cas = fresh->cas;
+
+            if (item != nullptr) {
+                if (ReplaceIf(found, item, fresh, update.touch, ExpireAt(update.expire, now))) {
+                    result = true;
+                    break;
+                }
+                continue;
+            }
+
+            Node *node = new Node(RegularKey(hash), key, fresh, ExpireAt(update.expire, now));
+            if (Publish(start, node)) {
+                result = true;
+                break;
+            }
+            delete node;
+        }
+        Evict(now);
+    }
+    DeliverEvicted(false);
+
+    if (result && cas != nullptr) {
+        *cas = result_cas;
+    }
+    return result;
+}
+
+// See LockFreeLRU.h
+uint64_t LockFreeLRU::RegularKey(uint64_t hash) { return Reverse(hash) | 1; }
+
+// See LockFreeLRU.h
+uint64_t LockFreeLRU::DummyKey(uint64_t bucket) { return Reverse(bucket); }
+
+// See LockFreeLRU.h
+std::atomic<LockFreeLRU::Node *> &LockFreeLRU::BucketSlot(uint64_t bucket) {
+    std::size_t segment = bucket == 0 ? 0 : 64 - __builtin_clzll(bucket);
+    std::size_t base = segment == 0 ? 0 : std::size_t(1) << (segment - 1);
+    std::size_t size = segment == 0 ? 1 : base;
+
+    std::atomic<Node *> *slots = _segments[segment].load(std::memory_order_acquire);
+    if (slots == nullptr) {
+        std::atomic<Node *> *fresh = new std::atomic<Node *>[size];
+        for (std::size_t i = 0; i < size; i++) {
+            fresh[i].store(nullptr, std::memory_order_relaxed);
+        }
+
+        if (_segments[segment].compare_exchange_strong(slots, fresh)) {
+            slots = fresh;
+        } else {
+            delete[] fresh;
+        }
+    }
+    return slots[bucket - base];
+}
+
+// See LockFreeLRU.h
+LockFreeLRU::Node *LockFreeLRU::Bucket(uint64_t hash) {
+    uint64_t bucket = hash & (_buckets_count.load(std::memory_order_acquire) - 1);
+    Node *start = BucketSlot(bucket).load(std::memory_order_acquire);
+    if (start == nullptr) {
+        start = InitBucket(bucket);
+    }
+    return start;
+}
+
+// See LockFreeLRU.h
+LockFreeLRU::Node *LockFreeLRU::InitBucket(uint64_t bucket) {
+    // Parent bucket is the one this bucket has been split from, it precedes new one in the list
+    uint64_t parent = bucket & ~(uint64_t(1) << (63 - __builtin_clzll(bucket)));
+    Node *start = BucketSlot(parent).load(std::memory_order_acquire);
+    if (start == nullptr) {
+        start = InitBucket(parent);
+    }
+
+    Node *dummy = new Node(DummyKey(bucket));
+    Node *found = Insert(start, dummy);
+    if (found != dummy) {
+        delete dummy;
+    }
+    BucketSlot(bucket).store(found, std::memory_order_release);
+    return found;
+}
+
+// See LockFreeLRU.h
+bool LockFreeLRU::Find(Node *start, uint64_t so_key, const StringRef *key, Link *&prev, Node *&curr) {
+    while (true) {
+        prev = &start->next;
+        curr = Ptr(prev->load(std::memory_order_acquire));
+
+        bool restart = false;
+        while (curr != nullptr) {
+            uintptr_t next = curr->next.load(std::memory_order_acquire);
+            if (Marked(next)) {
+                // Help to unlink deleted node, whoever succeeds frees it
+                uintptr_t expected = reinterpret_cast<uintptr_t>(curr);
+                if (!prev->compare_exchange_strong(expected, next & ~uintptr_t(1))) {
+                    restart = true;
+                    break;
+                }
+                _epoch.Retire(curr);
+                curr = Ptr(next);
+                continue;
+            }
+
+            if (curr->so_key > so_key) {
+                return false;
+            } else if (curr->so_key == so_key) {
+                // Dummy nodes have unique keys, regular ones could collide
+                int cmp = key == nullptr ? 0 : StringRef(curr->key).compare(*key);
+                if (cmp >= 0) {
+                    return cmp == 0;
+                }
+            }
+
+            prev = &curr->next;
+            curr = Ptr(next);
+        }
+
+        if (!restart) {
+            return false;
+        }
+    }
+}
+
+// See LockFreeLRU.h
+LockFreeLRU::Node *LockFreeLRU::Insert(Node *start, Node *node) {
+    StringRef node_key(node->key);
+    const StringRef *key = (node->so_key & 1) ? &node_key : nullptr;
+    while (true) {
+        Link *prev;
+        Node *curr;
+        if (Find(start, node->so_key, key, prev, curr)) {
+            return curr;
+        }
+
+        node->next.store(reinterpret_cast<uintptr_t>(curr), std::memory_order_relaxed);
+        uintptr_t expected = reinterpret_cast<uintptr_t>(curr);
+        if (prev->compare_exchange_strong(expected, reinterpret_cast<uintptr_t>(node))) {
+            return node;
+        }
+    }
+}
+
+// See LockFreeLRU.h
+bool LockFreeLRU::Publish(Node *start, Node *node) {
+    // Once published node could be deleted at any moment, so it gets accounted in advance for
+    // counters to never go below zero
+    std::size_t size = node->key.size() + node->item.load(std::memory_order_relaxed)->value.size();
+    std::size_t count = _items_count.fetch_add(1) + 1;
+    _storage_size.fetch_add(size);
+    if (Insert(start, node) != node) {
+        _items_count.fetch_sub(1);
+        _storage_size.fetch_sub(size);
+        return false;
+    }
+
+    // Grow bucket array once buckets get too long, new buckets are initialized lazily
+    std::size_t buckets = _buckets_count.load(std::memory_order_relaxed);
+    if (count > buckets * load_factor && buckets < (std::size_t(1) << (segments_count - 1))) {
+        _buckets_count.compare_exchange_strong(buckets, buckets * 2);
+    }
+    return true;
+}
+
+// See LockFreeLRU.h
+LockFreeLRU::Node *LockFreeLRU::Lookup(Node *start, uint64_t so_key, StringRef key, std::time_t now) {
+    Link *prev;
+    Node *curr;
+    if (!Find(start, so_key, &key, prev, curr)) {
+        return nullptr;
+    }
+
+    std::time_t expire_at = curr->expire_at.load(std::memory_order_relaxed);
+    if (expire_at != 0 && expire_at <= now) {
+        Remove(start, curr, false);
+        return nullptr;
+    }
+    return curr;
+}
+
+// See LockFreeLRU.h
+bool LockFreeLRU::Remove(Node *start, Node *node, bool evicted) {
+    uintptr_t next = node->next.load(std::memory_order_acquire);
+    do {
+        if (Marked(next)) {
+            return false;
+        }
+    } while (!node->next.compare_exchange_weak(next, next | 1));
+
+    // Node is logically deleted by this thread, so it is the one to take the item out
+    _items_count.fetch_sub(1);
+    Item *item = node->item.exchange(nullptr);
+    if (item != nullptr) {
+        _storage_size.fetch_sub(node->key.size() + item->value.size());
+        if (evicted && _eviction_listener) {
+            // Readers could still see item, so it is copied rather than moved
+            std::lock_guard<std::mutex> guard(_evicted_lock);
+            _evicted.push_back(EvictedItem{node->key, item->value, item->flags});
+        }
+        _epoch.Retire(item);
+    } else {
+        _storage_size.fetch_sub(node->key.size());
+    }
+
+    // Find unlinks all deleted nodes on its way
+    Link *prev;
+    Node *curr;
+    StringRef key(node->key);
+    Find(start, node->so_key, &key, prev, curr);
+    return true;
+}
+
+// See LockFreeLRU.h
+bool LockFreeLRU::Replace(Node *node, Item *item, std::time_t expire_at) {
+    // Expiration time goes first, so that new value is never seen with the old one
+    node->expire_at.store(expire_at, std::memory_order_relaxed);
+    _storage_size.fetch_add(item->value.size());
+
+    Item *old = node->item.exchange(item);
+    if (old != nullptr) {
+        _storage_size.fetch_sub(old->value.size());
+        _epoch.Retire(old);
+    }
+
+    if (old == nullptr || Marked(node->next.load(std::memory_order_acquire))) {
+        // Node has been deleted, whatever item is there now would never be taken by the deleter
+        Item *orphan = node->item.exchange(nullptr);
+        if (orphan != nullptr) {
+            _storage_size.fetch_sub(orphan->value.size());
+            _epoch.Retire(orphan);
+        }
+        return false;
+    }
+
+    node->referenced.store(true, std::memory_order_relaxed);
+    return true;
+}
+
+// See LockFreeLRU.h
+bool LockFreeLRU::ReplaceIf(Node *node, Item *expected, Item *item, bool touch, std::time_t expire_at) {
+    _storage_size.fetch_add(item->value.size());
+    if (!node->item.compare_exchange_strong(expected, item)) {
+        _storage_size.fetch_sub(item->value.size());
+        delete item;
+        return false;
+    }
+
+    if (touch) {
+        node->expire_at.store(expire_at, std::memory_order_relaxed);
+    }
+    _storage_size.fetch_sub(expected->value.size());
+    _epoch.Retire(expected);
+
+    // Deleter could have marked node before the exchange, see Replace
+    if (Marked(node->next.load(std::memory_order_acquire))) {
+        Item *orphan = node->item.exchange(nullptr);
+        if (orphan != nullptr) {
+            _storage_size.fetch_sub(orphan->value.size());
+            _epoch.Retire(orphan);
+        }
+        return false;
+    }
+
+    node->referenced.store(true, std::memory_order_relaxed);
+    return true;
+}
+
+// See LockFreeLRU.h
+bool LockFreeLRU::RemoveIf(Node *start, Node *node, Item *expected) {
+    // Taking item out first makes node look deleted for everyone, Remove then accounts key only
+    if (!node->item.compare_exchange_strong(expected, nullptr)) {
+        return false;
+    }
+    _storage_size.fetch_sub(expected->value.size());
+    _epoch.Retire(expected);
+
+    // Node could be marked by evictor meanwhile, item is taken out by this thread anyway
+    Remove(start, node, false);
+    return true;
+}
+
+// See LockFreeLRU.h
+void LockFreeLRU::Evict(std::time_t now) {
+    // Two full sweeps are enough to find a victim: the first one clears all reference bits
+    std::size_t sweeps = 2 * _buckets_count.load(std::memory_order_relaxed) + 1;
+    while (_storage_size.load(std::memory_order_relaxed) > _max_size && sweeps-- > 0) {
+        std::size_t buckets = _buckets_count.load(std::memory_order_acquire);
+        uint64_t bucket = _clock_hand.fetch_add(1, std::memory_order_relaxed) & (buckets - 1);
+        Node *start = BucketSlot(bucket).load(std::memory_order_acquire);
+        if (start == nullptr) {
+            start = InitBucket(bucket);
+        }
+
+        // Bucket ends where next dummy node starts
+        Node *node = Ptr(start->next.load(std::memory_order_acquire));
+        while (node != nullptr && (node->so_key & 1) && _storage_size.load(std::memory_order_relaxed) > _max_size) {
+            uintptr_t next = node->next.load(std::memory_order_acquire);
+            if (!Marked(next)) {
+                std::time_t expire_at = node->expire_at.load(std::memory_order_relaxed);
+                bool expired = expire_at != 0 && expire_at <= now;
+                if (expired || !node->referenced.load(std::memory_order_relaxed)) {
+                    Remove(start, node, !expired);
+                } else {
+                    node->referenced.store(false, std::memory_order_relaxed);
+                }
+            }
+            // Memory of unlinked node stays valid under the guard, as well as its next pointer
+            node = Ptr(node->next.load(std::memory_order_acquire));
+        }
+    }
+}
+
+// See LockFreeLRU.h
+LockFreeLRU::Item *LockFreeLRU::MakeItem(StringRef key, const std::string &value, uint32_t flags, bool stale,
+                                         bool win_sent) {
+    if (key.size() + value.size() > _max_size) {
+        return nullptr;
+    }
+    return new Item(value, flags, _cas.fetch_add(1, std::memory_order_relaxed) + 1, stale, win_sent);
+}
+
+// See LockFreeLRU.h
+void LockFreeLRU::DeliverEvicted(bool force) {
+    if (!_eviction_listener) {
+        return;
+    }
+
+    std::vector<EvictedItem> batch;
+    {
+        std::lock_guard<std::mutex> guard(_evicted_lock);
+        if (_evicted.empty() || (!force && _evicted.size() < _eviction_batch)) {
+            return;
+        }
+        batch.swap(_evicted);
+    }
+    _eviction_listener->OnEvict(std::move(batch));
+}
+
+} // namespace Backend
+} // namespace Afina
@@ -0,0 +1,212 @@
+#ifndef AFINA_STORAGE_LOCK_FREE_LRU_H
+#define AFINA_STORAGE_LOCK_FREE_LRU_H
+
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <afina/Storage.h>
+#include <afina/concurrency/Epoch.h>
+
+#include "Hash.h"
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Lock-free storage
+ * Index is a split-ordered list (Shalev, Shavit): single lock-free linked list of all items, sorted by
+ * bit reversed hash, plus an array of shortcuts into that list, one per bucket. Bucket array grows by
+ * doubling without moving any item: new bucket gets linked in the middle of its parent bucket.
+ *
+ * List nodes are removed in two steps Harris-Michael way: node is marked as deleted by setting lowest
+ * bit of its next pointer and then unlinked by whoever finds it first. Unlinked nodes and replaced
+ * values are freed through Concurrency::EpochDomain, so readers never block and never take a lock,
+ * even while writers evict or overwrite items they are reading.
+ *
+ * Eviction is approximated by CLOCK algorithm over buckets: every read sets the reference bit, writer
+ * which runs out of space sweeps buckets clearing reference bits and evicts first item found without
+ * one. Size limit is therefore soft: concurrent writers could exceed it for a moment.
+ *
+ * Only eviction listener buffer is guarded by a mutex, that path is never taken by readers.
+ */
+class LockFreeLRU : public Afina::Storage {
+public:
+    LockFreeLRU(size_t max_size = 1024) : LockFreeLRU(max_size, WyHash::Random()) {}
+
+    LockFreeLRU(size_t max_size, WyHash hash);
+
+    virtual ~LockFreeLRU();
+
+    // Implements Afina::Storage interface
+    void Stop() override;
+
+    // Implements Afina::Storage interface
+    bool Put(StringRef key, const std::string &value, uint32_t flags = 0, int32_t expire = 0) override;
+
+    // Implements Afina::Storage interface
+    bool PutIfAbsent(StringRef key, const std::string &value, uint32_t flags = 0,
+                     int32_t expire = 0) override;
+
+    // Implements Afina::Storage interface
+    bool Set(StringRef key, const std::string &value, uint32_t flags = 0, int32_t expire = 0) override;
+
+    // Implements Afina::Storage interface
+    bool Delete(StringRef key) override;
+
+    // Implements Afina::Storage interface
+    bool Get(StringRef key, std::string &value, uint32_t *flags = nullptr,
+             int32_t *expire = nullptr) override;
+
+    // Implements Afina::Storage interface
+    bool Touch(StringRef key, int32_t expire) override;
+
+    // Implements Afina::Storage interface
+    bool GetAndTouch(StringRef key, int32_t expire, std::string &value, uint32_t *flags = nullptr) override;
+
+    // Implements Afina::Storage interface
+    bool Update(StringRef key, ItemUpdater &updater, uint64_t *cas = nullptr) override;
+
+protected:
+    // Current time used to check items expiration
+    virtual std::time_t Now() const { return std::time(nullptr); }
+
+private:
+    // Value stored for the key, never changed once published. Even marks change replaces item as a whole,
+    // so that conditional updates are a single compare and swap of the item pointer
+    struct Item {
+        Item(const std::string &value, uint32_t flags, uint64_t cas, bool stale = false, bool win_sent = false)
+            : value(value), flags(flags), cas(cas), stale(stale), win_sent(win_sent) {}
+        const std::string value;
+        const uint32_t flags;
+        const uint64_t cas;
+        // See Afina::ItemState
+        const bool stale;
+        const bool win_sent;
+    };
+
+    // Node of the split-ordered list, either bucket start (dummy) or a regular one carrying the key
+    struct Node {
+        explicit Node(uint64_t so_key) : so_key(so_key), next(0), item(nullptr), expire_at(0), referenced(false) {}
+
+        Node(uint64_t so_key, StringRef key, Item *item, std::time_t expire_at)
+            : so_key(so_key), key(key.data(), key.size()), next(0), item(item), expire_at(expire_at), referenced(true) {}
+
+        ~Node() { delete item.load(std::memory_order_relaxed); }
+
+        // Bit reversed hash, lowest bit is set for regular nodes only
+        const uint64_t so_key;
+        const std::string key;
+
+        // Next node in the list, lowest bit is set once node is logically deleted
+        std::atomic<uintptr_t> next;
+
+        // Current value, replaced as a whole. Set to nullptr by the thread that deletes the node
+        std::atomic<Item *> item;
+
+        // Absolute time item expires at, 0 if it never expires
+        std::atomic<std::time_t> expire_at;
+
+        // CLOCK reference bit
+        std::atomic<bool> referenced;
+    };
+
+    using Link = std::atomic<uintptr_t>;
+
+    // Number of bucket array segments, segment i > 0 has 2^(i-1) buckets
+    static constexpr std::size_t segments_count = 48;
+
+    // Average number of items per bucket that triggers bucket array growth
+    static constexpr std::size_t load_factor = 2;
+
+    // Split order key of regular node and bucket dummy node
+    static uint64_t RegularKey(uint64_t hash);
+    static uint64_t DummyKey(uint64_t bucket);
+
+    // Pointer part of the link and the deleted mark
+    static inline Node *Ptr(uintptr_t link) { return reinterpret_cast<Node *>(link & ~uintptr_t(1)); }
+    static inline bool Marked(uintptr_t link) { return (link & 1) != 0; }
+
+    // Returns slot of the bucket in array, allocates segment if needed
+    std::atomic<Node *> &BucketSlot(uint64_t bucket);
+
+    // Returns dummy node for the given hash, initializes bucket if needed
+    Node *Bucket(uint64_t hash);
+
+    // Links dummy node for the bucket into the list
+    Node *InitBucket(uint64_t bucket);
+
+    // Looks for the position of the given key starting from the node, unlinks deleted nodes on the way.
+    // Returns true if key has been found, on return prev points to the link curr has been taken from
+    bool Find(Node *start, uint64_t so_key, const StringRef *key, Link *&prev, Node *&curr);
+
+    // Links node into the list, returns node with the same key if it is in the list already
+    Node *Insert(Node *start, Node *node);
+
+    // Links new regular node into the list and accounts it, grows bucket array if needed. Returns false
+    // if node with the same key is in the list already, node is not published then
+    bool Publish(Node *start, Node *node);
+
+    // Looks up node with the given key which is neither deleted nor expired, expired one gets removed
+    Node *Lookup(Node *start, uint64_t so_key, StringRef key, std::time_t now);
+
+    // Marks node as deleted and unlinks it. Returns false if node has been deleted by someone else
+    bool Remove(Node *start, Node *node, bool evicted);
+
+    // Installs new item into existing node. Returns false if node has been deleted meanwhile
+    bool Replace(Node *node, Item *item, std::time_t expire_at);
+
+    // Installs new item into existing node if it still holds the expected one, item is deleted otherwise.
+    // Expiration time is changed only on success and only if touch is set
+    bool ReplaceIf(Node *node, Item *expected, Item *item, bool touch, std::time_t expire_at);
+
+    // Deletes node if it still holds the expected item
+    bool RemoveIf(Node *start, Node *node, Item *expected);
+
+    // Evicts items until storage fits into limit
+    void Evict(std::time_t now);
+
+    // Creates item for the given value, returns nullptr if pair doesn't fit into storage at all
+    Item *MakeItem(StringRef key, const std::string &value, uint32_t flags, bool stale = false,
+                   bool win_sent = false);
+
+    // Notifies listener about evicted items if batch is full or force is set
+    void DeliverEvicted(bool force);
+
+    // Maximum number of bytes could be stored in this cache, i.e all (keys+values)
+    const std::size_t _max_size;
+
+    // Seeded hash function used to build index keys
+    const WyHash _hash;
+
+    // Reclamation of unlinked nodes and replaced items
+    Concurrency::EpochDomain _epoch;
+
+    // Bucket array, split into segments of growing size so that it never moves
+    std::atomic<std::atomic<Node *> *> _segments[segments_count];
+
+    // Current number of buckets, power of 2
+    std::atomic<std::size_t> _buckets_count;
+
+    // Number of items and number of bytes in keys and values
+    std::atomic<std::size_t> _items_count;
+    std::atomic<std::size_t> _storage_size;
+
+    // CLOCK hand, next bucket to sweep
+    std::atomic<std::size_t> _clock_hand;
+
+    // Last CAS token given to an item
+    std::atomic<uint64_t> _cas;
+
+    // Items evicted but not yet passed to the eviction listener
+    std::mutex _evicted_lock;
+    std::vector<EvictedItem> _evicted;
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_LOCK_FREE_LRU_H
@@ -4,104 +4,415 @@ namespace Afina {
 namespace Backend {
 
 // See MapBasedGlobalLockImpl.h
-bool SimpleLRU::Put(const std::string &key, const std::string &value) {
-    std::size_t pair_size = key.size() + value.size();
-    if (pair_size > _max_size) {
-        return false;
+void SimpleLRU::Stop() {
+    std::vector<EvictedItem> batch;
+    if (TakeEvicted(batch, true)) {
+        NotifyEvicted(std::move(batch));
     }
-    auto it = _lru_index.find(key);
+}
+
+// See MapBasedGlobalLockImpl.h
+bool SimpleLRU::Put(StringRef key, const std::string &value, uint32_t flags, int32_t expire) {
+    bool result = DoPut(MakeKey(key), value, flags, expire);
+    DeliverEvicted();
+    return result;
+}
+
+// See MapBasedGlobalLockImpl.h
+bool SimpleLRU::PutIfAbsent(StringRef key, const std::string &value, uint32_t flags, int32_t expire) {
+    bool result = DoPutIfAbsent(MakeKey(key), value, flags, expire);
+    DeliverEvicted();
+    return result;
+}
+
+// See MapBasedGlobalLockImpl.h
+bool SimpleLRU::Set(StringRef key, const std::string &value, uint32_t flags, int32_t expire) {
+    bool result = DoSet(MakeKey(key), value, flags, expire);
+    DeliverEvicted();
+    return result;
+}
+
+// See MapBasedGlobalLockImpl.h
+bool SimpleLRU::Delete(StringRef key) { return DoDelete(MakeKey(key)); }
+
+// See MapBasedGlobalLockImpl.h
+bool SimpleLRU::Get(StringRef key, std::string &value, uint32_t *flags, int32_t *expire) {
+    return DoGet(MakeKey(key), value, flags, expire);
+}
+
+// See SimpleLRU.h
+bool SimpleLRU::Touch(StringRef key, int32_t expire) { return DoTouch(MakeKey(key), expire); }
+
+// See SimpleLRU.h
+bool SimpleLRU::GetAndTouch(StringRef key, int32_t expire, std::string &value, uint32_t *flags) {
+    return DoGetAndTouch(MakeKey(key), expire, value, flags);
+}
+
+// See SimpleLRU.h
+bool SimpleLRU::Update(StringRef key, ItemUpdater &updater, uint64_t *cas) {
+    bool result = DoUpdate(MakeKey(key), updater, cas);
+    DeliverEvicted();
+    return result;
+}
+
+// See SimpleLRU.h
+bool SimpleLRU::DoPut(const lru_key &lk, const std::string &value, uint32_t flags, int32_t expire) {
+    std::time_t now = Now();
+    auto it = Find(lk, now);
     if (it != _lru_index.end()) {
-        lru_node &node = it->second.get();
-        if (node.prev && node.next) {
-            node.next->prev = node.prev;
-            _lru_tail->next = std::move(node.prev->next);
-            node.prev->next = std::move(node.next);
-            _lru_tail->next->prev = _lru_tail;
-            _lru_tail = _lru_tail->next.get();
-        } else if (!node.prev && _lru_index.size() > 1) {
-            _lru_head->next->prev = nullptr;
-            _lru_head->prev = _lru_tail;
-            _lru_tail->next = std::move(_lru_head);
-            _lru_head = std::move(node.next);
-            _lru_tail = _lru_tail->next.get();
-        }
-        storage_size += value.size() - node.value.size();
-        while (storage_size > _max_size) {
-            Delete(_lru_head->key);
-        }
-        node.value = value;
-    } else {
-        std::unique_ptr<lru_node> new_node(new lru_node(key, value, nullptr, nullptr));
-        storage_size += pair_size;
-        while (storage_size > _max_size) {
-            Delete(std::ref(_lru_head->key));
+        return Update(it->second.get(), value, flags, ExpireAt(expire, now));
+    }
+    return Insert(lk, value, flags, ExpireAt(expire, now));
+}
+
+// See SimpleLRU.h
+bool SimpleLRU::DoPutIfAbsent(const lru_key &lk, const std::string &value, uint32_t flags, int32_t expire) {
+    std::time_t now = Now();
+    if (Find(lk, now) != _lru_index.end()) {
+        return false;
+    }
+    return Insert(lk, value, flags, ExpireAt(expire, now));
+}
+
+// See SimpleLRU.h
+bool SimpleLRU::DoSet(const lru_key &lk, const std::string &value, uint32_t flags, int32_t expire) {
+    std::time_t now = Now();
+    auto it = Find(lk, now);
+    if (it == _lru_index.end()) {
+        return false;
+    }
+    return Update(it->second.get(), value, flags, ExpireAt(expire, now));
+}
+
+// See SimpleLRU.h
+bool SimpleLRU::DoDelete(const lru_key &lk) {
+    auto it = Find(lk, Now());
+    if (it == _lru_index.end()) {
+        return false;
+    }
+    Remove(it);
+    return true;
+}
+
+// See SimpleLRU.h
+bool SimpleLRU::DoGet(const lru_key &lk, std::string &value, uint32_t *flags, int32_t *expire) {
+    std::time_t now = Now();
+    auto it = Find(lk, now);
+    if (it == _lru_index.end()) {
+        return false;
+    }
+
+    lru_node &node = it->second.get();
+    value = node.value;
+    if (flags != nullptr) {
+        *flags = node.flags;
+    }
+    if (expire != nullptr) {
+        *expire = node.expire_at == 0 ? 0 : int32_t(node.expire_at - now);
+    }
+    return true;
+}
+
+// See SimpleLRU.h
+bool SimpleLRU::DoTouch(const lru_key &lk, int32_t expire) {
+    std::time_t now = Now();
+    auto it = Find(lk, now);
+    if (it == _lru_index.end()) {
+        return false;
+    }
+
+    lru_node &node = it->second.get();
+    Schedule(node, ExpireAt(expire, now));
+    MoveToTail(node);
+    return true;
+}
+
+// See SimpleLRU.h
+bool SimpleLRU::DoGetAndTouch(const lru_key &lk, int32_t expire, std::string &value, uint32_t *flags) {
+    std::time_t now = Now();
+    auto it = Find(lk, now);
+    if (it == _lru_index.end()) {
+        return false;
+    }
+
+    lru_node &node = it->second.get();
+    value = node.value;
+    if (flags != nullptr) {
+        *flags = node.flags;
+    }
+    Schedule(node, ExpireAt(expire, now));
+    MoveToTail(node);
+    return true;
+}
+
+// See SimpleLRU.h
+bool SimpleLRU::DoUpdate(const lru_key &lk, ItemUpdater &updater, uint64_t *cas) {
+    std::time_t now = Now();
+    auto it = Find(lk, now);
+    lru_node *node = it == _lru_index.end() ? nullptr : &it->second.get();
+
+    ItemState state;
+    if (node != nullptr) {
+        state.value = &node->value;
+        state.flags = node->flags;
+        state.ttl = node->expire_at == 0 ? -1 : int32_t(node->expire_at - now);
+        state.cas = node->cas;
+        state.stale = node->stale;
+        state.win_sent = node->win_sent;
+    }
+
+    ItemUpdate update;
+    switch (updater.Apply(node != nullptr ? &state : nullptr, update)) {
+    case ItemUpdater::Action::kKeep:
+        break;
+
+    case ItemUpdater::Action::kDelete:
+        if (node == nullptr) {
+            return false;
         }
+        Remove(it);
+        return true;
 
-        if (_lru_index.empty()) {
-            new_node->prev = nullptr;
-            _lru_index.insert(std::make_pair(std::ref(new_node->key), std::ref(*new_node)));
-            _lru_head = std::move(new_node);
-            _lru_tail = _lru_head.get();
-        } else {
-            new_node->prev = _lru_tail;
-            _lru_index.insert(std::make_pair(std::ref(new_node->key), std::ref(*new_node)));
-            _lru_tail->next = std::move(new_node);
-            _lru_tail = _lru_tail->next.get();
+    case ItemUpdater::Action::kStore:
+        if (update.value != nullptr) {
+            // New node is inserted in the tail of the list
+            std::time_t expire_at = node != nullptr && !update.touch ? node->expire_at : ExpireAt(update.expire, now);
+            if (node != nullptr ? !Update(*node, *update.value, update.flags, expire_at)
+                                : !Insert(lk, *update.value, update.flags, expire_at)) {
+                return false;
+            }
+            node = _lru_tail;
+        } else if (node == nullptr) {
+            return false;
+        } else if (update.touch) {
+            Schedule(*node, ExpireAt(update.expire, now));
+            MoveToTail(*node);
         }
+        node->stale = update.stale;
+        node->win_sent = update.win_sent;
+        break;
     }
+
+    if (node != nullptr && cas != nullptr) {
+        *cas = node->cas;
+    }
+    return node != nullptr;
+}
+
+// See SimpleLRU.h
+bool SimpleLRU::TakeEvicted(std::vector<EvictedItem> &batch, bool force) {
+    if (_evicted.empty() || (!force && _evicted.size() < _eviction_batch)) {
+        return false;
+    }
+    batch.swap(_evicted);
     return true;
 }
 
-// See MapBasedGlobalLockImpl.h
-bool SimpleLRU::PutIfAbsent(const std::string &key, const std::string &value) {
-    auto it = _lru_index.find(key);
+// See SimpleLRU.h
+void SimpleLRU::NotifyEvicted(std::vector<EvictedItem> &&batch) {
+    if (_eviction_listener && !batch.empty()) {
+        _eviction_listener->OnEvict(std::move(batch));
+    }
+}
+
+// See SimpleLRU.h
+void SimpleLRU::DeliverEvicted() {
+    std::vector<EvictedItem> batch;
+    if (TakeEvicted(batch)) {
+        NotifyEvicted(std::move(batch));
+    }
+}
+
+// See SimpleLRU.h
+SimpleLRU::lru_index::iterator SimpleLRU::Find(const lru_key &lk, std::time_t now) {
+    Expire(now);
+
+    auto it = _lru_index.find(lk);
     if (it == _lru_index.end()) {
-        return Put(key, value);
+        return it;
+    }
+
+    // Wheel is processed with one second granularity, so item could expire earlier than its slot
+    // gets visited
+    lru_node &node = it->second.get();
+    if (node.expire_at != 0 && node.expire_at <= now) {
+        Remove(it);
+        return _lru_index.end();
     }
-    return false;
+    return it;
 }
 
-// See MapBasedGlobalLockImpl.h
-bool SimpleLRU::Set(const std::string &key, const std::string &value) {
-    auto it = _lru_index.find(key);
-    if (it != _lru_index.end()) {
-        return Put(key, value);
+// See SimpleLRU.h
+bool SimpleLRU::Insert(const lru_key &lk, const std::string &value, uint32_t flags, std::time_t expire_at) {
+    std::size_t pair_size = lk.size + value.size();
+    if (pair_size > _max_size) {
+        return false;
     }
-    return false;
+    Evict(pair_size);
+
+    std::unique_ptr<lru_node> new_node(new lru_node(lk.data, lk.size, lk.hash, value, flags));
+    lru_node &node = *new_node;
+    if (_lru_tail == nullptr) {
+        _lru_head = std::move(new_node);
+    } else {
+        node.prev = _lru_tail;
+        _lru_tail->next = std::move(new_node);
+    }
+    _lru_tail = &node;
+    Schedule(node, expire_at);
+    node.cas = ++_cas;
+
+    // Index must point to the key owned by node, hash is the same so no need to compute it again
+    _lru_index.emplace(lru_key{node.key.data(), node.key.size(), node.hash}, std::ref(node));
+    storage_size += pair_size;
+    return true;
 }
 
-// See MapBasedGlobalLockImpl.h
-bool SimpleLRU::Delete(const std::string &key) {
-    auto it = _lru_index.find(key);
-    if (it != _lru_index.end()) {
-        lru_node &node = it->second.get();
-        storage_size -= node.key.size();
-        storage_size -= node.value.size();
+// See SimpleLRU.h
+bool SimpleLRU::Update(lru_node &node, const std::string &value, uint32_t flags, std::time_t expire_at) {
+    if (node.key.size() + value.size() > _max_size) {
+        return false;
+    }
+
+    // Node became the freshest one, so it won't be evicted to free space for itself
+    MoveToTail(node);
+    storage_size -= node.value.size();
+    Evict(value.size());
+
+    node.value = value;
+    node.flags = flags;
+    node.cas = ++_cas;
+    node.stale = node.win_sent = false;
+    Schedule(node, expire_at);
+    storage_size += value.size();
+    return true;
+}
+
+// See SimpleLRU.h
+void SimpleLRU::Remove(lru_index::iterator it, bool evicted) {
+    lru_node &node = it->second.get();
+    storage_size -= node.key.size() + node.value.size();
+    _lru_index.erase(it);
+    Unschedule(node);
+
+    // Node is not reachable from index anymore, so its memory could be handed over without copy
+    if (evicted && _eviction_listener) {
+        _evicted.push_back(EvictedItem{std::move(node.key), std::move(node.value), node.flags});
+    }
+
+    if (node.next) {
+        node.next->prev = node.prev;
+    } else {
+        _lru_tail = node.prev;
+    }
+
+    // Unlinking node from owner destroys it, so it must be the last action
+    if (node.prev) {
+        node.prev->next = std::move(node.next);
+    } else {
+        _lru_head = std::move(node.next);
+    }
+}
+
+// See SimpleLRU.h
+void SimpleLRU::MoveToTail(lru_node &node) {
+    if (&node == _lru_tail) {
+        return;
+    }
+
+    // Take ownership from the previous node (or head) and unlink
+    std::unique_ptr<lru_node> owner;
+    if (node.prev) {
+        owner = std::move(node.prev->next);
+        node.prev->next = std::move(node.next);
+        node.prev->next->prev = node.prev;
+    } else {
+        owner = std::move(_lru_head);
+        _lru_head = std::move(node.next);
+        _lru_head->prev = nullptr;
+    }
 
-        if (node.prev) {
-            if (node.next) {
-                node.next->prev = node.prev;
+    node.prev = _lru_tail;
+    _lru_tail->next = std::move(owner);
+    _lru_tail = &node;
+}
+
+// See SimpleLRU.h
+void SimpleLRU::Evict(std::size_t extra) {
+    while (_lru_head && storage_size + extra > _max_size) {
+        lru_node &victim = *_lru_head;
+        Remove(_lru_index.find(lru_key{victim.key.data(), victim.key.size(), victim.hash}), true);
+    }
+}
+
+// See SimpleLRU.h
+void SimpleLRU::Schedule(lru_node &node, std::time_t expire_at) {
+    Unschedule(node);
+    node.expire_at = expire_at;
+    if (expire_at == 0) {
+        return;
+    }
+
+    // Slots up to the current time are processed already, item that is expired by now gets reclaimed
+    // on the next tick
+    std::time_t at = expire_at > _wheel_time ? expire_at : _wheel_time + 1;
+    node.wheel_slot = uint32_t(at & (wheel_size - 1));
+
+    lru_node *&slot = _wheel[node.wheel_slot];
+    node.wheel_prev = nullptr;
+    node.wheel_next = slot;
+    if (slot != nullptr) {
+        slot->wheel_prev = &node;
+    }
+    slot = &node;
+}
+
+// See SimpleLRU.h
+void SimpleLRU::Unschedule(lru_node &node) {
+    if (node.expire_at == 0) {
+        return;
+    }
+
+    if (node.wheel_prev != nullptr) {
+        node.wheel_prev->wheel_next = node.wheel_next;
+    } else {
+        _wheel[node.wheel_slot] = node.wheel_next;
+    }
+    if (node.wheel_next != nullptr) {
+        node.wheel_next->wheel_prev = node.wheel_prev;
+    }
+    node.wheel_prev = node.wheel_next = nullptr;
+    node.expire_at = 0;
+}
+
+// See SimpleLRU.h
+void SimpleLRU::Expire(std::time_t now) {
+    if (_wheel_time == 0) {
+        _wheel_time = now;
+        return;
+    }
+
+    // Once whole turn is skipped every slot is visited, no need to do it again
+    std::time_t from = _wheel_time + 1;
+    if (now - _wheel_time > std::time_t(wheel_size)) {
+        from = now - std::time_t(wheel_size) + 1;
+    }
+
+    for (std::time_t t = from; t <= now; t++) {
+        lru_node *node = _wheel[t & (wheel_size - 1)];
+        while (node != nullptr) {
+            lru_node *next = node->wheel_next;
+            if (node->expire_at <= now) {
+                Remove(_lru_index.find(lru_key{node->key.data(), node->key.size(), node->hash}));
             }
-            node.prev->next = std::move(node.next);
-        } else {
-            _lru_head = std::move(_lru_head->next);
-            _lru_head->prev = nullptr;
+            node = next;
         }
-        _lru_index.erase(it);
-        return true;
     }
-    return false;
-}
 
-// See MapBasedGlobalLockImpl.h
-bool SimpleLRU::Get(const std::string &key, std::string &value) {
-    auto it = _lru_index.find(key);
-    if (it != _lru_index.end()) {
-        value = it->second.get().value;
-        return true;
+    if (now > _wheel_time) {
+        _wheel_time = now;
     }
-    return false;
 }
 
 } // namespace Backend
-} // namespace Afina
\ No newline at end of file
+} // namespace Afina
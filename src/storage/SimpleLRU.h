@@ -1,13 +1,19 @@
 #ifndef AFINA_STORAGE_SIMPLE_LRU_H
 #define AFINA_STORAGE_SIMPLE_LRU_H
 
+#include <array>
+#include <cstring>
+#include <ctime>
 #include <unordered_map>
 #include <memory>
 #include <mutex>
 #include <string>
+#include <vector>
 
 #include <afina/Storage.h>
 
+#include "Hash.h"
+
 namespace Afina {
 namespace Backend {
 
@@ -18,9 +24,13 @@ namespace Backend {
 
 class SimpleLRU : public Afina::Storage {
 public:
-    SimpleLRU(size_t max_size = 1024) : _max_size(max_size) {}
+    SimpleLRU(size_t max_size = 1024) : SimpleLRU(max_size, WyHash::Random()) {}
+
+    SimpleLRU(size_t max_size, WyHash hash) : _max_size(max_size), _lru_tail(nullptr), _hash(hash), _wheel_time(0) {
+        _wheel.fill(nullptr);
+    }
 
-    ~SimpleLRU() {
+    virtual ~SimpleLRU() {
         _lru_index.clear();
         while (_lru_head) {
             _lru_head = std::move(_lru_head->next);
@@ -28,35 +38,142 @@ public:
     }
 
     // Implements Afina::Storage interface
-    bool Put(const std::string &key, const std::string &value) override;
+    void Stop() override;
+
+    // Implements Afina::Storage interface
+    bool Put(StringRef key, const std::string &value, uint32_t flags = 0, int32_t expire = 0) override;
+
+    // Implements Afina::Storage interface
+    bool PutIfAbsent(StringRef key, const std::string &value, uint32_t flags = 0,
+                     int32_t expire = 0) override;
+
+    // Implements Afina::Storage interface
+    bool Set(StringRef key, const std::string &value, uint32_t flags = 0, int32_t expire = 0) override;
+
+    // Implements Afina::Storage interface
+    bool Delete(StringRef key) override;
 
     // Implements Afina::Storage interface
-    bool PutIfAbsent(const std::string &key, const std::string &value) override;
+    bool Get(StringRef key, std::string &value, uint32_t *flags = nullptr,
+             int32_t *expire = nullptr) override;
 
     // Implements Afina::Storage interface
-    bool Set(const std::string &key, const std::string &value) override;
+    bool Touch(StringRef key, int32_t expire) override;
 
     // Implements Afina::Storage interface
-    bool Delete(const std::string &key) override;
+    bool GetAndTouch(StringRef key, int32_t expire, std::string &value, uint32_t *flags = nullptr) override;
 
     // Implements Afina::Storage interface
-    bool Get(const std::string &key, std::string &value) override;
+    bool Update(StringRef key, ItemUpdater &updater, uint64_t *cas = nullptr) override;
+
+protected:
+    // Key as it is stored in the index: points to the key bytes and carries hash calculated once
+    // per request, so that no index operation ever needs to hash key again
+    struct lru_key {
+        const char *data;
+        std::size_t size;
+        std::size_t hash;
+    };
+
+    // Builds index key for the given string, that is the only place where hash function gets called
+    inline lru_key MakeKey(StringRef key) const { return lru_key{key.data(), key.size(), _hash(key)}; }
+
+    // Current time used to check items expiration
+    virtual std::time_t Now() const { return std::time(nullptr); }
+
+    // Implementation of Afina::Storage interface on top of the prehashed key. Derived classes could
+    // hash key in advance, for example outside of the critical section
+    bool DoPut(const lru_key &lk, const std::string &value, uint32_t flags, int32_t expire);
+    bool DoPutIfAbsent(const lru_key &lk, const std::string &value, uint32_t flags, int32_t expire);
+    bool DoSet(const lru_key &lk, const std::string &value, uint32_t flags, int32_t expire);
+    bool DoDelete(const lru_key &lk);
+    bool DoGet(const lru_key &lk, std::string &value, uint32_t *flags, int32_t *expire);
+    bool DoTouch(const lru_key &lk, int32_t expire);
+    bool DoGetAndTouch(const lru_key &lk, int32_t expire, std::string &value, uint32_t *flags);
+    bool DoUpdate(const lru_key &lk, ItemUpdater &updater, uint64_t *cas);
+
+    // Moves collected evicted items into the given batch if there are enough of them to notify
+    // listener or if force is set. Returns true if batch has been taken
+    bool TakeEvicted(std::vector<EvictedItem> &batch, bool force = false);
+
+    // Passes batch of evicted items to the listener
+    void NotifyEvicted(std::vector<EvictedItem> &&batch);
 
 private:
     // LRU cache node
     using lru_node = struct lru_node {
-        lru_node(const std::string key, std::string value,
-                lru_node *prev, std::unique_ptr<lru_node> next) :
-                key(key),
-                value(value),
-                prev(prev),
-                next(std::move(next)) {}
-        const std::string key;
+        lru_node(const char *key, std::size_t key_size, std::size_t hash, const std::string &value, uint32_t flags)
+            : key(key, key_size), hash(hash), value(value), flags(flags), wheel_slot(0), stale(false), win_sent(false),
+              cas(0), expire_at(0), prev(nullptr), wheel_prev(nullptr), wheel_next(nullptr) {}
+        // Key isn't changed while node is in the index, but could be moved out on eviction
+        std::string key;
+        // Hash of the key, see lru_key
+        const std::size_t hash;
         std::string value;
+        // Opaque client flags, kept inline so they cost no extra allocation
+        uint32_t flags;
+        // Timing wheel slot node is linked into, valid only if item expires
+        uint32_t wheel_slot;
+        // Marks used by meta commands, see Afina::ItemState
+        bool stale;
+        bool win_sent;
+        // CAS token, assigned on every store
+        uint64_t cas;
+        // Absolute time item expires at, 0 if it never expires
+        std::time_t expire_at;
         lru_node *prev;
         std::unique_ptr<lru_node> next;
+        // Links in the timing wheel slot, used only if item expires
+        lru_node *wheel_prev;
+        lru_node *wheel_next;
     };
 
+    struct lru_key_hash {
+        std::size_t operator()(const lru_key &k) const { return k.hash; }
+    };
+
+    struct lru_key_equal {
+        bool operator()(const lru_key &a, const lru_key &b) const {
+            return a.hash == b.hash && a.size == b.size && std::memcmp(a.data, b.data, a.size) == 0;
+        }
+    };
+
+    using lru_index = std::unordered_map<lru_key, std::reference_wrapper<lru_node>, lru_key_hash, lru_key_equal>;
+
+    // Number of one second slots in the timing wheel, must be power of 2
+    static constexpr std::size_t wheel_size = 256;
+
+    // Finds node that is not expired yet, expired one gets removed
+    lru_index::iterator Find(const lru_key &lk, std::time_t now);
+
+    // Inserts new node in the tail of the list and into the index
+    bool Insert(const lru_key &lk, const std::string &value, uint32_t flags, std::time_t expire_at);
+
+    // Replace value of the existing node and makes it the freshest one
+    bool Update(lru_node &node, const std::string &value, uint32_t flags, std::time_t expire_at);
+
+    // Removes node pointed by the given index position, if evicted is set then node memory
+    // is passed to the eviction listener
+    void Remove(lru_index::iterator it, bool evicted = false);
+
+    // Notifies listener about evicted items if batch is full
+    void DeliverEvicted();
+
+    // Makes given node the freshest one
+    void MoveToTail(lru_node &node);
+
+    // Drops oldest nodes until storage gets enough space to place extra bytes
+    void Evict(std::size_t extra);
+
+    // Changes node expiration time and moves it to the corresponding wheel slot
+    void Schedule(lru_node &node, std::time_t expire_at);
+
+    // Removes node from timing wheel
+    void Unschedule(lru_node &node);
+
+    // Moves timing wheel up to the given time, removing all expired items on the way
+    void Expire(std::time_t now);
+
     // Maximum number of bytes could be stored in this cache.
     // i.e all (keys+values) must be less the _max_size
     std::size_t _max_size;
@@ -67,12 +184,28 @@ private:
     // List owns all nodes
     std::unique_ptr<lru_node> _lru_head;
     lru_node *_lru_tail;
+
+    // Seeded hash function used to build index keys
+    WyHash _hash;
+
     // Index of nodes from list above, allows fast random access to elements by lru_node#key
-    std::unordered_map<std::reference_wrapper<const std::string>, std::reference_wrapper<lru_node>,
-    std::hash<std::string>, std::equal_to<std::string>> _lru_index;
+    lru_index _lru_index;
+
+    // Items evicted but not yet passed to the eviction listener
+    std::vector<EvictedItem> _evicted;
+
+    // Hashed timing wheel of expiring items, slot is choosen by expiration time. Slot could
+    // contain items expiring on the different wheel turns, those are skipped till their turn comes
+    std::array<lru_node *, wheel_size> _wheel;
+
+    // Time up to which (inclusive) timing wheel has been processed
+    std::time_t _wheel_time;
+
+    // Last CAS token given to an item
+    uint64_t _cas = 0;
 };
 
 } // namespace Backend
 } // namespace Afina
 
-#endif // AFINA_STORAGE_SIMPLE_LRU_H
\ No newline at end of file
+#endif // AFINA_STORAGE_SIMPLE_LRU_H
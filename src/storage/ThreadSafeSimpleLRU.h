@@ -18,46 +18,110 @@ namespace Backend {
 class ThreadSafeSimplLRU : public SimpleLRU {
 public:
     ThreadSafeSimplLRU(size_t max_size = 1024) : SimpleLRU(max_size) {}
+    ThreadSafeSimplLRU(size_t max_size, WyHash hash) : SimpleLRU(max_size, hash) {}
     ~ThreadSafeSimplLRU() {}
 
     // see SimpleLRU.h
-    bool Put(const std::string &key, const std::string &value) override {
-        // TODO: sinchronization
-        std::lock_guard<std::mutex> guard(_lock);
-        return SimpleLRU::Put(key, value);
+    void Stop() override {
+        std::vector<EvictedItem> evicted;
+        {
+            std::lock_guard<std::mutex> guard(_lock);
+            TakeEvicted(evicted, true);
+        }
+        NotifyEvicted(std::move(evicted));
+    }
+
+    // see SimpleLRU.h
+    bool Put(StringRef key, const std::string &value, uint32_t flags = 0, int32_t expire = 0) override {
+        // Key gets hashed outside of the critical section, listener gets notified about evicted
+        // items after it as well
+        lru_key lk = MakeKey(key);
+        bool result;
+        std::vector<EvictedItem> evicted;
+        {
+            std::lock_guard<std::mutex> guard(_lock);
+            result = DoPut(lk, value, flags, expire);
+            TakeEvicted(evicted);
+        }
+        NotifyEvicted(std::move(evicted));
+        return result;
     }
 
 
     // see SimpleLRU.h
-    bool PutIfAbsent(const std::string &key, const std::string &value) override {
-        // TODO: sinchronization
+    bool PutIfAbsent(StringRef key, const std::string &value, uint32_t flags = 0,
+                     int32_t expire = 0) override {
+        lru_key lk = MakeKey(key);
+        bool result;
+        std::vector<EvictedItem> evicted;
+        {
+            std::lock_guard<std::mutex> guard(_lock);
+            result = DoPutIfAbsent(lk, value, flags, expire);
+            TakeEvicted(evicted);
+        }
+        NotifyEvicted(std::move(evicted));
+        return result;
+    }
+
+    // see SimpleLRU.h
+    bool Set(StringRef key, const std::string &value, uint32_t flags = 0, int32_t expire = 0) override {
+        lru_key lk = MakeKey(key);
+        bool result;
+        std::vector<EvictedItem> evicted;
+        {
+            std::lock_guard<std::mutex> guard(_lock);
+            result = DoSet(lk, value, flags, expire);
+            TakeEvicted(evicted);
+        }
+        NotifyEvicted(std::move(evicted));
+        return result;
+    }
+
+    // see SimpleLRU.h
+    bool Delete(StringRef key) override {
+        lru_key lk = MakeKey(key);
         std::lock_guard<std::mutex> guard(_lock);
-        return SimpleLRU::PutIfAbsent(key, value);
+        return DoDelete(lk);
     }
 
     // see SimpleLRU.h
-    bool Set(const std::string &key, const std::string &value) override {
-        // TODO: sinchronization
+    bool Get(StringRef key, std::string &value, uint32_t *flags = nullptr,
+             int32_t *expire = nullptr) override {
+        lru_key lk = MakeKey(key);
         std::lock_guard<std::mutex> guard(_lock);
-        return SimpleLRU::Set(key, value);
+        return DoGet(lk, value, flags, expire);
     }
 
     // see SimpleLRU.h
-    bool Delete(const std::string &key) override {
-        // TODO: sinchronization
+    bool Touch(StringRef key, int32_t expire) override {
+        lru_key lk = MakeKey(key);
         std::lock_guard<std::mutex> guard(_lock);
-        return SimpleLRU::Delete(key);
+        return DoTouch(lk, expire);
     }
 
     // see SimpleLRU.h
-    bool Get(const std::string &key, std::string &value) override {
-        // TODO: sinchronization
+    bool GetAndTouch(StringRef key, int32_t expire, std::string &value, uint32_t *flags = nullptr) override {
+        lru_key lk = MakeKey(key);
         std::lock_guard<std::mutex> guard(_lock);
-        return SimpleLRU::Get(key, value);
+        return DoGetAndTouch(lk, expire, value, flags);
+    }
+
+    // see SimpleLRU.h
+    bool Update(StringRef key, ItemUpdater &updater, uint64_t *cas = nullptr) override {
+        lru_key lk = MakeKey(key);
+        bool result;
+        std::vector<EvictedItem> evicted;
+        {
+            std::lock_guard<std::mutex> guard(_lock);
+            result = DoUpdate(lk, updater, cas);
+            TakeEvicted(evicted);
+        }
+        NotifyEvicted(std::move(evicted));
+        return result;
     }
 
 private:
-    // TODO: sinchronization primitives
+    // Global lock protecting all storage structures
     std::mutex _lock;
 };
 
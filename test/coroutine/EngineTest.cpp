@@ -62,3 +62,53 @@ TEST(CoroutineTest, Printer) {
     engine.start(_printer, engine, result);
     ASSERT_STREQ("A1 B1 A2 B2 A3 B3 END", result.c_str());
 }
+
+void _waiter(Afina::Coroutine::Engine &pe, std::string &out, int &events) {
+    // Blocks until unblocker delivers an event, like connection waiting for socket
+    while (events < 3) {
+        out += "W" + std::to_string(events) + " ";
+        pe.block();
+    }
+    out += "DONE";
+}
+
+void _spawner(Afina::Coroutine::Engine &pe, std::string &out, int &events, void *&waiter) {
+    waiter = pe.run(_waiter, pe, out, events);
+}
+
+TEST(CoroutineTest, BlockUntilUnblocked) {
+    void *waiter = nullptr;
+    int events = 0;
+    int calls = 0;
+    Afina::Coroutine::Engine engine([&](Afina::Coroutine::Engine &pe) {
+        calls++;
+        events++;
+        pe.unblock(waiter);
+    });
+
+    std::string result;
+    engine.start(_spawner, engine, result, events, waiter);
+    ASSERT_EQ("W0 W1 W2 DONE", result);
+    ASSERT_EQ(3, calls);
+}
+
+void _blocker(Afina::Coroutine::Engine &pe, std::string &out) {
+    out += "B ";
+    pe.block();
+    out += "never";
+}
+
+void _yielder(Afina::Coroutine::Engine &pe, std::string &out) {
+    pe.run(_blocker, pe, out);
+    out += "Y1 ";
+    pe.yield();
+    out += "Y2 ";
+}
+
+TEST(CoroutineTest, BlockedDroppedWithoutUnblocker) {
+    Afina::Coroutine::Engine engine;
+
+    std::string result;
+    engine.start(_yielder, engine, result);
+    ASSERT_EQ("Y1 B Y2 ", result);
+}
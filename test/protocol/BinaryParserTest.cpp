@@ -0,0 +1,294 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <string>
+
+#include <protocol/Session.h>
+#include <storage/SimpleLRU.h>
+
+using namespace Afina;
+
+namespace {
+
+// Builds request packet
+std::string Request(uint8_t opcode, const std::string &extras, const std::string &key, const std::string &value,
+                    uint32_t opaque = 0, uint64_t cas = 0) {
+    std::string packet(24, '\0');
+    packet[0] = char(0x80);
+    packet[1] = char(opcode);
+    packet[2] = char(key.size() >> 8);
+    packet[3] = char(key.size());
+    packet[4] = char(extras.size());
+    uint32_t body = extras.size() + key.size() + value.size();
+    for (int i = 0; i < 4; i++) {
+        packet[8 + i] = char(body >> (24 - 8 * i));
+        packet[12 + i] = char(opaque >> (24 - 8 * i));
+    }
+    for (int i = 0; i < 8; i++) {
+        packet[16 + i] = char(cas >> (56 - 8 * i));
+    }
+    return packet + extras + key + value;
+}
+
+std::string Word(uint32_t v) { return std::string{char(v >> 24), char(v >> 16), char(v >> 8), char(v)}; }
+
+// Fields of the response packet
+struct Response {
+    uint8_t opcode;
+    uint16_t status;
+    uint32_t opaque;
+    uint64_t cas;
+    std::string extras, key, value;
+};
+
+// Splits output into response packets
+std::vector<Response> Responses(const std::string &out) {
+    std::vector<Response> result;
+    const uint8_t *p = reinterpret_cast<const uint8_t *>(out.data());
+    for (std::size_t pos = 0; pos + 24 <= out.size();) {
+        EXPECT_EQ(0x81, p[pos]);
+        Response r;
+        r.opcode = p[pos + 1];
+        std::size_t key = p[pos + 2] << 8 | p[pos + 3], extras = p[pos + 4];
+        r.status = p[pos + 6] << 8 | p[pos + 7];
+        std::size_t body = uint32_t(p[pos + 8]) << 24 | p[pos + 9] << 16 | p[pos + 10] << 8 | p[pos + 11];
+        r.opaque = uint32_t(p[pos + 12]) << 24 | p[pos + 13] << 16 | p[pos + 14] << 8 | p[pos + 15];
+        r.cas = 0;
+        for (int i = 0; i < 8; i++) {
+            r.cas = r.cas << 8 | p[pos + 16 + i];
+        }
+        r.extras = out.substr(pos + 24, extras);
+        r.key = out.substr(pos + 24 + extras, key);
+        r.value = out.substr(pos + 24 + extras + key, body - extras - key);
+        result.push_back(r);
+        pos += 24 + body;
+    }
+    return result;
+}
+
+} // namespace
+
+// Verify set and get round trip and opaque echo
+TEST(BinaryParserTest, SetGet) {
+    Backend::SimpleLRU storage;
+    Protocol::Session session(storage);
+
+    std::string input = Request(0x00, "", "foo", "", 1) + Request(0x01, Word(42) + Word(0), "foo", "bar", 2) +
+                        Request(0x00, "", "foo", "", 3) + Request(0x0c, "", "foo", "", 4);
+    std::string out;
+    session.Process(input.data(), input.size(), out);
+
+    std::vector<Response> responses = Responses(out);
+    ASSERT_EQ(4, responses.size());
+    EXPECT_EQ(0x01, responses[0].status);
+    EXPECT_EQ(1, responses[0].opaque);
+
+    EXPECT_EQ(0x01, responses[1].opcode);
+    EXPECT_EQ(0, responses[1].status);
+    EXPECT_EQ(2, responses[1].opaque);
+
+    EXPECT_EQ(0, responses[2].status);
+    EXPECT_EQ(Word(42), responses[2].extras);
+    EXPECT_EQ("", responses[2].key);
+    EXPECT_EQ("bar", responses[2].value);
+
+    EXPECT_EQ(0x0c, responses[3].opcode);
+    EXPECT_EQ("foo", responses[3].key);
+    EXPECT_EQ("bar", responses[3].value);
+}
+
+// Verify quiet commands answer only on unusual outcome and noop ends the batch
+TEST(BinaryParserTest, QuietPipeline) {
+    Backend::SimpleLRU storage;
+    Protocol::Session session(storage);
+
+    std::string input = Request(0x11, Word(0) + Word(0), "a", "1") + Request(0x11, Word(0) + Word(0), "b", "2") +
+                        Request(0x12, Word(0) + Word(0), "a", "3") + Request(0x09, "", "missing", "") +
+                        Request(0x0d, "", "b", "") + Request(0x0a, "", "", "", 7);
+    std::string out;
+    session.Process(input.data(), input.size(), out);
+
+    std::vector<Response> responses = Responses(out);
+    ASSERT_EQ(3, responses.size());
+    EXPECT_EQ(0x12, responses[0].opcode);
+    EXPECT_EQ(0x02, responses[0].status);
+    EXPECT_EQ(0x0d, responses[1].opcode);
+    EXPECT_EQ("b", responses[1].key);
+    EXPECT_EQ("2", responses[1].value);
+    EXPECT_EQ(0x0a, responses[2].opcode);
+    EXPECT_EQ(7, responses[2].opaque);
+}
+
+// Verify replace, prepend and delete, including quiet ones
+TEST(BinaryParserTest, ReplacePrependDelete) {
+    Backend::SimpleLRU storage;
+    Protocol::Session session(storage);
+
+    std::string input = Request(0x03, Word(0) + Word(0), "a", "1", 1) + Request(0x01, Word(0) + Word(0), "a", "1") +
+                        Request(0x03, Word(9) + Word(0), "a", "2", 2) + Request(0x0f, "", "a", "0", 3) +
+                        Request(0x1a, "", "a", "x") + Request(0x00, "", "a", "", 4) + Request(0x04, "", "a", "", 5) +
+                        Request(0x14, "", "a", "", 6) + Request(0x04, "", "a", "value", 7) +
+                        Request(0x0a, "", "", "", 8);
+    std::string out;
+    EXPECT_TRUE(session.Process(input.data(), input.size(), out));
+
+    std::vector<Response> responses = Responses(out);
+    ASSERT_EQ(9, responses.size());
+    EXPECT_EQ(0x01, responses[0].status);
+    EXPECT_EQ(1, responses[0].opaque);
+    EXPECT_EQ(0x00, responses[1].status);
+    EXPECT_EQ(0x00, responses[2].status);
+    EXPECT_EQ(2, responses[2].opaque);
+    EXPECT_EQ(0x00, responses[3].status);
+    EXPECT_EQ(3, responses[3].opaque);
+    EXPECT_EQ(4, responses[4].opaque);
+    EXPECT_EQ("x02", responses[4].value);
+    EXPECT_EQ(Word(9), responses[4].extras);
+    EXPECT_EQ(0x04, responses[5].opcode);
+    EXPECT_EQ(0x00, responses[5].status);
+    EXPECT_EQ(0x14, responses[6].opcode);
+    EXPECT_EQ(0x01, responses[6].status);
+    EXPECT_EQ(7, responses[7].opaque);
+    EXPECT_EQ(0x04, responses[7].status);
+    EXPECT_EQ(0x0a, responses[8].opcode);
+}
+
+// Verify request CAS token is checked by stores and deletes, and responses carry token of the item
+TEST(BinaryParserTest, Cas) {
+    Backend::SimpleLRU storage;
+    Protocol::Session session(storage);
+
+    std::string input = Request(0x01, Word(0) + Word(0), "a", "1") + Request(0x00, "", "a", "");
+    std::string out;
+    session.Process(input.data(), input.size(), out);
+    std::vector<Response> responses = Responses(out);
+    ASSERT_EQ(2, responses.size());
+    uint64_t cas = responses[0].cas;
+    EXPECT_NE(0, cas);
+    EXPECT_EQ(cas, responses[1].cas);
+
+    // Stale token is rejected, and so is the one of the item that doesn't exist
+    out.clear();
+    std::string extras = Word(0) + Word(0);
+    input = Request(0x01, extras, "a", "2", 1, cas + 1) + Request(0x03, extras, "a", "2", 2, cas + 1) +
+            Request(0x0e, "", "a", "2", 3, cas + 1) + Request(0x04, "", "a", "", 4, cas + 1) +
+            Request(0x11, extras, "a", "2", 5, cas + 1) + Request(0x01, extras, "b", "2", 6, cas) +
+            Request(0x04, "", "b", "", 7, cas) + Request(0x00, "", "a", "", 8);
+    session.Process(input.data(), input.size(), out);
+    responses = Responses(out);
+    ASSERT_EQ(8, responses.size());
+    for (int i = 0; i < 5; i++) {
+        EXPECT_EQ(0x02, responses[i].status) << i;
+        EXPECT_EQ(0, responses[i].cas) << i;
+    }
+    EXPECT_EQ(0x01, responses[5].status);
+    EXPECT_EQ(0x01, responses[6].status);
+    EXPECT_EQ("1", responses[7].value);
+    EXPECT_EQ(cas, responses[7].cas);
+
+    // Matching token lets update through, item gets the new one
+    out.clear();
+    input = Request(0x01, Word(0) + Word(0), "a", "3", 1, cas) + Request(0x00, "", "a", "", 2);
+    session.Process(input.data(), input.size(), out);
+    responses = Responses(out);
+    ASSERT_EQ(2, responses.size());
+    EXPECT_EQ(0, responses[0].status);
+    EXPECT_NE(cas, responses[0].cas);
+    EXPECT_EQ(responses[0].cas, responses[1].cas);
+    EXPECT_EQ("3", responses[1].value);
+
+    out.clear();
+    input = Request(0x04, "", "a", "", 1, cas) + Request(0x04, "", "a", "", 2, responses[1].cas) +
+            Request(0x00, "", "a", "", 3);
+    session.Process(input.data(), input.size(), out);
+    responses = Responses(out);
+    ASSERT_EQ(3, responses.size());
+    EXPECT_EQ(0x02, responses[0].status);
+    EXPECT_EQ(0, responses[1].status);
+    EXPECT_EQ(0x01, responses[2].status);
+}
+
+// Verify packets split between reads at any byte
+TEST(BinaryParserTest, SplitPackets) {
+    Backend::SimpleLRU storage;
+    Protocol::Session session(storage);
+
+    std::string input = Request(0x01, Word(1) + Word(0), "key", "value") + Request(0x00, "", "key", "");
+    std::string out;
+    for (char c : input) {
+        session.Process(&c, 1, out);
+    }
+
+    std::vector<Response> responses = Responses(out);
+    ASSERT_EQ(2, responses.size());
+    EXPECT_EQ("value", responses[1].value);
+    EXPECT_EQ(Word(1), responses[1].extras);
+}
+
+// Verify unknown and malformed requests are answered with errors without breaking the stream
+TEST(BinaryParserTest, Errors) {
+    Backend::SimpleLRU storage;
+    Protocol::Session session(storage);
+
+    std::string input = Request(0x7f, "", "key", "value") + Request(0x01, "", "key", "value") +
+                        Request(0x1c, Word(0), "key", "") + Request(0x0a, "", "", "");
+    std::string out;
+    session.Process(input.data(), input.size(), out);
+
+    std::vector<Response> responses = Responses(out);
+    ASSERT_EQ(4, responses.size());
+    EXPECT_EQ(0x81, responses[0].status);
+    EXPECT_EQ(0x04, responses[1].status);
+    EXPECT_EQ(0x01, responses[2].status);
+    EXPECT_EQ(0, responses[3].status);
+
+    // Key is longer than the whole body: body is skipped and the next packet is served
+    std::string invalid = Request(0x00, "", "key", "").substr(0, 24);
+    invalid[11] = 1;
+    invalid += "x" + Request(0x0a, "", "", "");
+    out.clear();
+    EXPECT_TRUE(session.Process(invalid.data(), invalid.size(), out));
+    responses = Responses(out);
+    ASSERT_EQ(2, responses.size());
+    EXPECT_EQ(0x04, responses[0].status);
+    EXPECT_EQ(0, responses[1].status);
+
+    // Stream without magic byte can't be resynchronized
+    std::string garbage = Request(0x0a, "", "", "");
+    garbage[0] = 0x42;
+    out.clear();
+    EXPECT_FALSE(session.Process(garbage.data(), garbage.size(), out));
+    EXPECT_TRUE(out.empty());
+}
+
+// Verify requests beyond the budget are answered with busy status, quiet ones as well
+TEST(BinaryParserTest, Busy) {
+    Backend::SimpleLRU storage;
+    Protocol::Session session(storage);
+
+    std::string input = Request(0x01, Word(0) + Word(0), "a", "1", 1) + Request(0x11, Word(0) + Word(0), "b", "2", 2) +
+                        Request(0x00, "", "a", "", 3) + Request(0x0a, "", "", "", 4);
+    std::string out;
+    session.SetBudget(1);
+    session.Process(input.data(), input.size(), out);
+
+    std::vector<Response> responses = Responses(out);
+    ASSERT_EQ(4, responses.size());
+    EXPECT_EQ(0, responses[0].status);
+    EXPECT_EQ(0x11, responses[1].opcode);
+    EXPECT_EQ(0x85, responses[1].status);
+    EXPECT_EQ(2, responses[1].opaque);
+    EXPECT_EQ(0x85, responses[2].status);
+    EXPECT_EQ("", responses[2].value);
+    EXPECT_EQ(0, responses[3].status);
+}
+
+// Verify text protocol is detected as well
+TEST(BinaryParserTest, TextDetected) {
+    Backend::SimpleLRU storage;
+    Protocol::Session session(storage);
+
+    std::string input = "set foo 0 0 3\r\nbar\r\nget foo\r\n", out;
+    session.Process(input.data(), input.size(), out);
+    EXPECT_EQ("STORED\r\nVALUE foo 0 3\r\nbar\r\nEND\r\n", out);
+}
@@ -1,37 +1,43 @@
 #include <gtest/gtest.h>
 
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
 #include <memory>
 #include <string>
 
 #include <afina/execute/Add.h>
+#include <afina/execute/Delete.h>
 #include <afina/execute/Get.h>
+#include <afina/execute/GetAndTouch.h>
 #include <afina/execute/Set.h>
 #include <afina/execute/Stats.h>
+#include <afina/execute/Touch.h>
 
 #include <protocol/Parser.h>
+#include <protocol/Scan.h>
+#include <protocol/Session.h>
+#include <storage/SimpleLRU.h>
 
 using namespace Afina;
 
-// TODO: Negative test on errors
-// TODO: Separate tests for integers overflow
-// TODO: Special test that consumed only increased
-
 // Verify simple set command passed in a single string
 TEST(MemcachedParserTest, SimpleSet) {
     Protocol::Parser parser;
 
     size_t consumed = 0;
-    bool cmd_avail = parser.Parse("set foo 0 0 6\r\nfooval\r\n", consumed);
+    const std::string input = "set foo 0 0 6\r\nfooval\r\n";
+    bool cmd_avail = parser.Parse(input, consumed);
     ASSERT_TRUE(cmd_avail);
     ASSERT_EQ(15, consumed);
     ASSERT_EQ("set", parser.Name());
 
     size_t value_size;
-    std::unique_ptr<Execute::Command> cmd = parser.Build(value_size);
+    Execute::Command *cmd = parser.Build(value_size);
     ASSERT_FALSE(cmd == nullptr);
     ASSERT_EQ(6, value_size);
 
-    Execute::Set *tmp = reinterpret_cast<Execute::Set *>(cmd.get());
+    Execute::Set *tmp = reinterpret_cast<Execute::Set *>(cmd);
     ASSERT_EQ("foo", tmp->key());
     ASSERT_EQ(0, tmp->flags());
     ASSERT_EQ(0, tmp->expire());
@@ -42,39 +48,86 @@ TEST(MemcachedParserTest, SimpleAdd) {
     Protocol::Parser parser;
 
     size_t consumed = 0;
-    bool cmd_avail = parser.Parse("add bar 10 -1 60\r\nbarval\r\n", consumed);
+    const std::string input = "add bar 10 -1 60\r\nbarval\r\n";
+    bool cmd_avail = parser.Parse(input, consumed);
     ASSERT_TRUE(cmd_avail);
     ASSERT_EQ(18, consumed);
     ASSERT_EQ("add", parser.Name());
 
     size_t value_size;
-    std::unique_ptr<Execute::Command> cmd = parser.Build(value_size);
+    Execute::Command *cmd = parser.Build(value_size);
     ASSERT_FALSE(cmd == nullptr);
     ASSERT_EQ(60, value_size);
 
-    Execute::Add *tmp = reinterpret_cast<Execute::Add *>(cmd.get());
+    Execute::Add *tmp = reinterpret_cast<Execute::Add *>(cmd);
     ASSERT_EQ("bar", tmp->key());
     ASSERT_EQ(10, tmp->flags());
     ASSERT_EQ(-1, tmp->expire());
 }
 
+// Verify flags field accepts full 32-bit range
+TEST(MemcachedParserTest, SetFlags) {
+    Protocol::Parser parser;
+
+    size_t consumed = 0;
+    const std::string input = "set foo 4294967295 0 6\r\nfooval\r\n";
+    bool cmd_avail = parser.Parse(input, consumed);
+    ASSERT_TRUE(cmd_avail);
+    ASSERT_EQ(24, consumed);
+
+    size_t value_size;
+    Execute::Command *cmd = parser.Build(value_size);
+    ASSERT_FALSE(cmd == nullptr);
+    ASSERT_EQ(6, value_size);
+
+    Execute::Set *tmp = reinterpret_cast<Execute::Set *>(cmd);
+    ASSERT_EQ("foo", tmp->key());
+    ASSERT_EQ(4294967295, tmp->flags());
+}
+
+// Verify multi-digit expiration time is parsed in both directions
+TEST(MemcachedParserTest, SetExpire) {
+    Protocol::Parser parser;
+
+    size_t consumed = 0;
+    const std::string input = "set foo 0 3600 6\r\nfooval\r\n";
+    bool cmd_avail = parser.Parse(input, consumed);
+    ASSERT_TRUE(cmd_avail);
+    ASSERT_EQ(18, consumed);
+
+    size_t value_size;
+    Execute::Command *cmd = parser.Build(value_size);
+    ASSERT_FALSE(cmd == nullptr);
+    Execute::Set *tmp = reinterpret_cast<Execute::Set *>(cmd);
+    ASSERT_EQ(3600, tmp->expire());
+
+    parser.Reset();
+    const std::string negative = "set foo 0 -120 6\r\nfooval\r\n";
+    cmd_avail = parser.Parse(negative, consumed);
+    ASSERT_TRUE(cmd_avail);
+    cmd = parser.Build(value_size);
+    tmp = reinterpret_cast<Execute::Set *>(cmd);
+    ASSERT_EQ(-120, tmp->expire());
+}
+
 // Verify simple get command passed in a single string
 TEST(MemcachedParserTest, SimpleGet) {
     Protocol::Parser parser;
 
     size_t consumed = 0;
-    bool cmd_avail = parser.Parse("get ke key2 super_long_key\r\n", consumed);
+    const std::string input = "get ke key2 super_long_key\r\n";
+    bool cmd_avail = parser.Parse(input, consumed);
     ASSERT_TRUE(cmd_avail);
     ASSERT_EQ(28, consumed);
     ASSERT_EQ("get", parser.Name());
 
     size_t value_size;
-    std::unique_ptr<Execute::Command> cmd = parser.Build(value_size);
+    Execute::Command *cmd = parser.Build(value_size);
     ASSERT_FALSE(cmd == nullptr);
     ASSERT_EQ(0, value_size);
 
-    Execute::Get *tmp = reinterpret_cast<Execute::Get *>(cmd.get());
-    std::vector<std::string> keys = tmp->keys();
+    Execute::Get *tmp = reinterpret_cast<Execute::Get *>(cmd);
+    const std::vector<StringRef> &keys = tmp->keys();
     ASSERT_EQ(3, keys.size());
     ASSERT_EQ("ke", keys[0]);
     ASSERT_EQ("key2", keys[1]);
@@ -85,16 +138,515 @@ TEST(MemcachedParserTest, Stats) {
     Protocol::Parser parser;
 
     size_t consumed = 0;
-    bool cmd_avail = parser.Parse("stats\r\n", consumed);
+    const std::string input = "stats\r\n";
+    bool cmd_avail = parser.Parse(input, consumed);
     ASSERT_TRUE(cmd_avail);
     ASSERT_EQ(7, consumed);
     ASSERT_EQ("stats", parser.Name());
 
     size_t value_size;
-    std::unique_ptr<Execute::Command> cmd = parser.Build(value_size);
+    Execute::Command *cmd = parser.Build(value_size);
     ASSERT_FALSE(cmd == nullptr);
     ASSERT_EQ(0, value_size);
 
-    Execute::Stats *tmp = reinterpret_cast<Execute::Stats *>(cmd.get());
+    Execute::Stats *tmp = reinterpret_cast<Execute::Stats *>(cmd);
     ASSERT_FALSE(tmp == nullptr);
 }
+
+TEST(MemcachedParserTest, Touch) {
+    Protocol::Parser parser;
+
+    size_t consumed = 0;
+    const std::string input = "touch foo 300\r\n";
+    bool cmd_avail = parser.Parse(input, consumed);
+    ASSERT_TRUE(cmd_avail);
+    ASSERT_EQ(15, consumed);
+    ASSERT_EQ("touch", parser.Name());
+
+    size_t value_size;
+    Execute::Command *cmd = parser.Build(value_size);
+    ASSERT_FALSE(cmd == nullptr);
+    ASSERT_EQ(0, value_size);
+
+    Execute::Touch *tmp = reinterpret_cast<Execute::Touch *>(cmd);
+    ASSERT_EQ("foo", tmp->key());
+    ASSERT_EQ(300, tmp->expire());
+}
+
+TEST(MemcachedParserTest, GetAndTouch) {
+    Protocol::Parser parser;
+
+    size_t consumed = 0;
+    const std::string input = "gat 25 foo bar\r\n";
+    bool cmd_avail = parser.Parse(input, consumed);
+    ASSERT_TRUE(cmd_avail);
+    ASSERT_EQ(16, consumed);
+    ASSERT_EQ("gat", parser.Name());
+
+    size_t value_size;
+    Execute::Command *cmd = parser.Build(value_size);
+    ASSERT_FALSE(cmd == nullptr);
+    ASSERT_EQ(0, value_size);
+
+    Execute::GetAndTouch *tmp = reinterpret_cast<Execute::GetAndTouch *>(cmd);
+    ASSERT_EQ(25, tmp->expire());
+    const std::vector<StringRef> &keys = tmp->keys();
+    ASSERT_EQ(2, keys.size());
+    ASSERT_EQ("foo", keys[0]);
+    ASSERT_EQ("bar", keys[1]);
+}
+
+// Verify gets and gats send CAS token of the item, the one meta get reports, and get and gat don't
+TEST(MemcachedParserTest, GetsCas) {
+    Backend::SimpleLRU storage;
+    Protocol::Session session(storage);
+
+    std::string out;
+    const std::string input = "set foo 5 0 3\r\nbar\r\nmg foo c\r\n";
+    session.Process(input.data(), input.size(), out);
+    ASSERT_EQ(0, out.find("STORED\r\nHD c"));
+    std::size_t at = out.find(" c") + 2;
+    std::string cas = out.substr(at, out.size() - at - 2);
+
+    out.clear();
+    const std::string gets = "gets foo baz\r\ngats 100 foo\r\nget foo\r\ngat 100 foo\r\n";
+    session.Process(gets.data(), gets.size(), out);
+    EXPECT_EQ("VALUE foo 5 3 " + cas + "\r\nbar\r\nEND\r\nVALUE foo 5 3 " + cas + "\r\nbar\r\nEND\r\n"
+              "VALUE foo 5 3\r\nbar\r\nEND\r\nVALUE foo 5 3\r\nbar\r\nEND\r\n",
+              out);
+
+    out.clear();
+    const std::string update = "set foo 5 0 3\r\nbaz\r\ngets foo\r\n";
+    session.Process(update.data(), update.size(), out);
+    EXPECT_EQ(std::string::npos, out.find("VALUE foo 5 3 " + cas + "\r\n"));
+    EXPECT_EQ(0, out.find("STORED\r\nVALUE foo 5 3 "));
+}
+
+// Verify command line split between reads at every possible position
+TEST(MemcachedParserTest, SplitLine) {
+    const std::string input = "set some_key 12 300 6\r\nfooval\r\n";
+    for (size_t split = 0; split < 23; split++) {
+        Protocol::Parser parser;
+
+        size_t consumed = 0;
+        ASSERT_FALSE(parser.Parse(input.data(), split, consumed));
+        ASSERT_EQ(split, consumed);
+        ASSERT_TRUE(parser.Parse(input.data() + split, input.size() - split, consumed));
+        ASSERT_EQ(23 - split, consumed);
+
+        size_t value_size;
+        Execute::Command *cmd = parser.Build(value_size);
+        ASSERT_FALSE(cmd == nullptr);
+        ASSERT_EQ(6, value_size);
+
+        Execute::Set *tmp = reinterpret_cast<Execute::Set *>(cmd);
+        ASSERT_EQ("some_key", tmp->key());
+        ASSERT_EQ(12, tmp->flags());
+        ASSERT_EQ(300, tmp->expire());
+    }
+}
+
+// Verify keys reference input in place, but key of command with data block survives next read
+TEST(MemcachedParserTest, KeysReferenceInput) {
+    Protocol::Parser parser;
+
+    size_t consumed = 0, value_size;
+    char buffer[] = "get user:session:123456\r\n";
+    ASSERT_TRUE(parser.Parse(buffer, sizeof(buffer) - 1, consumed));
+    Execute::Command *cmd = parser.Build(value_size);
+    const std::vector<StringRef> &keys = reinterpret_cast<Execute::Get *>(cmd)->keys();
+    ASSERT_EQ(1, keys.size());
+    ASSERT_EQ(buffer + 4, keys[0].data());
+    parser.Reset();
+
+    char set[] = "set user:session:123456 0 0 5\r\n";
+    ASSERT_TRUE(parser.Parse(set, sizeof(set) - 1, consumed));
+    cmd = parser.Build(value_size);
+    std::memset(set, 'x', sizeof(set));
+    ASSERT_EQ("user:session:123456", reinterpret_cast<Execute::Set *>(cmd)->key());
+}
+
+// Verify parser could be reused for the next command and extra spaces are ignored
+TEST(MemcachedParserTest, Reuse) {
+    Protocol::Parser parser;
+
+    size_t consumed = 0, value_size;
+    const std::string first = "get  a\r\nget b  c \r\n", second = "get b  c \r\n";
+    ASSERT_TRUE(parser.Parse(first, consumed));
+    ASSERT_EQ(8, consumed);
+    ASSERT_FALSE(parser.Build(value_size) == nullptr);
+    parser.Reset();
+
+    ASSERT_TRUE(parser.Parse(second, consumed));
+    ASSERT_EQ(11, consumed);
+    Execute::Command *cmd = parser.Build(value_size);
+    const std::vector<StringRef> &keys = reinterpret_cast<Execute::Get *>(cmd)->keys();
+    ASSERT_EQ(2, keys.size());
+    ASSERT_EQ("b", keys[0]);
+    ASSERT_EQ("c", keys[1]);
+}
+
+// Verify noreply is recognized only as the last parameter
+TEST(MemcachedParserTest, NoReply) {
+    Protocol::Parser parser;
+
+    size_t consumed = 0, value_size;
+    const std::string set = "set foo 0 0 3 noreply\r\n", touch = "touch foo 10 noreply\r\n",
+                      plain = "set foo 0 0 3\r\n", invalid = "set foo 0 0 3 norepl\r\n";
+    ASSERT_TRUE(parser.Parse(set, consumed));
+    ASSERT_FALSE(parser.Build(value_size) == nullptr);
+    ASSERT_EQ(3, value_size);
+    ASSERT_TRUE(parser.NoReply());
+    parser.Reset();
+
+    ASSERT_TRUE(parser.Parse(touch, consumed));
+    ASSERT_TRUE(parser.NoReply());
+    parser.Reset();
+
+    ASSERT_TRUE(parser.Parse(plain, consumed));
+    ASSERT_FALSE(parser.NoReply());
+    parser.Reset();
+
+    ASSERT_TRUE(parser.Parse(invalid, consumed));
+    ASSERT_TRUE(parser.Build(value_size) == nullptr);
+    ASSERT_STREQ("CLIENT_ERROR bad command line format", parser.Error());
+}
+
+// Verify commands with noreply are executed but not answered
+TEST(MemcachedParserTest, NoReplyPipeline) {
+    Backend::SimpleLRU storage;
+    Protocol::Session session(storage);
+
+    std::string out;
+    const std::string input = "set a 0 0 1 noreply\r\n1\r\nadd a 0 0 1 noreply\r\n2\r\n"
+                              "touch a 100 noreply\r\nget a\r\n";
+    session.Process(input.data(), input.size(), out);
+    ASSERT_EQ("VALUE a 0 1\r\n1\r\nEND\r\n", out);
+}
+
+// Verify commands beyond the budget are rejected with data blocks skipped, and budget is dropped by Reset
+TEST(MemcachedParserTest, Budget) {
+    Backend::SimpleLRU storage;
+    Protocol::Session session(storage);
+
+    std::string out;
+    const std::string input = "set a 0 0 1\r\n1\r\nset b 0 0 1 noreply\r\n2\r\nbogus\r\nget a b\r\n";
+    session.SetBudget(1);
+    session.Process(input.data(), input.size(), out);
+    ASSERT_EQ("STORED\r\nSERVER_ERROR busy\r\nERROR\r\nSERVER_ERROR busy\r\n", out);
+    ASSERT_EQ(0, session.Budget());
+
+    out.clear();
+    session.SetBudget(2);
+    const std::string get = "get a b\r\n";
+    session.Process(get.data(), get.size(), out);
+    ASSERT_EQ("VALUE a 0 1\r\n1\r\nEND\r\n", out);
+    ASSERT_EQ(1, session.Budget());
+
+    out.clear();
+    session.SetBudget(0);
+    session.Reset();
+    session.Process(get.data(), get.size(), out);
+    ASSERT_EQ("VALUE a 0 1\r\n1\r\nEND\r\n", out);
+}
+
+// Verify commands beyond the budget wait for the next one if session is asked to hold them
+TEST(MemcachedParserTest, BudgetHold) {
+    Backend::SimpleLRU storage;
+    Protocol::Session session(storage);
+
+    std::string out;
+    const std::string input = "set a 0 0 1\r\n1\r\nget a\r\nget b\r\n";
+    session.SetBudget(1, true);
+    EXPECT_TRUE(session.Process(input.data(), input.size(), out));
+    EXPECT_EQ("STORED\r\n", out);
+    EXPECT_TRUE(session.Held());
+
+    out.clear();
+    session.SetBudget(1, true);
+    EXPECT_TRUE(session.Resume(out));
+    EXPECT_EQ("VALUE a 0 1\r\n1\r\nEND\r\n", out);
+    EXPECT_TRUE(session.Held());
+
+    // Without hold the rest is rejected as usual
+    out.clear();
+    session.SetBudget(0);
+    EXPECT_TRUE(session.Resume(out));
+    EXPECT_EQ("SERVER_ERROR busy\r\n", out);
+    EXPECT_FALSE(session.Held());
+}
+
+// Verify delete command and its legacy zero time
+TEST(MemcachedParserTest, Delete) {
+    Protocol::Parser parser;
+
+    size_t consumed = 0, value_size;
+    const char *valid[] = {"delete foo\r\n", "delete foo 0\r\n", "delete foo noreply\r\n", "delete foo 0 noreply\r\n"};
+    for (const char *line : valid) {
+        parser.Reset();
+        ASSERT_TRUE(parser.Parse(line, strlen(line), consumed)) << line;
+        ASSERT_EQ("delete", parser.Name());
+        Execute::Command *cmd = parser.Build(value_size);
+        ASSERT_FALSE(cmd == nullptr) << line;
+        ASSERT_EQ(0, value_size);
+        ASSERT_EQ("foo", reinterpret_cast<Execute::Delete *>(cmd)->key());
+        ASSERT_EQ(strstr(line, "noreply") != nullptr, parser.NoReply()) << line;
+    }
+
+    const char *invalid[] = {"delete\r\n", "delete foo 10\r\n", "delete foo bar\r\n", "delete foo 0 noreply x\r\n",
+                             "delete foo noreply 0\r\n"};
+    for (const char *line : invalid) {
+        parser.Reset();
+        EXPECT_TRUE(parser.Parse(line, strlen(line), consumed)) << line;
+        EXPECT_TRUE(parser.Build(value_size) == nullptr) << line;
+        EXPECT_STREQ("CLIENT_ERROR bad command line format", parser.Error()) << line;
+    }
+}
+
+// Verify replace, prepend and delete round trip through the session
+TEST(MemcachedParserTest, ReplacePrependDelete) {
+    Backend::SimpleLRU storage;
+    Protocol::Session session(storage);
+
+    std::string out;
+    const std::string input = "replace foo 0 0 1\r\nx\r\nprepend foo 0 0 1\r\nx\r\ndelete foo\r\n"
+                              "set foo 3 0 3\r\nbar\r\nreplace foo 5 0 3\r\nbaz\r\nprepend foo 0 0 3\r\nfoo\r\n"
+                              "get foo\r\ndelete foo\r\nget foo\r\nset foo 0 0 1\r\n1\r\ndelete foo 0 noreply\r\n"
+                              "add foo 0 0 1\r\n2\r\n";
+    EXPECT_TRUE(session.Process(input.data(), input.size(), out));
+    EXPECT_EQ("NOT_STORED\r\nNOT_STORED\r\nNOT_FOUND\r\nSTORED\r\nSTORED\r\nSTORED\r\n"
+              "VALUE foo 5 6\r\nfoobaz\r\nEND\r\nDELETED\r\nEND\r\nSTORED\r\nSTORED\r\n",
+              out);
+}
+
+// Verify value which doesn't fit into storage is reported rather than acknowledged
+TEST(MemcachedParserTest, SetTooLarge) {
+    Backend::SimpleLRU storage(64);
+    Protocol::Session session(storage);
+
+    std::string out;
+    const std::string value(100, 'v');
+    const std::string input = "set foo 0 0 100\r\n" + value + "\r\nget foo\r\nset foo 0 0 3\r\nbar\r\n";
+    EXPECT_TRUE(session.Process(input.data(), input.size(), out));
+    EXPECT_EQ("SERVER_ERROR object too large for cache\r\nEND\r\nSTORED\r\n", out);
+}
+
+// Verify append and prepend keep flags and expiration time of the item, even the one given as absolute time
+TEST(MemcachedParserTest, AppendKeepsExpire) {
+    Backend::SimpleLRU storage;
+    Protocol::Session session(storage);
+
+    std::string out;
+    std::string expire = std::to_string(std::time(nullptr) + 40 * 24 * 3600);
+    const std::string input = "append foo 0 0 1\r\nx\r\nset foo 7 " + expire + " 3\r\nbar\r\n"
+                              "append foo 0 0 3\r\nbaz\r\nprepend foo 0 0 3\r\nfoo\r\nget foo\r\n";
+    EXPECT_TRUE(session.Process(input.data(), input.size(), out));
+    EXPECT_EQ("NOT_STORED\r\nSTORED\r\nSTORED\r\nSTORED\r\nVALUE foo 7 9\r\nfoobarbaz\r\nEND\r\n", out);
+
+    std::string value;
+    int32_t ttl = 0;
+    ASSERT_TRUE(storage.Get("foo", value, nullptr, &ttl));
+    EXPECT_GT(ttl, 39 * 24 * 3600);
+}
+
+// Verify session holds commands back once output limit is reached, and goes on with them on Resume
+TEST(MemcachedParserTest, OutputLimit) {
+    Backend::SimpleLRU storage;
+    Protocol::Session session(storage);
+    session.SetOutputLimit(20);
+
+    std::string out;
+    const std::string input = "set foo 0 0 3\r\nbar\r\nget foo\r\nget foo\r\nget ";
+    EXPECT_TRUE(session.Process(input.data(), input.size(), out));
+    EXPECT_EQ("STORED\r\nVALUE foo 0 3\r\nbar\r\nEND\r\n", out);
+    EXPECT_TRUE(session.Held());
+
+    // Input that comes meanwhile waits behind the one held
+    out.clear();
+    const std::string rest = "foo\r\n";
+    EXPECT_TRUE(session.Process(rest.data(), rest.size(), out));
+    EXPECT_EQ("VALUE foo 0 3\r\nbar\r\nEND\r\n", out);
+    EXPECT_TRUE(session.Held());
+
+    out.clear();
+    EXPECT_TRUE(session.Resume(out));
+    EXPECT_EQ("VALUE foo 0 3\r\nbar\r\nEND\r\n", out);
+    EXPECT_FALSE(session.Held());
+}
+
+// Verify buffer a large value has been read into isn't kept by the thread once response is formed
+TEST(MemcachedParserTest, ValueBufferReleased) {
+    Backend::SimpleLRU storage(4 << 20);
+    Protocol::Session session(storage);
+
+    std::string out;
+    const std::string value(1 << 20, 'x');
+    const std::string input = "set foo 0 0 " + std::to_string(value.size()) + "\r\n" + value + "\r\n";
+    EXPECT_TRUE(session.Process(input.data(), input.size(), out));
+    EXPECT_EQ("STORED\r\n", out);
+
+    for (const std::string get : {"get foo\r\n", "gats 0 foo\r\n", "mg foo v\r\n"}) {
+        out.clear();
+        EXPECT_TRUE(session.Process(get.data(), get.size(), out));
+        EXPECT_NE(std::string::npos, out.find(value)) << get;
+        EXPECT_GE(64u << 10, Execute::Get::ValueBuffer().capacity()) << get;
+    }
+}
+
+// Verify numbers on the edge of 32 bits range
+TEST(MemcachedParserTest, IntegerLimits) {
+    Protocol::Parser parser;
+
+    size_t consumed = 0, value_size;
+    const std::string input = "set foo 4294967295 -2147483648 0\r\n\r\n";
+    ASSERT_TRUE(parser.Parse(input, consumed));
+    Execute::Command *cmd = parser.Build(value_size);
+    Execute::Set *tmp = reinterpret_cast<Execute::Set *>(cmd);
+    ASSERT_EQ(4294967295u, tmp->flags());
+    ASSERT_EQ(INT32_MIN, tmp->expire());
+
+    const char *invalid[] = {"set foo 4294967296 0 0\r\n", "set foo 0 2147483648 0\r\n", "set foo 0 0 1x\r\n",
+                             "set foo -1 0 0\r\n",         "set foo 0 - 0\r\n",          "set foo 0 0\r\n",
+                             "gat abc foo\r\n",            "frobnicate foo\r\n",         "get\r\n"};
+    for (const char *line : invalid) {
+        parser.Reset();
+        EXPECT_TRUE(parser.Parse(line, strlen(line), consumed)) << line;
+        EXPECT_EQ(strlen(line), consumed) << line;
+        EXPECT_TRUE(parser.Build(value_size) == nullptr) << line;
+        EXPECT_FALSE(parser.Error() == nullptr) << line;
+    }
+
+    parser.Reset();
+    const std::string long_key = "get " + std::string(251, 'k') + "\r\n";
+    EXPECT_TRUE(parser.Parse(long_key, consumed));
+    EXPECT_FALSE(parser.Error() == nullptr);
+}
+
+// Verify malformed commands are answered with errors and stream goes on with the next command
+TEST(MemcachedParserTest, ErrorRecovery) {
+    Backend::SimpleLRU storage;
+    Protocol::Session session(storage);
+
+    std::string out;
+    const std::string input = "frobnicate foo\r\n\r\nset foo 0 zero 3\r\nabc\r\nget foo\r\nset foo 0 0 3 noreply\r\n"
+                              "abcdef\r\nset foo 0 0 0\r\n\r\nget foo\r\n";
+    EXPECT_TRUE(session.Process(input.data(), input.size(), out));
+    EXPECT_EQ("ERROR\r\nERROR\r\nCLIENT_ERROR bad command line format\r\nEND\r\n"
+              "CLIENT_ERROR bad data chunk\r\nERROR\r\nSTORED\r\nVALUE foo 0 0\r\n\r\nEND\r\n",
+              out);
+}
+
+// Verify data block of malformed storage command is skipped rather than parsed as the next command
+TEST(MemcachedParserTest, ErrorSkipsBlock) {
+    Backend::SimpleLRU storage;
+    Protocol::Session session(storage);
+
+    std::string out;
+    const std::string input = "set k abc 0 5\r\nhello\r\nadd k 0 0 5 junk\r\nget k\r\nget k\r\n";
+    EXPECT_TRUE(session.Process(input.data(), input.size(), out));
+    EXPECT_EQ("CLIENT_ERROR bad command line format\r\nCLIENT_ERROR bad command line format\r\nEND\r\n", out);
+
+    // Block arrives in the later reads
+    out.clear();
+    const std::string split = "set k 0 0 x\r\nset k 0 x 3\r\nabc";
+    EXPECT_TRUE(session.Process(split.data(), split.size(), out));
+    const std::string tail = "\r\nget k\r\n";
+    EXPECT_TRUE(session.Process(tail.data(), tail.size(), out));
+    EXPECT_EQ("CLIENT_ERROR bad command line format\r\nCLIENT_ERROR bad command line format\r\nEND\r\n", out);
+}
+
+// Verify broken lines are skipped up to their end, even if it comes in the later reads
+TEST(MemcachedParserTest, ErrorResync) {
+    Backend::SimpleLRU storage;
+    Protocol::Session session(storage);
+
+    // Carriage return must be followed by line feed
+    std::string out;
+    const std::string desync = "get foo\r\r\nget foo\r\n";
+    session.Process(desync.data(), desync.size(), out);
+    EXPECT_EQ("CLIENT_ERROR bad command line format\r\nEND\r\n", out);
+
+    // Line is too long, its rest arrives byte by byte
+    out.clear();
+    const std::string huge = "get " + std::string(Protocol::Parser::max_line, 'k');
+    session.Process(huge.data(), huge.size(), out);
+    EXPECT_EQ("CLIENT_ERROR line too long\r\n", out);
+    const std::string tail = "kkk\r\nget foo\r\n";
+    for (char c : tail) {
+        session.Process(&c, 1, out);
+    }
+    EXPECT_EQ("CLIENT_ERROR line too long\r\nEND\r\n", out);
+
+    // Next connection doesn't inherit the broken line
+    out.clear();
+    session.Process(huge.data(), huge.size(), out);
+    session.Reset();
+    const std::string next = "get foo\r\n";
+    session.Process(next.data(), next.size(), out);
+    EXPECT_EQ("CLIENT_ERROR line too long\r\nEND\r\n", out);
+}
+
+// Verify large data block read directly into the command argument, mixed with regular reads
+TEST(MemcachedParserTest, DirectBody) {
+    Backend::SimpleLRU storage(1 << 23);
+    Protocol::Session session(storage);
+
+    std::string value(3 * Protocol::Session::max_prealloc + 12345, 'v');
+    for (std::size_t i = 0; i < value.size(); i += 1000) {
+        value[i] = char('a' + i % 26);
+    }
+    const std::string block = value + "\r\n";
+
+    // Beginning of the value comes along with the command line, then reads go directly until small tail
+    std::string out, head = "set big 0 0 " + std::to_string(value.size()) + "\r\n" + block.substr(0, 100);
+    ASSERT_TRUE(session.Process(head.data(), head.size(), out));
+    std::size_t pos = 100, size = 0;
+    for (char *direct; (direct = session.BodyBuffer(size)) != nullptr; pos += size) {
+        ASSERT_LE(pos + size, block.size());
+        size = std::min<std::size_t>(size, 300000);
+        memcpy(direct, block.data() + pos, size);
+        ASSERT_TRUE(session.BodyReceived(size, out));
+    }
+    ASSERT_LT(block.size() - pos, Protocol::Session::direct_body);
+    const std::string tail = block.substr(pos) + "get big\r\n";
+    ASSERT_TRUE(session.Process(tail.data(), tail.size(), out));
+    EXPECT_TRUE(out == "STORED\r\nVALUE big 0 " + std::to_string(value.size()) + "\r\n" + block + "END\r\n");
+
+    // Small values are never read directly, broken data chunk is still detected
+    EXPECT_TRUE(session.BodyBuffer(size) == nullptr);
+    out.clear();
+    const std::string bad = "set big 0 0 " + std::to_string(Protocol::Session::direct_body) + "\r\n";
+    session.Process(bad.data(), bad.size(), out);
+    char *direct = session.BodyBuffer(size);
+    ASSERT_FALSE(direct == nullptr);
+    ASSERT_EQ(Protocol::Session::direct_body + 2, size);
+    memset(direct, 'x', size);
+    session.BodyReceived(size, out);
+    EXPECT_EQ("CLIENT_ERROR bad data chunk\r\n", out);
+}
+
+// Verify vector scanning primitives against scalar ones
+TEST(MemcachedParserTest, ScanPrimitives) {
+    unsigned seed = 1;
+    for (int n = 0; n < 10000; n++) {
+        std::string line(rand_r(&seed) % 100, 'a');
+        for (auto &c : line) {
+            int r = rand_r(&seed) % 8;
+            c = r == 0 ? ' ' : (r == 1 ? '\n' : 'a' + r);
+        }
+
+        ASSERT_EQ(Protocol::Scan::FindScalar(line.data(), line.size(), '\n'),
+                  Protocol::Scan::Find(line.data(), line.size(), '\n'));
+
+        std::vector<std::string> expected, actual;
+        Protocol::Scan::SplitScalar(line.data(), line.size(), [&](const char *p, size_t size) {
+            expected.emplace_back(p, size);
+            return true;
+        });
+        Protocol::Scan::Split(line.data(), line.size(), [&](const char *p, size_t size) {
+            actual.emplace_back(p, size);
+            return true;
+        });
+        ASSERT_EQ(expected, actual) << line;
+    }
+}
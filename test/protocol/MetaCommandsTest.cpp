@@ -0,0 +1,141 @@
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include <protocol/Session.h>
+#include <storage/LockFreeLRU.h>
+#include <storage/SimpleLRU.h>
+
+using namespace Afina;
+
+namespace {
+
+// Feeds requests into the session and returns all responses
+std::string Exchange(Protocol::Session &session, const std::string &input) {
+    std::string out;
+    session.Process(input.data(), input.size(), out);
+    return out;
+}
+
+} // namespace
+
+// Verify meta set and get with the returned flags
+TEST(MetaCommandsTest, SetGet) {
+    Backend::SimpleLRU storage;
+    Protocol::Session session(storage);
+
+    EXPECT_EQ("EN\r\n", Exchange(session, "mg foo v\r\n"));
+    EXPECT_EQ("HD c1\r\n", Exchange(session, "ms foo 3 F5 c\r\nbar\r\n"));
+    EXPECT_EQ("VA 3 f5 s3 t-1\r\nbar\r\n", Exchange(session, "mg foo v f s t\r\n"));
+    EXPECT_EQ("HD c1 Oabc kfoo\r\n", Exchange(session, "mg foo c Oabc k\r\n"));
+    EXPECT_EQ("HD t30\r\n", Exchange(session, "mg foo t T30\r\n"));
+
+    // Plain get sees items stored by meta commands and vice versa
+    EXPECT_EQ("VALUE foo 5 3\r\nbar\r\nEND\r\n", Exchange(session, "get foo\r\n"));
+    EXPECT_EQ("STORED\r\n", Exchange(session, "set foo 0 0 3\r\nbaz\r\n"));
+    EXPECT_EQ("VA 3 c2\r\nbaz\r\n", Exchange(session, "mg foo v c\r\n"));
+}
+
+// Verify quiet mode and opaque tokens in a pipelined batch finished by mn
+TEST(MetaCommandsTest, QuietPipeline) {
+    Backend::SimpleLRU storage;
+    Protocol::Session session(storage);
+
+    std::string out = Exchange(session, "ms a 1 q\r\n1\r\nms b 1 q O2\r\n2\r\nmg missing v q O3\r\nmg b v q O4\r\n"
+                                   "md a q\r\nmd a q\r\nmn\r\n");
+    EXPECT_EQ("VA 1 O4\r\n2\r\nMN\r\n", out);
+    EXPECT_EQ("EN Ox kmissing\r\n", Exchange(session, "mg missing Ox k\r\n"));
+}
+
+// Verify modes and CAS conditions of ms
+TEST(MetaCommandsTest, SetModes) {
+    Backend::SimpleLRU storage;
+    Protocol::Session session(storage);
+
+    EXPECT_EQ("NS\r\n", Exchange(session, "ms foo 1 MR\r\n1\r\n"));
+    EXPECT_EQ("NS\r\n", Exchange(session, "ms foo 1 MA\r\n1\r\n"));
+    EXPECT_EQ("NF\r\n", Exchange(session, "ms foo 1 C1\r\n1\r\n"));
+    EXPECT_EQ("HD c1\r\n", Exchange(session, "ms foo 1 ME c F7\r\n1\r\n"));
+    EXPECT_EQ("NS\r\n", Exchange(session, "ms foo 1 ME\r\n1\r\n"));
+    EXPECT_EQ("HD\r\n", Exchange(session, "ms foo 1 MA\r\n2\r\n"));
+    EXPECT_EQ("HD\r\n", Exchange(session, "ms foo 1 Mp\r\n0\r\n"));
+    EXPECT_EQ("VA 3 f7\r\n012\r\n", Exchange(session, "mg foo v f\r\n"));
+
+    EXPECT_EQ("EX\r\n", Exchange(session, "ms foo 1 C1\r\nx\r\n"));
+    EXPECT_EQ("HD c4\r\n", Exchange(session, "ms foo 1 C3 c\r\nx\r\n"));
+    EXPECT_EQ("CLIENT_ERROR invalid mode for ms\r\n", Exchange(session, "ms foo 1 MX\r\nx\r\n"));
+}
+
+// Verify delete and invalidation with stale-while-revalidate
+TEST(MetaCommandsTest, StaleWhileRevalidate) {
+    Backend::SimpleLRU storage;
+    Protocol::Session session(storage);
+
+    EXPECT_EQ("NF\r\n", Exchange(session, "md foo\r\n"));
+    EXPECT_EQ("HD\r\n", Exchange(session, "ms foo 3\r\nold\r\n"));
+    EXPECT_EQ("EX\r\n", Exchange(session, "md foo C9\r\n"));
+    EXPECT_EQ("HD\r\n", Exchange(session, "md foo I T30\r\n"));
+
+    // The first reader wins recache, the others are served stale value meanwhile
+    EXPECT_EQ("VA 3 W X\r\nold\r\n", Exchange(session, "mg foo v\r\n"));
+    EXPECT_EQ("VA 3 X Z\r\nold\r\n", Exchange(session, "mg foo v\r\n"));
+    EXPECT_EQ("HD\r\n", Exchange(session, "ms foo 3\r\nnew\r\n"));
+    EXPECT_EQ("VA 3\r\nnew\r\n", Exchange(session, "mg foo v\r\n"));
+
+    EXPECT_EQ("HD\r\n", Exchange(session, "md foo\r\n"));
+    EXPECT_EQ("EN\r\n", Exchange(session, "mg foo\r\n"));
+}
+
+// Verify miss with vivify and early recache
+TEST(MetaCommandsTest, Recache) {
+    Backend::SimpleLRU storage;
+    Protocol::Session session(storage);
+
+    EXPECT_EQ("VA 0 W\r\n\r\n", Exchange(session, "mg foo v N30\r\n"));
+    EXPECT_EQ("VA 0 Z\r\n\r\n", Exchange(session, "mg foo v N30\r\n"));
+    EXPECT_EQ("HD\r\n", Exchange(session, "ms foo 3 T30\r\nval\r\n"));
+    EXPECT_EQ("HD\r\n", Exchange(session, "mg foo R10\r\n"));
+    EXPECT_EQ("HD W\r\n", Exchange(session, "mg foo R60\r\n"));
+    EXPECT_EQ("HD Z\r\n", Exchange(session, "mg foo R60\r\n"));
+}
+
+// Verify meta arithmetic
+TEST(MetaCommandsTest, Arithmetic) {
+    Backend::LockFreeLRU storage;
+    Protocol::Session session(storage);
+
+    EXPECT_EQ("NF\r\n", Exchange(session, "ma n\r\n"));
+    EXPECT_EQ("VA 2\r\n10\r\n", Exchange(session, "ma n N0 J10 v\r\n"));
+    EXPECT_EQ("VA 2\r\n15\r\n", Exchange(session, "ma n D5 v\r\n"));
+    EXPECT_EQ("HD\r\n", Exchange(session, "ma n MD D20\r\n"));
+    EXPECT_EQ("VA 1\r\n0\r\n", Exchange(session, "mg n v\r\n"));
+    EXPECT_EQ("VA 1\r\n0\r\n", Exchange(session, "ma n M- v\r\n"));
+
+    // Increment wraps around
+    EXPECT_EQ("VA 20\r\n18446744073709551615\r\n", Exchange(session, "ma n D18446744073709551615 v\r\n"));
+    EXPECT_EQ("VA 1\r\n0\r\n", Exchange(session, "ma n v\r\n"));
+
+    EXPECT_EQ("HD\r\n", Exchange(session, "ms s 3\r\nabc\r\n"));
+    EXPECT_EQ("CLIENT_ERROR cannot increment or decrement non-numeric value\r\n", Exchange(session, "ma s\r\n"));
+    EXPECT_EQ("EX\r\n", Exchange(session, "ma n C1\r\n"));
+}
+
+// Verify malformed meta commands
+TEST(MetaCommandsTest, Errors) {
+    Backend::SimpleLRU storage;
+    Protocol::Session session(storage);
+
+    const std::string error = "CLIENT_ERROR bad command line format\r\n";
+    EXPECT_EQ(error, Exchange(session, "mg foo x\r\n"));
+    EXPECT_EQ(error, Exchange(session, "mg foo Tabc\r\n"));
+    EXPECT_EQ(error, Exchange(session, "mg foo v1\r\n"));
+    EXPECT_EQ(error, Exchange(session, "ms foo\r\n"));
+    EXPECT_EQ(error, Exchange(session, "md\r\n"));
+    EXPECT_EQ(error, Exchange(session, "mg foo O" + std::string(33, 'o') + "\r\n"));
+
+    // Data block is skipped once its size is known
+    EXPECT_EQ(error + "EN\r\n", Exchange(session, "ms foo 3 x\r\nabc\r\nmg foo v\r\n"));
+
+    // Quiet mode doesn't hide errors, session goes on after them
+    EXPECT_EQ(error + "MN\r\n", Exchange(session, "mg foo q x\r\nmn\r\n"));
+}
@@ -0,0 +1,133 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include <protocol/Session.h>
+#include <storage/SimpleLRU.h>
+
+using namespace Afina;
+
+namespace {
+
+// Builds RESP request out of arguments
+std::string Request(const std::vector<std::string> &args) {
+    std::string request = "*" + std::to_string(args.size()) + "\r\n";
+    for (auto &arg : args) {
+        request += "$" + std::to_string(arg.size()) + "\r\n" + arg + "\r\n";
+    }
+    return request;
+}
+
+// Feeds requests into the session and returns all replies
+std::string Exchange(Protocol::Session &session, const std::string &input) {
+    std::string out;
+    EXPECT_TRUE(session.Process(input.data(), input.size(), out));
+    return out;
+}
+
+} // namespace
+
+// Verify basic commands
+TEST(RespParserTest, Commands) {
+    Backend::SimpleLRU storage(4096);
+    Protocol::Session session(storage, true);
+
+    EXPECT_EQ("+OK\r\n", Exchange(session, Request({"SET", "foo", "bar"})));
+    EXPECT_EQ("$3\r\nbar\r\n", Exchange(session, Request({"GET", "foo"})));
+    EXPECT_EQ("$-1\r\n", Exchange(session, Request({"get", "nope"})));
+
+    EXPECT_EQ("$-1\r\n", Exchange(session, Request({"SET", "foo", "baz", "NX"})));
+    EXPECT_EQ("$-1\r\n", Exchange(session, Request({"SET", "new", "baz", "XX"})));
+    EXPECT_EQ("+OK\r\n", Exchange(session, Request({"SET", "foo", "", "xx", "EX", "100"})));
+    EXPECT_EQ("$0\r\n\r\n", Exchange(session, Request({"GET", "foo"})));
+
+    EXPECT_EQ(":1\r\n", Exchange(session, Request({"INCR", "counter"})));
+    EXPECT_EQ(":2\r\n", Exchange(session, Request({"incr", "counter"})));
+    EXPECT_EQ("$1\r\n2\r\n", Exchange(session, Request({"GET", "counter"})));
+
+    EXPECT_EQ(":1\r\n", Exchange(session, Request({"EXPIRE", "counter", "100"})));
+    EXPECT_EQ(":0\r\n", Exchange(session, Request({"EXPIRE", "nope", "100"})));
+    EXPECT_EQ(":1\r\n", Exchange(session, Request({"EXPIRE", "counter", "0"})));
+    EXPECT_EQ("$-1\r\n", Exchange(session, Request({"GET", "counter"})));
+
+    EXPECT_EQ("+OK\r\n", Exchange(session, Request({"SET", "a", "1", "PX", "1500"})));
+    EXPECT_EQ(":2\r\n", Exchange(session, Request({"DEL", "foo", "nope", "a"})));
+    EXPECT_EQ("$-1\r\n", Exchange(session, Request({"GET", "a"})));
+
+    EXPECT_EQ("+PONG\r\n", Exchange(session, Request({"PING"})));
+    EXPECT_EQ("$2\r\nhi\r\n", Exchange(session, Request({"PING", "hi"})));
+    EXPECT_EQ("*2\r\n$4\r\nsave\r\n$0\r\n\r\n", Exchange(session, Request({"CONFIG", "GET", "save"})));
+
+    // Inline commands
+    EXPECT_EQ("+PONG\r\n+OK\r\n$1\r\n1\r\n", Exchange(session, "PING\r\nset x 1\r\nGET x\n"));
+}
+
+// Verify errors which don't break the stream
+TEST(RespParserTest, Errors) {
+    Backend::SimpleLRU storage(4096);
+    Protocol::Session session(storage, true);
+
+    EXPECT_EQ("-ERR unknown command 'FLUSHALL'\r\n", Exchange(session, Request({"FLUSHALL"})));
+    EXPECT_EQ("-ERR wrong number of arguments for 'GET' command\r\n", Exchange(session, Request({"GET"})));
+    EXPECT_EQ("-ERR syntax error\r\n", Exchange(session, Request({"SET", "k", "v", "NX", "XX"})));
+    EXPECT_EQ("-ERR value is not an integer or out of range\r\n",
+              Exchange(session, Request({"SET", "k", "v", "EX", "soon"})));
+    EXPECT_EQ("-ERR invalid expire time\r\n", Exchange(session, Request({"SET", "k", "v", "EX", "0"})));
+    EXPECT_EQ("-ERR key is too long\r\n", Exchange(session, Request({"GET", std::string(251, 'k')})));
+
+    EXPECT_EQ("+OK\r\n", Exchange(session, Request({"SET", "k", "v"})));
+    EXPECT_EQ("-ERR value is not an integer or out of range\r\n", Exchange(session, Request({"INCR", "k"})));
+    EXPECT_EQ("", Exchange(session, "*0\r\n\r\n"));
+}
+
+// Verify commands beyond the budget are rejected, command on several keys counts once
+TEST(RespParserTest, Busy) {
+    Backend::SimpleLRU storage(4096);
+    Protocol::Session session(storage, true);
+
+    session.SetBudget(2);
+    EXPECT_EQ("+OK\r\n:0\r\n-BUSY server is busy, try again later\r\n",
+              Exchange(session, Request({"SET", "k", "v"}) + Request({"DEL", "a", "b"}) + Request({"GET", "k"})));
+    EXPECT_EQ(0, session.Budget());
+
+    session.SetBudget(1);
+    EXPECT_EQ("$1\r\nv\r\n", Exchange(session, Request({"GET", "k"})));
+}
+
+// Verify malformed protocol closes the connection
+TEST(RespParserTest, ProtocolErrors) {
+    Backend::SimpleLRU storage(4096);
+    const char *broken[] = {"*x\r\n", "*2\r\n+GET\r\n", "*1\r\n$-5\r\n", "*1\r\n$3\r\nGETX\r\n", "*99999\r\n"};
+    for (const char *input : broken) {
+        Protocol::Session session(storage, true);
+        std::string out, request = std::string(input) + Request({"PING"});
+        EXPECT_FALSE(session.Process(request.data(), request.size(), out)) << input;
+        EXPECT_EQ(0, out.compare(0, 20, "-ERR Protocol error:")) << input;
+        EXPECT_EQ(std::string::npos, out.find("PONG")) << input;
+    }
+}
+
+// Verify requests split at any place, including large values
+TEST(RespParserTest, SplitRequests) {
+    Backend::SimpleLRU storage(1 << 20);
+    Protocol::Session session(storage, true);
+
+    std::string value(100000, 'v');
+    std::string input = Request({"SET", "big", value}) + Request({"GET", "big"}) + Request({"DEL", "big"}) +
+                        "PING\r\n" + Request({"GET", "big"});
+    std::string expected = "+OK\r\n$100000\r\n" + value + "\r\n:1\r\n+PONG\r\n$-1\r\n";
+
+    std::string out;
+    for (char c : input) {
+        ASSERT_TRUE(session.Process(&c, 1, out));
+    }
+    EXPECT_TRUE(expected == out);
+
+    out.clear();
+    for (std::size_t pos = 0; pos < input.size(); pos += 4096) {
+        std::size_t size = std::min<std::size_t>(4096, input.size() - pos);
+        ASSERT_TRUE(session.Process(input.data() + pos, size, out));
+    }
+    EXPECT_TRUE(expected == out);
+}
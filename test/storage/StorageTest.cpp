@@ -1,7 +1,9 @@
 #include "gtest/gtest.h"
+#include <atomic>
 #include <iomanip>
 #include <iostream>
 #include <set>
+#include <thread>
 #include <vector>
 
 #include <afina/execute/Add.h>
@@ -10,7 +12,10 @@
 #include <afina/execute/Get.h>
 #include <afina/execute/Set.h>
 
+#include "storage/Hash.h"
+#include "storage/LockFreeLRU.h"
 #include "storage/SimpleLRU.h"
+#include "storage/ThreadSafeSimpleLRU.h"
 
 using namespace Afina::Backend;
 using namespace Afina::Execute;
@@ -56,6 +61,40 @@ TEST(StorageTest, PutIfAbsent) {
     EXPECT_TRUE(value == "val1");
 }
 
+TEST(StorageTest, PutGetFlags) {
+    SimpleLRU storage;
+
+    EXPECT_TRUE(storage.Put("KEY1", "val1", 42));
+    EXPECT_TRUE(storage.Put("KEY2", "val2"));
+
+    std::string value;
+    uint32_t flags = 1;
+    EXPECT_TRUE(storage.Get("KEY1", value, &flags));
+    EXPECT_TRUE(value == "val1");
+    EXPECT_EQ(42, flags);
+
+    EXPECT_TRUE(storage.Get("KEY2", value, &flags));
+    EXPECT_TRUE(value == "val2");
+    EXPECT_EQ(0, flags);
+}
+
+TEST(StorageTest, UpdateFlags) {
+    SimpleLRU storage;
+
+    EXPECT_TRUE(storage.PutIfAbsent("KEY1", "val1", 1));
+    EXPECT_FALSE(storage.PutIfAbsent("KEY1", "val2", 2));
+
+    std::string value;
+    uint32_t flags = 0;
+    EXPECT_TRUE(storage.Get("KEY1", value, &flags));
+    EXPECT_EQ(1, flags);
+
+    EXPECT_TRUE(storage.Set("KEY1", "val3", 0xFFFFFFFF));
+    EXPECT_TRUE(storage.Get("KEY1", value, &flags));
+    EXPECT_TRUE(value == "val3");
+    EXPECT_EQ(0xFFFFFFFF, flags);
+}
+
 TEST(StorageTest, PutSetGet) {
     SimpleLRU storage;
 
@@ -139,6 +178,502 @@ TEST(StorageTest, DeleteHeadAndTailNode)
     EXPECT_TRUE(storage.Delete("KEY1"));
 }
 
+TEST(StorageTest, DeleteSingleNode) {
+    SimpleLRU storage;
+
+    EXPECT_TRUE(storage.Put("KEY1", "val1"));
+    EXPECT_TRUE(storage.Delete("KEY1"));
+
+    std::string value;
+    EXPECT_FALSE(storage.Get("KEY1", value));
+
+    // List must stay consistent after it becomes empty
+    EXPECT_TRUE(storage.Put("KEY2", "val2"));
+    EXPECT_TRUE(storage.Get("KEY2", value));
+    EXPECT_TRUE(value == "val2");
+}
+
+TEST(StorageTest, DeleteTailThenEvict) {
+    SimpleLRU storage(24);
+
+    EXPECT_TRUE(storage.Put("KEY1", "val1"));
+    EXPECT_TRUE(storage.Put("KEY2", "val2"));
+    EXPECT_TRUE(storage.Delete("KEY2"));
+
+    // Goes after the KEY1, requires KEY1 to be evicted
+    EXPECT_TRUE(storage.Put("KEY3", "val3"));
+    EXPECT_TRUE(storage.Put("KEY4", "val4____"));
+
+    std::string value;
+    EXPECT_FALSE(storage.Get("KEY1", value));
+    EXPECT_TRUE(storage.Get("KEY3", value));
+    EXPECT_TRUE(value == "val3");
+    EXPECT_TRUE(storage.Get("KEY4", value));
+    EXPECT_TRUE(value == "val4____");
+}
+
+TEST(StorageTest, ThreadSafeConditionalPut) {
+    ThreadSafeSimplLRU storage;
+
+    EXPECT_TRUE(storage.PutIfAbsent("KEY1", "val1"));
+    EXPECT_FALSE(storage.PutIfAbsent("KEY1", "val2"));
+    EXPECT_TRUE(storage.Set("KEY1", "val3"));
+    EXPECT_FALSE(storage.Set("KEY2", "val3"));
+
+    std::string value;
+    EXPECT_TRUE(storage.Get("KEY1", value));
+    EXPECT_TRUE(value == "val3");
+}
+
+class CollectListener : public Afina::EvictionListener {
+public:
+    void OnEvict(std::vector<Afina::EvictedItem> &&items) override {
+        batches.push_back(items.size());
+        for (auto &item : items) {
+            evicted.push_back(std::move(item));
+        }
+    }
+
+    std::vector<std::size_t> batches;
+    std::vector<Afina::EvictedItem> evicted;
+};
+
+TEST(StorageTest, EvictionListener) {
+    SimpleLRU storage(24);
+    auto listener = std::make_shared<CollectListener>();
+    storage.SetEvictionListener(listener, 2);
+
+    EXPECT_TRUE(storage.Put("KEY1", "val1", 1));
+    EXPECT_TRUE(storage.Put("KEY2", "val2", 2));
+    EXPECT_TRUE(storage.Put("KEY3", "val3", 3));
+    EXPECT_TRUE(storage.Delete("KEY3"));
+
+    // Single eviction doesn't fill the batch
+    EXPECT_TRUE(storage.Put("KEY4", "val4", 4));
+    EXPECT_TRUE(storage.Put("KEY5", "val5", 5));
+    EXPECT_TRUE(listener->evicted.empty());
+
+    EXPECT_TRUE(storage.Put("KEY6", "val6", 6));
+    ASSERT_EQ(1, listener->batches.size());
+    ASSERT_EQ(2, listener->evicted.size());
+    EXPECT_EQ("KEY1", listener->evicted[0].key);
+    EXPECT_EQ("val1", listener->evicted[0].value);
+    EXPECT_EQ(1, listener->evicted[0].flags);
+    EXPECT_EQ("KEY2", listener->evicted[1].key);
+    EXPECT_EQ("val2", listener->evicted[1].value);
+
+    // Rest gets delivered on stop
+    EXPECT_TRUE(storage.Put("KEY7", "val7", 7));
+    storage.Stop();
+    ASSERT_EQ(2, listener->batches.size());
+    ASSERT_EQ(3, listener->evicted.size());
+    EXPECT_EQ("KEY4", listener->evicted[2].key);
+    EXPECT_EQ(4, listener->evicted[2].flags);
+}
+
+TEST(StorageTest, ThreadSafeEvictionListener) {
+    ThreadSafeSimplLRU storage(8);
+    auto listener = std::make_shared<CollectListener>();
+    storage.SetEvictionListener(listener, 1);
+
+    EXPECT_TRUE(storage.Put("KEY1", "val1"));
+    EXPECT_TRUE(storage.Put("KEY2", "val2"));
+    EXPECT_TRUE(storage.PutIfAbsent("KEY3", "val3"));
+    ASSERT_EQ(2, listener->evicted.size());
+    EXPECT_EQ("KEY1", listener->evicted[0].key);
+    EXPECT_EQ("KEY2", listener->evicted[1].key);
+}
+
+TEST(StorageTest, HashSeed) {
+    WyHash h1(1), h2(1), h3(2);
+
+    std::string key;
+    for (int i = 0; i < 300; i++) {
+        EXPECT_EQ(h1(key), h2(key));
+        EXPECT_NE(h1(key), h3(key));
+        key.push_back('a' + (i % 26));
+    }
+}
+
+TEST(StorageTest, HashDistinctKeys) {
+    WyHash hash = WyHash::Random();
+
+    std::set<std::size_t> seen;
+    for (long i = 0; i < 10000; ++i) {
+        seen.insert(hash("Key " + std::to_string(i)));
+    }
+    EXPECT_EQ(10000, seen.size());
+}
+
+// Storage with manually controlled clock
+class ClockedLRU : public SimpleLRU {
+public:
+    ClockedLRU(size_t max_size) : SimpleLRU(max_size), now(1500000000) {}
+
+    std::time_t now;
+
+protected:
+    std::time_t Now() const override { return now; }
+};
+
+TEST(StorageTest, Expire) {
+    ClockedLRU storage(1024);
+    std::string value;
+    int32_t expire;
+
+    EXPECT_TRUE(storage.Put("KEY1", "val1", 0, 10));
+    EXPECT_TRUE(storage.Put("KEY2", "val2", 0, 0));
+    EXPECT_TRUE(storage.Put("KEY3", "val3", 0, storage.now + 20));
+
+    storage.now += 5;
+    EXPECT_TRUE(storage.Get("KEY1", value, nullptr, &expire));
+    EXPECT_EQ(5, expire);
+    EXPECT_TRUE(storage.Get("KEY2", value, nullptr, &expire));
+    EXPECT_EQ(0, expire);
+
+    storage.now += 5;
+    EXPECT_FALSE(storage.Get("KEY1", value));
+    EXPECT_TRUE(storage.PutIfAbsent("KEY1", "new1"));
+    EXPECT_TRUE(storage.Get("KEY1", value));
+    EXPECT_EQ("new1", value);
+
+    // Item expired in a skipped wheel turn is gone as well
+    storage.now += 1000;
+    EXPECT_FALSE(storage.Get("KEY3", value));
+    EXPECT_TRUE(storage.Get("KEY2", value));
+
+    EXPECT_TRUE(storage.Put("KEY4", "val4", 0, -1));
+    EXPECT_FALSE(storage.Get("KEY4", value));
+}
+
+TEST(StorageTest, Touch) {
+    ClockedLRU storage(1024);
+    std::string value;
+    uint32_t flags;
+    int32_t expire;
+
+    EXPECT_FALSE(storage.Touch("KEY1", 10));
+    EXPECT_TRUE(storage.Put("KEY1", "val1", 7, 10));
+    EXPECT_TRUE(storage.Put("KEY2", "val2", 0, 10));
+
+    storage.now += 8;
+    EXPECT_TRUE(storage.Touch("KEY1", 100));
+    EXPECT_TRUE(storage.GetAndTouch("KEY2", 0, value, &flags));
+    EXPECT_EQ("val2", value);
+
+    storage.now += 50;
+    EXPECT_TRUE(storage.GetAndTouch("KEY1", 300, value, &flags));
+    EXPECT_EQ("val1", value);
+    EXPECT_EQ(7, flags);
+    EXPECT_TRUE(storage.Get("KEY1", value, nullptr, &expire));
+    EXPECT_EQ(300, expire);
+    EXPECT_TRUE(storage.Get("KEY2", value, nullptr, &expire));
+    EXPECT_EQ(0, expire);
+
+    EXPECT_TRUE(storage.Touch("KEY1", -1));
+    EXPECT_FALSE(storage.Get("KEY1", value));
+    EXPECT_FALSE(storage.Touch("KEY1", 0));
+}
+
+TEST(StorageTest, ExpiredSpaceReclaimed) {
+    ClockedLRU storage(16);
+    std::string value;
+
+    EXPECT_TRUE(storage.Put("KEY1", "val1", 0, 1));
+    EXPECT_TRUE(storage.Put("KEY2", "val2"));
+    storage.now += 2;
+
+    // Expired item is removed by the wheel, so no live item gets evicted
+    EXPECT_TRUE(storage.Put("KEY3", "val3"));
+    EXPECT_TRUE(storage.Get("KEY2", value));
+    EXPECT_TRUE(storage.Get("KEY3", value));
+}
+
+TEST(StorageTest, LockFreePutGet) {
+    LockFreeLRU storage(1024);
+    std::string value;
+    uint32_t flags;
+
+    EXPECT_TRUE(storage.Put("KEY1", "val1", 1));
+    EXPECT_TRUE(storage.Put("KEY2", "val2", 2));
+    EXPECT_TRUE(storage.Put("KEY1", "new1", 3));
+    EXPECT_FALSE(storage.PutIfAbsent("KEY2", "new2"));
+    EXPECT_TRUE(storage.Set("KEY2", "set2", 4));
+    EXPECT_FALSE(storage.Set("KEY3", "set3"));
+
+    EXPECT_TRUE(storage.Get("KEY1", value, &flags));
+    EXPECT_EQ("new1", value);
+    EXPECT_EQ(3, flags);
+    EXPECT_TRUE(storage.Get("KEY2", value, &flags));
+    EXPECT_EQ("set2", value);
+    EXPECT_EQ(4, flags);
+
+    EXPECT_TRUE(storage.Delete("KEY1"));
+    EXPECT_FALSE(storage.Delete("KEY1"));
+    EXPECT_FALSE(storage.Get("KEY1", value));
+    EXPECT_TRUE(storage.PutIfAbsent("KEY1", "val1"));
+    EXPECT_TRUE(storage.Get("KEY1", value));
+    EXPECT_EQ("val1", value);
+}
+
+TEST(StorageTest, LockFreeGrow) {
+    const size_t length = 20;
+    LockFreeLRU storage(2 * 10000 * length);
+
+    for (long i = 0; i < 10000; ++i) {
+        EXPECT_TRUE(storage.Put("Key " + std::to_string(i), "Val " + std::to_string(i)));
+    }
+
+    for (long i = 0; i < 10000; ++i) {
+        std::string res;
+        EXPECT_TRUE(storage.Get("Key " + std::to_string(i), res));
+        EXPECT_EQ("Val " + std::to_string(i), res);
+    }
+}
+
+TEST(StorageTest, LockFreeEvict) {
+    LockFreeLRU storage(100);
+    auto listener = std::make_shared<CollectListener>();
+    storage.SetEvictionListener(listener, 1);
+
+    EXPECT_FALSE(storage.Put("KEY", std::string(100, 'v')));
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_TRUE(storage.Put("KEY" + std::to_string(i), "val"));
+    }
+
+    // Recent keys are there, older ones are gone and reported
+    std::string value;
+    EXPECT_TRUE(storage.Get("KEY99", value));
+    EXPECT_FALSE(storage.Get("KEY0", value));
+    EXPECT_FALSE(listener->evicted.empty());
+
+    // Referenced key gets second chance
+    for (int i = 100; i < 120; ++i) {
+        EXPECT_TRUE(storage.Get("KEY99", value));
+        EXPECT_TRUE(storage.Put("KEY" + std::to_string(i), "val"));
+    }
+    EXPECT_TRUE(storage.Get("KEY99", value));
+}
+
+// Lock-free storage with manually controlled clock
+class ClockedLockFree : public LockFreeLRU {
+public:
+    ClockedLockFree(size_t max_size) : LockFreeLRU(max_size), now(1500000000) {}
+
+    std::time_t now;
+
+protected:
+    std::time_t Now() const override { return now; }
+};
+
+TEST(StorageTest, LockFreeExpire) {
+    ClockedLockFree storage(1024);
+    std::string value;
+    int32_t expire;
+
+    EXPECT_TRUE(storage.Put("KEY1", "val1", 0, 10));
+    EXPECT_TRUE(storage.Put("KEY2", "val2", 0, 10));
+    storage.now += 5;
+    EXPECT_TRUE(storage.Get("KEY1", value, nullptr, &expire));
+    EXPECT_EQ(5, expire);
+    EXPECT_TRUE(storage.Touch("KEY2", 100));
+
+    storage.now += 5;
+    EXPECT_FALSE(storage.Get("KEY1", value));
+    EXPECT_TRUE(storage.GetAndTouch("KEY2", 0, value));
+    EXPECT_EQ("val2", value);
+    EXPECT_TRUE(storage.PutIfAbsent("KEY1", "new1"));
+}
+
+namespace {
+
+// Stores given value if item has the expected CAS token, 0 means item must not exist
+class CompareAndSwap : public Afina::ItemUpdater {
+public:
+    CompareAndSwap(uint64_t cas, const std::string &value) : cas(cas), value(value) {}
+
+    Action Apply(const Afina::ItemState *item, Afina::ItemUpdate &update) override {
+        if ((item == nullptr ? 0 : item->cas) != cas) {
+            return Action::kKeep;
+        }
+        update.value = &value;
+        update.flags = 7;
+        update.expire = 10;
+        return Action::kStore;
+    }
+
+    uint64_t cas;
+    std::string value;
+};
+
+// Marks item stale keeping its value
+class MarkStale : public Afina::ItemUpdater {
+public:
+    Action Apply(const Afina::ItemState *item, Afina::ItemUpdate &update) override {
+        seen = item != nullptr ? *item : Afina::ItemState();
+        update.stale = true;
+        return Action::kStore;
+    }
+
+    Afina::ItemState seen;
+};
+
+// Increments decimal value of the item, creates it on miss
+class Increment : public Afina::ItemUpdater {
+public:
+    Action Apply(const Afina::ItemState *item, Afina::ItemUpdate &update) override {
+        value = std::to_string(item == nullptr ? 1 : std::stoll(*item->value) + 1);
+        update.value = &value;
+        return Action::kStore;
+    }
+
+    std::string value;
+};
+
+// Deletes item unconditionally
+class Erase : public Afina::ItemUpdater {
+public:
+    Action Apply(const Afina::ItemState *item, Afina::ItemUpdate &update) override { return Action::kDelete; }
+};
+
+template <typename S> void CheckUpdate(S &storage) {
+    std::string value;
+    uint32_t flags;
+    int32_t expire;
+    uint64_t cas = 0, next = 0;
+
+    CompareAndSwap swap(1, "val1");
+    EXPECT_FALSE(storage.Update("KEY1", swap, &cas));
+    swap.cas = 0;
+    EXPECT_TRUE(storage.Update("KEY1", swap, &cas));
+    EXPECT_TRUE(storage.Get("KEY1", value, &flags, &expire));
+    EXPECT_EQ("val1", value);
+    EXPECT_EQ(7, flags);
+    EXPECT_EQ(10, expire);
+
+    // Every store changes CAS token, including regular ones
+    swap.value = "val2";
+    EXPECT_TRUE(storage.Update("KEY1", swap, &next));
+    EXPECT_EQ(cas, next);
+    swap.cas = cas;
+    EXPECT_TRUE(storage.Update("KEY1", swap, &next));
+    EXPECT_NE(cas, next);
+    cas = next;
+    EXPECT_TRUE(storage.Put("KEY1", "val3", 1, 0));
+    EXPECT_TRUE(storage.Update("KEY1", swap, &next));
+    EXPECT_NE(cas, next);
+    cas = next;
+
+    // Marks change neither value nor CAS token nor expiration time
+    MarkStale mark;
+    EXPECT_FALSE(storage.Update("KEY2", mark));
+    EXPECT_TRUE(storage.Update("KEY1", mark, &next));
+    EXPECT_EQ(cas, next);
+    EXPECT_FALSE(mark.seen.stale);
+    EXPECT_EQ(-1, mark.seen.ttl);
+    EXPECT_TRUE(storage.Update("KEY1", mark, &next));
+    EXPECT_TRUE(mark.seen.stale);
+    EXPECT_EQ("val3", *mark.seen.value);
+
+    Increment increment;
+    EXPECT_TRUE(storage.Update("KEY2", increment));
+    EXPECT_TRUE(storage.Update("KEY2", increment));
+    EXPECT_TRUE(storage.Get("KEY2", value));
+    EXPECT_EQ("2", value);
+
+    Erase erase;
+    EXPECT_TRUE(storage.Update("KEY2", erase));
+    EXPECT_FALSE(storage.Update("KEY2", erase));
+    EXPECT_FALSE(storage.Get("KEY2", value));
+}
+
+} // namespace
+
+TEST(StorageTest, Update) {
+    ClockedLRU storage(1024);
+    CheckUpdate(storage);
+}
+
+TEST(StorageTest, LockFreeUpdate) {
+    ClockedLockFree storage(1024);
+    CheckUpdate(storage);
+}
+
+// Concurrent read-modify-write never loses an update
+TEST(StorageTest, LockFreeConcurrentUpdate) {
+    const int iterations = 10000;
+    LockFreeLRU storage(1024);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&]() {
+            Increment increment;
+            for (int i = 0; i < iterations; i++) {
+                storage.Update("counter", increment);
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    std::string value;
+    EXPECT_TRUE(storage.Get("counter", value));
+    EXPECT_EQ(std::to_string(4 * iterations), value);
+}
+
+// Readers run concurrently with writers overwriting, deleting and evicting the same keys. Value always
+// carries its key, so reader could verify it never observes memory that has been freed or reused.
+// Test is meant to be run under ThreadSanitizer as well, see README
+TEST(StorageTest, LockFreeStress) {
+    const int keys = 256;
+    const int iterations = 20000;
+    LockFreeLRU storage(64 * keys / 2);
+    auto listener = std::make_shared<CollectListener>();
+    storage.SetEvictionListener(listener, 1024);
+
+    std::atomic<bool> failed(false);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; t++) {
+        threads.emplace_back([&, t]() {
+            std::string value;
+            uint32_t flags;
+            unsigned seed = t;
+            for (int i = 0; i < iterations; i++) {
+                int k = rand_r(&seed) % keys;
+                std::string key = "key" + std::to_string(k);
+                switch (rand_r(&seed) % 8) {
+                case 0:
+                    storage.Put(key, key + ":" + std::string(rand_r(&seed) % 48, 'x'), k);
+                    break;
+                case 1:
+                    storage.Delete(key);
+                    break;
+                case 2:
+                    storage.PutIfAbsent(key, key + ":", k);
+                    break;
+                case 3:
+                    storage.Set(key, key + ":set", k, rand_r(&seed) % 2 ? -1 : 0);
+                    break;
+                default:
+                    if (storage.Get(key, value, &flags) &&
+                        (value.compare(0, key.size() + 1, key + ":") != 0 || flags != uint32_t(k))) {
+                        failed = true;
+                    }
+                }
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    storage.Stop();
+
+    EXPECT_FALSE(failed);
+    for (auto &item : listener->evicted) {
+        EXPECT_EQ(0, item.value.compare(0, item.key.size() + 1, item.key + ":"));
+    }
+}
+
 std::string pad_space(const std::string &s, size_t length) {
     std::string result = s;
     result.resize(length, ' ');